@@ -13,4 +13,21 @@ if (LINKER_VERBOSE_LIBRARY_INFO)
     set(COMPILER_SHOW_HEADERS_CMD "-H")
 else ()
     set(COMPILER_SHOW_HEADERS_CMD "")
-endif ()
\ No newline at end of file
+endif ()
+# Without the ARM toolchain the tree configures as a host-native build of the
+# clamp_meter modules against mocked peripherals (src/host).
+find_program(ARM_GCC_EXECUTABLE NAMES arm-none-eabi-gcc
+             HINTS "C:/dev/tools/arm_gcc_toolchain/10 2021.10/bin"
+             "C:/Program Files (x86)/Atmel/Studio/7.0/toolchain/arm/arm-gnu-toolchain/bin")
+
+if (ARM_GCC_EXECUTABLE)
+    set(CLAMP_METER_HOST_BUILD_DEFAULT OFF)
+else ()
+    set(CLAMP_METER_HOST_BUILD_DEFAULT ON)
+    if (NOT DEFINED CLAMP_METER_HOST_BUILD)
+        message(WARNING "arm-none-eabi-gcc not found, building clamp_meter for the host. "
+                        "Pass -DCLAMP_METER_HOST_BUILD=ON to select the host build explicitly.")
+    endif ()
+endif ()
+
+option(CLAMP_METER_HOST_BUILD "build clamp_meter natively for the host" ${CLAMP_METER_HOST_BUILD_DEFAULT})
@@ -0,0 +1,170 @@
+#include "asf.h"
+#include "DSP_calibration.h"
+#include "menu_calibration.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_CAL_SENSORS 3
+
+typedef struct {
+    /* the state the factors were built for */
+    bool        valid;
+    gain_type_t adc_gain[DSP_CAL_SENSORS];   /* see sensor_adc_gain() */
+    uint8_t     shunt_sensor_gain;
+    uint8_t     clamp_sensor_gain;
+    bool        clamp_pos_calibrated;
+    float32_t   clamp_pos_gain;
+
+    Dsp_cal_factor_t factor[DSP_CAL_SENSORS];   /* by sensor_type_t */
+    uint32_t         rebuilds;
+} Dsp_cal_cache_t;
+
+static Dsp_cal_cache_t cal_cache;
+/* the last factor asked for at other than the current gains, see dsp_calibration_for() */
+static Dsp_gain_state_t other_gain;
+static Dsp_cal_factor_t other_factor;
+static bool             other_valid;
+
+static void
+set_factor(Dsp_cal_factor_t *factor, float32_t gain, float32_t phi)
+{
+    factor->gain_inv   = 1 / gain;
+    factor->correction = complex_polar(factor->gain_inv, -phi);
+    factor->phi        = phi;
+}
+
+static void
+build_factor(Dsp_cal_factor_t *factor, const Dsp_gain_state_t *gain)
+{
+    float32_t adc_gain = adc_gain_coeffs[gain->adc_gain];
+    float32_t clamp_gain;
+
+    if (gain->sensor == VOLTAGE_SENSOR)
+        set_factor(factor, Cal_data.v_sens_gain * adc_gain, Cal_data.v_sens_phi);
+    else if (gain->sensor == SHUNT_SENSOR)
+        set_factor(factor, Cal_data.shunt_gain[gain->sensor_gain] * adc_gain, Cal_data.shunt_phi[gain->sensor_gain]);
+    else {
+        clamp_gain = Cal_data.clamp_gain[gain->sensor_gain] * adc_gain;
+
+        if (Clamp_calibrator.is_calibrated)
+            clamp_gain /= Clamp_calibrator.position_gain;
+
+        set_factor(factor, clamp_gain, Cal_data.clamp_phi[gain->sensor_gain]);
+    }
+}
+
+static bool
+adc_gains_changed(void)
+{
+    sensor_type_t sensor;
+
+    for (sensor = SHUNT_SENSOR; sensor < DSP_CAL_SENSORS; sensor++) {
+        if (cal_cache.adc_gain[sensor] != sensor_adc_gain(sensor))
+            return true;
+    }
+
+    return false;
+}
+
+static void
+rebuild(void)
+{
+    sensor_type_t    sensor;
+    Dsp_gain_state_t gain;
+
+    for (sensor = SHUNT_SENSOR; sensor < DSP_CAL_SENSORS; sensor++) {
+        gain = dsp_gain_state(sensor, sensor_adc_gain(sensor));
+        build_factor(&cal_cache.factor[sensor], &gain);
+        cal_cache.adc_gain[sensor] = gain.adc_gain;
+    }
+
+    cal_cache.shunt_sensor_gain    = Analog.shunt_sensor_gain;
+    cal_cache.clamp_sensor_gain    = Analog.clamp_sensor_gain;
+    cal_cache.clamp_pos_calibrated = Clamp_calibrator.is_calibrated;
+    cal_cache.clamp_pos_gain       = Clamp_calibrator.position_gain;
+    cal_cache.valid                = true;
+    cal_cache.rebuilds++;
+}
+
+const Dsp_cal_factor_t *
+dsp_calibration(sensor_type_t sensor)
+{
+    if (!cal_cache.valid || adc_gains_changed() ||
+        cal_cache.shunt_sensor_gain != Analog.shunt_sensor_gain ||
+        cal_cache.clamp_sensor_gain != Analog.clamp_sensor_gain ||
+        cal_cache.clamp_pos_calibrated != Clamp_calibrator.is_calibrated ||
+        cal_cache.clamp_pos_gain != Clamp_calibrator.position_gain) {
+        rebuild();
+        other_valid = false;
+    }
+
+    return &cal_cache.factor[sensor];
+}
+
+/* the gains of a sensor as they are set now, with the ADC at adc_gain */
+Dsp_gain_state_t
+dsp_gain_state(sensor_type_t sensor, gain_type_t adc_gain)
+{
+    Dsp_gain_state_t gain;
+
+    gain.sensor   = sensor;
+    gain.adc_gain = adc_gain;
+
+    if (sensor == SHUNT_SENSOR)
+        gain.sensor_gain = Analog.shunt_sensor_gain;
+    else if (sensor == CLAMP_SENSOR)
+        gain.sensor_gain = Analog.clamp_sensor_gain;
+    else
+        gain.sensor_gain = 0;
+
+    return gain;
+}
+
+bool
+dsp_gain_state_equal(const Dsp_gain_state_t *a, const Dsp_gain_state_t *b)
+{
+    return a->sensor == b->sensor && a->adc_gain == b->adc_gain && a->sensor_gain == b->sensor_gain;
+}
+
+/*
+ * For data taken at other gains than the current ones, which is the case
+ * for a block or two after every gain switch. The cache holds one such
+ * state besides the current ones.
+ */
+const Dsp_cal_factor_t *
+dsp_calibration_for(const Dsp_gain_state_t *gain)
+{
+    const Dsp_cal_factor_t *factor  = dsp_calibration(gain->sensor);
+    Dsp_gain_state_t        current = dsp_gain_state(gain->sensor, cal_cache.adc_gain[gain->sensor]);
+
+    if (dsp_gain_state_equal(gain, &current))
+        return factor;
+
+    if (!other_valid || !dsp_gain_state_equal(gain, &other_gain)) {
+        build_factor(&other_factor, gain);
+        other_gain  = *gain;
+        other_valid = true;
+    }
+
+    return &other_factor;
+}
+
+void
+dsp_calibration_changed(void)
+{
+    cal_cache.valid = false;
+    other_valid     = false;
+}
+
+/* for the tests: how often the factors were computed */
+uint32_t
+dsp_calibration_rebuilds(void)
+{
+    return cal_cache.rebuilds;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef DSP_CALIBRATION_H_
+#define DSP_CALIBRATION_H_
+#include "arm_math.h"
+#include "DSP_complex.h"
+#include "signal_conditioning.h"
+
+/*
+ * Calibration of the three sensors at the current gain state, folded into
+ * one factor per sensor: the lock-in vector times correction is the sensor
+ * vector in volts (amps for the clamp), phase corrected; |vector| times
+ * gain_inv is its magnitude.
+ *
+ * The factors are rebuilt by dsp_calibration() when the ADC gain of a sensor
+ * (sensor_adc_gain(), one per sensor while scanning), a sensor gain or the
+ * clamp position calibration differ from what they were built for, and after
+ * dsp_calibration_changed(), which every writer of Cal_data has to call. All
+ * three sensors are kept, so switching between them does not rebuild
+ * anything. Per-frequency or per-temperature tables would be looked up here
+ * as well.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float32_t gain_inv;
+    Complex_t correction;   /* gain_inv * e^(-j phi) */
+    float32_t phi;          /* degrees, for the displayed phases */
+} Dsp_cal_factor_t;
+
+/* the gain settings a reading was taken with */
+typedef struct {
+    sensor_type_t sensor;
+    gain_type_t   adc_gain;
+    uint8_t       sensor_gain;   /* shunt or clamp front end; 0 for the voltage sensor */
+} Dsp_gain_state_t;
+
+const Dsp_cal_factor_t *dsp_calibration(sensor_type_t sensor);
+const Dsp_cal_factor_t *dsp_calibration_for(const Dsp_gain_state_t *gain);
+Dsp_gain_state_t        dsp_gain_state(sensor_type_t sensor, gain_type_t adc_gain);
+bool                    dsp_gain_state_equal(const Dsp_gain_state_t *a, const Dsp_gain_state_t *b);
+void                    dsp_calibration_changed(void);
+uint32_t                dsp_calibration_rebuilds(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_CALIBRATION_H_ */
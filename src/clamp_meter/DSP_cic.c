@@ -0,0 +1,102 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_cic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int32_t cic_sin_ref[SINTABLE_LEN];
+int32_t cic_cos_ref[SINTABLE_LEN];
+
+/* CIC gain FIR_DEC_FACTOR^CIC_ORDER and the reference scale, back to ADC codes */
+static float32_t cic_norm;
+
+void
+dsp_cic_init(void)
+{
+    uint16_t idx;
+    uint32_t gain = 1;
+
+    for (idx = 0; idx < SINTABLE_LEN; idx++) {
+        cic_sin_ref[idx] = (int32_t)lroundf(sin_table[idx] * (1 << CIC_REF_SHIFT));
+        cic_cos_ref[idx] = (int32_t)lroundf(cos_table[idx] * (1 << CIC_REF_SHIFT));
+    }
+
+    for (idx = 0; idx < CIC_ORDER; idx++)
+        gain *= FIR_DEC_FACTOR;
+
+    cic_norm = 1.0f / ((float32_t)gain * (1 << CIC_REF_SHIFT));
+}
+
+void
+dsp_cic_reset(Cic_t *cic)
+{
+    memset(cic, 0, sizeof(*cic));
+}
+
+static inline float32_t
+cic_comb(uint64_t *comb, uint64_t value)
+{
+    uint64_t delayed;
+    uint16_t stage;
+
+    for (stage = 0; stage < CIC_ORDER; stage++) {
+        delayed     = comb[stage];
+        comb[stage] = value;
+        value -= delayed;
+    }
+
+    return (float32_t)(int64_t)value * cic_norm;
+}
+
+/*
+ * raw[0] was taken at table index phase. Returns the number of decimated
+ * outputs written to sin_out/cos_out; the decimation phase carries over
+ * between calls, so the input may be cut anywhere (one sample per call from
+ * the ADC interrupt, whole blocks from do_filter()).
+ */
+uint32_t
+dsp_cic_process(Cic_t         *cic,
+                const int32_t *raw,
+                uint32_t       phase,
+                uint32_t       len,
+                float32_t     *sin_out,
+                float32_t     *cos_out)
+{
+    uint32_t outputs = 0;
+    uint64_t sin_acc;
+    uint64_t cos_acc;
+    uint16_t stage;
+
+    while (len--) {
+        sin_acc = (uint64_t)((int64_t)*raw * cic_sin_ref[phase]);
+        cos_acc = (uint64_t)((int64_t)*raw * cic_cos_ref[phase]);
+        raw++;
+
+        for (stage = 0; stage < CIC_ORDER; stage++) {
+            sin_acc += cic->sin_integ[stage];
+            cos_acc += cic->cos_integ[stage];
+            cic->sin_integ[stage] = sin_acc;
+            cic->cos_integ[stage] = cos_acc;
+        }
+
+        if (++phase == SINTABLE_LEN)
+            phase = 0;
+
+        if (++cic->count < FIR_DEC_FACTOR)
+            continue;
+
+        cic->count = 0;
+
+        *sin_out++ = cic_comb(cic->sin_comb, sin_acc);
+        *cos_out++ = cic_comb(cic->cos_comb, cos_acc);
+        outputs++;
+    }
+
+    return outputs;
+}
+
+#ifdef __cplusplus
+}
+#endif
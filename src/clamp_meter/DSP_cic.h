@@ -0,0 +1,45 @@
+#ifndef DSP_CIC_H_
+#define DSP_CIC_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+
+/*
+ * Mixer and CIC decimator in place of biquad1 -> firdec1: the ADC code is
+ * multiplied by integer references and runs through CIC_ORDER integrators at
+ * the ADC rate and CIC_ORDER combs at the decimated rate, integer additions
+ * only. The integrators wrap around; with two's complement that is harmless
+ * as long as the result fits, which needs
+ *   24 (ADC) + CIC_REF_SHIFT + CIC_ORDER * log2(FIR_DEC_FACTOR) < 64 bits.
+ *
+ * The nulls of the CIC sit on the multiples of the decimated rate, so all
+ * that folds onto DC is rejected; the passband droop is corrected by
+ * cic_comp_coeffs at the decimated rate, in do_filter().
+ */
+#define CIC_ORDER     4
+#define CIC_REF_SHIFT 23
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t sin_integ[CIC_ORDER];
+    uint64_t cos_integ[CIC_ORDER];
+    uint64_t sin_comb[CIC_ORDER];
+    uint64_t cos_comb[CIC_ORDER];
+    uint32_t count;
+} Cic_t;
+
+void     dsp_cic_init(void);
+void     dsp_cic_reset(Cic_t *cic);
+uint32_t dsp_cic_process(Cic_t         *cic,
+                         const int32_t *raw,
+                         uint32_t       phase,
+                         uint32_t       len,
+                         float32_t     *sin_out,
+                         float32_t     *cos_out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_CIC_H_ */
@@ -0,0 +1,124 @@
+#ifndef DSP_COMPLEX_H_
+#define DSP_COMPLEX_H_
+#include "arm_math.h"
+
+/*
+ * I/Q phasors for the result math. Sensor vectors, calibration corrections,
+ * V_applied and the admittances stay in rectangular form; magnitude and
+ * phase are only taken where a value is displayed. Plain structs passed by
+ * value, so that several channels can be laid out as arrays of them.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float32_t I;
+    float32_t Q;
+} Complex_t;
+
+static inline Complex_t
+complex_make(float32_t I, float32_t Q)
+{
+    Complex_t z;
+
+    z.I = I;
+    z.Q = Q;
+
+    return z;
+}
+
+/* mag at phi degrees, as arm_sin_cos_f32() takes them */
+static inline Complex_t
+complex_polar(float32_t mag, float32_t phi)
+{
+    float32_t sine;
+    float32_t cosine;
+
+    arm_sin_cos_f32(phi, &sine, &cosine);
+
+    return complex_make(mag * cosine, mag * sine);
+}
+
+static inline Complex_t
+complex_add(Complex_t a, Complex_t b)
+{
+    return complex_make(a.I + b.I, a.Q + b.Q);
+}
+
+static inline Complex_t
+complex_sub(Complex_t a, Complex_t b)
+{
+    return complex_make(a.I - b.I, a.Q - b.Q);
+}
+
+static inline Complex_t
+complex_scale(Complex_t a, float32_t k)
+{
+    return complex_make(a.I * k, a.Q * k);
+}
+
+static inline Complex_t
+complex_conj(Complex_t a)
+{
+    return complex_make(a.I, -a.Q);
+}
+
+static inline Complex_t
+complex_mul(Complex_t a, Complex_t b)
+{
+    return complex_make(a.I * b.I - a.Q * b.Q, a.I * b.Q + a.Q * b.I);
+}
+
+/* a * conj(b), the phase difference of a and b without a division */
+static inline Complex_t
+complex_mul_conj(Complex_t a, Complex_t b)
+{
+    return complex_make(a.I * b.I + a.Q * b.Q, a.Q * b.I - a.I * b.Q);
+}
+
+/* |a|^2 */
+static inline float32_t
+complex_norm(Complex_t a)
+{
+    return a.I * a.I + a.Q * a.Q;
+}
+
+static inline float32_t
+complex_abs(Complex_t a)
+{
+    float32_t abs_val;
+
+    arm_sqrt_f32(complex_norm(a), &abs_val);
+
+    return abs_val;
+}
+
+/* a / b; b_norm is |b|^2 when the caller has it already */
+static inline Complex_t
+complex_div_norm(Complex_t a, Complex_t b, float32_t b_norm)
+{
+    return complex_scale(complex_mul_conj(a, b), 1 / b_norm);
+}
+
+static inline Complex_t
+complex_div(Complex_t a, Complex_t b)
+{
+    return complex_div_norm(a, b, complex_norm(b));
+}
+
+/* a / |a| given |a|; 1 for a zero vector, which has no phase */
+static inline Complex_t
+complex_unit(Complex_t a, float32_t abs_val)
+{
+    if (abs_val == 0)
+        return complex_make(1, 0);
+
+    return complex_scale(a, 1 / abs_val);
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_COMPLEX_H_ */
@@ -0,0 +1,246 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_correlator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t
+dsp_correlator_periods(uint32_t integrator_len)
+{
+    /* the same span as integrator_len cascade outputs, in whole periods */
+    uint32_t periods = (integrator_len * BIQUAD1_BUFFSIZE + SINTABLE_LEN / 2) / SINTABLE_LEN;
+
+    if (periods < CORRELATOR_MIN_PERIODS)
+        periods = CORRELATOR_MIN_PERIODS;
+
+    return periods;
+}
+
+void
+dsp_correlator_reset(Correlator_t *corr, uint32_t window_periods)
+{
+    corr->sin_tone        = sin_table;
+    corr->cos_tone        = cos_table;
+    corr->sin_acc         = 0;
+    corr->cos_acc         = 0;
+    corr->period_sin      = 0;
+    corr->period_cos      = 0;
+    corr->periods         = 0;
+    corr->window_periods  = window_periods;
+    corr->last_period_sin = 0;
+    corr->last_period_cos = 0;
+
+    corr->sin_ref            = 0;
+    corr->cos_ref            = 0;
+    corr->sin_dev            = 0;
+    corr->cos_dev            = 0;
+    corr->sin_sq             = 0;
+    corr->cos_sq             = 0;
+    corr->uncertainty_target = 0;
+    corr->mag_uncertainty    = 1;
+    corr->phi_uncertainty    = PI;
+    corr->has_final          = false;
+}
+
+/* after the reset, which goes back to the excitation */
+void
+dsp_correlator_set_tone(Correlator_t *corr, float32_t *sin_tone, float32_t *cos_tone)
+{
+    corr->sin_tone = sin_tone;
+    corr->cos_tone = cos_tone;
+}
+
+static void
+correlator_uncertainty(Correlator_t *corr, float32_t *mag_rel, float32_t *phi_rad)
+{
+    float32_t n = corr->periods;
+    float32_t sin_var;
+    float32_t cos_var;
+
+    if (corr->periods < 2) {
+        *mag_rel = 1;
+        *phi_rad = PI;
+        return;
+    }
+
+    /* variance of the mean of n period values */
+    sin_var = (corr->sin_sq - corr->sin_dev * corr->sin_dev / n) / ((n - 1) * n);
+    cos_var = (corr->cos_sq - corr->cos_dev * corr->cos_dev / n) / ((n - 1) * n);
+
+    dsp_vector_uncertainty(corr->sin_ref + corr->sin_dev / n,
+                           corr->cos_ref + corr->cos_dev / n,
+                           sin_var,
+                           cos_var,
+                           mag_rel,
+                           phi_rad);
+}
+
+static inline void
+correlator_update_stats(Correlator_t *corr)
+{
+    float32_t sin_d;
+    float32_t cos_d;
+
+    /* deviations from the first period, so the squares don't cancel against the mean */
+    if (corr->periods == 1) {
+        corr->sin_ref = corr->last_period_sin;
+        corr->cos_ref = corr->last_period_cos;
+    }
+
+    sin_d = corr->last_period_sin - corr->sin_ref;
+    cos_d = corr->last_period_cos - corr->cos_ref;
+
+    corr->sin_dev += sin_d;
+    corr->cos_dev += cos_d;
+    corr->sin_sq += sin_d * sin_d;
+    corr->cos_sq += cos_d * cos_d;
+}
+
+static inline bool
+correlator_window_done(Correlator_t *corr)
+{
+    float32_t mag_rel;
+    float32_t phi_rad;
+
+    if (corr->periods >= corr->window_periods)
+        return true;
+
+    if (corr->uncertainty_target <= 0 || corr->periods < CORRELATOR_MIN_PERIODS)
+        return false;
+
+    correlator_uncertainty(corr, &mag_rel, &phi_rad);
+
+    return mag_rel <= corr->uncertainty_target && phi_rad <= corr->uncertainty_target;
+}
+
+/*
+ * raw[0] was taken at table index phase. Returns true when a window has been
+ * completed in this block; the window averages are then in sin_vect/cos_vect
+ * and their uncertainty in mag_uncertainty/phi_uncertainty. A window is at
+ * least CORRELATOR_MIN_PERIODS long, so one block can never complete two of
+ * them.
+ */
+bool
+dsp_correlator_process(Correlator_t *corr,
+                       float32_t    *raw,
+                       uint32_t      phase,
+                       uint32_t      len,
+                       float32_t    *sin_vect,
+                       float32_t    *cos_vect)
+{
+    bool      window_done = false;
+    float32_t dot;
+    uint32_t  seg;
+
+    while (len) {
+        /* up to the end of the current period */
+        seg = SINTABLE_LEN - phase;
+
+        if (seg > len)
+            seg = len;
+
+        arm_dot_prod_f32(raw, &corr->sin_tone[phase], seg, &dot);
+        corr->period_sin += dot;
+        arm_dot_prod_f32(raw, &corr->cos_tone[phase], seg, &dot);
+        corr->period_cos += dot;
+
+        raw += seg;
+        len -= seg;
+        phase += seg;
+
+        if (phase < SINTABLE_LEN)
+            break;
+
+        phase = 0;
+
+        corr->last_period_sin = corr->period_sin / SINTABLE_LEN;
+        corr->last_period_cos = corr->period_cos / SINTABLE_LEN;
+        corr->sin_acc += corr->period_sin;
+        corr->cos_acc += corr->period_cos;
+        corr->period_sin = 0;
+        corr->period_cos = 0;
+
+        corr->periods++;
+        correlator_update_stats(corr);
+
+        if (correlator_window_done(corr)) {
+            float64_t norm = 1.0 / ((float64_t)corr->periods * SINTABLE_LEN);
+
+            *sin_vect = (float32_t)(corr->sin_acc * norm);
+            *cos_vect = (float32_t)(corr->cos_acc * norm);
+            correlator_uncertainty(corr, &corr->mag_uncertainty, &corr->phi_uncertainty);
+
+            corr->sin_acc   = 0;
+            corr->cos_acc   = 0;
+            corr->periods   = 0;
+            corr->sin_dev   = 0;
+            corr->cos_dev   = 0;
+            corr->sin_sq    = 0;
+            corr->cos_sq    = 0;
+            corr->has_final = true;
+            window_done     = true;
+        }
+    }
+
+    return window_done;
+}
+
+/*
+ * The input has been multiplied by ratio (a gain switch): the sums follow
+ * exactly, the spread only in magnitude.
+ */
+void
+dsp_correlator_rotate(Correlator_t *corr, Complex_t ratio)
+{
+    float64_t sin_acc   = corr->sin_acc;
+    float32_t sin_val   = corr->period_sin;
+    float32_t mag_sq    = complex_norm(ratio);
+    Complex_t rotated;
+
+    corr->sin_acc = corr->cos_acc * ratio.Q + sin_acc * ratio.I;
+    corr->cos_acc = corr->cos_acc * ratio.I - sin_acc * ratio.Q;
+
+    corr->period_sin = corr->period_cos * ratio.Q + sin_val * ratio.I;
+    corr->period_cos = corr->period_cos * ratio.I - sin_val * ratio.Q;
+
+    rotated               = complex_mul(complex_make(corr->last_period_cos, corr->last_period_sin), ratio);
+    corr->last_period_cos = rotated.I;
+    corr->last_period_sin = rotated.Q;
+
+    rotated       = complex_mul(complex_make(corr->cos_ref, corr->sin_ref), ratio);
+    corr->cos_ref = rotated.I;
+    corr->sin_ref = rotated.Q;
+
+    rotated       = complex_mul(complex_make(corr->cos_dev, corr->sin_dev), ratio);
+    corr->cos_dev = rotated.I;
+    corr->sin_dev = rotated.Q;
+
+    corr->sin_sq *= mag_sq;
+    corr->cos_sq *= mag_sq;
+}
+
+/*
+ * Provisional average of the window in progress, until the first window has
+ * been completed. Returns false when there is nothing (new) to show.
+ */
+bool
+dsp_correlator_estimate(Correlator_t *corr, float32_t *sin_vect, float32_t *cos_vect)
+{
+    float64_t norm;
+
+    if (corr->has_final || corr->periods < CORRELATOR_MIN_PERIODS)
+        return false;
+
+    norm      = 1.0 / ((float64_t)corr->periods * SINTABLE_LEN);
+    *sin_vect = (float32_t)(corr->sin_acc * norm);
+    *cos_vect = (float32_t)(corr->cos_acc * norm);
+    correlator_uncertainty(corr, &corr->mag_uncertainty, &corr->phi_uncertainty);
+
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+#ifndef DSP_CORRELATOR_H_
+#define DSP_CORRELATOR_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+#include "DSP_complex.h"
+
+/*
+ * Period synchronous single-bin DFT. The excitation is generated from the
+ * same SINTABLE_LEN table and clocked by the ADC data ready line, so every
+ * period is exactly SINTABLE_LEN samples: correlating against sin/cos over a
+ * whole number of periods cancels the 2f mixing product, DC and all other
+ * harmonics exactly, without a filter to settle.
+ *
+ * The result has the units of the filter cascade output (A/2 for an input of
+ * amplitude A), so it feeds manage_sensed_data() unchanged.
+ *
+ * The per-period values are independent samples of the same vector, so their
+ * spread gives the uncertainty of the window average directly. With a non
+ * zero uncertainty_target a window is closed as soon as it is reached.
+ *
+ * The reference is one period of the excitation (sin_table / cos_table)
+ * after a reset; dsp_correlator_set_tone() swaps in another tone with a
+ * whole number of periods in SINTABLE_LEN samples (DSP_DUAL_TONE).
+ */
+#define CORRELATOR_MIN_PERIODS 5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    /* SINTABLE_LEN points of the tone correlated against */
+    float32_t *sin_tone;
+    float32_t *cos_tone;
+
+    float64_t sin_acc;
+    float64_t cos_acc;
+    float32_t period_sin;
+    float32_t period_cos;
+    uint32_t  periods;
+    uint32_t  window_periods;
+
+    /* last whole period, for a fast running estimate (buzzer) */
+    float32_t last_period_sin;
+    float32_t last_period_cos;
+
+    /* spread of the period values, around the first one of the window */
+    float32_t sin_ref;
+    float32_t cos_ref;
+    float32_t sin_dev;
+    float32_t cos_dev;
+    float32_t sin_sq;
+    float32_t cos_sq;
+
+    /* 0 closes windows at window_periods only */
+    float32_t uncertainty_target;
+    /* of the last result: relative and in rad, see dsp_vector_uncertainty() */
+    float32_t mag_uncertainty;
+    float32_t phi_uncertainty;
+    bool      has_final;
+} Correlator_t;
+
+uint32_t dsp_correlator_periods(uint32_t integrator_len);
+void     dsp_correlator_reset(Correlator_t *corr, uint32_t window_periods);
+void     dsp_correlator_set_tone(Correlator_t *corr, float32_t *sin_tone, float32_t *cos_tone);
+bool     dsp_correlator_process(Correlator_t *corr,
+                                float32_t    *raw,
+                                uint32_t      phase,
+                                uint32_t      len,
+                                float32_t    *sin_vect,
+                                float32_t    *cos_vect);
+bool     dsp_correlator_estimate(Correlator_t *corr, float32_t *sin_vect, float32_t *cos_vect);
+void     dsp_correlator_rotate(Correlator_t *corr, Complex_t ratio);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_CORRELATOR_H_ */
@@ -9,11 +9,22 @@
 #include "arm_math.h"
 #include "fastmath.h"
 #include "DSP_functions.h"
+#include "DSP_q31.h"
+#include "DSP_correlator.h"
+#include "DSP_harmonics.h"
+#include "DSP_cic.h"
+#include "DSP_halfband.h"
+#include "DSP_quadrature.h"
+#include "DSP_queue.h"
+#include "DSP_complex.h"
+#include "DSP_calibration.h"
 #include "MCP3462.h"
 #include "pio.h"
 #include "system_init.h"
 #include "signal_conditioning.h"
 #include "menu_calibration.h"
+#include "profiler.h"
+#include "sweep.h"
 
 // #define TEST_DATA_LEN 100
 #ifdef __cplusplus
@@ -21,17 +32,24 @@ extern "C" {
 #endif
 
 void manage_sensed_data(float32_t sin_vect, float32_t cos_vect);
+#ifdef DSP_DUAL_TONE
+void manage_tone2_data(float32_t sin_vect, float32_t cos_vect);
+#endif
 
 volatile float32_t g_costable_f[DACC_PACKETLEN];
 volatile float32_t g_sintable_f[DACC_PACKETLEN];
 
 uint16_t biquad1_counter = 0;
 
+/* g_sintable is one of them, the PDC reads the other until the next period */
+static uint16_t dacc_tables[2][DACC_PACKETLEN];
+/* g_sintable is queued at the PDC next pointer, the other table still plays */
+static volatile bool dacc_swap_pending;
+
 pdc_packet_t g_dacc_packet;
 pdc_packet_t g_dacc_next_packet;
 Pdc         *g_dacc_pdc_base;
-uint16_t     g_sintable[DACC_PACKETLEN];
-bool         decimator_databuff_is_ready;
+uint16_t    *g_sintable = dacc_tables[0];
 bool         fir2_dataready_flag;
 uint32_t     test_counter_dacc;
 uint32_t     test_counter_adc;
@@ -48,16 +66,61 @@ uint16_t my_counter = 0;
 uint32_t  phase_counter;
 float32_t adc_sin_prod;
 float32_t adc_cos_prod;
-bool      use_next_buffer = false;
+
+/* completed blocks from the ADC interrupt to do_filter() */
+Dsp_queue_t block_queue;
+/* blocks left before the integrator window is clear of the last dropped one */
+static uint32_t data_lost_blocks;
+static uint32_t data_lost_seen;
+/* filtered since the filters were last reset */
+static uint32_t restart_blocks;
 
 float32_t fir1_sin[FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
 float32_t fir1_cos[FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
 float32_t fir2_sin[FIR2_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
 float32_t fir2_cos[FIR2_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
-float32_t biquad1_sin_buff_A[BIQUAD1_BUFFSIZE];
-float32_t biquad1_cos_buff_A[BIQUAD1_BUFFSIZE];
-float32_t biquad1_sin_buff_B[BIQUAD1_BUFFSIZE];
-float32_t biquad1_cos_buff_B[BIQUAD1_BUFFSIZE];
+#ifdef DSP_Q31
+typedef q31_t     adc_raw_t;
+#define ADC_RAW(code) dsp_q31_from_adc(code)
+#elif defined(DSP_CIC)
+typedef int32_t   adc_raw_t;
+#define ADC_RAW(code) (code)
+#else
+typedef float32_t adc_raw_t;
+#define ADC_RAW(code) ((float32_t)(code))
+#endif
+
+#ifdef DSP_BLOCK_MIXER
+adc_raw_t adc_raw_queue[DSP_QUEUE_LEN][BIQUAD1_BUFFSIZE];
+uint32_t  adc_raw_phase[DSP_QUEUE_LEN];
+#if !defined(DSP_Q31) && !defined(DSP_CIC) && !defined(DSP_QUADRATURE)
+float32_t mixer_sin_ref[MIXER_REF_LEN];
+float32_t mixer_cos_ref[MIXER_REF_LEN];
+float32_t biquad1_sin_buff[BIQUAD1_BUFFSIZE];
+float32_t biquad1_cos_buff[BIQUAD1_BUFFSIZE];
+#endif
+#elif defined(DSP_CIC)
+float32_t cic_sin_queue[DSP_QUEUE_LEN][CIC_COMP_BLOCKSIZE];
+float32_t cic_cos_queue[DSP_QUEUE_LEN][CIC_COMP_BLOCKSIZE];
+#else
+float32_t biquad1_sin_queue[DSP_QUEUE_LEN][BIQUAD1_BUFFSIZE];
+float32_t biquad1_cos_queue[DSP_QUEUE_LEN][BIQUAD1_BUFFSIZE];
+#endif
+#if defined(DSP_CIC) && defined(DSP_BLOCK_MIXER)
+float32_t cic_sin_buff[CIC_COMP_BLOCKSIZE];
+float32_t cic_cos_buff[CIC_COMP_BLOCKSIZE];
+#endif
+#ifdef DSP_HALFBAND
+float32_t halfband1_sin[HALFBAND2_BLOCKSIZE];
+float32_t halfband1_cos[HALFBAND2_BLOCKSIZE];
+#endif
+#if defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+/* halfband or quadrature mixer output */
+float32_t halfband2_sin[POLY1_DEC_BLOCKSIZE];
+float32_t halfband2_cos[POLY1_DEC_BLOCKSIZE];
+float32_t poly1_sin[POLY2_DEC_BLOCKSIZE];
+float32_t poly1_cos[POLY2_DEC_BLOCKSIZE];
+#endif
 float32_t biquad2_sin[FIR2_DEC_BLOCKSIZE];
 float32_t biquad2_cos[FIR2_DEC_BLOCKSIZE];
 float32_t biquad3_sin;
@@ -78,70 +141,458 @@ arm_biquad_cascade_df2T_instance_f32 biquad2_cos_inst;
 arm_biquad_cascade_df2T_instance_f32 biquad3_sin_inst;
 arm_biquad_cascade_df2T_instance_f32 biquad3_cos_inst;
 
+#ifdef DSP_CIC
+Cic_t                cic;
+arm_fir_instance_f32 cic_comp_sin_inst;
+arm_fir_instance_f32 cic_comp_cos_inst;
+#endif
+
+#ifdef DSP_HALFBAND
+Halfband_t                    halfband1_sin_inst;
+Halfband_t                    halfband1_cos_inst;
+Halfband_t                    halfband2_sin_inst;
+Halfband_t                    halfband2_cos_inst;
+#endif
+#ifdef DSP_QUADRATURE
+Quadrature_t quadrature;
+#endif
+#if defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+arm_fir_decimate_instance_f32 poly1_sin_inst;
+arm_fir_decimate_instance_f32 poly1_cos_inst;
+arm_fir_decimate_instance_f32 poly2_sin_inst;
+arm_fir_decimate_instance_f32 poly2_cos_inst;
+#endif
+
+/* history of the float cascade, see Scan_bank_t */
+typedef struct {
+#ifdef DSP_CIC
+    float32_t cic_comp_statebuff_sin[CIC_COMP_BLOCKSIZE + CIC_COMP_NCOEFFS - 1];
+    float32_t cic_comp_statebuff_cos[CIC_COMP_BLOCKSIZE + CIC_COMP_NCOEFFS - 1];
+#endif
+#if defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+    float32_t poly1_statebuff_sin[POLY1_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+    float32_t poly1_statebuff_cos[POLY1_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+    float32_t poly2_statebuff_sin[POLY2_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+    float32_t poly2_statebuff_cos[POLY2_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+#endif
+    float32_t fir1_statebuff_sin[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    float32_t fir1_statebuff_cos[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    float32_t fir2_statebuff_sin[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
+    float32_t fir2_statebuff_cos[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
+    float32_t biquad1_statebuff_sin[BIQUAD1_NSTAGES * 2];
+    float32_t biquad1_statebuff_cos[BIQUAD1_NSTAGES * 2];
+    float32_t biquad2_statebuff_sin[BIQUAD2_NSTAGES * 2];
+    float32_t biquad2_statebuff_cos[BIQUAD2_NSTAGES * 2];
+    float32_t biquad3_statebuff_sin[BIQUAD3_NSTAGES * 2];
+    float32_t biquad3_statebuff_cos[BIQUAD3_NSTAGES * 2];
+} Filter_state_t;
+
+static Filter_state_t filter_state;
+
+/* the biquad3 coefficient sets the profiles choose from, see Dsp_profile_cfg_t */
+#define OUTPUT_STAGE_NARROW 0
+#define OUTPUT_STAGE_WIDE   1
+#define OUTPUT_STAGES       2
+
+#ifdef DSP_CORRELATOR
+Correlator_t correlator;
+#ifdef DSP_DUAL_TONE
+/* the second tone of the excitation, on the same blocks */
+Correlator_t correlator_tone2;
+
+static float32_t tone2_sin_table[SINTABLE_LEN];
+static float32_t tone2_cos_table[SINTABLE_LEN];
+#endif
+#else
+#ifdef DSP_Q31
+typedef q31_t     integ_sample_t;
+typedef q63_t     integ_sum_t;
+#else
+typedef float32_t integ_sample_t;
+typedef float32_t integ_sum_t;
+#endif
+
+/*
+ * sliding window over the last integrator_len cascade outputs. The spread of
+ * the window is tracked in float around ref (the window mean at the last
+ * rebuild) so the sums of squares don't cancel out against the mean.
+ */
+typedef struct {
+    integ_sample_t sin_hist[INTEGRATOR_MAX_LENGTH];
+    integ_sample_t cos_hist[INTEGRATOR_MAX_LENGTH];
+    integ_sum_t    sin_sum;
+    integ_sum_t    cos_sum;
+    float32_t      sin_ref;
+    float32_t      cos_ref;
+    float32_t      sin_dev;
+    float32_t      cos_dev;
+    float32_t      sin_sq;
+    float32_t      cos_sq;
+    uint16_t       head;
+    uint16_t       filled;
+    uint16_t       len;
+    uint16_t       steps;
+    bool           final;
+} Integrator_t;
+
+Integrator_t integrator;
+
+/*
+ * variance of the window mean per sample variance in it, by count - 1, for
+ * each output stage; see cascade_noise_model()
+ */
+static float32_t        cascade_var_factor[OUTPUT_STAGES][INTEGRATOR_MAX_LENGTH];
+static const float32_t *var_factor = cascade_var_factor[OUTPUT_STAGE_NARROW];
+#endif
+
+#ifdef DSP_HARMONICS
+Harmonics_t harmonics;
+#endif
+
+#ifdef DSP_BLOCK_MIXER
+/*
+ * sensor and gains of each block, as they are when it completes, and whether
+ * it is dropped: still settling, or the front-end gain was switched while it
+ * was being sampled.
+ */
+Dsp_gain_state_t adc_block_gain[DSP_QUEUE_LEN];
+bool             adc_block_settling[DSP_QUEUE_LEN];
+static sensor_type_t isr_sensor;
+static uint8_t       isr_sensor_gain;
+static uint32_t      isr_settle_blocks;
+#endif
+
+/* the gains the filter history was sampled with, see rescale_state() */
+typedef struct {
+    bool             valid;
+    Dsp_gain_state_t gain;
+} Filter_gain_t;
+
+static Filter_gain_t filter_gain;
+
+/*
+ * Everything that carries history from block to block, once per sensor. The
+ * live instances keep working on their own buffers; the bank of the sensor a
+ * block belongs to is swapped in before it is filtered, whether the MUX was
+ * moved by MEASUREMENT_MODE_SCAN or by hand.
+ */
+typedef struct {
+#ifdef DSP_CORRELATOR
+    Correlator_t correlator;
+#ifdef DSP_DUAL_TONE
+    Correlator_t correlator_tone2;
+#endif
+#else
+#ifdef DSP_Q31
+    Dsp_q31_state_t q31;
+#else
+    Filter_state_t filter;
+#endif
+#ifdef DSP_CIC
+    Cic_t cic;
+#endif
+#ifdef DSP_HALFBAND
+    Halfband_t halfband[4];
+#endif
+#ifdef DSP_QUADRATURE
+    Quadrature_t quadrature;
+#endif
+    Integrator_t integrator;
+#endif
+#ifdef DSP_HARMONICS
+    Harmonics_t harmonics;
+#endif
+    Filter_gain_t filter_gain;
+} Scan_bank_t;
+
+typedef struct {
+    bool          active;
+    /* a bank has just been loaded or a block dropped: the correlator waits for a period start */
+    bool          resume;
+    /* whose bank is live */
+    sensor_type_t sensor;
+} Scan_t;
+
+#ifdef DSP_BLOCK_MIXER
+static Scan_bank_t scan_bank[VOLTAGE_SENSOR + 1];
+#endif
+static Scan_t      scan;
+
+/* the sensor the block being filtered, and so its result, belongs to */
+static inline sensor_type_t
+result_sensor(void)
+{
+    return scan.active ? scan.sensor : Analog.selected_sensor;
+}
+
+/* of the gains the result was filtered with, which may lag the current ones */
+static inline const Dsp_cal_factor_t *
+result_calibration(sensor_type_t sensor)
+{
+    if (filter_gain.valid && filter_gain.gain.sensor == sensor)
+        return dsp_calibration_for(&filter_gain.gain);
+
+    return dsp_calibration(sensor);
+}
+
+/* shared by the float chain and the q31 one (DSP_q31.c) */
+float32_t fir1_3kHz_coeffs[] = { 0.02868781797587871551513671875f,
+                                 0.25f,
+                                 0.4426243603229522705078125f,
+                                 0.25f,
+                                 0.02868781797587871551513671875f };
+
+float32_t fir2_300Hz_coeffs[] = { 0.02867834083735942840576171875f,
+                                  0.25f,
+                                  0.4426433145999908447265625f,
+                                  0.25f,
+                                  0.02867834083735942840576171875f };
+
+float32_t biquad1_coeffs[] = {
+    0.00018072660895995795726776123046875f,
+    0.0003614532179199159145355224609375f,
+    0.00018072660895995795726776123046875f,
+
+    1.9746592044830322265625f,
+    -0.975681483745574951171875f,
+
+    0.00035528256557881832122802734375f,
+    0.0007105651311576366424560546875f,
+    0.00035528256557881832122802734375f,
+
+    1.94127738475799560546875f,
+    -0.9422824382781982421875f,
+};
+
+float32_t biquad2_coeffs[] = { 0.000180378541699610650539398193359375f,
+                               0.00036075708339922130107879638671875f,
+                               0.000180378541699610650539398193359375f,
+
+                               1.97468459606170654296875f,
+                               -0.975704848766326904296875f,
+
+                               0.00035460057551972568035125732421875f,
+                               0.0007092011510394513607025146484375f,
+                               0.00035460057551972568035125732421875f,
+
+                               1.941333770751953125f,
+                               -0.942336857318878173828125f };
+
+float32_t biquad3_coeffs[] = { 0.0000231437370530329644680023193359375f,
+                               0.000046287474106065928936004638671875f,
+                               0.0000231437370530329644680023193359375f,
+
+                               1.98140633106231689453125f,
+                               -0.981498897075653076171875f,
+
+                               0.000020184184904792346060276031494140625f,
+                               0.00004036836980958469212055206298828125f,
+                               0.000020184184904792346060276031494140625f,
+
+                               1.99491560459136962890625f,
+                               -0.99500882625579833984375f,
+
+                               0.000026784562578541226685047149658203125f,
+                               0.00005356912515708245337009429931640625f,
+                               0.000026784562578541226685047149658203125f,
+
+                               1.9863297939300537109375f,
+                               -0.986422598361968994140625f };
+
+/*
+ * biquad3 ten times wider, for DSP_PROFILE_FAST: 6th order Butterworth at
+ * 0.0154 of the block rate, settled to 1e-3 in 250 blocks instead of 2500
+ */
+float32_t biquad3_fast_coeffs[] = { 0.00213922560214996337890625f,
+                                    0.0042784512042999267578125f,
+                                    0.00213922560214996337890625f,
+
+                                    1.8207366466522216796875f,
+                                    -0.829293549060821533203125f,
+
+                                    0.00218927860260009765625f,
+                                    0.0043785572052001953125f,
+                                    0.00218927860260009765625f,
+
+                                    1.86335217952728271484375f,
+                                    -0.87210929393768310546875f,
+
+                                    0.00228178501129150390625f,
+                                    0.0045635700225830078125f,
+                                    0.00228178501129150390625f,
+
+                                    1.94208371639251708984375f,
+                                    -0.95121085643768310546875f };
+
+#ifndef DSP_CORRELATOR
+static float32_t *const output_stage_coeffs[OUTPUT_STAGES] = {
+    [OUTPUT_STAGE_NARROW] = biquad3_coeffs,
+    [OUTPUT_STAGE_WIDE]   = biquad3_fast_coeffs,
+};
+#endif
+
+/*
+ * inverse of the CIC passband droop up to a quarter of the decimated rate,
+ * least squares, linear phase, unity gain at DC
+ */
+float32_t cic_comp_coeffs[] = { -0.012840089554358f, 0.095768770503377f, -0.435952251421306f, 1.706047141944574f,
+                                -0.435952251421306f, 0.095768770503377f, -0.012840089554358f };
+
 void dacc_setup(void);
 void adc_interrupt_init(void);
 void filters_init(void);
+#ifdef DSP_Q31
+static void do_filter_q31(q31_t *sin_out, q31_t *cos_out);
+#endif
 
-static inline void
-check_amplitude(int32_t data)
+/* extremes of the samples since the last AGC decision, see check_amplitude() */
+static q31_t    agc_max;
+static q31_t    agc_min;
+static uint32_t agc_count;
+static uint32_t agc_hold;
+
+/*
+ * Peak of each MCP3462_STREAM_BLOCKLEN samples, from a vector max and min
+ * rather than a branch per sample, and the AGC decision on it. Takes the
+ * whole PDC block at once, or single samples without the stream.
+ */
+static void
+check_amplitude(const int32_t *samples, uint32_t len)
 {
+    q31_t    value;
+    uint32_t index;
+    uint32_t peak;
+    uint8_t  gain;
+
+    arm_max_q31((q31_t *)samples, len, &value, &index);
+    if (agc_count == 0 || value > agc_max)
+        agc_max = value;
+
+    arm_min_q31((q31_t *)samples, len, &value, &index);
+    if (agc_count == 0 || value < agc_min)
+        agc_min = value;
+
+    agc_count += len;
+
+    if (agc_count < MCP3462_STREAM_BLOCKLEN)
+        return;
+
+    agc_count        = 0;
+    peak             = (agc_max > -agc_min) ? agc_max : -agc_min;
+    Analog.ampl_peak = peak;
+
     if (Calibrator.is_calibrating)
         return;
 
-    static uint32_t check_counter = 0;
+    /* the block a move was made in, and the next */
+    if (agc_hold > 0) {
+        agc_hold--;
+        return;
+    }
+
+    /* a move whose ADC gain is waiting for the resync */
+    if (MCP3462_get_gain() != Analog.adc_gain)
+        return;
 
-    if (data < 0)
-        data = -data;
+    /* a sensor switch waiting for the resync, and the blocks settling after it */
+    if (sensor_of_mux(MCP3462_get_mux()) != Analog.selected_sensor)
+        return;
+#ifdef DSP_BLOCK_MIXER
+    if (isr_sensor != Analog.selected_sensor || isr_settle_blocks > 0)
+        return;
+#endif
 
-    if (data > AMPLITUDE_TOO_HIGH_LIMIT)
-        Analog.ampl_too_high_counter++;
-    else if (data < AMPLITUDE_TOO_LOW_LIMIT)
-        Analog.ampl_too_low_counter++;
+    Analog.ampl_is_too_high = peak > AMPLITUDE_TOO_HIGH_LIMIT;
+    Analog.ampl_is_too_low  = peak < AMPLITUDE_TOO_LOW_LIMIT;
 
-    if (Analog.ampl_too_high_counter > AMPLITUDE_HIGH_COUNTER_LIMIT) {
-        Analog.ampl_is_too_high = true;
+    if (!Analog.AGC_on || !(Analog.ampl_is_too_high || Analog.ampl_is_too_low))
+        return;
 
-        if (Analog.AGC_on)
-            decrease_gain();
-    }
-    else if (Analog.ampl_too_low_counter > AMPLITUDE_LOW_COUNTER_LIMIT) {
-        Analog.ampl_is_too_low = true;
+    gain = agc_target_gain(peak);
 
-        if (Analog.AGC_on)
-            increase_gain();
+    if (gain != Analog.overall_gain) {
+        set_overall_gain(gain);
+        agc_hold = AGC_HOLD_BLOCKS;
     }
+}
 
-    check_counter++;
+#ifdef DSP_BLOCK_MIXER
+/*
+ * A new MUX setting has to settle before its blocks are used, see
+ * SCAN_SETTLE_BLOCKS. MUX and ADC gain only change between blocks (at a
+ * resync); the front-end gain is switched by the main loop at any time, so a
+ * block that ends at a new one had the old one for part of it.
+ */
+static inline void
+tag_block(uint32_t slot)
+{
+    sensor_type_t    sensor = sensor_of_mux(MCP3462_get_mux());
+    Dsp_gain_state_t gain   = dsp_gain_state(sensor, MCP3462_get_gain());
+    bool             mixed  = false;
 
-    if (check_counter > AMPLITUDE_LOW_COUNTER_LIMIT) {
-        check_counter               = 0;
-        Analog.ampl_too_low_counter = 0;
+    if (sensor != isr_sensor) {
+        isr_sensor        = sensor;
+        isr_settle_blocks = SCAN_SETTLE_BLOCKS;
     }
+    else if (gain.sensor_gain != isr_sensor_gain)
+        mixed = true;
+
+    isr_sensor_gain = gain.sensor_gain;
+
+    adc_block_gain[slot]     = gain;
+    adc_block_settling[slot] = mixed || isr_settle_blocks > 0;
+
+    if (isr_settle_blocks > 0)
+        isr_settle_blocks--;
 }
 
-void
-adc_interrupt_handler(uint32_t id, uint32_t mask)
+static inline void
+dsp_process_sample(int32_t adc_data)
 {
-    int32_t    adc_data;
-    float32_t *biquad1_sin_buffer;
-    float32_t *biquad1_cos_buffer;
-    float32_t  sinprod_buff;
-    float32_t  cosprod_buff;
+    uint32_t   slot       = dsp_queue_write_slot(&block_queue);
+    adc_raw_t *raw_buffer = adc_raw_queue[slot];
 
     test_counter_adc++;
 
-    if (use_next_buffer) {
-        biquad1_sin_buffer = &biquad1_sin_buff_A[biquad1_counter];
-        biquad1_cos_buffer = &biquad1_cos_buff_A[biquad1_counter];
-    }
-    else {
-        biquad1_sin_buffer = &biquad1_sin_buff_B[biquad1_counter];
-        biquad1_cos_buffer = &biquad1_cos_buff_B[biquad1_counter];
+    if (biquad1_counter == 0)
+        adc_raw_phase[slot] = phase_counter;
+
+    raw_buffer[biquad1_counter] = ADC_RAW(adc_data);
+
+    if (biquad1_counter == (BIQUAD1_BUFFSIZE - 1)) {
+        biquad1_counter = 0;
+
+        tag_block(slot);
+        dsp_queue_publish(&block_queue);
+
+        if (Analog.mes_mode == MEASUREMENT_MODE_SCAN && !adc_block_settling[slot])
+            sensor_scan_block(adc_block_gain[slot].sensor);
     }
+    else
+        biquad1_counter++;
+
+    if (phase_counter == (DACC_PACKETLEN - 1))
+        phase_counter = 0;
+    else
+        phase_counter++;
+}
+#else
+static inline void
+dsp_process_sample(int32_t adc_data)
+{
+    uint32_t slot = dsp_queue_write_slot(&block_queue);
+#ifdef DSP_CIC
+    /* a decimated output at every FIR_DEC_FACTOR-th sample of the block */
+    float32_t *cic_sin_buffer = &cic_sin_queue[slot][biquad1_counter / FIR_DEC_FACTOR];
+    float32_t *cic_cos_buffer = &cic_cos_queue[slot][biquad1_counter / FIR_DEC_FACTOR];
+#else
+    float32_t *biquad1_sin_buffer = &biquad1_sin_queue[slot][biquad1_counter];
+    float32_t *biquad1_cos_buffer = &biquad1_cos_queue[slot][biquad1_counter];
+    float32_t  sinprod_buff;
+    float32_t  cosprod_buff;
+#endif
 
-    adc_data = MCP3462_read(0);
-    // adc_data = 1000;
-    check_amplitude(adc_data);
+    test_counter_adc++;
 
 #ifdef TEST_DATA_LEN
     static uint16_t counter2 = 0;
@@ -156,24 +607,21 @@ adc_interrupt_handler(uint32_t id, uint32_t mask)
 
 #endif
 
+#ifdef DSP_CIC
+    dsp_cic_process(&cic, &adc_data, phase_counter, 1, cic_sin_buffer, cic_cos_buffer);
+#else
     sinprod_buff = sin_table[phase_counter] * adc_data;
     cosprod_buff = cos_table[phase_counter] * adc_data;
 
     arm_biquad_cascade_df2T_f32(&biquad1_sin_inst, &sinprod_buff, biquad1_sin_buffer, 1);
 
     arm_biquad_cascade_df2T_f32(&biquad1_cos_inst, &cosprod_buff, biquad1_cos_buffer, 1);
+#endif
 
     if (biquad1_counter == (BIQUAD1_BUFFSIZE - 1)) {
         biquad1_counter = 0;
 
-        decimator_databuff_is_ready = true;
-
-        if (use_next_buffer)
-            use_next_buffer = false;
-        else
-            use_next_buffer = true;
-
-        Analog.ampl_too_high_counter = 0;
+        dsp_queue_publish(&block_queue);
     }
     else
         biquad1_counter++;
@@ -183,31 +631,121 @@ adc_interrupt_handler(uint32_t id, uint32_t mask)
     else
         phase_counter++;
 }
+#endif
+
+/* the oldest block waiting for do_filter() */
+static inline uint32_t
+ready_slot(void)
+{
+    uint32_t slot = 0;
+
+    dsp_queue_read_slot(&block_queue, &slot);
+
+    return slot;
+}
+
+#ifdef DSP_BLOCK_MIXER
+/* the oldest waiting block and the phase it starts at */
+static inline void
+ready_raw_block(adc_raw_t **raw_buffer, uint32_t *raw_phase)
+{
+    uint32_t slot = ready_slot();
+
+    *raw_buffer = adc_raw_queue[slot];
+    *raw_phase  = adc_raw_phase[slot];
+}
+#endif
+
+void
+adc_interrupt_handler(uint32_t id, uint32_t mask)
+{
+    int32_t sample;
+
+    PROFILE_BEGIN(PROFILE_ADC_ISR);
+
+    sample = MCP3462_read(0);
+    dsp_process_sample(sample);
+    check_amplitude(&sample, 1);
+
+    PROFILE_END_ISR(PROFILE_ADC_ISR, 1);
+}
+
+void
+adc_block_handler(const int32_t *samples, uint16_t len)
+{
+    uint16_t idx;
+
+    PROFILE_BEGIN(PROFILE_ADC_ISR);
+
+    for (idx = 0; idx < len; idx++)
+        dsp_process_sample(samples[idx]);
+
+    /* after the block: a gain move belongs to the next one */
+    check_amplitude(samples, len);
+
+    PROFILE_END_ISR(PROFILE_ADC_ISR, len);
+}
 
 void
 DACC_Handler(void)
 {
     pdc_tx_init(g_dacc_pdc_base, NULL, &g_dacc_next_packet);
+    /* the queued table plays now, the other one is free */
+    dacc_swap_pending = false;
 }
 
 void
 dsp_calculate_sine_table(uint16_t amplitude)
 {
-    uint16_t counter = 0;
-    uint16_t offs    = DACC_OFFSET_HALFSCALE;
-
     if (amplitude > DACC_MAX_AMPLITUDE) {
         amplitude            = DACC_MAX_AMPLITUDE;
         Analog.error_occured = true;
     }
 
-    amplitude = amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
-
-    while (counter < DACC_PACKETLEN) {
-        g_sintable[counter] = (uint16_t)((float)amplitude * sin_table[counter] + (float)offs);
+    dsp_set_sine_table_digits(amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF);
+}
 
-        counter++;
+/*
+ * Fills the table the DAC isn't playing and queues it at the PDC next
+ * pointer: the period in progress ends on the old table and the next one
+ * starts on the new, so a change never glitches a period. The old table is
+ * the one the next call fills, so while the DAC runs a call is refused
+ * (false) until DACC_Handler() has seen the last one start.
+ */
+bool
+dsp_set_sine_table_digits(uint16_t digits)
+{
+    uint16_t *table   = (g_sintable == dacc_tables[0]) ? dacc_tables[1] : dacc_tables[0];
+    bool      playing = g_dacc_pdc_base != NULL && (pdc_read_status(g_dacc_pdc_base) & PERIPH_PTSR_TXTEN);
+    uint16_t  counter;
+    uint16_t  offs = DACC_OFFSET_HALFSCALE;
+
+    if (playing && dacc_swap_pending)
+        return false;
+
+    if (digits > DACC_MAX_AMPLITUDE * DACC_VOLTS_TO_DIGITS_CONV_COEFF)
+        digits = DACC_MAX_AMPLITUDE * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+
+    for (counter = 0; counter < DACC_PACKETLEN; counter++) {
+#ifdef DSP_DUAL_TONE
+        /* the sum peaks below digits */
+        table[counter] =
+            (uint16_t)((float)digits * 0.5f * (sin_table[counter] + tone2_sin_table[counter]) + (float)offs);
+#else
+        table[counter] = (uint16_t)((float)digits * sin_table[counter] + (float)offs);
+#endif
     }
+
+    g_sintable                 = table;
+    g_dacc_packet.ul_addr      = (uint32_t)(uintptr_t)table;
+    g_dacc_next_packet.ul_addr = (uint32_t)(uintptr_t)table;
+
+    /* DACC_Handler() reloads the same packet, so it can't undo this */
+    dacc_swap_pending = playing;
+    if (g_dacc_pdc_base != NULL)
+        pdc_tx_init(g_dacc_pdc_base, NULL, &g_dacc_next_packet);
+
+    return true;
 }
 
 void
@@ -218,6 +756,7 @@ dacc_setup(void)
     g_dacc_packet.ul_size      = DACC_PACKETLEN;
     g_dacc_next_packet.ul_addr = (uint32_t)g_sintable;
     g_dacc_next_packet.ul_size = DACC_PACKETLEN;
+    dacc_swap_pending          = false;
 
     NVIC_ClearPendingIRQ(DACC_IRQn);
     NVIC_SetPriority(DACC_IRQn, DACC_INTERRUPT_PRIO);
@@ -228,127 +767,225 @@ dacc_setup(void)
 void
 adc_interrupt_init(void)
 {
+#ifdef ADC_PDC_STREAM
+    MCP3462_stream_init(adc_block_handler);
+#else
     pio_handler_set(PIOA, ID_PIOA, (1 << ADC_INTERRUPT_PIN), PIO_IT_FALL_EDGE, adc_interrupt_handler);
     pio_handler_set_priority(PIOA, PIOA_IRQn, ADC_INTERRUPT_PRIO);
+#endif
 }
 #endif
 
 void
-filters_init(void)
+dsp_acquisition_start(void)
 {
-    static float32_t fir1_statebuff_sin[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
-    static float32_t fir1_statebuff_cos[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
-    static float32_t fir2_statebuff_sin[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
-    static float32_t fir2_statebuff_cos[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
-    static float32_t biquad1_statebuff_sin[BIQUAD1_NSTAGES * 2];
-    static float32_t biquad1_statebuff_cos[BIQUAD1_NSTAGES * 2];
-    static float32_t biquad2_statebuff_sin[BIQUAD2_NSTAGES * 2];
-    static float32_t biquad2_statebuff_cos[BIQUAD2_NSTAGES * 2];
-    static float32_t biquad3_statebuff_sin[BIQUAD3_NSTAGES * 2];
-    static float32_t biquad3_statebuff_cos[BIQUAD3_NSTAGES * 2];
-
-    static float32_t fir1_3kHz_coeffs[] = { 0.02868781797587871551513671875f,
-                                            0.25f,
-                                            0.4426243603229522705078125f,
-                                            0.25f,
-                                            0.02868781797587871551513671875f };
-
-    static float32_t fir2_300Hz_coeffs[] = { 0.02867834083735942840576171875f,
-                                             0.25f,
-                                             0.4426433145999908447265625f,
-                                             0.25f,
-                                             0.02867834083735942840576171875f };
-
-    static float32_t biquad1_coeffs[] = {
-        0.00018072660895995795726776123046875f,
-        0.0003614532179199159145355224609375f,
-        0.00018072660895995795726776123046875f,
-
-        1.9746592044830322265625f,
-        -0.975681483745574951171875f,
-
-        0.00035528256557881832122802734375f,
-        0.0007105651311576366424560546875f,
-        0.00035528256557881832122802734375f,
-
-        1.94127738475799560546875f,
-        -0.9422824382781982421875f,
-    };
-
-    static float32_t biquad2_coeffs[] = { 0.000180378541699610650539398193359375f,
-                                          0.00036075708339922130107879638671875f,
-                                          0.000180378541699610650539398193359375f,
-
-                                          1.97468459606170654296875f,
-                                          -0.975704848766326904296875f,
+#ifdef ADC_PDC_STREAM
+    MCP3462_stream_start();
+#else
+    pio_enable_interrupt(PIOA, (1 << ADC_INTERRUPT_PIN));
+#endif
+}
 
-                                          0.00035460057551972568035125732421875f,
-                                          0.0007092011510394513607025146484375f,
-                                          0.00035460057551972568035125732421875f,
+void
+dsp_acquisition_stop(void)
+{
+#ifdef ADC_PDC_STREAM
+    MCP3462_stream_stop();
+#else
+    pio_disable_interrupt(PIOA, (1 << ADC_INTERRUPT_PIN));
+#endif
+}
 
-                                          1.941333770751953125f,
-                                          -0.942336857318878173828125f };
+#ifndef DSP_CORRELATOR
+#define CASCADE_IMPULSE_LEN 3000
 
-    static float32_t biquad3_coeffs[] = { 0.0000231437370530329644680023193359375f,
-                                          0.000046287474106065928936004638671875f,
-                                          0.0000231437370530329644680023193359375f,
+/*
+ * Neighbouring cascade outputs are correlated over a few hundred steps, so
+ * the spread inside a window says little about the error of its mean. With
+ * the autocorrelation rho of biquad3 (which sets the output bandwidth) for
+ * white noise at its input, a window of N outputs has
+ *   var(mean) = var * g(N),  g(N) = (1 + 2 * sum (1 - k/N) * rho(k)) / N
+ *   E[s^2]    = var * N / (N - 1) * (1 - g(N))
+ * and the factor from s^2 to var(mean) is tabulated for every N.
+ */
+static void
+cascade_noise_model(uint8_t stage)
+{
+    arm_biquad_cascade_df2T_instance_f32 inst;
+    float32_t                            state[BIQUAD3_NSTAGES * 2];
+    float32_t                            ring[INTEGRATOR_MAX_LENGTH];
+    float32_t                           *factor = cascade_var_factor[stage];
+    float32_t                           *rho    = factor;
+    float32_t                            in     = 1;
+    float32_t                            out;
+    float32_t                            rho_0;
+    float32_t                            sum_rho   = 0;
+    float32_t                            sum_k_rho = 0;
+    float32_t                            g;
+    uint32_t                             idx;
+    uint32_t                             pos;
+    uint32_t                             k;
+
+    arm_biquad_cascade_df2T_init_f32(&inst, BIQUAD3_NSTAGES, output_stage_coeffs[stage], state);
+    memset(rho, 0, sizeof(cascade_var_factor[stage]));
+
+    for (idx = 0; idx < CASCADE_IMPULSE_LEN; idx++) {
+        arm_biquad_cascade_df2T_f32(&inst, &in, &out, 1);
+        in = 0;
+
+        pos       = idx % INTEGRATOR_MAX_LENGTH;
+        ring[pos] = out;
+
+        for (k = 0; k <= pos; k++)
+            rho[k] += out * ring[pos - k];
+
+        for (; k <= idx && k < INTEGRATOR_MAX_LENGTH; k++)
+            rho[k] += out * ring[pos + INTEGRATOR_MAX_LENGTH - k];
+    }
 
-                                          1.98140633106231689453125f,
-                                          -0.981498897075653076171875f,
+    /* in place: rho[N - 1] is last needed for N, where factor(N) goes */
+    rho_0     = rho[0];
+    factor[0] = 0;
 
-                                          0.000020184184904792346060276031494140625f,
-                                          0.00004036836980958469212055206298828125f,
-                                          0.000020184184904792346060276031494140625f,
+    for (k = 2; k <= INTEGRATOR_MAX_LENGTH; k++) {
+        sum_rho += rho[k - 1] / rho_0;
+        sum_k_rho += (k - 1) * rho[k - 1] / rho_0;
 
-                                          1.99491560459136962890625f,
-                                          -0.99500882625579833984375f,
+        g = (1 + 2 * sum_rho - 2 * sum_k_rho / k) / k;
 
-                                          0.000026784562578541226685047149658203125f,
-                                          0.00005356912515708245337009429931640625f,
-                                          0.000026784562578541226685047149658203125f,
+        factor[k - 1] = g * (k - 1) / (k * (1 - g));
+    }
+}
+#endif
 
-                                          1.9863297939300537109375f,
-                                          -0.986422598361968994140625f };
+void
+filters_init(void)
+{
+#if defined(DSP_BLOCK_MIXER) && !defined(DSP_Q31) && !defined(DSP_CIC) && !defined(DSP_QUADRATURE)
+    uint16_t idx;
+#endif
+#ifdef DSP_DUAL_TONE
+    uint16_t point;
 
+    /* DUAL_TONE_BIN periods in SINTABLE_LEN points, exact from the excitation table */
+    for (point = 0; point < SINTABLE_LEN; point++) {
+        tone2_sin_table[point] = sin_table[(point * DUAL_TONE_BIN) % SINTABLE_LEN];
+        tone2_cos_table[point] = cos_table[(point * DUAL_TONE_BIN) % SINTABLE_LEN];
+    }
+#endif
     arm_fir_decimate_init_f32(&firdec1_sin_inst,
                               FIR1_DEC_NCOEFFS,
                               FIR_DEC_FACTOR,
                               fir1_3kHz_coeffs,
-                              fir1_statebuff_sin,
+                              filter_state.fir1_statebuff_sin,
                               FIR1_DEC_BLOCKSIZE);
 
     arm_fir_decimate_init_f32(&firdec1_cos_inst,
                               FIR1_DEC_NCOEFFS,
                               FIR_DEC_FACTOR,
                               fir1_3kHz_coeffs,
-                              fir1_statebuff_cos,
+                              filter_state.fir1_statebuff_cos,
                               FIR1_DEC_BLOCKSIZE);
 
     arm_fir_decimate_init_f32(&firdec2_sin_inst,
                               FIR2_DEC_NCOEFFS,
                               FIR_DEC_FACTOR,
                               fir2_300Hz_coeffs,
-                              fir2_statebuff_sin,
+                              filter_state.fir2_statebuff_sin,
                               FIR2_DEC_BLOCKSIZE);
 
     arm_fir_decimate_init_f32(&firdec2_cos_inst,
                               FIR2_DEC_NCOEFFS,
                               FIR_DEC_FACTOR,
                               fir2_300Hz_coeffs,
-                              fir2_statebuff_cos,
+                              filter_state.fir2_statebuff_cos,
                               FIR2_DEC_BLOCKSIZE);
 
-    arm_biquad_cascade_df2T_init_f32(&biquad1_sin_inst, BIQUAD1_NSTAGES, biquad1_coeffs, biquad1_statebuff_sin);
+    arm_biquad_cascade_df2T_init_f32(&biquad1_sin_inst, BIQUAD1_NSTAGES, biquad1_coeffs, filter_state.biquad1_statebuff_sin);
+
+    arm_biquad_cascade_df2T_init_f32(&biquad1_cos_inst, BIQUAD1_NSTAGES, biquad1_coeffs, filter_state.biquad1_statebuff_cos);
+
+    arm_biquad_cascade_df2T_init_f32(&biquad2_sin_inst, BIQUAD2_NSTAGES, biquad2_coeffs, filter_state.biquad2_statebuff_sin);
+
+    arm_biquad_cascade_df2T_init_f32(&biquad2_cos_inst, BIQUAD2_NSTAGES, biquad2_coeffs, filter_state.biquad2_statebuff_cos);
+
+    arm_biquad_cascade_df2T_init_f32(&biquad3_sin_inst, BIQUAD3_NSTAGES, biquad3_coeffs, filter_state.biquad3_statebuff_sin);
+
+    arm_biquad_cascade_df2T_init_f32(&biquad3_cos_inst, BIQUAD3_NSTAGES, biquad3_coeffs, filter_state.biquad3_statebuff_cos);
+
+#ifdef DSP_CIC
+    arm_fir_init_f32(&cic_comp_sin_inst,
+                     CIC_COMP_NCOEFFS,
+                     cic_comp_coeffs,
+                     filter_state.cic_comp_statebuff_sin,
+                     CIC_COMP_BLOCKSIZE);
+
+    arm_fir_init_f32(&cic_comp_cos_inst,
+                     CIC_COMP_NCOEFFS,
+                     cic_comp_coeffs,
+                     filter_state.cic_comp_statebuff_cos,
+                     CIC_COMP_BLOCKSIZE);
 
-    arm_biquad_cascade_df2T_init_f32(&biquad1_cos_inst, BIQUAD1_NSTAGES, biquad1_coeffs, biquad1_statebuff_cos);
+    dsp_cic_init();
+#endif
+
+#ifdef DSP_HALFBAND
+    dsp_halfband_reset(&halfband1_sin_inst);
+    dsp_halfband_reset(&halfband1_cos_inst);
+    dsp_halfband_reset(&halfband2_sin_inst);
+    dsp_halfband_reset(&halfband2_cos_inst);
+#endif
+
+#if defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+
+    arm_fir_decimate_init_f32(&poly1_sin_inst,
+                              POLY_DEC_NCOEFFS,
+                              POLY_DEC_FACTOR,
+                              poly_dec_coeffs,
+                              filter_state.poly1_statebuff_sin,
+                              POLY1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_f32(&poly1_cos_inst,
+                              POLY_DEC_NCOEFFS,
+                              POLY_DEC_FACTOR,
+                              poly_dec_coeffs,
+                              filter_state.poly1_statebuff_cos,
+                              POLY1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_f32(&poly2_sin_inst,
+                              POLY_DEC_NCOEFFS,
+                              POLY_DEC_FACTOR,
+                              poly_dec_coeffs,
+                              filter_state.poly2_statebuff_sin,
+                              POLY2_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_f32(&poly2_cos_inst,
+                              POLY_DEC_NCOEFFS,
+                              POLY_DEC_FACTOR,
+                              poly_dec_coeffs,
+                              filter_state.poly2_statebuff_cos,
+                              POLY2_DEC_BLOCKSIZE);
+#endif
 
-    arm_biquad_cascade_df2T_init_f32(&biquad2_sin_inst, BIQUAD2_NSTAGES, biquad2_coeffs, biquad2_statebuff_sin);
+#if defined(DSP_BLOCK_MIXER) && !defined(DSP_Q31) && !defined(DSP_CIC) && !defined(DSP_QUADRATURE)
+    for (idx = 0; idx < MIXER_REF_LEN; idx++) {
+        mixer_sin_ref[idx] = sin_table[idx % SINTABLE_LEN];
+        mixer_cos_ref[idx] = cos_table[idx % SINTABLE_LEN];
+    }
+#endif
 
-    arm_biquad_cascade_df2T_init_f32(&biquad2_cos_inst, BIQUAD2_NSTAGES, biquad2_coeffs, biquad2_statebuff_cos);
+#ifdef DSP_Q31
+    dsp_q31_init(fir1_3kHz_coeffs, fir2_300Hz_coeffs, biquad1_coeffs, biquad2_coeffs, biquad3_coeffs);
+#endif
 
-    arm_biquad_cascade_df2T_init_f32(&biquad3_sin_inst, BIQUAD3_NSTAGES, biquad3_coeffs, biquad3_statebuff_sin);
+#ifdef DSP_HARMONICS
+    dsp_harmonics_init();
+#endif
 
-    arm_biquad_cascade_df2T_init_f32(&biquad3_cos_inst, BIQUAD3_NSTAGES, biquad3_coeffs, biquad3_statebuff_cos);
+#ifndef DSP_CORRELATOR
+    cascade_noise_model(OUTPUT_STAGE_NARROW);
+    cascade_noise_model(OUTPUT_STAGE_WIDE);
+#endif
 }
 
 void
@@ -356,20 +993,24 @@ dsp_init(void)
 {
     recall_coeffs_from_flash_struct();
 
-    Analog.generator_amplitude = DACC_MAX_AMPLITUDE;
-    Analog.pos_ch              = REF_CH4;
-    Analog.neg_ch              = REF_CH5;
-    Analog.adc_gain            = GAIN_1;
-    Analog.AGC_on              = true;
-    Analog.selected_sensor     = VOLTAGE_SENSOR;
-    Analog.clamp_sensor_gain   = 0;
-    Analog.shunt_sensor_gain   = 0;
-    Analog.overall_gain        = 1;
-    Analog.mes_mode            = MEASUREMENT_MODE_MANUAL;
-
-    clamp_measurements_result.integrator_len = INTEGRATOR_LENGTH;
+    Analog.generator_amplitude   = DACC_MAX_AMPLITUDE;
+    Analog.excitation_amplitude  = DACC_MAX_AMPLITUDE * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+    Analog.excitation_control_on = false;
+    Analog.pos_ch                = REF_CH4;
+    Analog.neg_ch                = REF_CH5;
+    Analog.adc_gain              = GAIN_1;
+    Analog.AGC_on                = true;
+    Analog.selected_sensor       = VOLTAGE_SENSOR;
+    Analog.clamp_sensor_gain     = 0;
+    Analog.shunt_sensor_gain     = 0;
+    Analog.overall_gain          = 1;
+    Analog.mes_mode              = MEASUREMENT_MODE_MANUAL;
 
     filters_init();
+    dsp_set_profile(DSP_PROFILE_NORMAL);
+#ifdef DSP_HARMONICS
+    clamp_measurements_result.thd_limit = THD_LIMIT_DEFAULT;
+#endif
     dsp_calculate_sine_table(Analog.generator_amplitude);
     dacc_setup();
 #ifdef ADC_TEST_DEF
@@ -377,69 +1018,952 @@ dsp_init(void)
 #endif
 }
 
+/*
+ * 1-sigma relative uncertainty of |V| and uncertainty of phi in rad, from
+ * the variances of the I/Q means (first order propagation).
+ */
 void
-dsp_integrating_filter(void)
+dsp_vector_uncertainty(float32_t  sin_mean,
+                       float32_t  cos_mean,
+                       float32_t  sin_var,
+                       float32_t  cos_var,
+                       float32_t *mag_rel,
+                       float32_t *phi_rad)
 {
-    static uint32_t  counter = 0;
-    static float32_t sin_vect;
-    static float32_t cos_vect;
-    float32_t        sin_buff;
-    float32_t        cos_buff;
-
-    if (decimator_databuff_is_ready == true) {
-        do_filter(&sin_buff, &cos_buff);
-        counter++;
-        sin_vect += sin_buff;
-        cos_vect += cos_buff;
+    float32_t sin_sq = sin_mean * sin_mean;
+    float32_t cos_sq = cos_mean * cos_mean;
+    float32_t mag_4  = (sin_sq + cos_sq) * (sin_sq + cos_sq);
+
+    if (mag_4 <= 0) {
+        /* no signal: nothing is known about it */
+        *mag_rel = 1;
+        *phi_rad = PI;
+        return;
+    }
 
-        if (Analog.selected_sensor == CLAMP_SENSOR) {
-            float32_t abs_val;
-            float32_t gain = Cal_data.clamp_gain[Analog.clamp_sensor_gain] * adc_gain_coeffs[Analog.adc_gain];
+    arm_sqrt_f32((sin_sq * sin_var + cos_sq * cos_var) / mag_4, mag_rel);
+    arm_sqrt_f32((cos_sq * sin_var + sin_sq * cos_var) / mag_4, phi_rad);
+}
 
-            arm_sqrt_f32(sin_buff * sin_buff + cos_buff * cos_buff, &abs_val);
+static void
+publish_result(float32_t sin_vect, float32_t cos_vect, float32_t mag_rel, float32_t phi_rad, bool final)
+{
+#ifdef DSP_BLOCK_MIXER
+    /* a block of the sensor switched away from, still in the queue: it only updates its bank */
+    if (scan.sensor != result_sensor())
+        return;
+#endif
 
-            abs_val /= gain;
+    clamp_measurements_result.mag_uncertainty = mag_rel;
+    clamp_measurements_result.phi_uncertainty = phi_rad * (180 / PI);
+    clamp_measurements_result.result_is_final = final;
+    clamp_measurements_result.data_lost       = data_lost_blocks > 0;
 
-            buzzer_set_freq(abs_val);
-        }
-    }
+    if (final)
+        clamp_measurements_result.final_sensors |= 1u << result_sensor();
     else
-        return;
-
-    if (counter == (clamp_measurements_result.integrator_len - 1)) {
-        counter = 0;
+        clamp_measurements_result.final_sensors &= ~(1u << result_sensor());
 
-        sin_vect /= clamp_measurements_result.integrator_len;
-        cos_vect /= clamp_measurements_result.integrator_len;
+    PROFILE_BEGIN(PROFILE_MANAGE_SENSED_DATA);
+    manage_sensed_data(sin_vect, cos_vect);
+    PROFILE_END(PROFILE_MANAGE_SENSED_DATA);
+}
 
-        manage_sensed_data(sin_vect, cos_vect);
+#ifdef DSP_HARMONICS
+/* of the sensor on display; the others may be left from a scan or an earlier selection */
+static float32_t
+displayed_thd(void)
+{
+    if (Analog.selected_sensor == SHUNT_SENSOR)
+        return clamp_measurements_result.V_shunt_thd;
+    else if (Analog.selected_sensor == CLAMP_SENSOR)
+        return clamp_measurements_result.I_clamp_thd;
 
-        sin_vect = 0;
-        cos_vect = 0;
-    }
+    return clamp_measurements_result.V_ovrl_thd;
 }
 
-void
-do_filter(float32_t *sin_out, float32_t *cos_out)
+/* the raw block of the filtered one, whichever chain demodulated it */
+static void
+harmonics_block(void)
 {
-    decimator_databuff_is_ready = false;
+    float32_t *raw_buffer;
+    uint32_t   raw_phase;
+    uint32_t   window_periods = dsp_correlator_periods(clamp_measurements_result.integrator_len);
+    float32_t  thd;
 
-    float32_t *biquad1_sin_buffer_ptr;
-    float32_t *biquad1_cos_buffer_ptr;
+    if (harmonics.order[0].window_periods != window_periods)
+        dsp_harmonics_reset(&harmonics, window_periods);
 
-    if (use_next_buffer) {
-        biquad1_sin_buffer_ptr = biquad1_sin_buff_B;
-        biquad1_cos_buffer_ptr = biquad1_cos_buff_B;
-    }
-    else {
-        biquad1_sin_buffer_ptr = biquad1_sin_buff_A;
-        biquad1_cos_buffer_ptr = biquad1_cos_buff_A;
-    }
+    ready_raw_block(&raw_buffer, &raw_phase);
 
-    arm_fir_decimate_f32(&firdec1_sin_inst, biquad1_sin_buffer_ptr, fir1_sin, FIR1_DEC_BLOCKSIZE);
+    if (!dsp_harmonics_process(&harmonics, raw_buffer, raw_phase, BIQUAD1_BUFFSIZE, &thd))
+        return;
 
-    arm_fir_decimate_f32(&firdec1_cos_inst, biquad1_cos_buffer_ptr, fir1_cos, FIR1_DEC_BLOCKSIZE);
+    /* the gates of publish_result() */
+    if (scan.sensor != result_sensor() || Calibrator.is_calibrating)
+        return;
 
+    if (result_sensor() == VOLTAGE_SENSOR)
+        clamp_measurements_result.V_ovrl_thd = thd;
+    else if (result_sensor() == SHUNT_SENSOR)
+        clamp_measurements_result.V_shunt_thd = thd;
+    else if (result_sensor() == CLAMP_SENSOR)
+        clamp_measurements_result.I_clamp_thd = thd;
+
+    clamp_measurements_result.distorted = displayed_thd() > clamp_measurements_result.thd_limit;
+}
+#endif
+
+#ifdef DSP_DUAL_TONE
+/* the second tone goes through the same gates as publish_result() */
+static void
+publish_tone2(float32_t sin_vect, float32_t cos_vect, bool final)
+{
+    Dsp_tone_t *tone = &clamp_measurements_result.tone2;
+
+    if (scan.sensor != result_sensor())
+        return;
+
+    tone->mag_uncertainty = correlator_tone2.mag_uncertainty;
+    tone->phi_uncertainty = correlator_tone2.phi_uncertainty * (180 / PI);
+    tone->result_is_final = final;
+
+    manage_tone2_data(sin_vect, cos_vect);
+}
+#endif
+
+#ifdef DSP_CORRELATOR
+/* every tone starts a new window */
+static void
+correlator_restart(uint32_t window_periods)
+{
+    dsp_correlator_reset(&correlator, window_periods);
+#ifdef DSP_DUAL_TONE
+    dsp_correlator_reset(&correlator_tone2, window_periods);
+    dsp_correlator_set_tone(&correlator_tone2, tone2_sin_table, tone2_cos_table);
+#endif
+}
+
+static void
+integrate_block(void)
+{
+    float32_t *raw_buffer;
+    uint32_t   raw_phase;
+    uint32_t   window_periods = dsp_correlator_periods(clamp_measurements_result.integrator_len);
+    uint32_t   skip           = 0;
+    float32_t  sin_vect;
+    float32_t  cos_vect;
+    bool       window_done;
+#ifdef DSP_DUAL_TONE
+    float32_t  tone2_sin;
+    float32_t  tone2_cos;
+    bool       tone2_done;
+#endif
+
+    if (correlator.window_periods != window_periods)
+        correlator_restart(window_periods);
+
+    correlator.uncertainty_target = clamp_measurements_result.uncertainty_target;
+#ifdef DSP_DUAL_TONE
+    correlator_tone2.uncertainty_target = clamp_measurements_result.uncertainty_target;
+#endif
+
+    PROFILE_BEGIN(PROFILE_DO_FILTER);
+    ready_raw_block(&raw_buffer, &raw_phase);
+
+    if (scan.resume) {
+        /* the period in progress was cut short: start over at the next period */
+        skip        = (SINTABLE_LEN - raw_phase) % SINTABLE_LEN;
+        raw_buffer += skip;
+        raw_phase   = (raw_phase + skip) % SINTABLE_LEN;
+        scan.resume = false;
+    }
+
+    window_done = dsp_correlator_process(&correlator, raw_buffer, raw_phase, BIQUAD1_BUFFSIZE - skip, &sin_vect, &cos_vect);
+#ifdef DSP_DUAL_TONE
+    tone2_done = dsp_correlator_process(&correlator_tone2,
+                                        raw_buffer,
+                                        raw_phase,
+                                        BIQUAD1_BUFFSIZE - skip,
+                                        &tone2_sin,
+                                        &tone2_cos);
+#endif
+    PROFILE_END(PROFILE_DO_FILTER);
+
+    if (result_sensor() == CLAMP_SENSOR) {
+        float32_t abs_val;
+
+        arm_sqrt_f32(correlator.last_period_sin * correlator.last_period_sin +
+                       correlator.last_period_cos * correlator.last_period_cos,
+                     &abs_val);
+
+        abs_val *= result_calibration(CLAMP_SENSOR)->gain_inv;
+
+        buzzer_set_freq(abs_val);
+    }
+
+    if (window_done)
+        publish_result(sin_vect, cos_vect, correlator.mag_uncertainty, correlator.phi_uncertainty, true);
+    else if (dsp_correlator_estimate(&correlator, &sin_vect, &cos_vect))
+        publish_result(sin_vect, cos_vect, correlator.mag_uncertainty, correlator.phi_uncertainty, false);
+
+#ifdef DSP_DUAL_TONE
+    if (tone2_done)
+        publish_tone2(tone2_sin, tone2_cos, true);
+    else if (dsp_correlator_estimate(&correlator_tone2, &tone2_sin, &tone2_cos))
+        publish_tone2(tone2_sin, tone2_cos, false);
+#endif
+}
+#else
+static inline float32_t
+integ_to_float(integ_sample_t value)
+{
+#ifdef DSP_Q31
+    return dsp_q31_to_adc(value);
+#else
+    return value;
+#endif
+}
+
+/* outputs the window currently averages */
+static inline uint16_t
+integrator_count(void)
+{
+    return (integrator.filled < integrator.len) ? integrator.filled : integrator.len;
+}
+
+static void
+integrator_rebuild(void)
+{
+    uint16_t  count = integrator_count();
+    uint16_t  idx   = integrator.head;
+    float32_t value;
+
+    integrator.sin_sum = 0;
+    integrator.cos_sum = 0;
+    integrator.sin_dev = 0;
+    integrator.cos_dev = 0;
+    integrator.sin_sq  = 0;
+    integrator.cos_sq  = 0;
+    integrator.steps   = 0;
+
+    while (count--) {
+        idx = (idx == 0) ? (INTEGRATOR_MAX_LENGTH - 1) : (idx - 1);
+
+        integrator.sin_sum += integrator.sin_hist[idx];
+        integrator.cos_sum += integrator.cos_hist[idx];
+    }
+
+    count = integrator_count();
+
+    if (count == 0) {
+        integrator.sin_ref = 0;
+        integrator.cos_ref = 0;
+        return;
+    }
+
+    integrator.sin_ref = integ_to_float(integrator.sin_sum / count);
+    integrator.cos_ref = integ_to_float(integrator.cos_sum / count);
+
+    idx = integrator.head;
+
+    for (count = integrator_count(); count; count--) {
+        idx = (idx == 0) ? (INTEGRATOR_MAX_LENGTH - 1) : (idx - 1);
+
+        value = integ_to_float(integrator.sin_hist[idx]) - integrator.sin_ref;
+        integrator.sin_dev += value;
+        integrator.sin_sq += value * value;
+
+        value = integ_to_float(integrator.cos_hist[idx]) - integrator.cos_ref;
+        integrator.cos_dev += value;
+        integrator.cos_sq += value * value;
+    }
+}
+
+static inline void
+integrator_add(integ_sample_t sin_in, integ_sample_t cos_in, float32_t sign)
+{
+    float32_t sin_dev = integ_to_float(sin_in) - integrator.sin_ref;
+    float32_t cos_dev = integ_to_float(cos_in) - integrator.cos_ref;
+
+    integrator.sin_dev += sign * sin_dev;
+    integrator.cos_dev += sign * cos_dev;
+    integrator.sin_sq += sign * sin_dev * sin_dev;
+    integrator.cos_sq += sign * cos_dev * cos_dev;
+}
+
+/* returns true once the window holds enough outputs for a (provisional) reading */
+static bool
+integrator_push(integ_sample_t sin_in, integ_sample_t cos_in)
+{
+    uint32_t len = clamp_measurements_result.integrator_len;
+    uint16_t oldest;
+
+    if (len < 1)
+        len = 1;
+    else if (len > INTEGRATOR_MAX_LENGTH)
+        len = INTEGRATOR_MAX_LENGTH;
+
+    if (len != integrator.len) {
+        /* the history is kept, so a new length takes effect at once */
+        integrator.len = len;
+        integrator_rebuild();
+    }
+
+    if (integrator.filled >= len) {
+        oldest = (integrator.head + INTEGRATOR_MAX_LENGTH - len) % INTEGRATOR_MAX_LENGTH;
+
+        integrator.sin_sum -= integrator.sin_hist[oldest];
+        integrator.cos_sum -= integrator.cos_hist[oldest];
+        integrator_add(integrator.sin_hist[oldest], integrator.cos_hist[oldest], -1.0f);
+    }
+
+    integrator.sin_hist[integrator.head] = sin_in;
+    integrator.cos_hist[integrator.head] = cos_in;
+    integrator.sin_sum += sin_in;
+    integrator.cos_sum += cos_in;
+    integrator_add(sin_in, cos_in, 1.0f);
+
+    integrator.head = (integrator.head + 1) % INTEGRATOR_MAX_LENGTH;
+
+    if (integrator.filled < INTEGRATOR_MAX_LENGTH)
+        integrator.filled++;
+
+    /* float running sums drift; start them over once per window */
+    if (++integrator.steps >= len)
+        integrator_rebuild();
+
+    return integrator_count() >= ((len < INTEGRATOR_MIN_LENGTH) ? len : INTEGRATOR_MIN_LENGTH);
+}
+
+static void
+integrator_reset(void)
+{
+    integrator.head    = 0;
+    integrator.filled  = 0;
+    integrator.len     = 0;
+    integrator.steps   = 0;
+    integrator.final   = false;
+    integrator.sin_sum = 0;
+    integrator.cos_sum = 0;
+    integrator.sin_ref = 0;
+    integrator.cos_ref = 0;
+    integrator.sin_dev = 0;
+    integrator.cos_dev = 0;
+    integrator.sin_sq  = 0;
+    integrator.cos_sq  = 0;
+}
+
+/* publishes the window average with its uncertainty, see cascade_noise_model() */
+static void
+integrator_publish(void)
+{
+    uint16_t  count = integrator_count();
+    float32_t sin_mean;
+    float32_t cos_mean;
+    float32_t sin_var;
+    float32_t cos_var;
+    float32_t mag_rel = 1;
+    float32_t phi_rad = PI;
+    float32_t target  = clamp_measurements_result.uncertainty_target;
+
+#ifdef DSP_Q31
+    sin_mean = dsp_q31_to_adc(integrator.sin_sum / (q63_t)count);
+    cos_mean = dsp_q31_to_adc(integrator.cos_sum / (q63_t)count);
+#else
+    sin_mean = integrator.sin_sum / count;
+    cos_mean = integrator.cos_sum / count;
+#endif
+
+    if (count > 1) {
+        sin_var = (integrator.sin_sq - integrator.sin_dev * integrator.sin_dev / count) / (count - 1);
+        cos_var = (integrator.cos_sq - integrator.cos_dev * integrator.cos_dev / count) / (count - 1);
+
+        dsp_vector_uncertainty(sin_mean,
+                               cos_mean,
+                               sin_var * var_factor[count - 1],
+                               cos_var * var_factor[count - 1],
+                               &mag_rel,
+                               &phi_rad);
+    }
+
+    if (count >= integrator.len || (mag_rel <= target && phi_rad <= target))
+        integrator.final = true;
+
+    publish_result(sin_mean, cos_mean, mag_rel, phi_rad, integrator.final);
+}
+
+static void
+integrate_block(void)
+{
+    float32_t sin_buff;
+    float32_t cos_buff;
+#ifdef DSP_Q31
+    q31_t     sin_q31;
+    q31_t     cos_q31;
+#endif
+
+    PROFILE_BEGIN(PROFILE_DO_FILTER);
+#ifdef DSP_Q31
+    do_filter_q31(&sin_q31, &cos_q31);
+    PROFILE_END(PROFILE_DO_FILTER);
+
+    sin_buff = dsp_q31_to_adc(sin_q31);
+    cos_buff = dsp_q31_to_adc(cos_q31);
+
+    if (integrator_push(sin_q31, cos_q31))
+        integrator_publish();
+#else
+    do_filter(&sin_buff, &cos_buff);
+    PROFILE_END(PROFILE_DO_FILTER);
+
+    if (integrator_push(sin_buff, cos_buff))
+        integrator_publish();
+#endif
+
+    if (result_sensor() == CLAMP_SENSOR) {
+        float32_t abs_val;
+
+        arm_sqrt_f32(sin_buff * sin_buff + cos_buff * cos_buff, &abs_val);
+
+        abs_val *= result_calibration(CLAMP_SENSOR)->gain_inv;
+
+        buzzer_set_freq(abs_val);
+    }
+}
+#endif
+
+#ifdef DSP_BLOCK_MIXER
+static void
+bank_store(sensor_type_t sensor)
+{
+    Scan_bank_t *bank = &scan_bank[sensor];
+
+#ifdef DSP_CORRELATOR
+    bank->correlator = correlator;
+    /* the period in progress is not finished with this sensor */
+    bank->correlator.period_sin = 0;
+    bank->correlator.period_cos = 0;
+#ifdef DSP_DUAL_TONE
+    bank->correlator_tone2            = correlator_tone2;
+    bank->correlator_tone2.period_sin = 0;
+    bank->correlator_tone2.period_cos = 0;
+#endif
+#else
+#ifdef DSP_Q31
+    dsp_q31_save_state(&bank->q31);
+#else
+    bank->filter = filter_state;
+#endif
+#ifdef DSP_CIC
+    bank->cic = cic;
+#endif
+#ifdef DSP_HALFBAND
+    bank->halfband[0] = halfband1_sin_inst;
+    bank->halfband[1] = halfband1_cos_inst;
+    bank->halfband[2] = halfband2_sin_inst;
+    bank->halfband[3] = halfband2_cos_inst;
+#endif
+#ifdef DSP_QUADRATURE
+    bank->quadrature = quadrature;
+#endif
+    bank->integrator = integrator;
+#endif
+#ifdef DSP_HARMONICS
+    bank->harmonics = harmonics;
+    dsp_harmonics_break(&bank->harmonics);
+#endif
+    bank->filter_gain = filter_gain;
+}
+
+static void
+bank_load(sensor_type_t sensor)
+{
+    const Scan_bank_t *bank = &scan_bank[sensor];
+
+#ifdef DSP_CORRELATOR
+    correlator = bank->correlator;
+#ifdef DSP_DUAL_TONE
+    correlator_tone2 = bank->correlator_tone2;
+#endif
+#else
+#ifdef DSP_Q31
+    dsp_q31_load_state(&bank->q31);
+#else
+    filter_state = bank->filter;
+#endif
+#ifdef DSP_CIC
+    cic = bank->cic;
+#endif
+#ifdef DSP_HALFBAND
+    halfband1_sin_inst = bank->halfband[0];
+    halfband1_cos_inst = bank->halfband[1];
+    halfband2_sin_inst = bank->halfband[2];
+    halfband2_cos_inst = bank->halfband[3];
+#endif
+#ifdef DSP_QUADRATURE
+    quadrature = bank->quadrature;
+#endif
+    integrator = bank->integrator;
+#endif
+#ifdef DSP_HARMONICS
+    harmonics = bank->harmonics;
+#endif
+    filter_gain = bank->filter_gain;
+
+#ifdef DSP_CORRELATOR
+    scan.resume = true;
+#endif
+}
+
+/* the live state from the start, in every bank */
+static void
+bank_reset_all(void)
+{
+    sensor_type_t sensor;
+
+#ifdef DSP_CORRELATOR
+    correlator_restart(dsp_correlator_periods(clamp_measurements_result.integrator_len));
+#else
+#ifdef DSP_Q31
+    static const Dsp_q31_state_t q31_zero;
+
+    dsp_q31_load_state(&q31_zero);
+#else
+    memset(&filter_state, 0, sizeof(filter_state));
+#endif
+#ifdef DSP_CIC
+    dsp_cic_reset(&cic);
+#endif
+#ifdef DSP_HALFBAND
+    dsp_halfband_reset(&halfband1_sin_inst);
+    dsp_halfband_reset(&halfband1_cos_inst);
+    dsp_halfband_reset(&halfband2_sin_inst);
+    dsp_halfband_reset(&halfband2_cos_inst);
+#endif
+#ifdef DSP_QUADRATURE
+    dsp_quadrature_reset(&quadrature);
+#endif
+    integrator_reset();
+#endif
+#ifdef DSP_HARMONICS
+    dsp_harmonics_reset(&harmonics, dsp_correlator_periods(clamp_measurements_result.integrator_len));
+#endif
+    filter_gain.valid = false;
+
+    for (sensor = SHUNT_SENSOR; sensor <= VOLTAGE_SENSOR; sensor++)
+        bank_store(sensor);
+}
+
+static inline void
+rotate_pairs(float32_t *sin_buf, float32_t *cos_buf, uint32_t len, Complex_t ratio)
+{
+    float32_t sin_val;
+
+    while (len--) {
+        sin_val    = *sin_buf;
+        *sin_buf++ = *cos_buf * ratio.Q + sin_val * ratio.I;
+        *cos_buf   = *cos_buf * ratio.I - sin_val * ratio.Q;
+        cos_buf++;
+    }
+}
+
+#define ROTATE_STATE(name, ratio)                                                   \
+    rotate_pairs(filter_state.name##_sin,                                           \
+                 filter_state.name##_cos,                                           \
+                 sizeof(filter_state.name##_sin) / sizeof(filter_state.name##_sin[0]), \
+                 ratio)
+
+/*
+ * The gains changed between two blocks of the same sensor. Everything in the
+ * filter history is linear in the input, so instead of letting the step ring
+ * through the cascade and the integrator window, the history is brought to
+ * what it would have been at the new gains: times the ratio of the two
+ * calibration corrections, which also carries the phase step of a front-end
+ * gain switch.
+ */
+static void
+rescale_state(const Dsp_gain_state_t *from, const Dsp_gain_state_t *to)
+{
+    Complex_t ratio;
+
+    /* calibration measures the raw vector of each gain on its own */
+    if (Calibrator.is_calibrating)
+        return;
+
+    /* the second lookup may reuse the cache entry of the first */
+    ratio = dsp_calibration_for(from)->correction;
+    ratio = complex_div(ratio, dsp_calibration_for(to)->correction);
+
+#ifdef DSP_CORRELATOR
+    dsp_correlator_rotate(&correlator, ratio);
+#ifdef DSP_DUAL_TONE
+    dsp_correlator_rotate(&correlator_tone2, ratio);
+#endif
+#else
+#ifdef DSP_Q31
+    dsp_q31_rotate_state(ratio);
+    dsp_q31_rotate(integrator.sin_hist, integrator.cos_hist, INTEGRATOR_MAX_LENGTH, ratio);
+#else
+#ifdef DSP_CIC
+    ROTATE_STATE(cic_comp_statebuff, ratio);
+#endif
+#if defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+    ROTATE_STATE(poly1_statebuff, ratio);
+    ROTATE_STATE(poly2_statebuff, ratio);
+#endif
+    ROTATE_STATE(fir1_statebuff, ratio);
+    ROTATE_STATE(fir2_statebuff, ratio);
+    ROTATE_STATE(biquad1_statebuff, ratio);
+    ROTATE_STATE(biquad2_statebuff, ratio);
+    ROTATE_STATE(biquad3_statebuff, ratio);
+    rotate_pairs(integrator.sin_hist, integrator.cos_hist, INTEGRATOR_MAX_LENGTH, ratio);
+#endif
+#ifdef DSP_CIC
+    /* the integrators wrap around, so their state has no scale to change */
+    dsp_cic_reset(&cic);
+#endif
+#ifdef DSP_HALFBAND
+    rotate_pairs(halfband1_sin_inst.state, halfband1_cos_inst.state, HALFBAND_NCOEFFS - 1, ratio);
+    rotate_pairs(halfband2_sin_inst.state, halfband2_cos_inst.state, HALFBAND_NCOEFFS - 1, ratio);
+#endif
+#ifdef DSP_QUADRATURE
+    /* raw samples ahead of the mixer: only the magnitude applies */
+    dsp_quadrature_scale(&quadrature, complex_abs(ratio));
+#endif
+    integrator_rebuild();
+#endif
+#ifdef DSP_HARMONICS
+    dsp_harmonics_rotate(&harmonics, ratio);
+#endif
+}
+#endif
+
+/* the next block does not follow on from the last one: no period may span the gap */
+static void
+break_periods(void)
+{
+#ifdef DSP_CORRELATOR
+    correlator.period_sin = 0;
+    correlator.period_cos = 0;
+#ifdef DSP_DUAL_TONE
+    correlator_tone2.period_sin = 0;
+    correlator_tone2.period_cos = 0;
+#endif
+    scan.resume           = true;
+#endif
+#ifdef DSP_HARMONICS
+    dsp_harmonics_break(&harmonics);
+#endif
+}
+
+/* false for a block that is dropped; otherwise the bank of its sensor is live, at its gains */
+static bool
+enter_block(uint32_t slot)
+{
+#ifdef DSP_BLOCK_MIXER
+    const Dsp_gain_state_t *gain = &adc_block_gain[slot];
+
+    if (adc_block_settling[slot]) {
+        break_periods();
+        return false;
+    }
+
+    /* a manual switch as well as a scan step: the sensor carries on where it left off */
+    if (gain->sensor != scan.sensor) {
+        bank_store(scan.sensor);
+        bank_load(gain->sensor);
+        scan.sensor = gain->sensor;
+    }
+
+    if (filter_gain.valid && filter_gain.gain.sensor == gain->sensor &&
+        !dsp_gain_state_equal(&filter_gain.gain, gain))
+        rescale_state(&filter_gain.gain, gain);
+
+    filter_gain.gain  = *gain;
+    filter_gain.valid = true;
+#endif
+
+    return true;
+}
+
+/*
+ * Each sensor has its own filter history and integrator window, so the
+ * readings of all three build up side by side. The banks follow the MUX in
+ * manual mode as well, so a scan starts from warm banks and the displayed
+ * sensor carries on from its own when it stops. Only on the block mixer: the
+ * sample mixer filters in the interrupt, before a block is known to be whole.
+ */
+bool
+dsp_scan_start(void)
+{
+#ifdef DSP_BLOCK_MIXER
+    scan.active = true;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+dsp_scan_stop(void)
+{
+    scan.active = false;
+}
+
+/*
+ * A dropped block leaves a gap in the data; the readings are flagged until
+ * the window has moved past it. The gap lies behind the blocks that were
+ * waiting when it happened, up to DSP_QUEUE_LEN - 1 of them.
+ */
+static inline void
+track_data_lost(void)
+{
+    uint32_t dropped = block_queue.dropped;
+
+    if (dropped != data_lost_seen) {
+        data_lost_seen   = dropped;
+        data_lost_blocks = clamp_measurements_result.integrator_len + DSP_QUEUE_LEN;
+    }
+    else if (data_lost_blocks > 0)
+        data_lost_blocks--;
+}
+
+/* all blocks the ADC interrupt has completed since the last call, oldest first */
+void
+dsp_integrating_filter(void)
+{
+    uint32_t slot;
+    uint32_t filtered = 0;
+
+    dsp_queue_visit(&block_queue);
+
+    while (dsp_queue_read_slot(&block_queue, &slot)) {
+        track_data_lost();
+
+        if (dsp_queue_gap(&block_queue))
+            break_periods();
+
+        if (enter_block(slot)) {
+            integrate_block();
+#ifdef DSP_HARMONICS
+            harmonics_block();
+#endif
+            filtered++;
+        }
+
+        dsp_queue_release(&block_queue);
+    }
+
+    restart_blocks += filtered;
+
+    /* between blocks, where the sweep may restart the filters */
+    sweep_poll(filtered);
+    excitation_control(filtered);
+}
+
+Dsp_queue_stats_t
+dsp_block_queue_stats(void)
+{
+    return dsp_queue_stats(&block_queue);
+}
+
+/* blocks filtered since the last reset_filters() or dsp_restart_readings(), of all sensors */
+uint32_t
+dsp_blocks_since_restart(void)
+{
+    return restart_blocks;
+}
+
+void
+dsp_set_integrator_len(uint32_t len)
+{
+    if (len < 1)
+        len = 1;
+    else if (len > INTEGRATOR_MAX_LENGTH)
+        len = INTEGRATOR_MAX_LENGTH;
+
+    clamp_measurements_result.integrator_len = len;
+}
+
+/* 0 turns early finalization off: every reading runs to integrator_len */
+void
+dsp_set_uncertainty_target(float32_t target)
+{
+    if (target < 0)
+        target = 0;
+
+    clamp_measurements_result.uncertainty_target = target;
+}
+
+typedef struct {
+    uint8_t   output_stage;
+    uint32_t  integrator_len;
+    float32_t uncertainty_target;
+} Dsp_profile_cfg_t;
+
+static const Dsp_profile_cfg_t dsp_profiles[DSP_PROFILE_COUNT] = {
+    [DSP_PROFILE_FAST]    = { OUTPUT_STAGE_WIDE, 20, 1e-2f },
+    [DSP_PROFILE_NORMAL]  = { OUTPUT_STAGE_NARROW, INTEGRATOR_LENGTH, UNCERTAINTY_TARGET_DEFAULT },
+    [DSP_PROFILE_PRECISE] = { OUTPUT_STAGE_NARROW, INTEGRATOR_MAX_LENGTH, 2e-4f },
+};
+
+#ifndef DSP_CORRELATOR
+/* the biquad3 instances start over with the coefficients of the stage */
+static void
+output_stage_select(uint8_t stage)
+{
+    float32_t *coeffs = output_stage_coeffs[stage];
+
+    arm_biquad_cascade_df2T_init_f32(&biquad3_sin_inst, BIQUAD3_NSTAGES, coeffs, filter_state.biquad3_statebuff_sin);
+    arm_biquad_cascade_df2T_init_f32(&biquad3_cos_inst, BIQUAD3_NSTAGES, coeffs, filter_state.biquad3_statebuff_cos);
+#ifdef DSP_Q31
+    dsp_q31_set_biquad3(coeffs);
+#endif
+
+    var_factor = cascade_var_factor[stage];
+}
+#endif
+
+/*
+ * Everything of a profile at once. The output stage restarts from zero, so
+ * this goes between two readings, with reset_filters() after it; see
+ * measurement_set_profile().
+ */
+void
+dsp_set_profile(Dsp_profile_t profile)
+{
+    const Dsp_profile_cfg_t *cfg;
+
+    if (profile >= DSP_PROFILE_COUNT)
+        return;
+
+    cfg = &dsp_profiles[profile];
+
+#ifndef DSP_CORRELATOR
+    output_stage_select(cfg->output_stage);
+#endif
+    dsp_set_integrator_len(cfg->integrator_len);
+    dsp_set_uncertainty_target(cfg->uncertainty_target);
+
+    clamp_measurements_result.profile = profile;
+}
+
+#ifdef DSP_Q31
+static void
+do_filter_q31(q31_t *sin_out, q31_t *cos_out)
+{
+    q31_t   *raw_buffer;
+    uint32_t raw_phase;
+
+    ready_raw_block(&raw_buffer, &raw_phase);
+    dsp_q31_filter_block(raw_buffer, raw_phase, sin_out, cos_out);
+}
+
+void
+do_filter(float32_t *sin_out, float32_t *cos_out)
+{
+    q31_t sin_q31;
+    q31_t cos_q31;
+
+    do_filter_q31(&sin_q31, &cos_q31);
+
+    *sin_out = dsp_q31_to_adc(sin_q31);
+    *cos_out = dsp_q31_to_adc(cos_q31);
+}
+#else
+void
+do_filter(float32_t *sin_out, float32_t *cos_out)
+{
+#ifdef DSP_CIC
+    float32_t *cic_sin_ptr;
+    float32_t *cic_cos_ptr;
+
+#ifdef DSP_BLOCK_MIXER
+    int32_t *raw_buffer;
+    uint32_t raw_phase;
+
+    ready_raw_block(&raw_buffer, &raw_phase);
+
+    cic_sin_ptr = cic_sin_buff;
+    cic_cos_ptr = cic_cos_buff;
+
+    dsp_cic_process(&cic, raw_buffer, raw_phase, BIQUAD1_BUFFSIZE, cic_sin_ptr, cic_cos_ptr);
+#else
+    uint32_t slot;
+
+    slot        = ready_slot();
+    cic_sin_ptr = cic_sin_queue[slot];
+    cic_cos_ptr = cic_cos_queue[slot];
+#endif
+
+    arm_fir_f32(&cic_comp_sin_inst, cic_sin_ptr, fir1_sin, CIC_COMP_BLOCKSIZE);
+
+    arm_fir_f32(&cic_comp_cos_inst, cic_cos_ptr, fir1_cos, CIC_COMP_BLOCKSIZE);
+#elif defined(DSP_HALFBAND) || defined(DSP_QUADRATURE)
+    float32_t *raw_buffer;
+    uint32_t   raw_phase;
+
+    ready_raw_block(&raw_buffer, &raw_phase);
+
+#ifdef DSP_HALFBAND
+    arm_mult_f32(raw_buffer, &mixer_sin_ref[raw_phase], biquad1_sin_buff, BIQUAD1_BUFFSIZE);
+
+    arm_mult_f32(raw_buffer, &mixer_cos_ref[raw_phase], biquad1_cos_buff, BIQUAD1_BUFFSIZE);
+
+    dsp_halfband_decimate(&halfband1_sin_inst, biquad1_sin_buff, halfband1_sin, HALFBAND1_BLOCKSIZE);
+
+    dsp_halfband_decimate(&halfband1_cos_inst, biquad1_cos_buff, halfband1_cos, HALFBAND1_BLOCKSIZE);
+
+    dsp_halfband_decimate(&halfband2_sin_inst, halfband1_sin, halfband2_sin, HALFBAND2_BLOCKSIZE);
+
+    dsp_halfband_decimate(&halfband2_cos_inst, halfband1_cos, halfband2_cos, HALFBAND2_BLOCKSIZE);
+#else
+    dsp_quadrature_mix(&quadrature, raw_buffer, raw_phase, BIQUAD1_BUFFSIZE, halfband2_sin, halfband2_cos);
+#endif
+
+    arm_fir_decimate_f32(&poly1_sin_inst, halfband2_sin, poly1_sin, POLY1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_f32(&poly1_cos_inst, halfband2_cos, poly1_cos, POLY1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_f32(&poly2_sin_inst, poly1_sin, fir2_sin, POLY2_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_f32(&poly2_cos_inst, poly1_cos, fir2_cos, POLY2_DEC_BLOCKSIZE);
+#else
+    float32_t *biquad1_sin_buffer_ptr;
+    float32_t *biquad1_cos_buffer_ptr;
+
+#ifdef DSP_BLOCK_MIXER
+    float32_t *raw_buffer;
+    uint32_t   raw_phase;
+
+    ready_raw_block(&raw_buffer, &raw_phase);
+
+    biquad1_sin_buffer_ptr = biquad1_sin_buff;
+    biquad1_cos_buffer_ptr = biquad1_cos_buff;
+
+    arm_mult_f32(raw_buffer, &mixer_sin_ref[raw_phase], biquad1_sin_buffer_ptr, BIQUAD1_BUFFSIZE);
+
+    arm_mult_f32(raw_buffer, &mixer_cos_ref[raw_phase], biquad1_cos_buffer_ptr, BIQUAD1_BUFFSIZE);
+
+    arm_biquad_cascade_df2T_f32(&biquad1_sin_inst, biquad1_sin_buffer_ptr, biquad1_sin_buffer_ptr, BIQUAD1_BUFFSIZE);
+
+    arm_biquad_cascade_df2T_f32(&biquad1_cos_inst, biquad1_cos_buffer_ptr, biquad1_cos_buffer_ptr, BIQUAD1_BUFFSIZE);
+#else
+    uint32_t slot;
+
+    slot                   = ready_slot();
+    biquad1_sin_buffer_ptr = biquad1_sin_queue[slot];
+    biquad1_cos_buffer_ptr = biquad1_cos_queue[slot];
+#endif
+
+    arm_fir_decimate_f32(&firdec1_sin_inst, biquad1_sin_buffer_ptr, fir1_sin, FIR1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_f32(&firdec1_cos_inst, biquad1_cos_buffer_ptr, fir1_cos, FIR1_DEC_BLOCKSIZE);
+#endif
+
+#if !defined(DSP_HALFBAND) && !defined(DSP_QUADRATURE)
     arm_biquad_cascade_df2T_f32(&biquad2_sin_inst, fir1_sin, biquad2_sin, BIQUAD2_BUFFSIZE);
 
     arm_biquad_cascade_df2T_f32(&biquad2_cos_inst, fir1_cos, biquad2_cos, BIQUAD2_BUFFSIZE);
@@ -447,6 +1971,7 @@ do_filter(float32_t *sin_out, float32_t *cos_out)
     arm_fir_decimate_f32(&firdec2_sin_inst, biquad2_sin, fir2_sin, FIR2_DEC_BLOCKSIZE);
 
     arm_fir_decimate_f32(&firdec2_cos_inst, biquad2_cos, fir2_cos, FIR2_DEC_BLOCKSIZE);
+#endif
 
     arm_biquad_cascade_df2T_f32(&biquad3_sin_inst, fir2_sin, &biquad3_sin, BIQUAD3_BUFFSIZE);
 
@@ -455,20 +1980,113 @@ do_filter(float32_t *sin_out, float32_t *cos_out)
     *sin_out = biquad3_sin;
     *cos_out = biquad3_cos;
 }
+#endif
 
 void
 reset_filters(void)
 {
-    decimator_databuff_is_ready = false;
-    fir2_dataready_flag         = false;
-    use_next_buffer             = false;
-    biquad1_counter             = 0;
-    phase_counter               = 0;
+    fir2_dataready_flag = false;
+    biquad1_counter     = 0;
+    phase_counter       = 0;
+    data_lost_blocks    = 0;
+    data_lost_seen      = 0;
+    restart_blocks      = 0;
+    agc_count           = 0;
+    agc_hold            = 0;
+
+    dsp_queue_reset(&block_queue);
+    clamp_measurements_result.final_sensors = 0;
+
+#ifdef DSP_HARMONICS
+    clamp_measurements_result.V_ovrl_thd  = 0;
+    clamp_measurements_result.V_shunt_thd = 0;
+    clamp_measurements_result.I_clamp_thd = 0;
+    clamp_measurements_result.distorted   = false;
+#endif
+
+#ifdef DSP_CIC
+    dsp_cic_reset(&cic);
+#endif
+#ifdef DSP_QUADRATURE
+    dsp_quadrature_reset(&quadrature);
+#endif
+
+#ifdef DSP_CORRELATOR
+    correlator_restart(dsp_correlator_periods(clamp_measurements_result.integrator_len));
+#else
+    integrator_reset();
+#endif
+
+    filter_gain.valid = false;
+
+#ifdef DSP_BLOCK_MIXER
+    isr_sensor        = sensor_of_mux(MCP3462_get_mux());
+
+    bank_reset_all();
+    scan.sensor = isr_sensor;
+    scan.resume = false;
+
+    isr_sensor_gain   = dsp_gain_state(isr_sensor, GAIN_1).sensor_gain;
+    isr_settle_blocks = 0;
+#endif
 
     test_counter_adc  = 0;
     test_counter_dacc = 0;
 }
 
+/*
+ * reset_filters() with the generator running: the DAC goes on where it is,
+ * so the mixer references stay in step with it. The phases of the sensors
+ * are measured against the DAC, and the clamp current against V_ovrl.
+ */
+void
+dsp_restart_readings(void)
+{
+    uint32_t phase = phase_counter;
+
+    reset_filters();
+    phase_counter = phase;
+}
+
+/*
+ * The excitation moved by ratio: the sensor readings still on display go
+ * with it, so the impedances formed from them against the next reading of
+ * another sensor stay right.
+ */
+void
+dsp_scale_readings(float32_t ratio)
+{
+    Dsp_t *res = &clamp_measurements_result;
+
+    res->V_ovrl_I *= ratio;
+    res->V_ovrl_Q *= ratio;
+    res->V_ovrl *= ratio;
+    res->V_applied_I *= ratio;
+    res->V_applied_Q *= ratio;
+    res->V_applied *= ratio;
+    res->V_shunt_I *= ratio;
+    res->V_shunt_Q *= ratio;
+    res->V_shunt *= ratio;
+    res->I_clamp_I *= ratio;
+    res->I_clamp_Q *= ratio;
+    res->I_clamp *= ratio;
+
+#ifdef DSP_DUAL_TONE
+    res->tone2.V_ovrl_I *= ratio;
+    res->tone2.V_ovrl_Q *= ratio;
+    res->tone2.V_ovrl *= ratio;
+    res->tone2.V_applied_I *= ratio;
+    res->tone2.V_applied_Q *= ratio;
+    res->tone2.V_applied *= ratio;
+    res->tone2.V_shunt_I *= ratio;
+    res->tone2.V_shunt_Q *= ratio;
+    res->tone2.V_shunt *= ratio;
+    res->tone2.I_clamp_I *= ratio;
+    res->tone2.I_clamp_Q *= ratio;
+    res->tone2.I_clamp *= ratio;
+#endif
+}
+
 static inline float32_t
 normalize_angle(float32_t degree)
 {
@@ -480,154 +2098,123 @@ normalize_angle(float32_t degree)
     return degree;
 }
 
+/* phase of cosine + j sine in degrees, 0 ... 360; absval is not needed any more */
 float32_t
 find_angle(float32_t sine, float32_t cosine, float32_t absval)
 {
-    float32_t        abs_sin;
-    float32_t        abs_cos;
-    float32_t        degree;
-    static float32_t rad2deg_conv_coeff = 180 / PI;
-
-    if (sine < 0)
-        abs_sin = -sine;
-    else
-        abs_sin = sine;
-
-    if (cosine < 0)
-        abs_cos = -cosine;
-    else
-        abs_cos = cosine;
-
-    if (abs_sin < abs_cos)
-        degree = acosf(abs_cos / absval) * rad2deg_conv_coeff;
-    else
-        degree = asinf(abs_sin / absval) * rad2deg_conv_coeff;
-
-    if (sine < 0) {
-        if (cosine < 0)
-            degree += 180;
-        else
-            degree = 360 - degree;
-    }
-    else {
-        if (cosine < 0)
-            degree = 180 - degree;
-    }
-
-    return degree;
+    return normalize_angle(fast_atan2f(sine, cosine) * (180 / PI));
 }
 
 void
 calculate_clamp_sensor(float32_t I, float32_t Q, float32_t abs_val, float32_t degree)
 {
-    float32_t sine;
-    float32_t cosine;
-    float32_t buff;
-    float32_t gain = Cal_data.clamp_gain[Analog.clamp_sensor_gain] * adc_gain_coeffs[Analog.adc_gain];
-
-    if (Clamp_calibrator.is_calibrated)
-        clamp_measurements_result.I_clamp *= Clamp_calibrator.position_gain;
+    Complex_t I_clamp;
+    Complex_t V_ovrl    = complex_make(clamp_measurements_result.V_ovrl_I, clamp_measurements_result.V_ovrl_Q);
+    Complex_t V_applied = complex_make(clamp_measurements_result.V_applied_I, clamp_measurements_result.V_applied_Q);
+    Complex_t reference;
 
-    clamp_measurements_result.I_clamp = abs_val / gain;
+    const Dsp_cal_factor_t *cal = result_calibration(CLAMP_SENSOR);
 
-    if (Clamp_calibrator.is_calibrated)
-        clamp_measurements_result.I_clamp *= Clamp_calibrator.position_gain;
+    clamp_measurements_result.I_clamp = abs_val * cal->gain_inv;
 
-    clamp_measurements_result.I_clamp_phi = degree - clamp_measurements_result.V_ovrl_phi -
-                                            clamp_measurements_result.V_applied_phi -
-                                            Cal_data.clamp_phi[Analog.clamp_sensor_gain];
-
-    clamp_measurements_result.Z_clamp     = clamp_measurements_result.V_applied / clamp_measurements_result.I_clamp;
-    clamp_measurements_result.Z_clamp_phi = normalize_angle(clamp_measurements_result.I_clamp_phi);
+    /* the current relative to the phases of V_ovrl and V_applied */
+    reference = complex_mul(complex_unit(V_ovrl, clamp_measurements_result.V_ovrl),
+                            complex_unit(V_applied, clamp_measurements_result.V_applied));
+    I_clamp   = complex_mul_conj(complex_mul(complex_make(I, Q), cal->correction), reference);
 
-    arm_sin_cos_f32(clamp_measurements_result.I_clamp_phi, &sine, &cosine);
-    clamp_measurements_result.I_clamp_I = clamp_measurements_result.I_clamp * cosine;
-    clamp_measurements_result.I_clamp_Q = clamp_measurements_result.I_clamp * sine;
+    clamp_measurements_result.I_clamp_I = I_clamp.I;
+    clamp_measurements_result.I_clamp_Q = I_clamp.Q;
 
+    clamp_measurements_result.Z_clamp = clamp_measurements_result.V_applied / clamp_measurements_result.I_clamp;
     clamp_measurements_result.R_clamp = clamp_measurements_result.V_applied / clamp_measurements_result.I_clamp_I;
     clamp_measurements_result.X_clamp = clamp_measurements_result.V_applied / clamp_measurements_result.I_clamp_Q;
-}
-
-static inline void
-calculate_V_applied(void)
-{
-    clamp_measurements_result.V_applied_I = clamp_measurements_result.V_ovrl_I - clamp_measurements_result.V_shunt_I;
-    clamp_measurements_result.V_applied_Q = clamp_measurements_result.V_ovrl_Q - clamp_measurements_result.V_shunt_Q;
-
-    arm_sqrt_f32(clamp_measurements_result.V_applied_I * clamp_measurements_result.V_applied_I +
-                   clamp_measurements_result.V_applied_Q * clamp_measurements_result.V_applied_Q,
-                 &clamp_measurements_result.V_applied);
 
-    clamp_measurements_result.V_applied_phi = find_angle(clamp_measurements_result.V_applied_Q,
-                                                         clamp_measurements_result.V_applied_I,
-                                                         clamp_measurements_result.V_applied);
+    /* display only */
+    clamp_measurements_result.I_clamp_phi = degree - clamp_measurements_result.V_ovrl_phi -
+                                            clamp_measurements_result.V_applied_phi - cal->phi;
+    clamp_measurements_result.Z_clamp_phi = normalize_angle(clamp_measurements_result.I_clamp_phi);
 }
 
 void
 calculate_shunt_sensor(float32_t I, float32_t Q, float32_t abs_val, float32_t degree)
 {
-    float32_t A_i, A_q, B_mag, B_phi, magic_mag, magic_phi, magic_i, magic_q;
-    float32_t buff;
-    float32_t sine;
-    float32_t cosine;
-
-    float32_t gain = Cal_data.shunt_gain[Analog.shunt_sensor_gain] * adc_gain_coeffs[Analog.adc_gain];
-
-    clamp_measurements_result.V_shunt     = abs_val / gain;
-    clamp_measurements_result.V_shunt_phi = normalize_angle(degree - Cal_data.shunt_phi[Analog.shunt_sensor_gain]);
-
-    arm_sin_cos_f32(clamp_measurements_result.V_shunt_phi, &sine, &cosine);
-
-    clamp_measurements_result.V_shunt_I = clamp_measurements_result.V_shunt * cosine;
-    clamp_measurements_result.V_shunt_Q = clamp_measurements_result.V_shunt * sine;
-
-    calculate_V_applied();
-
-    A_i = clamp_measurements_result.V_ovrl_I - clamp_measurements_result.V_shunt_I;
-    A_q = clamp_measurements_result.V_ovrl_Q - clamp_measurements_result.V_shunt_Q;
-
-    magic_mag = clamp_measurements_result.V_shunt / (R_SHUNT * clamp_measurements_result.V_applied);
-    magic_phi = clamp_measurements_result.V_shunt_phi - clamp_measurements_result.V_applied_phi;
-
-    arm_sin_cos_f32(magic_phi, &sine, &cosine);
-
-    magic_i = magic_mag * cosine;
-    magic_q = magic_mag * sine;
-
-    clamp_measurements_result.R_ovrl     = 1 / magic_i;
-    clamp_measurements_result.X_ovrl     = 1 / magic_q;
-    clamp_measurements_result.Z_ovrl_phi = magic_phi;
-    clamp_measurements_result.Z_ovrl     = 1 / magic_mag;
+    Complex_t V_shunt;
+    Complex_t V_applied;
+    Complex_t Y_ovrl;
+    float32_t V_applied_norm;
+
+    const Dsp_cal_factor_t *cal = result_calibration(SHUNT_SENSOR);
+
+    V_shunt        = complex_mul(complex_make(I, Q), cal->correction);
+    V_applied      = complex_sub(complex_make(clamp_measurements_result.V_ovrl_I, clamp_measurements_result.V_ovrl_Q),
+                            V_shunt);
+    V_applied_norm = complex_norm(V_applied);
+
+    clamp_measurements_result.V_shunt     = abs_val * cal->gain_inv;
+    clamp_measurements_result.V_shunt_I   = V_shunt.I;
+    clamp_measurements_result.V_shunt_Q   = V_shunt.Q;
+    clamp_measurements_result.V_applied_I = V_applied.I;
+    clamp_measurements_result.V_applied_Q = V_applied.Q;
+    arm_sqrt_f32(V_applied_norm, &clamp_measurements_result.V_applied);
+
+    /* admittance of the load: the shunt current over V_applied */
+    Y_ovrl = complex_scale(complex_div_norm(V_shunt, V_applied, V_applied_norm), 1.0f / R_SHUNT);
+
+    clamp_measurements_result.R_ovrl = 1 / Y_ovrl.I;
+    clamp_measurements_result.X_ovrl = 1 / Y_ovrl.Q;
+    clamp_measurements_result.Z_ovrl = R_SHUNT * clamp_measurements_result.V_applied / clamp_measurements_result.V_shunt;
+
+    /* display only; V_applied_phi also goes into I_clamp_phi */
+    clamp_measurements_result.V_shunt_phi   = normalize_angle(degree - cal->phi);
+    clamp_measurements_result.V_applied_phi = find_angle(V_applied.Q, V_applied.I, clamp_measurements_result.V_applied);
+    clamp_measurements_result.Z_ovrl_phi    = clamp_measurements_result.V_shunt_phi -
+                                              clamp_measurements_result.V_applied_phi;
 }
 
 void
 calculate_voltage_sensor(float32_t I, float32_t Q, float32_t abs_val, float32_t degree)
 {
-    float32_t gain = (Cal_data.v_sens_gain * adc_gain_coeffs[Analog.adc_gain]);
-    float32_t sine;
-    float32_t cosine;
+    Complex_t V_ovrl;
 
-    clamp_measurements_result.V_ovrl          = abs_val / gain;
-    clamp_measurements_result.V_ovrl_phi_orig = degree;
-    clamp_measurements_result.V_ovrl_phi      = degree - Cal_data.v_sens_phi;
+    const Dsp_cal_factor_t *cal = result_calibration(VOLTAGE_SENSOR);
 
-    arm_sin_cos_f32(clamp_measurements_result.V_ovrl_phi, &sine, &cosine);
+    V_ovrl = complex_mul(complex_make(I, Q), cal->correction);
 
-    clamp_measurements_result.V_ovrl_I = clamp_measurements_result.V_ovrl * cosine;
-    clamp_measurements_result.V_ovrl_Q = clamp_measurements_result.V_ovrl * sine;
+    clamp_measurements_result.V_ovrl   = abs_val * cal->gain_inv;
+    clamp_measurements_result.V_ovrl_I = V_ovrl.I;
+    clamp_measurements_result.V_ovrl_Q = V_ovrl.Q;
+
+    /* display only */
+    clamp_measurements_result.V_ovrl_phi_orig = degree;
+    clamp_measurements_result.V_ovrl_phi      = degree - cal->phi;
+}
+
+/* the shunt gives Z_ovrl, the clamp Z_clamp; with DSP_DUAL_TONE once the second tone is in as well */
+static void
+fit_sensed_data(sensor_type_t sensor)
+{
+    if (sensor == SHUNT_SENSOR)
+        circuit_fit_reading(false, &clamp_measurements_result.fit_ovrl);
+    else if (sensor == CLAMP_SENSOR)
+        circuit_fit_reading(true, &clamp_measurements_result.fit_clamp);
 }
 
 void
 manage_sensed_data(float32_t sin_vect, float32_t cos_vect)
 {
-    float32_t abs_val;
-    float32_t buff;
-    float32_t degree;
+    float32_t     abs_val;
+    float32_t     buff;
+    float32_t     degree;
+    sensor_type_t sensor = result_sensor();
 
     arm_sqrt_f32(sin_vect * sin_vect + cos_vect * cos_vect, &abs_val);
     degree = find_angle(sin_vect, cos_vect, abs_val);
 
     if (Calibrator.is_calibrating) {
+        /* calibration only takes settled readings */
+        if (!clamp_measurements_result.result_is_final)
+            return;
+
         Calibrator.sensor_mag        = abs_val;
         Calibrator.sensor_phi        = degree;
         Calibrator.new_data_is_ready = true;
@@ -636,15 +2223,86 @@ manage_sensed_data(float32_t sin_vect, float32_t cos_vect)
         clamp_measurements_result.new_data_is_ready = true;
         clamp_measurements_result.degree            = degree;
 
-        if (Analog.selected_sensor == VOLTAGE_SENSOR)
+        if (sensor == VOLTAGE_SENSOR)
             calculate_voltage_sensor(cos_vect, sin_vect, abs_val, degree);
-        else if (Analog.selected_sensor == SHUNT_SENSOR)
+        else if (sensor == SHUNT_SENSOR)
             calculate_shunt_sensor(cos_vect, sin_vect, abs_val, degree);
-        else if (Analog.selected_sensor == CLAMP_SENSOR)
+        else if (sensor == CLAMP_SENSOR)
             calculate_clamp_sensor(cos_vect, sin_vect, abs_val, degree);
+
+#ifndef DSP_DUAL_TONE
+        fit_sensed_data(sensor);
+#endif
     }
 }
 
+#ifdef DSP_DUAL_TONE
+/*
+ * The second tone, as calculate_*_sensor() do it for the excitation, with
+ * the phasors in place of the display angles: Z_ovrl_phi is the angle of the
+ * load admittance and Z_clamp_phi the one of the clamp current against
+ * V_ovrl and V_applied, as for the excitation.
+ */
+void
+manage_tone2_data(float32_t sin_vect, float32_t cos_vect)
+{
+    Dsp_tone_t   *tone   = &clamp_measurements_result.tone2;
+    sensor_type_t sensor = result_sensor();
+    Complex_t     value;
+    Complex_t     V_ovrl;
+    Complex_t     V_applied;
+    Complex_t     reference;
+    Complex_t     Y_ovrl;
+    float32_t     V_applied_norm;
+
+    /* the calibration is of the excitation only */
+    if (Calibrator.is_calibrating)
+        return;
+
+    value                   = complex_mul(complex_make(cos_vect, sin_vect), result_calibration(sensor)->correction);
+    V_ovrl                  = complex_make(tone->V_ovrl_I, tone->V_ovrl_Q);
+    tone->new_data_is_ready = true;
+
+    if (sensor == VOLTAGE_SENSOR) {
+        tone->V_ovrl_I = value.I;
+        tone->V_ovrl_Q = value.Q;
+        tone->V_ovrl   = complex_abs(value);
+    }
+    else if (sensor == SHUNT_SENSOR) {
+        V_applied      = complex_sub(V_ovrl, value);
+        V_applied_norm = complex_norm(V_applied);
+        Y_ovrl         = complex_scale(complex_div_norm(value, V_applied, V_applied_norm), 1.0f / R_SHUNT);
+
+        tone->V_shunt_I   = value.I;
+        tone->V_shunt_Q   = value.Q;
+        tone->V_shunt     = complex_abs(value);
+        tone->V_applied_I = V_applied.I;
+        tone->V_applied_Q = V_applied.Q;
+        arm_sqrt_f32(V_applied_norm, &tone->V_applied);
+
+        tone->R_ovrl     = 1 / Y_ovrl.I;
+        tone->X_ovrl     = 1 / Y_ovrl.Q;
+        tone->Z_ovrl     = R_SHUNT * tone->V_applied / tone->V_shunt;
+        tone->Z_ovrl_phi = fast_atan2f(Y_ovrl.Q, Y_ovrl.I) * (180 / PI);
+    }
+    else if (sensor == CLAMP_SENSOR) {
+        V_applied = complex_make(tone->V_applied_I, tone->V_applied_Q);
+        reference = complex_mul(complex_unit(V_ovrl, tone->V_ovrl), complex_unit(V_applied, tone->V_applied));
+        value     = complex_mul_conj(value, reference);
+
+        tone->I_clamp_I   = value.I;
+        tone->I_clamp_Q   = value.Q;
+        tone->I_clamp     = complex_abs(value);
+        tone->Z_clamp     = tone->V_applied / tone->I_clamp;
+        tone->R_clamp     = tone->V_applied / tone->I_clamp_I;
+        tone->X_clamp     = tone->V_applied / tone->I_clamp_Q;
+        tone->Z_clamp_phi = normalize_angle(fast_atan2f(value.Q, value.I) * (180 / PI));
+    }
+
+    fit_sensed_data(sensor);
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
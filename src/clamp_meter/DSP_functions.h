@@ -9,14 +9,127 @@
 #define DSP_FUNCTIONS_H_
 #include "arm_math.h"
 #include "MCP3462.h"
+#include "DSP_queue.h"
+#include "circuit_fit.h"
 #define ADC_TEST_DEF
+#define ADC_PDC_STREAM
+
+/*
+ * DSP_BLOCK_MIXER: the ADC interrupt only stores raw samples; the I/Q mixing
+ * and biquad1 run on whole BIQUAD1_BUFFSIZE blocks in do_filter(). Define
+ * DSP_SAMPLE_MIXER to get the original per-sample mixing in the interrupt.
+ */
+#ifndef DSP_SAMPLE_MIXER
+#define DSP_BLOCK_MIXER
+#endif
+
+/*
+ * DSP_Q31: mixer, filters and integrator in fixed point (DSP_q31.c) instead of
+ * float32. Works on the blocks of the block mixer.
+ */
+// #define DSP_Q31
+
+#if defined(DSP_Q31) && !defined(DSP_BLOCK_MIXER)
+#error "DSP_Q31 needs the block mixer"
+#endif
+
+/*
+ * DSP_CORRELATOR: demodulate by correlating whole excitation periods
+ * (DSP_correlator.c) instead of mixing into the filter cascade. Works on the
+ * float blocks of the block mixer.
+ */
+// #define DSP_CORRELATOR
+
+#if defined(DSP_CORRELATOR) && (!defined(DSP_BLOCK_MIXER) || defined(DSP_Q31))
+#error "DSP_CORRELATOR needs the float block mixer"
+#endif
+
+/*
+ * DSP_DUAL_TONE: the DAC table is the sum of the excitation and a second tone
+ * at DUAL_TONE_BIN times its frequency, each at half the amplitude. A second
+ * correlator demodulates the same blocks at the second tone, so one window
+ * gives both readings (clamp_measurements_result.tone2). Both tones have a
+ * whole number of periods in SINTABLE_LEN samples: over whole periods their
+ * mixing products cancel exactly, which is what the correlator needs.
+ */
+// #define DSP_DUAL_TONE
+
+#if defined(DSP_DUAL_TONE) && !defined(DSP_CORRELATOR)
+#error "DSP_DUAL_TONE needs the correlator"
+#endif
+
+/*
+ * bin of the second tone in the SINTABLE_LEN point period. The harmonic k of
+ * the excitation folds onto bin k mod SINTABLE_LEN or its mirror, so on an even
+ * bin only even harmonics ever land: the odd ones, which symmetric distortion
+ * in the generator and the front ends makes, can't reach the second tone. 6
+ * leaves the 2nd and the 4th clear as well; the first harmonic on it is the
+ * 6th, the first product of the two on the excitation is f2 - 5 f1.
+ */
+#define DUAL_TONE_BIN 6
+
+/*
+ * DSP_CIC: integer mixer and CIC decimator (DSP_cic.c) in place of biquad1 and
+ * firdec1, followed by a droop compensation FIR at the decimated rate. Runs
+ * in the ADC interrupt with DSP_SAMPLE_MIXER, on whole blocks otherwise.
+ */
+// #define DSP_CIC
+
+#if defined(DSP_CIC) && (defined(DSP_Q31) || defined(DSP_CORRELATOR))
+#error "DSP_CIC replaces the front end of the float filter cascade"
+#endif
+
+/*
+ * DSP_HALFBAND: halfband and polyphase decimators (DSP_halfband.c) in place of
+ * biquad1 -> firdec1 -> biquad2 -> firdec2, ahead of the unchanged biquad3.
+ * Works on the float blocks of the block mixer.
+ */
+// #define DSP_HALFBAND
+
+#if defined(DSP_HALFBAND) && (!defined(DSP_BLOCK_MIXER) || defined(DSP_Q31) || defined(DSP_CORRELATOR) || defined(DSP_CIC))
+#error "DSP_HALFBAND replaces the decimation of the float block mixer cascade"
+#endif
+
+/*
+ * DSP_QUADRATURE: four samples per excitation period, so that the mixer
+ * (DSP_quadrature.c) needs no multiplies, followed by the polyphase stages of
+ * DSP_HALFBAND and biquad3. The excitation frequency goes up by
+ * 22 / 4 with the same ADC rate; the sensor calibration has to be redone.
+ */
+// #define DSP_QUADRATURE
+
+#if defined(DSP_QUADRATURE) &&                                                                            \
+    (!defined(DSP_BLOCK_MIXER) || defined(DSP_Q31) || defined(DSP_CORRELATOR) || defined(DSP_CIC) ||    \
+     defined(DSP_HALFBAND))
+#error "DSP_QUADRATURE has its own mixer and needs the float block mixer"
+#endif
+
+/*
+ * DSP_HARMONICS: THD of every reading from the 2nd and 3rd harmonic of the
+ * float raw blocks (DSP_harmonics.c), next to whichever chain demodulates
+ * them. The 4 point period of DSP_QUADRATURE can't hold a 3rd harmonic.
+ */
+// #define DSP_HARMONICS
+
+#if defined(DSP_HARMONICS) &&                                                                             \
+    (!defined(DSP_BLOCK_MIXER) || defined(DSP_Q31) || defined(DSP_CIC) || defined(DSP_QUADRATURE))
+#error "DSP_HARMONICS needs the float raw blocks of the block mixer"
+#endif
 
 #define ADC_INTERRUPT_PIN   2
 #define ADC_INTERRUPT_PRIO  2
 #define DACC_INTERRUPT_PRIO 2
 #define DACC_INTERRUPT_MASK 0x04
 
+#ifdef DSP_QUADRATURE
+#define SINTABLE_LEN 4
+#else
 #define SINTABLE_LEN 22
+#endif
+
+#if defined(DSP_DUAL_TONE) && ((DUAL_TONE_BIN % 2) != 0 || (2 * DUAL_TONE_BIN) >= SINTABLE_LEN)
+#error "DUAL_TONE_BIN must be an even bin below the Nyquist bin"
+#endif
 
 #define DACC_PACKETLEN                  SINTABLE_LEN
 #define DACC_OFFSET_HALFSCALE           2047
@@ -36,19 +149,32 @@
 #define FIR1_DEC_NCOEFFS   5
 #define FIR_DEC_FACTOR     10
 
+/* CIC droop compensation, at the FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR rate */
+#define CIC_COMP_NCOEFFS   7
+#define CIC_COMP_BLOCKSIZE (FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR)
+
 #define FIR2_DEC_BLOCKSIZE 10
 #define FIR2_DEC_NCOEFFS   5
 
 #define BIQUAD1_NSTAGES  2
 #define BIQUAD1_BUFFSIZE FIR1_DEC_BLOCKSIZE
 
+/* references for a block starting at any phase, read contiguously */
+#define MIXER_REF_LEN (SINTABLE_LEN + BIQUAD1_BUFFSIZE)
+
 #define BIQUAD2_NSTAGES  2
 #define BIQUAD2_BUFFSIZE FIR2_DEC_BLOCKSIZE
 
 #define BIQUAD3_NSTAGES  3
 #define BIQUAD3_BUFFSIZE 1
 
-#define INTEGRATOR_LENGTH 300
+#define INTEGRATOR_LENGTH     300
+#define INTEGRATOR_MAX_LENGTH (2 * INTEGRATOR_LENGTH)
+/* provisional readings are published from this many cascade outputs on */
+#define INTEGRATOR_MIN_LENGTH 16
+
+/* relative 1-sigma uncertainty of |V| (and of phi in rad) that makes a reading final */
+#define UNCERTAINTY_TARGET_DEFAULT 1e-3f
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,12 +187,79 @@ extern volatile float32_t g_sintable_f[DACC_PACKETLEN];
 extern pdc_packet_t g_dacc_packet;
 extern pdc_packet_t g_dacc_next_packet;
 extern Pdc         *g_dacc_pdc_base;
-extern uint16_t     g_sintable[DACC_PACKETLEN];
-extern bool decimator_databuff_is_ready;
+/* the table the DAC plays, from the next period on after a change */
+extern uint16_t    *g_sintable;
 extern bool fir2_dataready_flag;
 extern uint32_t test_counter_dacc;
 extern uint32_t test_counter_adc;
 
+extern float32_t fir1_3kHz_coeffs[FIR1_DEC_NCOEFFS];
+extern float32_t fir2_300Hz_coeffs[FIR2_DEC_NCOEFFS];
+extern float32_t biquad1_coeffs[BIQUAD1_NSTAGES * 5];
+extern float32_t biquad2_coeffs[BIQUAD2_NSTAGES * 5];
+extern float32_t biquad3_coeffs[BIQUAD3_NSTAGES * 5];
+extern float32_t biquad3_fast_coeffs[BIQUAD3_NSTAGES * 5];
+extern float32_t cic_comp_coeffs[CIC_COMP_NCOEFFS];
+
+/*
+ * Measurement speed profiles: the bandwidth of the last cascade stage
+ * (biquad3), integrator_len and uncertainty_target, set together by
+ * dsp_set_profile(). FAST follows a moving clamp with the buzzer, PRECISE is
+ * for the documented reading. The ADC rate is not part of them: the DAC
+ * steps on data ready, so the OSR sets the excitation frequency, and the
+ * sensors are calibrated at the nominal one only; the sweep (sweep.c) is
+ * the one thing that moves the rate. Nor is the block size: the PDC ring,
+ * the filter buffers and the one cascade output per block are sized for
+ * MCP3462_STREAM_BLOCKLEN at compile time.
+ */
+typedef enum {
+    DSP_PROFILE_FAST = 0,
+    DSP_PROFILE_NORMAL,
+    DSP_PROFILE_PRECISE,
+    DSP_PROFILE_COUNT
+} Dsp_profile_t;
+
+#ifdef DSP_DUAL_TONE
+/*
+ * The readings at the second tone, computed as the ones of Dsp_t with the
+ * same calibration: it is measured at the excitation frequency only, so the
+ * sensor ratios (Z_ovrl) hold better than the absolute values.
+ */
+typedef struct {
+    bool new_data_is_ready;
+
+    float32_t mag_uncertainty;
+    float32_t phi_uncertainty;
+    bool      result_is_final;
+
+    float32_t R_ovrl;
+    float32_t X_ovrl;
+    float32_t Z_ovrl;
+    float32_t Z_ovrl_phi;
+
+    float32_t R_clamp;
+    float32_t X_clamp;
+    float32_t Z_clamp;
+    float32_t Z_clamp_phi;
+
+    float32_t V_ovrl_I;
+    float32_t V_ovrl_Q;
+    float32_t V_ovrl;
+
+    float32_t V_applied_I;
+    float32_t V_applied_Q;
+    float32_t V_applied;
+
+    float32_t V_shunt_I;
+    float32_t V_shunt_Q;
+    float32_t V_shunt;
+
+    float32_t I_clamp_I;
+    float32_t I_clamp_Q;
+    float32_t I_clamp;
+} Dsp_tone_t;
+#endif
+
 typedef struct {
     bool new_data_is_ready;
 
@@ -76,8 +269,39 @@ typedef struct {
     float32_t sin_vect_postfilter;
     float32_t cos_vect_postfilter;
 
+    Dsp_profile_t profile;
+
+    /* cascade outputs averaged per result; may change while running, see dsp_set_integrator_len() */
     uint32_t integrator_len;
 
+    /*
+     * 1-sigma uncertainty of the published value, relative for the magnitude
+     * and in degrees for the phase. A reading is provisional until both are
+     * below uncertainty_target (phase in rad), or the window has reached
+     * integrator_len.
+     */
+    float32_t mag_uncertainty;
+    float32_t phi_uncertainty;
+    bool      result_is_final;
+    float32_t uncertainty_target;
+    /*
+     * a bit (1 << sensor_type_t) per sensor whose last reading was final;
+     * cleared by a restart, or by a caller waiting for a new round of them
+     */
+    uint8_t   final_sensors;
+
+    /* the integrator window of this reading has a gap from a dropped block, see dsp_block_queue_stats() */
+    bool data_lost;
+
+#ifdef DSP_HARMONICS
+    /* THD of each sensor, as a ratio; distorted: the one of the displayed sensor is above thd_limit */
+    float32_t V_ovrl_thd;
+    float32_t V_shunt_thd;
+    float32_t I_clamp_thd;
+    float32_t thd_limit;
+    bool      distorted;
+#endif
+
     float32_t R_ovrl;
     float32_t X_ovrl;
     float32_t Z_ovrl;
@@ -114,18 +338,50 @@ typedef struct {
     float32_t I_clamp_phi;
 
     float32_t degree;
+
+#ifdef DSP_DUAL_TONE
+    Dsp_tone_t tone2;
+#endif
+
+    /* equivalent circuits of the load and of the clamp branch, refitted with each reading of their sensor */
+    Circuit_result_t fit_ovrl;
+    Circuit_result_t fit_clamp;
 } Dsp_t;
 
 extern Dsp_t clamp_measurements_result;
 
 void      dsp_calculate_sine_table(uint16_t amplitude);
+bool      dsp_set_sine_table_digits(uint16_t digits);
 void      adc_interrupt_handler(uint32_t id, uint32_t mask);
+void      adc_block_handler(const int32_t *samples, uint16_t len);
+void      dsp_acquisition_start(void);
+void      dsp_acquisition_stop(void);
 void      dsp_init(void);
 void      dsp_integrating_filter(void);
+void      dsp_set_integrator_len(uint32_t len);
+void      dsp_set_uncertainty_target(float32_t target);
+void      dsp_set_profile(Dsp_profile_t profile);
+Dsp_queue_stats_t dsp_block_queue_stats(void);
+uint32_t  dsp_blocks_since_restart(void);
+void      dsp_vector_uncertainty(float32_t  sin_mean,
+                                 float32_t  cos_mean,
+                                 float32_t  sin_var,
+                                 float32_t  cos_var,
+                                 float32_t *mag_rel,
+                                 float32_t *phi_rad);
 void      do_filter(float32_t *sin_out, float32_t *cos_out);
 void      reset_filters(void);
+void      dsp_restart_readings(void);
+void      dsp_scale_readings(float32_t ratio);
+bool      dsp_scan_start(void);
+void      dsp_scan_stop(void);
 float32_t find_angle(float32_t sine, float32_t cosine, float32_t absval);
 
+#ifdef DSP_QUADRATURE
+/* DSP_quadrature.c */
+extern float32_t sin_table[SINTABLE_LEN];
+extern float32_t cos_table[SINTABLE_LEN];
+#else
 static float32_t sin_table[] = { 0,
                                  0.28173256f,
                                  0.54064083f,
@@ -171,6 +427,7 @@ static float32_t cos_table[] = { 1,
                                  0.65486073f,
                                  0.84125352f,
                                  0.95949298f };
+#endif
 
 #ifdef __cplusplus
 }
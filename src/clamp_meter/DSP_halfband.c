@@ -0,0 +1,49 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_halfband.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* every other tap but the centre one is zero, see dsp_halfband_decimate() */
+float32_t halfband_coeffs[] = { -0.03125f, 0, 0.28125f, 0.5f, 0.28125f, 0, -0.03125f };
+
+/* (1 1 1 1 1)^3 / 125 */
+float32_t poly_dec_coeffs[] = { 0.008f, 0.024f, 0.048f, 0.08f, 0.12f, 0.144f, 0.152f,
+                                0.144f, 0.12f,  0.08f,  0.048f, 0.024f, 0.008f };
+
+void
+dsp_halfband_reset(Halfband_t *hb)
+{
+    memset(hb, 0, sizeof(*hb));
+}
+
+/*
+ * len input samples (even, at most HALFBAND1_BLOCKSIZE) to len / 2 outputs,
+ * on the same input phase as arm_fir_decimate_f32(). Only the outputs that
+ * are kept are computed, and with the zero taps and the symmetry folded that
+ * is three multiplies each.
+ */
+void
+dsp_halfband_decimate(Halfband_t *hb, const float32_t *src, float32_t *dst, uint32_t len)
+{
+    float32_t        buff[HALFBAND_NCOEFFS - 1 + HALFBAND1_BLOCKSIZE];
+    const float32_t  c0 = halfband_coeffs[0];
+    const float32_t  c2 = halfband_coeffs[2];
+    const float32_t  c3 = halfband_coeffs[3];
+    const float32_t *x;
+    uint32_t         idx;
+
+    memcpy(buff, hb->state, sizeof(hb->state));
+    memcpy(&buff[HALFBAND_NCOEFFS - 1], src, len * sizeof(float32_t));
+
+    for (idx = 0, x = buff; idx < len / HALFBAND_FACTOR; idx++, x += HALFBAND_FACTOR)
+        dst[idx] = c0 * (x[0] + x[6]) + c2 * (x[2] + x[4]) + c3 * x[3];
+
+    memcpy(hb->state, &buff[len], sizeof(hb->state));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+#ifndef DSP_HALFBAND_H_
+#define DSP_HALFBAND_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+
+/*
+ * Decimation chain of DSP_HALFBAND, in place of biquad1 -> firdec1 -> biquad2
+ * -> firdec2:
+ *
+ *   mixer -> halfband /2 -> halfband /2 -> poly /5 -> poly /5 -> biquad3
+ *   100      50             25             5          1
+ *
+ * Only what would fold onto the band of biquad3 has to go, i.e. the
+ * neighbourhoods of the multiples of each output rate. The halfband
+ * (-1 0 9 16 9 0 -1) / 32 has a fourth order zero at half its input rate, the
+ * polyphase stages are a length 5 moving average to the third power with
+ * triple zeros at every multiple of their output rate. Everything else
+ * (the 2f mixer product and the excitation harmonics included) lands outside
+ * the band after decimation and is taken out by biquad3, as before.
+ *
+ * All stages are linear phase and have unity gain at DC.
+ */
+#define HALFBAND_NCOEFFS  7
+#define HALFBAND_FACTOR   2
+#define HALFBAND1_BLOCKSIZE BIQUAD1_BUFFSIZE
+#define HALFBAND2_BLOCKSIZE (HALFBAND1_BLOCKSIZE / HALFBAND_FACTOR)
+
+#define POLY_DEC_NCOEFFS   13
+#define POLY_DEC_FACTOR    5
+#define POLY1_DEC_BLOCKSIZE (HALFBAND2_BLOCKSIZE / HALFBAND_FACTOR)
+#define POLY2_DEC_BLOCKSIZE (POLY1_DEC_BLOCKSIZE / POLY_DEC_FACTOR)
+
+#if POLY2_DEC_BLOCKSIZE != POLY_DEC_FACTOR
+#error "the halfband chain must give one output per block"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern float32_t halfband_coeffs[HALFBAND_NCOEFFS];
+extern float32_t poly_dec_coeffs[POLY_DEC_NCOEFFS];
+
+typedef struct {
+    float32_t state[HALFBAND_NCOEFFS - 1];
+} Halfband_t;
+
+void dsp_halfband_reset(Halfband_t *hb);
+void dsp_halfband_decimate(Halfband_t *hb, const float32_t *src, float32_t *dst, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_HALFBAND_H_ */
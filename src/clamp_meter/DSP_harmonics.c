@@ -0,0 +1,120 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_harmonics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* order n: n periods in SINTABLE_LEN points, exact from the excitation table */
+static float32_t harmonic_sin[HARMONIC_ORDERS][SINTABLE_LEN];
+static float32_t harmonic_cos[HARMONIC_ORDERS][SINTABLE_LEN];
+
+void
+dsp_harmonics_init(void)
+{
+    uint32_t order;
+    uint32_t point;
+
+    for (order = 0; order < HARMONIC_ORDERS; order++) {
+        for (point = 0; point < SINTABLE_LEN; point++) {
+            harmonic_sin[order][point] = sin_table[(point * (order + 1)) % SINTABLE_LEN];
+            harmonic_cos[order][point] = cos_table[(point * (order + 1)) % SINTABLE_LEN];
+        }
+    }
+}
+
+void
+dsp_harmonics_reset(Harmonics_t *harm, uint32_t window_periods)
+{
+    uint32_t order;
+
+    for (order = 0; order < HARMONIC_ORDERS; order++) {
+        dsp_correlator_reset(&harm->order[order], window_periods);
+        dsp_correlator_set_tone(&harm->order[order], harmonic_sin[order], harmonic_cos[order]);
+    }
+
+    harm->resume = false;
+}
+
+/* a block is missing, or the sensor was switched away: the window goes on from the next period */
+void
+dsp_harmonics_break(Harmonics_t *harm)
+{
+    uint32_t order;
+
+    for (order = 0; order < HARMONIC_ORDERS; order++) {
+        harm->order[order].period_sin = 0;
+        harm->order[order].period_cos = 0;
+    }
+
+    harm->resume = true;
+}
+
+/*
+ * raw[0] was taken at table index phase. Returns true when a window has been
+ * completed in this block, with its THD in thd; 0 without a fundamental.
+ */
+bool
+dsp_harmonics_process(Harmonics_t *harm, float32_t *raw, uint32_t phase, uint32_t len, float32_t *thd)
+{
+    float32_t sin_vect[HARMONIC_ORDERS];
+    float32_t cos_vect[HARMONIC_ORDERS];
+    float32_t fundamental;
+    float32_t distortion;
+    uint32_t  skip = 0;
+    uint32_t  order;
+    bool      window_done = false;
+
+    if (harm->resume) {
+        skip         = (SINTABLE_LEN - phase) % SINTABLE_LEN;
+        harm->resume = false;
+
+        if (skip >= len) {
+            /* no period starts in this block */
+            harm->resume = true;
+            return false;
+        }
+    }
+
+    /* the orders share the windows: same periods, no early close */
+    for (order = 0; order < HARMONIC_ORDERS; order++) {
+        harm->order[order].uncertainty_target = 0;
+        window_done = dsp_correlator_process(&harm->order[order],
+                                             raw + skip,
+                                             (phase + skip) % SINTABLE_LEN,
+                                             len - skip,
+                                             &sin_vect[order],
+                                             &cos_vect[order]);
+    }
+
+    if (!window_done)
+        return false;
+
+    fundamental = sin_vect[0] * sin_vect[0] + cos_vect[0] * cos_vect[0];
+    distortion  = 0;
+
+    for (order = 1; order < HARMONIC_ORDERS; order++)
+        distortion += sin_vect[order] * sin_vect[order] + cos_vect[order] * cos_vect[order];
+
+    if (fundamental > 0)
+        arm_sqrt_f32(distortion / fundamental, thd);
+    else
+        *thd = 0;
+
+    return true;
+}
+
+/* the input has been multiplied by ratio (a gain switch), see dsp_correlator_rotate() */
+void
+dsp_harmonics_rotate(Harmonics_t *harm, Complex_t ratio)
+{
+    uint32_t order;
+
+    for (order = 0; order < HARMONIC_ORDERS; order++)
+        dsp_correlator_rotate(&harm->order[order], ratio);
+}
+
+#ifdef __cplusplus
+}
+#endif
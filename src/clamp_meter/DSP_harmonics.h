@@ -0,0 +1,41 @@
+#ifndef DSP_HARMONICS_H_
+#define DSP_HARMONICS_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+#include "DSP_correlator.h"
+
+/*
+ * Distortion monitor (DSP_HARMONICS): the raw blocks the mixer works on are
+ * also correlated against the 2nd and 3rd harmonic of the excitation, and
+ * against the fundamental for a reference over the same window. The
+ * references come from the same SINTABLE_LEN point period, so every order
+ * has whole periods in it and the correlators (DSP_correlator.c) separate
+ * them exactly. Nothing is added to the ADC interrupt.
+ *
+ * THD is |H2, H3| / |H1| of a window of dsp_correlator_periods() periods;
+ * a reading is flagged as distorted above thd_limit.
+ */
+#define HARMONIC_ORDERS   3
+#define THD_LIMIT_DEFAULT 0.03f
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    /* the fundamental first */
+    Correlator_t order[HARMONIC_ORDERS];
+    /* the period in progress was cut short: wait for the next one */
+    bool         resume;
+} Harmonics_t;
+
+void dsp_harmonics_init(void);
+void dsp_harmonics_reset(Harmonics_t *harm, uint32_t window_periods);
+void dsp_harmonics_break(Harmonics_t *harm);
+bool dsp_harmonics_process(Harmonics_t *harm, float32_t *raw, uint32_t phase, uint32_t len, float32_t *thd);
+void dsp_harmonics_rotate(Harmonics_t *harm, Complex_t ratio);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_HARMONICS_H_ */
@@ -0,0 +1,258 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_q31.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+q31_t mixer_sin_ref_q31[MIXER_REF_LEN];
+q31_t mixer_cos_ref_q31[MIXER_REF_LEN];
+
+q31_t biquad1_sin_q31[BIQUAD1_BUFFSIZE];
+q31_t biquad1_cos_q31[BIQUAD1_BUFFSIZE];
+q31_t fir1_sin_q31[FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+q31_t fir1_cos_q31[FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+q31_t biquad2_sin_q31[FIR2_DEC_BLOCKSIZE];
+q31_t biquad2_cos_q31[FIR2_DEC_BLOCKSIZE];
+q31_t fir2_sin_q31[FIR2_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+q31_t fir2_cos_q31[FIR2_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+
+arm_fir_decimate_instance_q31 firdec1_sin_inst_q31;
+arm_fir_decimate_instance_q31 firdec1_cos_inst_q31;
+
+arm_fir_decimate_instance_q31 firdec2_sin_inst_q31;
+arm_fir_decimate_instance_q31 firdec2_cos_inst_q31;
+
+arm_biquad_cas_df1_32x64_ins_q31 biquad1_sin_inst_q31;
+arm_biquad_cas_df1_32x64_ins_q31 biquad1_cos_inst_q31;
+
+arm_biquad_cas_df1_32x64_ins_q31 biquad2_sin_inst_q31;
+arm_biquad_cas_df1_32x64_ins_q31 biquad2_cos_inst_q31;
+
+arm_biquad_cas_df1_32x64_ins_q31 biquad3_sin_inst_q31;
+arm_biquad_cas_df1_32x64_ins_q31 biquad3_cos_inst_q31;
+
+static Dsp_q31_state_t q31_state;
+static q31_t           biquad3_coeffs_q31[BIQUAD3_NSTAGES * 5];
+
+static void
+coeffs_to_q31(float32_t *src, q31_t *dst, uint16_t len, uint8_t post_shift)
+{
+    float32_t scaled;
+
+    while (len--) {
+        scaled = *src++ / (float32_t)(1 << post_shift);
+        arm_float_to_q31(&scaled, dst++, 1);
+    }
+}
+
+void
+dsp_q31_init(float32_t *fir1_coeffs,
+             float32_t *fir2_coeffs,
+             float32_t *biquad1_coeffs,
+             float32_t *biquad2_coeffs,
+             float32_t *biquad3_coeffs)
+{
+    static q31_t fir1_coeffs_q31[FIR1_DEC_NCOEFFS];
+    static q31_t fir2_coeffs_q31[FIR2_DEC_NCOEFFS];
+    static q31_t biquad1_coeffs_q31[BIQUAD1_NSTAGES * 5];
+    static q31_t biquad2_coeffs_q31[BIQUAD2_NSTAGES * 5];
+
+    uint16_t idx;
+
+    coeffs_to_q31(fir1_coeffs, fir1_coeffs_q31, FIR1_DEC_NCOEFFS, 0);
+    coeffs_to_q31(fir2_coeffs, fir2_coeffs_q31, FIR2_DEC_NCOEFFS, 0);
+    coeffs_to_q31(biquad1_coeffs, biquad1_coeffs_q31, BIQUAD1_NSTAGES * 5, DSP_Q31_BIQUAD_POSTSHIFT);
+    coeffs_to_q31(biquad2_coeffs, biquad2_coeffs_q31, BIQUAD2_NSTAGES * 5, DSP_Q31_BIQUAD_POSTSHIFT);
+
+    for (idx = 0; idx < MIXER_REF_LEN; idx++) {
+        arm_float_to_q31(&sin_table[idx % SINTABLE_LEN], &mixer_sin_ref_q31[idx], 1);
+        arm_float_to_q31(&cos_table[idx % SINTABLE_LEN], &mixer_cos_ref_q31[idx], 1);
+    }
+
+    arm_fir_decimate_init_q31(&firdec1_sin_inst_q31,
+                              FIR1_DEC_NCOEFFS,
+                              FIR_DEC_FACTOR,
+                              fir1_coeffs_q31,
+                              q31_state.fir1_statebuff_sin,
+                              FIR1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_q31(&firdec1_cos_inst_q31,
+                              FIR1_DEC_NCOEFFS,
+                              FIR_DEC_FACTOR,
+                              fir1_coeffs_q31,
+                              q31_state.fir1_statebuff_cos,
+                              FIR1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_q31(&firdec2_sin_inst_q31,
+                              FIR2_DEC_NCOEFFS,
+                              FIR_DEC_FACTOR,
+                              fir2_coeffs_q31,
+                              q31_state.fir2_statebuff_sin,
+                              FIR2_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_init_q31(&firdec2_cos_inst_q31,
+                              FIR2_DEC_NCOEFFS,
+                              FIR_DEC_FACTOR,
+                              fir2_coeffs_q31,
+                              q31_state.fir2_statebuff_cos,
+                              FIR2_DEC_BLOCKSIZE);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad1_sin_inst_q31,
+                                      BIQUAD1_NSTAGES,
+                                      biquad1_coeffs_q31,
+                                      q31_state.biquad1_statebuff_sin,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad1_cos_inst_q31,
+                                      BIQUAD1_NSTAGES,
+                                      biquad1_coeffs_q31,
+                                      q31_state.biquad1_statebuff_cos,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad2_sin_inst_q31,
+                                      BIQUAD2_NSTAGES,
+                                      biquad2_coeffs_q31,
+                                      q31_state.biquad2_statebuff_sin,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad2_cos_inst_q31,
+                                      BIQUAD2_NSTAGES,
+                                      biquad2_coeffs_q31,
+                                      q31_state.biquad2_statebuff_cos,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+
+    dsp_q31_set_biquad3(biquad3_coeffs);
+}
+
+/* another output stage, see dsp_set_profile(); its history starts from zero */
+void
+dsp_q31_set_biquad3(float32_t *biquad3_coeffs)
+{
+    coeffs_to_q31(biquad3_coeffs, biquad3_coeffs_q31, BIQUAD3_NSTAGES * 5, DSP_Q31_BIQUAD_POSTSHIFT);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad3_sin_inst_q31,
+                                      BIQUAD3_NSTAGES,
+                                      biquad3_coeffs_q31,
+                                      q31_state.biquad3_statebuff_sin,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+
+    arm_biquad_cas_df1_32x64_init_q31(&biquad3_cos_inst_q31,
+                                      BIQUAD3_NSTAGES,
+                                      biquad3_coeffs_q31,
+                                      q31_state.biquad3_statebuff_cos,
+                                      DSP_Q31_BIQUAD_POSTSHIFT);
+}
+
+void
+dsp_q31_filter_block(q31_t *raw, uint32_t phase, q31_t *sin_out, q31_t *cos_out)
+{
+    arm_mult_q31(raw, &mixer_sin_ref_q31[phase], biquad1_sin_q31, BIQUAD1_BUFFSIZE);
+
+    arm_mult_q31(raw, &mixer_cos_ref_q31[phase], biquad1_cos_q31, BIQUAD1_BUFFSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad1_sin_inst_q31, biquad1_sin_q31, biquad1_sin_q31, BIQUAD1_BUFFSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad1_cos_inst_q31, biquad1_cos_q31, biquad1_cos_q31, BIQUAD1_BUFFSIZE);
+
+    arm_fir_decimate_q31(&firdec1_sin_inst_q31, biquad1_sin_q31, fir1_sin_q31, FIR1_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_q31(&firdec1_cos_inst_q31, biquad1_cos_q31, fir1_cos_q31, FIR1_DEC_BLOCKSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad2_sin_inst_q31, fir1_sin_q31, biquad2_sin_q31, BIQUAD2_BUFFSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad2_cos_inst_q31, fir1_cos_q31, biquad2_cos_q31, BIQUAD2_BUFFSIZE);
+
+    arm_fir_decimate_q31(&firdec2_sin_inst_q31, biquad2_sin_q31, fir2_sin_q31, FIR2_DEC_BLOCKSIZE);
+
+    arm_fir_decimate_q31(&firdec2_cos_inst_q31, biquad2_cos_q31, fir2_cos_q31, FIR2_DEC_BLOCKSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad3_sin_inst_q31, fir2_sin_q31, sin_out, BIQUAD3_BUFFSIZE);
+
+    arm_biquad_cas_df1_32x64_q31(&biquad3_cos_inst_q31, fir2_cos_q31, cos_out, BIQUAD3_BUFFSIZE);
+}
+
+void
+dsp_q31_save_state(Dsp_q31_state_t *state)
+{
+    *state = q31_state;
+}
+
+void
+dsp_q31_load_state(const Dsp_q31_state_t *state)
+{
+    q31_state = *state;
+}
+
+static inline q31_t
+saturate_q31(float64_t value)
+{
+    if (value >= 2147483647.0)
+        return 0x7FFFFFFF;
+    else if (value <= -2147483648.0)
+        return (q31_t)0x80000000;
+
+    return (q31_t)value;
+}
+
+/* (cos + j sin) * ratio for every pair, saturated */
+void
+dsp_q31_rotate(q31_t *sin_buf, q31_t *cos_buf, uint32_t len, Complex_t ratio)
+{
+    float64_t sin_val;
+    float64_t cos_val;
+
+    while (len--) {
+        sin_val = *sin_buf;
+        cos_val = *cos_buf;
+
+        *cos_buf++ = saturate_q31(cos_val * ratio.I - sin_val * ratio.Q);
+        *sin_buf++ = saturate_q31(cos_val * ratio.Q + sin_val * ratio.I);
+    }
+}
+
+static void
+rotate_q63(q63_t *sin_buf, q63_t *cos_buf, uint32_t len, Complex_t ratio)
+{
+    float64_t sin_val;
+    float64_t cos_val;
+
+    while (len--) {
+        sin_val = (float64_t)*sin_buf;
+        cos_val = (float64_t)*cos_buf;
+
+        *cos_buf++ = (q63_t)(cos_val * ratio.I - sin_val * ratio.Q);
+        *sin_buf++ = (q63_t)(cos_val * ratio.Q + sin_val * ratio.I);
+    }
+}
+
+/* the whole history of the chain, as if it had seen its input times ratio */
+void
+dsp_q31_rotate_state(Complex_t ratio)
+{
+    dsp_q31_rotate(q31_state.fir1_statebuff_sin,
+                   q31_state.fir1_statebuff_cos,
+                   sizeof(q31_state.fir1_statebuff_sin) / sizeof(q31_t),
+                   ratio);
+    dsp_q31_rotate(q31_state.fir2_statebuff_sin,
+                   q31_state.fir2_statebuff_cos,
+                   sizeof(q31_state.fir2_statebuff_sin) / sizeof(q31_t),
+                   ratio);
+    rotate_q63(q31_state.biquad1_statebuff_sin,
+               q31_state.biquad1_statebuff_cos,
+               sizeof(q31_state.biquad1_statebuff_sin) / sizeof(q63_t),
+               ratio);
+    rotate_q63(q31_state.biquad2_statebuff_sin,
+               q31_state.biquad2_statebuff_cos,
+               sizeof(q31_state.biquad2_statebuff_sin) / sizeof(q63_t),
+               ratio);
+    rotate_q63(q31_state.biquad3_statebuff_sin,
+               q31_state.biquad3_statebuff_cos,
+               sizeof(q31_state.biquad3_statebuff_sin) / sizeof(q63_t),
+               ratio);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+#ifndef DSP_Q31_H_
+#define DSP_Q31_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+#include "DSP_complex.h"
+
+/*
+ * Fixed point version of the lock-in chain in do_filter(): the same mixer,
+ * biquad1 -> firdec1 -> biquad2 -> firdec2 -> biquad3 structure and
+ * coefficients, in q31 with the 32x64 biquads (poles this close to z = 1 need
+ * the 64-bit feedback state).
+ *
+ * ADC codes enter as code << DSP_Q31_ADC_SHIFT. The 24-bit code would fit with
+ * a shift of 8; one bit is left as headroom for the biquad overshoot.
+ */
+#define DSP_Q31_ADC_SHIFT        7
+#define DSP_Q31_BIQUAD_POSTSHIFT 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* history of the chain, all a scan bank has to hold */
+typedef struct {
+    q31_t fir1_statebuff_sin[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    q31_t fir1_statebuff_cos[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    q31_t fir2_statebuff_sin[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
+    q31_t fir2_statebuff_cos[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
+    q63_t biquad1_statebuff_sin[BIQUAD1_NSTAGES * 4];
+    q63_t biquad1_statebuff_cos[BIQUAD1_NSTAGES * 4];
+    q63_t biquad2_statebuff_sin[BIQUAD2_NSTAGES * 4];
+    q63_t biquad2_statebuff_cos[BIQUAD2_NSTAGES * 4];
+    q63_t biquad3_statebuff_sin[BIQUAD3_NSTAGES * 4];
+    q63_t biquad3_statebuff_cos[BIQUAD3_NSTAGES * 4];
+} Dsp_q31_state_t;
+
+static inline q31_t
+dsp_q31_from_adc(int32_t code)
+{
+    return (q31_t)((uint32_t)code << DSP_Q31_ADC_SHIFT);
+}
+
+/* back to ADC codes, the unit the float chain works in */
+static inline float32_t
+dsp_q31_to_adc(q63_t value)
+{
+    return (float32_t)value * (1.0f / (1 << DSP_Q31_ADC_SHIFT));
+}
+
+void dsp_q31_init(float32_t *fir1_coeffs,
+                  float32_t *fir2_coeffs,
+                  float32_t *biquad1_coeffs,
+                  float32_t *biquad2_coeffs,
+                  float32_t *biquad3_coeffs);
+void dsp_q31_set_biquad3(float32_t *biquad3_coeffs);
+void dsp_q31_filter_block(q31_t *raw, uint32_t phase, q31_t *sin_out, q31_t *cos_out);
+void dsp_q31_save_state(Dsp_q31_state_t *state);
+void dsp_q31_load_state(const Dsp_q31_state_t *state);
+void dsp_q31_rotate(q31_t *sin_buf, q31_t *cos_buf, uint32_t len, Complex_t ratio);
+void dsp_q31_rotate_state(Complex_t ratio);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_Q31_H_ */
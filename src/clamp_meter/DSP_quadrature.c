@@ -0,0 +1,71 @@
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_quadrature.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef DSP_QUADRATURE
+float32_t sin_table[SINTABLE_LEN] = { 0, 1, 0, -1 };
+float32_t cos_table[SINTABLE_LEN] = { 1, 0, -1, 0 };
+#endif
+
+void
+dsp_quadrature_reset(Quadrature_t *quad)
+{
+    memset(quad, 0, sizeof(*quad));
+}
+
+/* the history holds raw samples, which only scale with a gain switch */
+void
+dsp_quadrature_scale(Quadrature_t *quad, float32_t gain)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < QUADRATURE_HISTORY; idx++)
+        quad->history[idx] *= gain;
+}
+
+/*
+ * raw[0] was taken at table index phase; len is a multiple of QUADRATURE_LEN
+ * (at most BIQUAD1_BUFFSIZE) and gives len / QUADRATURE_LEN outputs, so the
+ * table index at the start of a block is the same from call to call. The
+ * last QUADRATURE_HISTORY samples are kept for the taps that reach back into
+ * the previous block.
+ */
+uint32_t
+dsp_quadrature_mix(Quadrature_t    *quad,
+                   const float32_t *raw,
+                   uint32_t         phase,
+                   uint32_t         len,
+                   float32_t       *sin_out,
+                   float32_t       *cos_out)
+{
+    float32_t        buff[QUADRATURE_HISTORY + BIQUAD1_BUFFSIZE];
+    const float32_t *x;
+    uint32_t         outputs = len / QUADRATURE_LEN;
+    uint32_t         start;
+    uint32_t         idx;
+
+    memcpy(buff, quad->history, sizeof(quad->history));
+    memcpy(&buff[QUADRATURE_HISTORY], raw, len * sizeof(float32_t));
+
+    /* buff[i] is at table index phase + i - QUADRATURE_HISTORY; centres from buff[3] on */
+    start = 3;
+    while ((phase + start + 2 * QUADRATURE_LEN - QUADRATURE_HISTORY) % QUADRATURE_LEN != 0)
+        start++;
+
+    for (idx = 0, x = &buff[start]; idx < outputs; idx++, x += QUADRATURE_LEN) {
+        sin_out[idx] = (3.0f * (x[1] - x[-1]) + x[-3] - x[3]) * 0.0625f;
+        cos_out[idx] = (2.0f * x[0] - x[-2] - x[2]) * 0.125f;
+    }
+
+    memcpy(quad->history, &buff[len], sizeof(quad->history));
+
+    return outputs;
+}
+
+#ifdef __cplusplus
+}
+#endif
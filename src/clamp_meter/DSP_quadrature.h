@@ -0,0 +1,50 @@
+#ifndef DSP_QUADRATURE_H_
+#define DSP_QUADRATURE_H_
+#include "arm_math.h"
+#include "DSP_functions.h"
+#include "DSP_complex.h"
+#include "DSP_halfband.h"
+
+/*
+ * Mixer of DSP_QUADRATURE. With four samples per period the references are
+ * sin = 0 1 0 -1 and cos = 1 0 -1 0, so mixing is only routing the samples
+ * into I or Q with a sign. The mixed streams go through a length 4 moving
+ * average to the second power (1 2 3 4 3 2 1) / 16, decimated by 4: double
+ * zeros on every multiple of a quarter of the ADC rate: the mixed ADC offset
+ * and all that the decimation folds onto DC. Only every other tap meets
+ * a non zero sample, which leaves
+ *   I = (3 (x[t+1] - x[t-1]) + x[t-3] - x[t+3]) / 16
+ *   Q = (2 x[t] - x[t-2] - x[t+2]) / 8
+ * around each t at table index 0, I and Q centred on the same sample.
+ *
+ * The output is one value per period, POLY1_DEC_BLOCKSIZE per block, and
+ * continues with the polyphase stages of DSP_halfband.h.
+ */
+#define QUADRATURE_LEN     4
+#define QUADRATURE_HISTORY 6
+
+#if BIQUAD1_BUFFSIZE != QUADRATURE_LEN * POLY1_DEC_BLOCKSIZE
+#error "the quadrature mixer must give POLY1_DEC_BLOCKSIZE outputs per block"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    float32_t history[QUADRATURE_HISTORY];
+} Quadrature_t;
+
+void     dsp_quadrature_reset(Quadrature_t *quad);
+void     dsp_quadrature_scale(Quadrature_t *quad, float32_t gain);
+uint32_t dsp_quadrature_mix(Quadrature_t    *quad,
+                            const float32_t *raw,
+                            uint32_t         phase,
+                            uint32_t         len,
+                            float32_t       *sin_out,
+                            float32_t       *cos_out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_QUADRATURE_H_ */
@@ -0,0 +1,167 @@
+#ifndef DSP_QUEUE_H_
+#define DSP_QUEUE_H_
+#include "asf.h"
+
+/*
+ * Single producer / single consumer ring of block slots between the ADC
+ * interrupt and do_filter(). The queue only hands out slot numbers; the
+ * sample buffers are arrays of DSP_QUEUE_LEN blocks next to it.
+ *
+ * Slot head % DSP_QUEUE_LEN is always the one the interrupt is filling, so
+ * at most DSP_QUEUE_LEN - 1 blocks wait for the main loop. A block that
+ * completes while they are all taken is dropped (the slot is filled again)
+ * and counted; queued blocks are never overwritten.
+ *
+ * head is written only by the interrupt, tail only by the main loop. Each
+ * side publishes its index after a barrier (release) and reads the other's
+ * before touching the slot (acquire).
+ */
+#define DSP_QUEUE_LEN 8
+
+#if (DSP_QUEUE_LEN & (DSP_QUEUE_LEN - 1)) != 0
+#error "DSP_QUEUE_LEN must be a power of two"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t blocks;     /* completed by the interrupt, dropped ones included */
+    uint32_t dropped;    /* completed while the queue was full */
+    uint32_t high_water; /* most blocks waiting at once */
+    uint32_t max_lag;    /* most blocks completed between two visits of the main loop */
+} Dsp_queue_stats_t;
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t blocks;
+    volatile uint32_t dropped;
+    volatile uint32_t high_water;
+    /* index of the first block published after the latest drop */
+    volatile uint32_t gap;
+    /* main loop side */
+    uint32_t          max_lag;
+    uint32_t          blocks_seen;
+    uint32_t          dropped_seen;
+} Dsp_queue_t;
+
+static inline void
+dsp_queue_reset(Dsp_queue_t *queue)
+{
+    memset((void *)queue, 0, sizeof(*queue));
+}
+
+/* interrupt: the slot to fill */
+static inline uint32_t
+dsp_queue_write_slot(const Dsp_queue_t *queue)
+{
+    return queue->head & (DSP_QUEUE_LEN - 1);
+}
+
+/* interrupt: the write slot is complete; false if it had to be dropped */
+static inline bool
+dsp_queue_publish(Dsp_queue_t *queue)
+{
+    uint32_t head    = queue->head;
+    uint32_t waiting = head - queue->tail;
+
+    queue->blocks++;
+
+    if (waiting >= DSP_QUEUE_LEN - 1) {
+        /* the index before the count */
+        queue->gap = head;
+        __DMB();
+        queue->dropped++;
+        return false;
+    }
+
+    if (waiting + 1 > queue->high_water)
+        queue->high_water = waiting + 1;
+
+    /* the samples before the index */
+    __DMB();
+    queue->head = head + 1;
+
+    return true;
+}
+
+/* main loop: the oldest waiting slot, if any */
+static inline bool
+dsp_queue_read_slot(Dsp_queue_t *queue, uint32_t *slot)
+{
+    uint32_t tail = queue->tail;
+
+    if (queue->head == tail)
+        return false;
+
+    /* the index before the samples */
+    __DMB();
+    *slot = tail & (DSP_QUEUE_LEN - 1);
+
+    return true;
+}
+
+/* main loop: done with the slot from dsp_queue_read_slot() */
+static inline void
+dsp_queue_release(Dsp_queue_t *queue)
+{
+    __DMB();
+    queue->tail = queue->tail + 1;
+}
+
+/*
+ * main loop: true if blocks were dropped right before the slot from
+ * dsp_queue_read_slot(). A drop only happens with the queue full, so the gap
+ * lies behind the blocks that were waiting then, not before the next read.
+ * Of two drops that happen before the main loop reaches the first, only the
+ * later one is reported.
+ */
+static inline bool
+dsp_queue_gap(Dsp_queue_t *queue)
+{
+    uint32_t dropped = queue->dropped;
+
+    if (dropped == queue->dropped_seen)
+        return false;
+
+    /* the count before the index */
+    __DMB();
+    if (queue->tail != queue->gap)
+        return false;
+
+    queue->dropped_seen = dropped;
+
+    return true;
+}
+
+/* main loop: once per visit, before draining */
+static inline void
+dsp_queue_visit(Dsp_queue_t *queue)
+{
+    uint32_t blocks = queue->blocks;
+
+    if (blocks - queue->blocks_seen > queue->max_lag)
+        queue->max_lag = blocks - queue->blocks_seen;
+
+    queue->blocks_seen = blocks;
+}
+
+static inline Dsp_queue_stats_t
+dsp_queue_stats(const Dsp_queue_t *queue)
+{
+    Dsp_queue_stats_t stats;
+
+    stats.blocks     = queue->blocks;
+    stats.dropped    = queue->dropped;
+    stats.high_water = queue->high_water;
+    stats.max_lag    = queue->max_lag;
+
+    return stats;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* DSP_QUEUE_H_ */
@@ -1,11 +1,12 @@
 
 #include "asf.h"
 #include <stdlib.h>
-#include "ili9486_fonts.h"
-#include "ili9486_config.h"
-#include "ili9486_public.h"
-#include "ili9486_private.h"
+#include "ILI9486_fonts.h"
+#include "ILI9486_config.h"
+#include "ILI9486_public.h"
+#include "ILI9486_private.h"
 #include "arm_math.h"
+#include "profiler.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -827,6 +828,8 @@ TFT_Print_Char(uint16_t x,
 	uint8_t counter = 0;
 	uint8_t data_from_memory[FONT_ONE_CHAR_BYTES];
 
+	PROFILE_BEGIN(PROFILE_TFT_PRINT_CHAR);
+
 	TFT_SetAddrWindow(x, y, x + FONT_WIDTH * size - 1,
 	                  y + FONT_HEIGHT * size - 1);
 	TFT_Write_Cmd_Byte(TFT_RAMWR);
@@ -887,6 +890,8 @@ TFT_Print_Char(uint16_t x,
 	}
 
 	tft_cs_disable();
+
+	PROFILE_END(PROFILE_TFT_PRINT_CHAR);
 }
 
 void
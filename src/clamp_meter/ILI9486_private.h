@@ -54,7 +54,7 @@ static inline void TFT_Write_Cmd_Byte		(uint8_t cmd);
 static inline void TFT_Wrte_Data_Word		(uint16_t data);
 static inline void TFT_Write_Cmd_Word		(uint16_t data);
 void TFT_put_pixel			(unsigned int data);
-void TFT_put_N_pixels		(unsigned int color, unsigned long int n);
+void TFT_put_N_pixels		(unsigned int color, uint32_t n);
 void TFT_SetAddrWindow		(int16_t x_beg, int16_t y_beg, int16_t x_end,
 							 int16_t y_end);
 void TFT_fillCircleHelper	(int16_t x0, int16_t y0, int16_t r,
@@ -113,6 +113,45 @@
 extern "C" {
 #endif
 
+#define STREAM_PENDING_CONFIG2	(1 << 0)
+#define STREAM_PENDING_MUX		(1 << 1)
+#define STREAM_PENDING_CONFIG1	(1 << 2)
+#define STREAM_SPI_IRQ_PRIO		MCP3462_STREAM_IRQ_PRIO
+#define STREAM_RING_BYTES		(MCP3462_STREAM_BLOCKLEN * MCP3462_SAMPLE_BYTES)
+
+typedef struct {
+	volatile MCP3462_stream_state_t state;
+	volatile uint8_t pending;
+	uint8_t pending_config2;
+	uint8_t pending_mux;
+	gain_type_t pending_gain;
+	MCP3462_rate_t pending_rate;
+
+	uint8_t scbr;
+	uint8_t dlybct;
+	uint32_t csr_saved;
+	uint8_t filled_idx;
+
+	MCP3462_block_handler_t handler;
+	Pdc *pdc;
+	pdc_packet_t rx_packet[2];
+	pdc_packet_t tx_packet;
+
+	MCP3462_stream_stats_t stats;
+} MCP3462_stream_t;
+
+static MCP3462_stream_t Stream;
+/*
+ * MUX and gain of the conversions being delivered, from the configuration
+ * send_configuration() writes; a deferred write moves them at the resync
+ */
+static uint8_t mux_applied = MUX_SET_VPOS(REF_CH4) | REF_CH5;
+static gain_type_t gain_applied = GAIN_1;
+static uint32_t ratio_applied = MCP3462_OSR_RATIO * MCP3462_PRE_RATIO;
+static uint8_t stream_ring[2][STREAM_RING_BYTES];
+static uint8_t stream_tx_dummy[STREAM_RING_BYTES];
+static int32_t stream_samples[MCP3462_STREAM_BLOCKLEN];
+
 void clock_init(void);
 void test_com(void);
 void send_configuration(void);
@@ -166,6 +205,10 @@ void send_configuration(void)
 	spi_write(SPI, irq_regval, 0, 0);
 	spi_write(SPI, mux_regval, 0, 0);
 	spi_set_lastxfer(SPI);
+
+	mux_applied = mux_regval;
+	gain_applied = GAIN_1;
+	ratio_applied = MCP3462_OSR_RATIO * MCP3462_PRE_RATIO;
 }
 
 void MCP3462_init(void)
@@ -174,51 +217,68 @@ void MCP3462_init(void)
 	send_configuration();
 }
 
-void MCP3462_set_gain(gain_type_t gain)
+static void write_register_byte(uint8_t reg_addr, uint8_t value)
 {
 	uint32_t timeout_counter = SPI_TIMEOUT;
 	uint16_t firstbyte;
-	uint16_t config2_byte;
-	uint16_t retval;
-	firstbyte = DEVICE_ADDR | CMD_ADDR(CONFIG2_REG_ADDR) | CMD_INCREMENTAL_WRITE;
-	config2_byte = BOOST(BOOST_2) | GAIN(gain) | AZ_MUX(0) | 1;
-	
-	
+
+	firstbyte = DEVICE_ADDR | CMD_ADDR(reg_addr) | CMD_INCREMENTAL_WRITE;
+
 	while((!spi_is_tx_ready(SPI)) && (timeout_counter--));
-	
+
 	if (!timeout_counter)
 		return;
-		
+
 	spi_configure_cs_behavior(SPI, 0, SPI_CS_RISE_FORCED);
 	spi_set_bits_per_transfer(SPI, 0, SPI_CSR_BITS_16_BIT);
-		
-	spi_write(SPI, (firstbyte << 8) | config2_byte, 0, 0);
+
+	spi_write(SPI, (firstbyte << 8) | value, 0, 0);
 	spi_set_lastxfer(SPI);
 }
 
+void MCP3462_set_gain(gain_type_t gain)
+{
+	uint8_t config2_byte = BOOST(BOOST_2) | GAIN(gain) | AZ_MUX(0) | 1;
+
+	/* the bus belongs to the PDC while streaming, defer to the next resync */
+	if (Stream.state != MCP3462_STREAM_IDLE) {
+		Stream.pending_config2 = config2_byte;
+		Stream.pending_gain = gain;
+		Stream.pending |= STREAM_PENDING_CONFIG2;
+		return;
+	}
+
+	write_register_byte(CONFIG2_REG_ADDR, config2_byte);
+	gain_applied = gain;
+}
+
 void MCP3462_set_mux(uint8_t positive_ch, uint8_t negative_ch)
 {
-	uint32_t timeout_counter = SPI_TIMEOUT;
-	uint16_t firstbyte;
-	uint16_t mux_byte;
-	uint16_t retval;
-	
+	uint8_t mux_byte;
+
 	if ((positive_ch > REF_CH5) || (negative_ch > REF_CH5))
 		return;
-	
-	firstbyte = DEVICE_ADDR | CMD_ADDR(MUX_REG_ADDR) | CMD_INCREMENTAL_WRITE;
+
 	mux_byte = MUX_SET_VPOS(positive_ch) | negative_ch;
-	
-	while((!spi_is_tx_ready(SPI)) && (timeout_counter--));
-	
-	if (!timeout_counter)
+
+	if (Stream.state != MCP3462_STREAM_IDLE) {
+		Stream.pending_mux = mux_byte;
+		Stream.pending |= STREAM_PENDING_MUX;
 		return;
-		
-	spi_configure_cs_behavior(SPI, 0, SPI_CS_RISE_FORCED);
-	spi_set_bits_per_transfer(SPI, 0, SPI_CSR_BITS_16_BIT);
-		
-	spi_write(SPI, (firstbyte << 8) | mux_byte, 0, 0);
-	spi_set_lastxfer(SPI);
+	}
+
+	write_register_byte(MUX_REG_ADDR, mux_byte);
+	mux_applied = mux_byte;
+}
+
+uint8_t MCP3462_get_mux(void)
+{
+	return mux_applied;
+}
+
+gain_type_t MCP3462_get_gain(void)
+{
+	return gain_applied;
 }
 
 int32_t MCP3462_read(uint16_t data)
@@ -263,6 +323,257 @@ int32_t MCP3462_read(uint16_t data)
 	return retval;
 }
 
+static bool stream_timing(uint32_t mck_hz, uint32_t ratio, uint8_t *scbr, uint8_t *dlybct)
+{
+	uint64_t period = (uint64_t)mck_hz * 4 * ratio;
+	uint32_t byte_cycles;
+	uint32_t div;
+
+	/* one conversion must be an exact number of MCK cycles, split in 3 bytes */
+	if (period % MCP3462_MCLK_HZ)
+		return false;
+
+	period /= MCP3462_MCLK_HZ;
+
+	if (period % MCP3462_SAMPLE_BYTES)
+		return false;
+
+	byte_cycles = (uint32_t)(period / MCP3462_SAMPLE_BYTES);
+
+	/* byte time = 8 * SCBR + 32 * DLYBCT MCK cycles */
+	for (div = MCP3462_STREAM_MIN_SCBR; div <= 255; div++) {
+		uint32_t rest;
+
+		if (8 * div > byte_cycles)
+			break;
+
+		rest = byte_cycles - 8 * div;
+
+		if ((rest % 32 == 0) && (rest / 32 <= 255)) {
+			*scbr = (uint8_t)div;
+			*dlybct = (uint8_t)(rest / 32);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MCP3462_stream_timing(uint32_t mck_hz, uint8_t *scbr, uint8_t *dlybct)
+{
+	return stream_timing(mck_hz, MCP3462_OSR_RATIO * MCP3462_PRE_RATIO, scbr, dlybct);
+}
+
+/* false for a rate the stream cannot be paced at from this MCK */
+bool MCP3462_rate_prepare(osr_type_t osr, prescaller_type_t pre, MCP3462_rate_t *rate)
+{
+	static const uint32_t osr_ratio[] = {
+		32, 64, 128, 256, 512, 1024, 2048, 4096,
+		8192, 16384, 20480, 24576, 40960, 49152, 81920, 98304
+	};
+
+	if ((osr > OSR_98304) || (pre > PRE_8))
+		return false;
+
+	rate->config1 = PRE(pre) | OSR(osr);
+	rate->ratio = osr_ratio[osr] << pre;
+
+	return stream_timing(sysclk_get_peripheral_hz(), rate->ratio, &rate->scbr, &rate->dlybct);
+}
+
+/*
+ * The DAC steps on data ready, so this moves the excitation frequency as well.
+ * While streaming the write waits for the next resync, where the SPI pacing
+ * changes with it.
+ */
+void MCP3462_set_rate(const MCP3462_rate_t *rate)
+{
+	if (Stream.state != MCP3462_STREAM_IDLE) {
+		Stream.pending_rate = *rate;
+		Stream.pending |= STREAM_PENDING_CONFIG1;
+		return;
+	}
+
+	write_register_byte(CONFIG1_REG_ADDR, rate->config1);
+	Stream.scbr = rate->scbr;
+	Stream.dlybct = rate->dlybct;
+	ratio_applied = rate->ratio;
+}
+
+/* OSR * PRE of the conversions being delivered */
+uint32_t MCP3462_get_rate(void)
+{
+	return ratio_applied;
+}
+
+static void stream_apply_pending(void)
+{
+	uint8_t pending = Stream.pending;
+
+	Stream.pending = 0;
+
+	if (pending & STREAM_PENDING_CONFIG2) {
+		write_register_byte(CONFIG2_REG_ADDR, Stream.pending_config2);
+		gain_applied = Stream.pending_gain;
+	}
+
+	if (pending & STREAM_PENDING_MUX) {
+		write_register_byte(MUX_REG_ADDR, Stream.pending_mux);
+		mux_applied = Stream.pending_mux;
+	}
+
+	if (pending & STREAM_PENDING_CONFIG1) {
+		write_register_byte(CONFIG1_REG_ADDR, Stream.pending_rate.config1);
+		Stream.scbr = Stream.pending_rate.scbr;
+		Stream.dlybct = Stream.pending_rate.dlybct;
+		ratio_applied = Stream.pending_rate.ratio;
+	}
+}
+
+static void stream_halt(void)
+{
+	spi_disable_interrupt(SPI, SPI_IDR_ENDRX | SPI_IDR_RXBUFF);
+	pdc_disable_transfer(Stream.pdc, PERIPH_PTCR_RXTDIS | PERIPH_PTCR_TXTDIS);
+	spi_set_lastxfer(SPI);
+	SPI->SPI_CSR[0] = Stream.csr_saved;
+}
+
+static void stream_sync_handler(uint32_t id, uint32_t mask)
+{
+	uint16_t status;
+
+	UNUSED(id);
+	UNUSED(mask);
+
+	if (Stream.state != MCP3462_STREAM_ARMED)
+		return;
+
+	pio_disable_interrupt(MCP3462_IRQ_PIO, (1 << MCP3462_IRQ_PIN));
+
+	/* a conversion has just completed: reconfigure, then start reading it */
+	stream_apply_pending();
+	Stream.csr_saved = SPI->SPI_CSR[0];
+
+	spi_set_bits_per_transfer(SPI, 0, SPI_CSR_BITS_8_BIT);
+	spi_configure_cs_behavior(SPI, 0, SPI_CS_KEEP_LOW);
+	spi_write(SPI, DEVICE_ADDR | CMD_ADDR(ADCDATA_ADDR) | CMD_STATIC_READ, 0, 0);
+	/* drain the status byte so the PDC starts on the first data byte */
+	spi_read(SPI, &status, NULL);
+
+	spi_set_baudrate_div(SPI, 0, Stream.scbr);
+	spi_set_transfer_delay(SPI, 0, 0, Stream.dlybct);
+
+	Stream.filled_idx = 0;
+	pdc_rx_init(Stream.pdc, &Stream.rx_packet[0], &Stream.rx_packet[1]);
+	pdc_tx_init(Stream.pdc, &Stream.tx_packet, &Stream.tx_packet);
+
+	Stream.state = MCP3462_STREAM_RUNNING;
+	Stream.stats.resyncs++;
+
+	spi_enable_interrupt(SPI, SPI_IER_ENDRX);
+	pdc_enable_transfer(Stream.pdc, PERIPH_PTCR_RXTEN | PERIPH_PTCR_TXTEN);
+}
+
+void SPI_Handler(void)
+{
+	uint8_t filled = Stream.filled_idx;
+	const uint8_t *raw = stream_ring[filled];
+	uint16_t idx;
+
+	if (!(spi_read_status(SPI) & SPI_SR_ENDRX))
+		return;
+
+	Stream.filled_idx ^= 1;
+
+	for (idx = 0; idx < MCP3462_STREAM_BLOCKLEN; idx++)
+		stream_samples[idx] = MCP3462_decode_sample(&raw[idx * MCP3462_SAMPLE_BYTES]);
+
+	Stream.stats.blocks++;
+	Stream.stats.samples += MCP3462_STREAM_BLOCKLEN;
+
+	if (Stream.handler)
+		Stream.handler(stream_samples, MCP3462_STREAM_BLOCKLEN);
+
+	if (Stream.state == MCP3462_STREAM_STOPPING) {
+		/* the ring has run dry: reprogram the device and realign on DR */
+		stream_halt();
+		Stream.state = MCP3462_STREAM_ARMED;
+		pio_enable_interrupt(MCP3462_IRQ_PIO, (1 << MCP3462_IRQ_PIN));
+		return;
+	}
+
+	if (Stream.pending) {
+		/* let the PDC finish the buffer in flight and stop */
+		Stream.state = MCP3462_STREAM_STOPPING;
+		spi_disable_interrupt(SPI, SPI_IDR_ENDRX);
+		spi_enable_interrupt(SPI, SPI_IER_RXBUFF);
+		return;
+	}
+
+	pdc_rx_init(Stream.pdc, NULL, &Stream.rx_packet[filled]);
+	pdc_tx_init(Stream.pdc, NULL, &Stream.tx_packet);
+}
+
+void MCP3462_stream_init(MCP3462_block_handler_t handler)
+{
+	Stream.state = MCP3462_STREAM_IDLE;
+	Stream.pending = 0;
+	Stream.handler = handler;
+	memset(&Stream.stats, 0, sizeof(Stream.stats));
+	Stream.pdc = spi_get_pdc_base(SPI);
+
+	Stream.rx_packet[0].ul_addr = (uint32_t)(uintptr_t)stream_ring[0];
+	Stream.rx_packet[0].ul_size = STREAM_RING_BYTES;
+	Stream.rx_packet[1].ul_addr = (uint32_t)(uintptr_t)stream_ring[1];
+	Stream.rx_packet[1].ul_size = STREAM_RING_BYTES;
+	Stream.tx_packet.ul_addr = (uint32_t)(uintptr_t)stream_tx_dummy;
+	Stream.tx_packet.ul_size = STREAM_RING_BYTES;
+
+	if (!MCP3462_stream_timing(sysclk_get_peripheral_hz(), &Stream.scbr, &Stream.dlybct))
+		Stream.handler = NULL;
+
+	pio_handler_set(MCP3462_IRQ_PIO, MCP3462_IRQ_PIO_ID, (1 << MCP3462_IRQ_PIN), PIO_IT_FALL_EDGE,
+	                stream_sync_handler);
+	pio_handler_set_priority(MCP3462_IRQ_PIO, MCP3462_IRQ_PIO_IRQN, MCP3462_STREAM_IRQ_PRIO);
+
+	NVIC_ClearPendingIRQ(SPI_IRQn);
+	NVIC_SetPriority(SPI_IRQn, STREAM_SPI_IRQ_PRIO);
+	NVIC_EnableIRQ(SPI_IRQn);
+}
+
+void MCP3462_stream_start(void)
+{
+	if (Stream.handler == NULL || Stream.state != MCP3462_STREAM_IDLE)
+		return;
+
+	Stream.state = MCP3462_STREAM_ARMED;
+	pio_enable_interrupt(MCP3462_IRQ_PIO, (1 << MCP3462_IRQ_PIN));
+}
+
+void MCP3462_stream_stop(void)
+{
+	pio_disable_interrupt(MCP3462_IRQ_PIO, (1 << MCP3462_IRQ_PIN));
+	NVIC_DisableIRQ(SPI_IRQn);
+
+	if ((Stream.state == MCP3462_STREAM_RUNNING) || (Stream.state == MCP3462_STREAM_STOPPING))
+		stream_halt();
+
+	Stream.state = MCP3462_STREAM_IDLE;
+	stream_apply_pending();
+
+	NVIC_EnableIRQ(SPI_IRQn);
+}
+
+MCP3462_stream_state_t MCP3462_stream_state(void)
+{
+	return Stream.state;
+}
+
+MCP3462_stream_stats_t MCP3462_stream_stats(void)
+{
+	return Stream.stats;
+}
+
 void MCP3462_enable_clock(void)
 {
 	pmc_enable_pck(CLOCK_PCK_ID);
@@ -101,12 +101,79 @@ typedef enum{
 	CONV_MODE_CONT
 } conv_mode_type_t;
 
+/*
+ * Continuous acquisition: after one static-read command the ADCDATA register
+ * is clocked out back to back by the SPI PDC into a ping-pong ring, paced by
+ * DLYBCT to exactly one conversion per 24-bit read (MCLK and MCK come from the
+ * same crystal). The data-ready pin is only used to align the first read.
+ */
+#define MCP3462_IRQ_PIO				PIOA
+#define MCP3462_IRQ_PIO_ID			ID_PIOA
+#define MCP3462_IRQ_PIO_IRQN		PIOA_IRQn
+#define MCP3462_IRQ_PIN				2
+#define MCP3462_STREAM_IRQ_PRIO		2
+
+#define MCP3462_SAMPLE_BYTES		3
+#define MCP3462_STREAM_BLOCKLEN		100
+#define MCP3462_STREAM_MIN_SCBR		6		/* SCK <= 20MHz at MCK = 120MHz */
+#define MCP3462_MCLK_HZ				20000000UL
+#define MCP3462_OSR_RATIO			256		/* CONFIG1 as set by send_configuration(), see MCP3462_set_rate() */
+#define MCP3462_PRE_RATIO			1
+
+typedef void (*MCP3462_block_handler_t)(const int32_t *samples, uint16_t len);
+
+typedef enum {
+	MCP3462_STREAM_IDLE = 0,
+	MCP3462_STREAM_ARMED,
+	MCP3462_STREAM_RUNNING,
+	MCP3462_STREAM_STOPPING
+} MCP3462_stream_state_t;
+
+typedef struct {
+	uint32_t blocks;
+	uint32_t samples;
+	uint32_t resyncs;
+} MCP3462_stream_stats_t;
+
+/*
+ * A data rate, ready to be applied: the CONFIG1 byte, its OSR * PRE ratio
+ * (MCP3462_MCLK_HZ / 4 / ratio conversions per second) and the SPI pacing of
+ * the stream at that rate, see MCP3462_rate_prepare().
+ */
+typedef struct {
+	uint8_t config1;
+	uint32_t ratio;
+	uint8_t scbr;
+	uint8_t dlybct;
+} MCP3462_rate_t;
+
+static inline int32_t
+MCP3462_decode_sample(const uint8_t *data)
+{
+	int32_t value = ((int32_t)data[0] << 16) | ((int32_t)data[1] << 8) | data[2];
+
+	return (value ^ 0x800000) - 0x800000;
+}
+
 void	MCP3462_init			(void);
 int32_t MCP3462_read			(uint16_t ch_nb);
 void	MCP3462_enable_clock	(void);
 void	MCP3462_disable_clock	(void);
 void	MCP3462_set_gain		(gain_type_t gain);
 void	MCP3462_set_mux			(uint8_t positive_ch, uint8_t negative_ch);
+uint8_t	MCP3462_get_mux			(void);
+gain_type_t	MCP3462_get_gain		(void);
+bool	MCP3462_rate_prepare	(osr_type_t osr, prescaller_type_t pre, MCP3462_rate_t *rate);
+void	MCP3462_set_rate		(const MCP3462_rate_t *rate);
+uint32_t	MCP3462_get_rate		(void);
+
+void	MCP3462_stream_init		(MCP3462_block_handler_t handler);
+void	MCP3462_stream_start	(void);
+void	MCP3462_stream_stop		(void);
+bool	MCP3462_stream_timing	(uint32_t mck_hz, uint8_t *scbr, uint8_t *dlybct);
+
+MCP3462_stream_state_t	MCP3462_stream_state	(void);
+MCP3462_stream_stats_t	MCP3462_stream_stats	(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,262 @@
+#include <math.h>
+
+#include "asf.h"
+#include "circuit_fit.h"
+#include "DSP_functions.h"
+#include "MCP3462.h"
+#include "sweep.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if SWEEP_POINTS > CIRCUIT_FIT_MAX_POINTS
+#error "the spectrum of a sweep has to fit into one circuit fit"
+#endif
+
+/* normal equations of target ~ p0 + p1 * basis, summed over the points */
+typedef struct {
+    float32_t a00;
+    float32_t a01;
+    float32_t a11;
+    float32_t b0;
+    float32_t b1;
+} Normal_eq_t;
+
+/* the parallel model is linear in the admittance, the series ones in the impedance */
+static inline bool
+model_is_admittance(Circuit_model_t model)
+{
+    return model == CIRCUIT_PARALLEL_RC;
+}
+
+/* the term of p1 at omega, relative to the one of the first point */
+static inline Complex_t
+model_basis(Circuit_model_t model, float32_t omega_rel)
+{
+    if (model == CIRCUIT_SERIES_RC)
+        return complex_make(0, -1 / omega_rel);
+
+    return complex_make(0, omega_rel);
+}
+
+static inline Complex_t
+point_target(Circuit_model_t model, const Circuit_point_t *point)
+{
+    if (model_is_admittance(model))
+        return point->Y;
+
+    return complex_div(complex_make(1, 0), point->Y);
+}
+
+static void
+normal_add(Normal_eq_t *eq, Complex_t target, Complex_t basis, float32_t weight)
+{
+    /* p0 is real: its term is 1 */
+    eq->a00 += weight;
+    eq->a01 += weight * basis.I;
+    eq->a11 += weight * complex_norm(basis);
+    eq->b0 += weight * target.I;
+    eq->b1 += weight * (basis.I * target.I + basis.Q * target.Q);
+}
+
+static bool
+normal_solve(const Normal_eq_t *eq, float32_t *p0, float32_t *p1)
+{
+    float32_t det = eq->a00 * eq->a11 - eq->a01 * eq->a01;
+
+    /* the matrix is positive semidefinite: anything else is a degenerate set of points */
+    if (!(det > 0))
+        return false;
+
+    *p0 = (eq->b0 * eq->a11 - eq->b1 * eq->a01) / det;
+    *p1 = (eq->b1 * eq->a00 - eq->b0 * eq->a01) / det;
+
+    return true;
+}
+
+/*
+ * Targets and frequencies are scaled by those of the first point, so the
+ * sums stay near 1 for loads from ohms to megohms; the points are weighted
+ * by 1 / |target|^2, so each counts by its relative error.
+ */
+static void
+fit_model(Circuit_model_t model, const Circuit_point_t *points, uint32_t count, Circuit_fit_t *fit)
+{
+    Normal_eq_t eq         = { 0 };
+    float32_t   omega_ref  = 2 * PI * points[0].freq_hz;
+    float32_t   target_ref = complex_abs(point_target(model, &points[0]));
+    float32_t   omega_rel;
+    float32_t   p0;
+    float32_t   p1;
+    float32_t   err_sq = 0;
+    Complex_t   target;
+    Complex_t   fitted;
+    uint32_t    idx;
+
+    fit->valid    = false;
+    fit->R        = 0;
+    fit->reactive = 0;
+    fit->residual = 0;
+
+    for (idx = 0; idx < count; idx++) {
+        omega_rel = points[idx].freq_hz / points[0].freq_hz;
+        target    = complex_scale(point_target(model, &points[idx]), 1 / target_ref);
+
+        normal_add(&eq, target, model_basis(model, omega_rel), 1 / complex_norm(target));
+    }
+
+    if (!normal_solve(&eq, &p0, &p1))
+        return;
+
+    /* the real part only takes p0, so the best p0 >= 0 is the clipped one */
+    if (p0 < 0)
+        p0 = 0;
+
+    for (idx = 0; idx < count; idx++) {
+        omega_rel = points[idx].freq_hz / points[0].freq_hz;
+        target    = complex_scale(point_target(model, &points[idx]), 1 / target_ref);
+        fitted    = complex_add(complex_make(p0, 0), complex_scale(model_basis(model, omega_rel), p1));
+
+        /* relative to the impedance: to the fitted admittance in the parallel plane */
+        if (model_is_admittance(model))
+            err_sq += complex_norm(fitted) > 0 ? complex_norm(complex_sub(fitted, target)) / complex_norm(fitted) : 1;
+        else
+            err_sq += complex_norm(complex_sub(fitted, target)) / complex_norm(target);
+    }
+
+    arm_sqrt_f32(err_sq / count, &fit->residual);
+
+    if (!(p1 > 0))
+        return;
+
+    switch (model) {
+    case CIRCUIT_SERIES_RC:
+        fit->R        = p0 * target_ref;
+        fit->reactive = 1 / (p1 * target_ref * omega_ref);
+        break;
+
+    case CIRCUIT_PARALLEL_RC:
+        /* a capacitor without loss has no parallel resistance */
+        fit->R        = p0 > 0 ? 1 / (p0 * target_ref) : INFINITY;
+        fit->reactive = p1 * target_ref / omega_ref;
+        break;
+
+    default:
+        fit->R        = p0 * target_ref;
+        fit->reactive = p1 * target_ref / omega_ref;
+        break;
+    }
+
+    fit->valid = true;
+}
+
+/* the point of a reading: Z and the angle of the admittance in degrees, as Z_ovrl / Z_ovrl_phi */
+Circuit_point_t
+circuit_point(float32_t freq_hz, float32_t Z, float32_t Y_phi)
+{
+    Circuit_point_t point;
+
+    /* readings may leave it outside -180 ... 180 */
+    Y_phi = remainderf(Y_phi, 360);
+
+    point.freq_hz = freq_hz;
+    point.Y       = Z > 0 ? complex_polar(1 / Z, Y_phi) : complex_make(0, 0);
+
+    return point;
+}
+
+/* false for no points, too many, or one without a frequency or an admittance */
+bool
+circuit_fit(const Circuit_point_t *points, uint32_t count, Circuit_result_t *result)
+{
+    Circuit_model_t model;
+    uint32_t        idx;
+
+    result->has_best = false;
+
+    if (count == 0 || count > CIRCUIT_FIT_MAX_POINTS)
+        return false;
+
+    for (idx = 0; idx < count; idx++)
+        if (!(points[idx].freq_hz > 0) || !(complex_norm(points[idx].Y) > 0))
+            return false;
+
+    for (model = CIRCUIT_SERIES_RC; model < CIRCUIT_MODELS; model++) {
+        fit_model(model, points, count, &result->model[model]);
+
+        if (!result->model[model].valid)
+            continue;
+
+        if (!result->has_best || result->model[model].residual < result->model[result->best].residual) {
+            result->best     = model;
+            result->has_best = true;
+        }
+    }
+
+    return true;
+}
+
+/* the last reading of the load (or of the clamp branch), at the excitation and, with DSP_DUAL_TONE, at the second tone */
+bool
+circuit_fit_reading(bool clamp, Circuit_result_t *result)
+{
+    Circuit_point_t points[2];
+    uint32_t        count   = 0;
+    float32_t       freq_hz = (float32_t)MCP3462_MCLK_HZ / (4.0f * (float32_t)MCP3462_get_rate() * SINTABLE_LEN);
+
+    if (clamp)
+        points[count++] = circuit_point(freq_hz, clamp_measurements_result.Z_clamp, clamp_measurements_result.Z_clamp_phi);
+    else
+        points[count++] = circuit_point(freq_hz, clamp_measurements_result.Z_ovrl, clamp_measurements_result.Z_ovrl_phi);
+
+#ifdef DSP_DUAL_TONE
+    if (clamp)
+        points[count++] = circuit_point(freq_hz * DUAL_TONE_BIN,
+                                        clamp_measurements_result.tone2.Z_clamp,
+                                        clamp_measurements_result.tone2.Z_clamp_phi);
+    else
+        points[count++] = circuit_point(freq_hz * DUAL_TONE_BIN,
+                                        clamp_measurements_result.tone2.Z_ovrl,
+                                        clamp_measurements_result.tone2.Z_ovrl_phi);
+#endif
+
+    return circuit_fit(points, count, result);
+}
+
+/*
+ * The points of a finished sweep that have no gap in their window. Off the
+ * nominal frequency they carry the front ends' response uncorrected (see
+ * Sweep_point_t.calibrated), so the fit is as good as the front ends are
+ * flat over the sweep.
+ */
+bool
+circuit_fit_spectrum(bool clamp, Circuit_result_t *result)
+{
+    Circuit_point_t points[SWEEP_POINTS];
+    uint32_t        count = 0;
+    uint8_t         step;
+
+    if (Sweep.state != SWEEP_DONE) {
+        result->has_best = false;
+        return false;
+    }
+
+    for (step = 0; step < SWEEP_POINTS; step++) {
+        const Sweep_point_t *point = &Sweep.spectrum[step];
+
+        if (point->data_lost)
+            continue;
+
+        if (clamp)
+            points[count++] = circuit_point(point->freq_hz, point->Z_clamp, point->Z_clamp_phi);
+        else
+            points[count++] = circuit_point(point->freq_hz, point->Z_ovrl, point->Z_ovrl_phi);
+    }
+
+    return circuit_fit(points, count, result);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+#ifndef CIRCUIT_FIT_H_
+#define CIRCUIT_FIT_H_
+#include "asf.h"
+#include "arm_math.h"
+#include "DSP_complex.h"
+
+/*
+ * Equivalent circuits of a measured load: series RC, parallel RC and series
+ * RL are fitted to up to CIRCUIT_FIT_MAX_POINTS frequency points. Each model
+ * is linear in two parameters in the impedance (series) or the admittance
+ * (parallel) plane, so a fit is a 2 x 2 weighted least squares solve: no
+ * iterations, no allocation, and a time bound by the number of points. One
+ * point determines every model exactly; the residual then only tells which
+ * of them are physical.
+ *
+ * The points are admittances, as the readings are: Z_ovrl_phi and
+ * Z_clamp_phi are the angles of the load admittance.
+ */
+#define CIRCUIT_FIT_MAX_POINTS 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CIRCUIT_SERIES_RC = 0,
+    CIRCUIT_PARALLEL_RC,
+    CIRCUIT_SERIES_RL,
+    CIRCUIT_MODELS
+} Circuit_model_t;
+
+typedef struct {
+    float32_t freq_hz;
+    Complex_t Y;
+} Circuit_point_t;
+
+typedef struct {
+    /* the components came out positive and the fit was solvable */
+    bool valid;
+
+    float32_t R;
+    /* C in F for the RC models, L in H for RL */
+    float32_t reactive;
+
+    /* RMS over the points of |Z_model - Z| / |Z| */
+    float32_t residual;
+} Circuit_fit_t;
+
+typedef struct {
+    Circuit_fit_t   model[CIRCUIT_MODELS];
+    /* the valid model with the smallest residual, if any is valid */
+    bool            has_best;
+    Circuit_model_t best;
+} Circuit_result_t;
+
+Circuit_point_t circuit_point(float32_t freq_hz, float32_t Z, float32_t Y_phi);
+bool            circuit_fit(const Circuit_point_t *points, uint32_t count, Circuit_result_t *result);
+bool            circuit_fit_reading(bool clamp, Circuit_result_t *result);
+bool            circuit_fit_spectrum(bool clamp, Circuit_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CIRCUIT_FIT_H_ */
@@ -0,0 +1,173 @@
+#ifndef FASTMATH_H_
+#define FASTMATH_H_
+#include "arm_math.h"
+
+/*
+ * Single precision approximations for the result path, polynomial and FPU
+ * only, no tables. Stands in for newlib's <fastmath.h>, which is just
+ * <math.h>. The bounds below are checked by the sweeps of
+ * src/host/test/test_fastmath.c against double precision libm:
+ *
+ *   fast_atan2f     any finite y, x      4e-7 rad absolute, 0 for 0, 0
+ *   fast_sinf/cosf  any x                2.5e-7 + 9e-8 |x| absolute, the
+ *                                        second term from x - k pi / 2 in float
+ *   fast_hypotf     |x|, |y| < 1e18      2.4e-7 relative (VSQRT)
+ *   fast_log2f      positive normal x    3e-7 absolute plus the rounding of
+ *                                        the result; 0 and denormals give -127
+ *
+ * -ffast-math reassociates a split pi / 2 back into one constant, so the
+ * sin/cos range reduction uses a single one; phases in this firmware stay
+ * within a few turns.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FASTMATH_PI_2 1.57079632679489662f
+#define FASTMATH_2_PI 0.63661977236758134f
+
+typedef union {
+    float32_t f;
+    uint32_t  u;
+} fastmath_bits_t;
+
+/* atan(z) for 0 <= z <= 1, Abramowitz & Stegun 4.4.49 */
+static inline float32_t
+fast_atan_unit(float32_t z)
+{
+    float32_t z2 = z * z;
+
+    return z * (1.0f +
+                 z2 * (-0.3333314528f +
+                       z2 * (0.1999355085f +
+                             z2 * (-0.1420889944f +
+                                   z2 * (0.1065626393f +
+                                         z2 * (-0.0752896400f +
+                                               z2 * (0.0429096138f +
+                                                     z2 * (-0.0161657367f + z2 * 0.0028662257f))))))));
+}
+
+/* atan2(y, x) in -pi ... pi */
+static inline float32_t
+fast_atan2f(float32_t y, float32_t x)
+{
+    float32_t abs_y = y < 0 ? -y : y;
+    float32_t abs_x = x < 0 ? -x : x;
+    float32_t angle;
+
+    if (abs_y == 0 && abs_x == 0)
+        return 0;
+
+    if (abs_y <= abs_x)
+        angle = fast_atan_unit(abs_y / abs_x);
+    else
+        angle = FASTMATH_PI_2 - fast_atan_unit(abs_x / abs_y);
+
+    if (x < 0)
+        angle = PI - angle;
+
+    return y < 0 ? -angle : angle;
+}
+
+static inline float32_t
+fast_hypotf(float32_t x, float32_t y)
+{
+    float32_t abs_val;
+
+    arm_sqrt_f32(x * x + y * y, &abs_val);
+
+    return abs_val;
+}
+
+/* sin and cos of x in rad, reduced to |r| <= pi / 4 around a multiple of pi / 2 */
+static inline void
+fast_sincosf(float32_t x, float32_t *sin_out, float32_t *cos_out)
+{
+    float32_t k = x * FASTMATH_2_PI;
+    int32_t   quadrant;
+    float32_t r;
+    float32_t r2;
+    float32_t sine;
+    float32_t cosine;
+
+    quadrant = (int32_t)(k < 0 ? k - 0.5f : k + 0.5f);
+    k        = (float32_t)quadrant;
+    r        = x - k * FASTMATH_PI_2;
+    r2       = r * r;
+
+    /* cephes sinf / cosf kernels */
+    sine   = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    cosine = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f +
+                                                                         r2 * 2.443315711809948e-5f));
+
+    switch (quadrant & 3) {
+    case 0:
+        *sin_out = sine;
+        *cos_out = cosine;
+        break;
+    case 1:
+        *sin_out = cosine;
+        *cos_out = -sine;
+        break;
+    case 2:
+        *sin_out = -sine;
+        *cos_out = -cosine;
+        break;
+    default:
+        *sin_out = -cosine;
+        *cos_out = sine;
+        break;
+    }
+}
+
+static inline float32_t
+fast_sinf(float32_t x)
+{
+    float32_t sine;
+    float32_t cosine;
+
+    fast_sincosf(x, &sine, &cosine);
+
+    return sine;
+}
+
+static inline float32_t
+fast_cosf(float32_t x)
+{
+    float32_t sine;
+    float32_t cosine;
+
+    fast_sincosf(x, &sine, &cosine);
+
+    return cosine;
+}
+
+/* log2(x) = e + log2(m), m in sqrt(1/2) ... sqrt(2), by the atanh series of t = (m - 1) / (m + 1) */
+static inline float32_t
+fast_log2f(float32_t x)
+{
+    fastmath_bits_t bits;
+    int32_t         e;
+    float32_t       t;
+    float32_t       t2;
+
+    bits.f = x;
+    e      = (int32_t)((bits.u >> 23) & 0xff) - 127;
+    bits.u = (bits.u & 0x007fffff) | 0x3f800000;
+
+    if (bits.f > 1.41421356f) {
+        bits.f *= 0.5f;
+        e++;
+    }
+
+    t  = (bits.f - 1.0f) / (bits.f + 1.0f);
+    t2 = t * t;
+
+    return (float32_t)e + t * (2.8853900818f + t2 * (0.9617966939f + t2 * (0.5770780164f + t2 * 0.4121985831f)));
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* FASTMATH_H_ */
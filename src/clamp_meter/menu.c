@@ -413,8 +413,8 @@ void menu_display_globalconfig_page(bool reprint_all)
 
 	if (Analog.mes_mode == MEASUREMENT_MODE_MANUAL)
 		LCD_write("Manual");
-	else if (Analog.mes_mode == MEASUREMENT_MODE_1)
-		LCD_write("nodef");
+	else if (Analog.mes_mode == MEASUREMENT_MODE_SCAN)
+		LCD_write("Scan");
 
 
 	LCD_cursor_setpos(11, 3);
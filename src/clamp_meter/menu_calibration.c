@@ -15,6 +15,7 @@
 #include "menu.h"
 #include "menu_calibration.h"
 #include "keyboard.h"
+#include "DSP_calibration.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -150,6 +151,7 @@ void calibration_clamp_pos_vout(calibrator_action_type_t action)
 		LCD_cursor_setpos(1, 4);
 		LCD_write("stable..............");
 
+		measurement_set_mode(MEASUREMENT_MODE_MANUAL);
 		switch_sensing_chanel(VOLTAGE_SENSOR);
 		measurement_start();
 
@@ -259,6 +261,8 @@ void calibration_terminate(void)
 
 void calibration_start(void)
 {
+	/* every step reads one sensor at a time */
+	measurement_set_mode(MEASUREMENT_MODE_MANUAL);
 	Calibrator.is_calibrating = true;
 
 	switch (Calibrator.cal_phase) {
@@ -450,6 +454,7 @@ void calibration_save(void)
 	Cal_data.v_sens_phi = Calibrator.vout_phi_noload;
 
 	Cal_data.data_password = CALIBRATION_DATA_PASSWORD;
+	dsp_calibration_changed();
 
 	store_coeffs_to_flash_struct();
 	calibration_terminate();
@@ -12,11 +12,18 @@
 #include "menu_ili9486.h"
 #include "signal_conditioning.h"
 #include "menu.h"
+#include "profiler.h"
+#include "sweep.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* characters of the status right of the sensor in the top bar */
+#define TOP_BAR_STATUS_LEN 14
+/* significant digits of the fitted components; with the exponents the line just fits the bottom bar */
+#define BOT_BAR_FIT_DIGITS 4
+
 MMMenu_t                MMMenu;
 page_params_Measure_t   page_params_Measure;
 page_params_TopHeader_t page_params_TopHeader;
@@ -84,6 +91,8 @@ top_header_init(void)
     page_params_TopHeader.output_status_text_xy.y         = 0;
     page_params_TopHeader.info_text_xy.x                  = 0;
     page_params_TopHeader.info_text_xy.y                  = 40;
+    page_params_TopHeader.status_text_xy.x                = 154;
+    page_params_TopHeader.status_text_xy.y                = 40;
     page_params_TopHeader.header_coordinates.lft_x        = 0;
     page_params_TopHeader.header_coordinates.width        = tft_W;
     page_params_TopHeader.header_coordinates.top_y        = 0;
@@ -226,6 +235,73 @@ print_line_text(const char *str, uint8_t line_num, uint8_t font_size)
     TFT_print_str(str, TFT_STR_M_BACKGR, font_size);
 }
 
+static uint8_t
+status_append(char *status, uint8_t pos, const char *str)
+{
+    while (*str && pos < TOP_BAR_STATUS_LEN)
+        status[pos++] = *str++;
+
+    return pos;
+}
+
+static uint8_t
+status_append_number(char *status, uint8_t pos, uint32_t number)
+{
+    char    digits[10];
+    uint8_t count = 0;
+
+    do {
+        digits[count++] = (char)('0' + number % 10);
+        number /= 10;
+    } while (number != 0);
+
+    while (count > 0 && pos < TOP_BAR_STATUS_LEN)
+        status[pos++] = digits[--count];
+
+    return pos;
+}
+
+/* what runs besides the reading, right of the sensor; padded, as it prints over the last one */
+static void
+show_top_bar_status(void)
+{
+    char    status[TOP_BAR_STATUS_LEN + 1];
+    uint8_t pos = 0;
+
+    if (sweep_is_running()) {
+        pos = status_append(status, pos, "Sweep ");
+        pos = status_append_number(status, pos, Sweep.step + 1);
+        pos = status_append(status, pos, "/");
+        pos = status_append_number(status, pos, SWEEP_POINTS);
+    }
+
+    /* where the loop acts, in % of the operator's amplitude */
+    if (Analog.excitation_control_on && Analog.mes_mode == MEASUREMENT_MODE_MANUAL && Analog.generator_amplitude > 0) {
+        pos = status_append(status, pos, "Exc ");
+        pos = status_append_number(status,
+                                   pos,
+                                   100UL * Analog.excitation_amplitude /
+                                       (Analog.generator_amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF));
+        pos = status_append(status, pos, "%");
+    }
+
+#ifdef DSP_HARMONICS
+    if (clamp_measurements_result.distorted) {
+        if (pos > 0)
+            pos = status_append(status, pos, " ");
+        pos = status_append(status, pos, "THD!");
+    }
+#endif
+
+    while (pos < TOP_BAR_STATUS_LEN)
+        status[pos++] = ' ';
+    status[pos] = '\0';
+
+    TFT_cursor_set(page_params_TopHeader.status_text_xy.x, page_params_TopHeader.status_text_xy.y);
+    TFT_text_color_set(page_params_TopHeader.info_text_color, page_params_TopHeader.output_enabled_bk_color);
+    TFT_print_str(status, TFT_STR_M_BACKGR, 1);
+}
+
 void
 display_show_top_bar(void)
 {
@@ -254,13 +330,27 @@ display_show_top_bar(void)
         TFT_cursor_set(page_params_TopHeader.info_text_xy.x, page_params_TopHeader.info_text_xy.y);
         TFT_text_color_set(page_params_TopHeader.info_text_color, page_params_TopHeader.output_enabled_bk_color);
 
-        switch (Analog.selected_sensor) {
-        case VOLTAGE_SENSOR: TFT_print_str("Sensor: Vout ", TFT_STR_M_BACKGR, 1); break;
+        if (Analog.mes_mode == MEASUREMENT_MODE_SCAN) {
+            /* all three are measured, the one shown is still selected */
+            switch (Analog.selected_sensor) {
+            case VOLTAGE_SENSOR: TFT_print_str("Scan:   Vout ", TFT_STR_M_BACKGR, 1); break;
+
+            case SHUNT_SENSOR: TFT_print_str("Scan:   Shunt", TFT_STR_M_BACKGR, 1); break;
 
-        case SHUNT_SENSOR: TFT_print_str("Sensor: Shunt", TFT_STR_M_BACKGR, 1); break;
+            case CLAMP_SENSOR: TFT_print_str("Scan:   Clamp", TFT_STR_M_BACKGR, 1); break;
+            }
+        }
+        else {
+            switch (Analog.selected_sensor) {
+            case VOLTAGE_SENSOR: TFT_print_str("Sensor: Vout ", TFT_STR_M_BACKGR, 1); break;
+
+            case SHUNT_SENSOR: TFT_print_str("Sensor: Shunt", TFT_STR_M_BACKGR, 1); break;
 
-        case CLAMP_SENSOR: TFT_print_str("Sensor: Clamp", TFT_STR_M_BACKGR, 1); break;
+            case CLAMP_SENSOR: TFT_print_str("Sensor: Clamp", TFT_STR_M_BACKGR, 1); break;
+            }
         }
+
+        show_top_bar_status();
     }
     else {
         TFT_text_color_set(page_params_TopHeader.output_disabled_main_text_color,
@@ -269,6 +359,36 @@ display_show_top_bar(void)
     }
 }
 
+/*
+ * The best equivalent circuit of what the page shows, the clamp branch or
+ * the load, in place of the message once there is one: "Par RC R1000 C1.8e-07"
+ */
+static bool
+show_bot_bar_fit(void)
+{
+    static const char *const model_names[CIRCUIT_MODELS] = { "Ser RC R", "Par RC R", "Ser RL R" };
+
+    const Circuit_result_t *fit;
+
+    if (MMMenu.current_menu != MENU_MEASURE || !Analog.generator_is_active)
+        return false;
+
+    if (Analog.selected_sensor == CLAMP_SENSOR)
+        fit = &clamp_measurements_result.fit_clamp;
+    else
+        fit = &clamp_measurements_result.fit_ovrl;
+
+    if (!fit->has_best)
+        return false;
+
+    TFT_print_str(model_names[fit->best], TFT_STR_M_BACKGR, 1);
+    TFT_print_number_f(fit->model[fit->best].R, BOT_BAR_FIT_DIGITS, 1);
+    TFT_print_str(fit->best == CIRCUIT_SERIES_RL ? " L" : " C", TFT_STR_M_BACKGR, 1);
+    TFT_print_number_f(fit->model[fit->best].reactive, BOT_BAR_FIT_DIGITS, 1);
+
+    return true;
+}
+
 void
 display_show_bot_bar(void)
 {
@@ -284,6 +404,9 @@ display_show_bot_bar(void)
     TFT_cursor_set(page_params_BotHeader.msg_coordinates.x, page_params_BotHeader.msg_coordinates.y);
     TFT_text_color_set(page_params_BotHeader.text_color, page_params_BotHeader.normal_bk_color);
 
+    if (show_bot_bar_fit())
+        return;
+
     if (MMMenu.bot_header_msg != NULL)
         TFT_print_str(MMMenu.bot_header_msg, TFT_STR_M_BACKGR, 1);
 }
@@ -436,12 +559,16 @@ display_print_page(void)
 void
 display_refresh(void)
 {
+    PROFILE_BEGIN(PROFILE_DISPLAY_REFRESH);
+
     MMMenu.if_reprint_all = true;
     MMMenu.reprint        = REPRINT_ONLYVALUE;
 
     display_print_page();
     display_show_top_bar();
     display_show_bot_bar();
+
+    PROFILE_END(PROFILE_DISPLAY_REFRESH);
 }
 
 #ifdef __cplusplus
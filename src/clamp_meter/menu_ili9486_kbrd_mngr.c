@@ -12,6 +12,7 @@
 #include "menu.h"
 #include "keyboard.h"
 #include "signal_conditioning.h"
+#include "sweep.h"
 #include "system_init.h"
 
 #ifdef __cplusplus
@@ -75,6 +76,56 @@ km_page_measurement(void)
 	}
 	break;
 
+	case KEY_LEFT: {
+		/* the impedance spectrum; a second press stops it with the points taken so far */
+		if (Analog.generator_is_active) {
+			if (sweep_is_running())
+				sweep_stop();
+			else
+				sweep_start();
+		}
+
+		MMMenu.if_reprint_all = true;
+		MMMenu.reprint = REPRINT_ALL;
+		display_show_top_bar();
+	}
+	break;
+
+	case KEY_BACK: {
+		/* the excitation amplitude loop, for the ends of the gain ladder in manual mode */
+		excitation_control_enable(!Analog.excitation_control_on);
+
+		MMMenu.if_reprint_all = true;
+		MMMenu.reprint = REPRINT_ALL;
+		display_show_top_bar();
+	}
+	break;
+
+	case KEY_UP: {
+		if (Analog.generator_is_active) {
+			if (Analog.mes_mode == MEASUREMENT_MODE_SCAN)
+				measurement_set_mode(MEASUREMENT_MODE_MANUAL);
+			else
+				measurement_set_mode(MEASUREMENT_MODE_SCAN);
+		}
+
+		MMMenu.if_reprint_all = true;
+		MMMenu.reprint = REPRINT_ALL;
+		display_show_top_bar();
+	}
+	break;
+
+	case KEY_DOWN: {
+		/* FAST -> NORMAL -> PRECISE -> FAST */
+		if (clamp_measurements_result.profile == DSP_PROFILE_PRECISE)
+			measurement_set_profile(DSP_PROFILE_FAST);
+		else
+			measurement_set_profile(clamp_measurements_result.profile + 1);
+
+		display_print_page();
+	}
+	break;
+
 	case KEY_ENCSW: {
 		if (Analog.generator_is_active) {
 			switch (Analog.selected_sensor) {
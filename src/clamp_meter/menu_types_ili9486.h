@@ -132,6 +132,7 @@ typedef struct {
 	Page		header_coordinates;
 	Point		output_status_text_xy;
 	Point		info_text_xy;
+	Point		status_text_xy;
 }page_params_TopHeader_t;
 
 extern page_params_TopHeader_t page_params_TopHeader;
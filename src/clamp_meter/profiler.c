@@ -0,0 +1,108 @@
+#include "asf.h"
+#include "profiler.h"
+#include "MCP3462.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static Profile_region_t profile_regions[PROFILE_REGIONS];
+static uint32_t         profile_isr_samples;
+/* slowest ADC interrupt, per sample */
+static uint32_t         profile_isr_peak_cycles;
+static uint32_t         profile_isr_peak_samples;
+
+void
+profiler_init(void)
+{
+#ifdef PROFILER_ENABLE
+    profiler_clock_init();
+#endif
+    profiler_reset();
+}
+
+void
+profiler_reset(void)
+{
+    __disable_irq();
+
+    memset(profile_regions, 0, sizeof(profile_regions));
+    profile_isr_samples      = 0;
+    profile_isr_peak_cycles  = 0;
+    profile_isr_peak_samples = 0;
+
+    __enable_irq();
+}
+
+void
+profiler_record(profile_region_t region, uint32_t cycles)
+{
+    Profile_region_t *stats = &profile_regions[region];
+
+    if (stats->calls == 0 || cycles < stats->min)
+        stats->min = cycles;
+
+    if (cycles > stats->max)
+        stats->max = cycles;
+
+    stats->total += cycles;
+    stats->calls++;
+}
+
+void
+profiler_record_isr(profile_region_t region, uint32_t cycles, uint32_t samples)
+{
+    profiler_record(region, cycles);
+
+    profile_isr_samples += samples;
+
+    /* cycles / samples > peak_cycles / peak_samples */
+    if ((uint64_t)cycles * profile_isr_peak_samples > (uint64_t)profile_isr_peak_cycles * samples ||
+        profile_isr_peak_samples == 0) {
+        profile_isr_peak_cycles  = cycles;
+        profile_isr_peak_samples = samples;
+    }
+}
+
+Profile_t
+profiler_results(void)
+{
+    Profile_t results;
+    uint32_t  peak_cycles;
+    uint32_t  peak_samples;
+    uint32_t  idx;
+
+    /* the interrupt side is written from the ADC interrupt */
+    __disable_irq();
+
+    memcpy(results.region, profile_regions, sizeof(results.region));
+    results.isr_samples = profile_isr_samples;
+    peak_cycles         = profile_isr_peak_cycles;
+    peak_samples        = profile_isr_peak_samples;
+
+    __enable_irq();
+
+    for (idx = 0; idx < PROFILE_REGIONS; idx++)
+        if (results.region[idx].calls)
+            results.region[idx].mean = (uint32_t)(results.region[idx].total / results.region[idx].calls);
+
+    results.clock_hz      = sysclk_get_cpu_hz();
+    results.sample_cycles = (uint32_t)((uint64_t)results.clock_hz * 4 * MCP3462_get_rate() /
+                                       MCP3462_MCLK_HZ);
+
+    results.isr_load      = 0;
+    results.isr_load_peak = 0;
+
+    if (results.isr_samples)
+        results.isr_load = 100.0f * (float32_t)results.region[PROFILE_ADC_ISR].total /
+                           ((float32_t)results.isr_samples * results.sample_cycles);
+
+    if (peak_samples)
+        results.isr_load_peak = 100.0f * (float32_t)peak_cycles / ((float32_t)peak_samples * results.sample_cycles);
+
+    return results;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+#include "asf.h"
+#include "arm_math.h"
+
+/*
+ * PROFILER_ENABLE: count the cycles spent in the instrumented regions below.
+ * Without it the PROFILE_* macros compile to nothing and the hot paths are
+ * unchanged.
+ */
+// #define PROFILER_ENABLE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Time base: the DWT cycle counter, counting core clocks and wrapping every
+ * 2^32 of them (~36 s at 120 MHz). Durations are unsigned differences, so a
+ * wrap inside a region is harmless.
+ */
+static inline void
+profiler_clock_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t
+profiler_clock_read(void)
+{
+    return DWT->CYCCNT;
+}
+
+typedef enum {
+    PROFILE_ADC_ISR = 0,           /* adc_interrupt_handler(), adc_block_handler() */
+    PROFILE_DO_FILTER,             /* one block through the filter cascade */
+    PROFILE_MANAGE_SENSED_DATA,
+    PROFILE_DISPLAY_REFRESH,
+    PROFILE_TFT_PRINT_CHAR,
+    PROFILE_REGIONS
+} profile_region_t;
+
+typedef struct {
+    uint32_t calls;
+    uint32_t min;   /* cycles */
+    uint32_t max;
+    uint32_t mean;
+    uint64_t total;
+} Profile_region_t;
+
+typedef struct {
+    Profile_region_t region[PROFILE_REGIONS];
+    uint32_t         clock_hz;      /* profiler_clock_read() ticks per second */
+    uint32_t         sample_cycles; /* ticks per ADC sample */
+    uint32_t         isr_samples;   /* ADC samples handled in PROFILE_ADC_ISR */
+    float32_t        isr_load;      /* percent of the sample period in PROFILE_ADC_ISR, on average */
+    float32_t        isr_load_peak; /* the same for the slowest interrupt */
+} Profile_t;
+
+#ifdef PROFILER_ENABLE
+#define PROFILE_BEGIN(region) uint32_t profile_start_##region = profiler_clock_read()
+#define PROFILE_END(region)   profiler_record((region), profiler_clock_read() - profile_start_##region)
+/* as PROFILE_END, for the ADC interrupt that handled samples conversions */
+#define PROFILE_END_ISR(region, samples)                                                                  \
+    profiler_record_isr((region), profiler_clock_read() - profile_start_##region, (samples))
+#else
+#define PROFILE_BEGIN(region)            do { } while (0)
+#define PROFILE_END(region)              do { } while (0)
+#define PROFILE_END_ISR(region, samples) do { } while (0)
+#endif
+
+void      profiler_init(void);
+void      profiler_reset(void);
+void      profiler_record(profile_region_t region, uint32_t cycles);
+void      profiler_record_isr(profile_region_t region, uint32_t cycles, uint32_t samples);
+Profile_t profiler_results(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* PROFILER_H_ */
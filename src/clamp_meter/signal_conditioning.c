@@ -15,6 +15,7 @@
 #include "menu_calibration.h"
 #include "arm_math.h"
 #include "external_periph_ctrl.h"
+#include "DSP_calibration.h"
 
 #define TEST_PAGE_ADDRESS	COEFFS_FLASH_START_ADDR
 
@@ -27,6 +28,16 @@ Calibrator_t Calibrator;
 calibration_data_type_t Cal_data;
 bool flash_test_runing;
 
+/* ADC inputs of the sensors, VIN+ and VIN- */
+static const refsel_type_t sensor_inputs[][2] = {
+	[SHUNT_SENSOR] = { REF_CH2, REF_CH3 },
+	[CLAMP_SENSOR] = { REF_CH0, REF_CH1 },
+	[VOLTAGE_SENSOR] = { REF_CH4, REF_CH5 }
+};
+
+/* the overall_gain each sensor was left at, see switch_sensing_chanel() */
+static uint8_t sensor_overall_gain[VOLTAGE_SENSOR + 1];
+
 void shunt_sensor_set_gain(uint8_t gain)
 {
 	switch (gain) {
@@ -183,8 +194,12 @@ void adc_decrease_gain(void)
 
 void composite_gain_controll(sensor_type_t sensor)
 {
+	/* scanning: the ADC gain is set with the input, see scan_select() */
+	bool set_adc_gain = Analog.mes_mode != MEASUREMENT_MODE_SCAN;
+
 	if (sensor == SHUNT_SENSOR) {
-		if (Analog.adc_gain != shunt_sensor_adc_gain_preset[Analog.overall_gain]) {
+		if (set_adc_gain &&
+		    Analog.adc_gain != shunt_sensor_adc_gain_preset[Analog.overall_gain]) {
 			Analog.adc_gain = shunt_sensor_adc_gain_preset[Analog.overall_gain];
 			MCP3462_set_gain(Analog.adc_gain);
 		}
@@ -195,7 +210,8 @@ void composite_gain_controll(sensor_type_t sensor)
 			shunt_sensor_set_gain(Analog.shunt_sensor_gain);
 		}
 	} else if (sensor == CLAMP_SENSOR) {
-		if (Analog.adc_gain != clamp_sensor_adc_gain_preset[Analog.overall_gain]) {
+		if (set_adc_gain &&
+		    Analog.adc_gain != clamp_sensor_adc_gain_preset[Analog.overall_gain]) {
 			Analog.adc_gain = clamp_sensor_adc_gain_preset[Analog.overall_gain];
 			MCP3462_set_gain(Analog.adc_gain);
 		}
@@ -247,15 +263,187 @@ void decrease_gain(void)
 	composite_gain_controll(Analog.selected_sensor);
 }
 
-void measurement_start(void)
+/* counts at the ADC per unit at the sensor for an overall_gain step, from the calibration */
+static float32_t overall_gain_factor(sensor_type_t sensor, uint8_t gain)
+{
+	if (sensor == SHUNT_SENSOR)
+		return Cal_data.shunt_gain[shunt_sensor_gain_preset[gain]] *
+		       adc_gain_coeffs[shunt_sensor_adc_gain_preset[gain]];
+
+	return Cal_data.clamp_gain[clamp_sensor_gain_preset[gain]] *
+	       adc_gain_coeffs[clamp_sensor_adc_gain_preset[gain]];
+}
+
+static uint8_t max_overall_gain(sensor_type_t sensor)
+{
+	return (sensor == SHUNT_SENSOR) ? SHUNT_SENSOR_MAX_OVERALL_GAIN :
+	       CLAMP_SENSOR_MAX_OVERALL_GAIN;
+}
+
+/*
+ * The highest overall_gain step that puts a block peak of peak counts, seen at
+ * the current step, at AGC_TARGET_LEVEL or below. A clipped peak is a lower
+ * bound, so the step found for it may still be too high for one more move.
+ */
+uint8_t agc_target_gain(uint32_t peak)
+{
+	sensor_type_t sensor = Analog.selected_sensor;
+	float32_t level;
+	uint8_t target = 0;
+	uint8_t gain;
+
+	if ((sensor != SHUNT_SENSOR) && (sensor != CLAMP_SENSOR))
+		return Analog.overall_gain;
+
+	level = peak / overall_gain_factor(sensor, Analog.overall_gain);
+
+	for (gain = 0; gain <= max_overall_gain(sensor); gain++) {
+		if (level * overall_gain_factor(sensor, gain) <= AGC_TARGET_LEVEL)
+			target = gain;
+	}
+
+	return target;
+}
+
+/* straight to an overall_gain step, instead of one increase_gain() at a time */
+void set_overall_gain(uint8_t gain)
+{
+	if (Calibrator.is_calibrating)
+		return;
+
+	if ((Analog.selected_sensor != SHUNT_SENSOR) &&
+	    (Analog.selected_sensor != CLAMP_SENSOR)) {
+		Analog.error_occured = true;
+		return;
+	}
+
+	if (gain > max_overall_gain(Analog.selected_sensor))
+		gain = max_overall_gain(Analog.selected_sensor);
+
+	Analog.overall_gain = gain;
+	composite_gain_controll(Analog.selected_sensor);
+}
+
+/* filtered blocks before the next move: a whole reading at the last one */
+static uint32_t excitation_hold;
+/* the loop was switched off before the DAC took its last move */
+static bool excitation_restore;
+
+/*
+ * a new amplitude in digits, from the next DAC period on; false while the
+ * DAC has yet to start on the last table
+ */
+static bool excitation_set(uint32_t amplitude)
+{
+	if (amplitude == Analog.excitation_amplitude)
+		return true;
+
+	if (!dsp_set_sine_table_digits(amplitude))
+		return false;
+
+	__disable_irq();
+	dsp_scale_readings((float32_t)amplitude / Analog.excitation_amplitude);
+	dsp_restart_readings();
+	__enable_irq();
+
+	Analog.excitation_amplitude = amplitude;
+	excitation_hold = clamp_measurements_result.integrator_len;
+
+	return true;
+}
+
+/*
+ * Main loop, after the filtered blocks (the number of them); off until
+ * the operator turns it on (excitation_control_enable()), as a source that
+ * doesn't follow the generator would be taken down to the minimum. The
+ * readings other sensors left in clamp_measurements_result are scaled with
+ * the move, the windows in progress are restarted; the load is taken as
+ * linear, so the impedances don't change.
+ */
+void excitation_control(uint32_t blocks)
+{
+	sensor_type_t sensor = Analog.selected_sensor;
+	uint32_t peak = Analog.ampl_peak;
+	uint32_t ceiling = Analog.generator_amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+	uint32_t amplitude;
+	bool at_lowest;
+	bool at_highest;
+
+	if (excitation_restore) {
+		excitation_restore = !excitation_set(ceiling);
+		return;
+	}
+
+	if (excitation_hold > blocks) {
+		excitation_hold -= blocks;
+		return;
+	}
+
+	excitation_hold = 0;
+
+	if (!Analog.excitation_control_on || Calibrator.is_calibrating ||
+	    Analog.mes_mode != MEASUREMENT_MODE_MANUAL)
+		return;
+
+	/* between readings, with the AGC settled */
+	if (!clamp_measurements_result.result_is_final || MCP3462_get_gain() != Analog.adc_gain)
+		return;
+
+	if (sensor == VOLTAGE_SENSOR) {
+		at_lowest  = true;
+		at_highest = true;
+	}
+	else if (Analog.AGC_on) {
+		at_lowest  = Analog.overall_gain == 0;
+		at_highest = Analog.overall_gain == max_overall_gain(sensor);
+	}
+	else
+		/* the operator holds the range */
+		return;
+
+	if (peak > AMPLITUDE_TOO_HIGH_LIMIT && at_lowest)
+		amplitude = (uint32_t)((uint64_t)Analog.excitation_amplitude * EXCITATION_TARGET_LEVEL / peak);
+	else if (peak < EXCITATION_RAISE_LEVEL && at_highest)
+		amplitude = (peak > 0) ?
+		            (uint32_t)((uint64_t)Analog.excitation_amplitude * EXCITATION_TARGET_LEVEL / peak) :
+		            ceiling;
+	else
+		return;
+
+	if (amplitude > ceiling)
+		amplitude = ceiling;
+	if (amplitude < EXCITATION_AMPLITUDE_MIN)
+		amplitude = EXCITATION_AMPLITUDE_MIN;
+
+	/* refused, it is taken again after the next filtered block */
+	excitation_set(amplitude);
+}
+
+/*
+ * The operator's switch. Off, the operator's generator_amplitude is back
+ * in the table, once the DAC has started on the last move; on, the loop
+ * starts from wherever the table is.
+ */
+void excitation_control_enable(bool on)
 {
-	const uint32_t adc_int_pin = (1 << ADC_INTERRUPT_PIN);
+	Analog.excitation_control_on = on;
+	excitation_hold = 0;
+	excitation_restore = false;
+
+	if (!on && Analog.generator_is_active)
+		excitation_restore = !excitation_set(Analog.generator_amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF);
+}
 
+void measurement_start(void)
+{
 	hi_voltage_enable();
 	reset_filters();
 	dacc_init();
 	dacc_set_trigger(DACC, DACC_TRGSEL);
 	dsp_calculate_sine_table(Analog.generator_amplitude);
+	Analog.excitation_amplitude = Analog.generator_amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+	excitation_hold = 0;
+	excitation_restore = false;
 	pdc_tx_init(g_dacc_pdc_base, &g_dacc_packet, &g_dacc_next_packet);
 	pdc_enable_transfer(g_dacc_pdc_base, PERIPH_PTCR_TXTEN);
 
@@ -263,7 +451,7 @@ void measurement_start(void)
 	NVIC_ClearPendingIRQ(PIOA_IRQn);
 
 	dacc_enable_interrupt(DACC, DACC_INTERRUPT_MASK);
-	pio_enable_interrupt(PIOA, adc_int_pin);
+	dsp_acquisition_start();
 	MCP3462_enable_clock();
 	delay_ms(100);
 	output_enable();
@@ -272,22 +460,40 @@ void measurement_start(void)
 
 void measurement_stop(void)
 {
-	const uint32_t adc_int_pin = (1 << ADC_INTERRUPT_PIN);
+	dsp_acquisition_stop();
 	output_disable();
 	hi_voltage_disable();
 	MCP3462_disable_clock();
 	dacc_disable_interrupt(DACC, DACC_INTERRUPT_MASK);
 	pdc_disable_transfer(g_dacc_pdc_base, PERIPH_PTCR_TXTDIS);
 	dacc_disable_trigger(DACC);
-	pio_disable_interrupt(PIOA, adc_int_pin);
 	Analog.generator_is_active = false;
 }
 
+/*
+ * Each sensor comes back at the range it was left at: its overall_gain is
+ * kept across a switch and the ADC and front-end gains follow from it. With
+ * the filter banks of the block mixer the first reading after the switch is
+ * then taken from a warm filter history as well. The calibration sets its
+ * own gains after a switch and leaves the remembered ones alone.
+ */
 void switch_sensing_chanel(sensor_type_t switch_to_sensor)
 {
+	/* all sensors are being measured: only the one shown changes */
+	if (Analog.mes_mode == MEASUREMENT_MODE_SCAN) {
+		Analog.selected_sensor = switch_to_sensor;
+		return;
+	}
+
+	if (!Calibrator.is_calibrating) {
+		sensor_overall_gain[Analog.selected_sensor] = Analog.overall_gain;
+		Analog.overall_gain = sensor_overall_gain[switch_to_sensor];
+	}
+
+	MCP3462_set_mux(sensor_inputs[switch_to_sensor][0], sensor_inputs[switch_to_sensor][1]);
+
 	switch (switch_to_sensor) {
 	case VOLTAGE_SENSOR: {
-		MCP3462_set_mux(REF_CH4, REF_CH5);
 		Analog.AGC_on = false;
 
 		if (Analog.adc_gain != GAIN_1) {
@@ -304,26 +510,131 @@ void switch_sensing_chanel(sensor_type_t switch_to_sensor)
 	break;
 
 	case SHUNT_SENSOR:
-		MCP3462_set_mux(REF_CH2, REF_CH3);
 		{
 			Analog.AGC_on = true;
 			clamp_sensor_set_gain(0);
 			Analog.clamp_sensor_gain = 0;
+
+			if (!Calibrator.is_calibrating)
+				composite_gain_controll(SHUNT_SENSOR);
 		}
 		break;
 
 	case CLAMP_SENSOR:
-		MCP3462_set_mux(REF_CH0, REF_CH1);
 		{
 			Analog.AGC_on = true;
 			shunt_sensor_set_gain(0);
 			Analog.shunt_sensor_gain = 0;
+
+			if (!Calibrator.is_calibrating)
+				composite_gain_controll(CLAMP_SENSOR);
 		}
 	}
 
 	Analog.selected_sensor = switch_to_sensor;
 }
 
+sensor_type_t sensor_of_mux(uint8_t mux)
+{
+	sensor_type_t sensor;
+
+	for (sensor = SHUNT_SENSOR; sensor <= VOLTAGE_SENSOR; sensor++) {
+		if ((mux >> 4) == sensor_inputs[sensor][0])
+			return sensor;
+	}
+
+	return VOLTAGE_SENSOR;
+}
+
+/* the ADC gain the readings of a sensor are taken with */
+gain_type_t sensor_adc_gain(sensor_type_t sensor)
+{
+	if (Analog.mes_mode != MEASUREMENT_MODE_SCAN)
+		return Analog.adc_gain;
+
+	if (sensor == SHUNT_SENSOR)
+		return shunt_sensor_adc_gain_preset[Analog.overall_gain];
+	else if (sensor == CLAMP_SENSOR)
+		return clamp_sensor_adc_gain_preset[Analog.overall_gain];
+
+	return GAIN_1;
+}
+
+/* moves the ADC to a sensor; while streaming, at the next resync */
+static void scan_select(sensor_type_t sensor)
+{
+	gain_type_t gain = sensor_adc_gain(sensor);
+
+	if (Analog.adc_gain != gain) {
+		Analog.adc_gain = gain;
+		MCP3462_set_gain(gain);
+	}
+
+	MCP3462_set_mux(sensor_inputs[sensor][0], sensor_inputs[sensor][1]);
+
+	Analog.scan_sensor = sensor;
+	Analog.scan_blocks = 0;
+}
+
+/* acquisition interrupt: a settled block of the sensor has been completed */
+void sensor_scan_block(sensor_type_t sensor)
+{
+	/* blocks still in flight from the previous input don't count */
+	if (sensor != Analog.scan_sensor)
+		return;
+
+	if (++Analog.scan_blocks < SCAN_DWELL_BLOCKS)
+		return;
+
+	if (sensor == VOLTAGE_SENSOR)
+		scan_select(SHUNT_SENSOR);
+	else if (sensor == SHUNT_SENSOR)
+		scan_select(CLAMP_SENSOR);
+	else
+		scan_select(VOLTAGE_SENSOR);
+}
+
+void measurement_set_mode(measurement_mode_type_t mode)
+{
+	if (mode == Analog.mes_mode)
+		return;
+
+	if (mode == MEASUREMENT_MODE_SCAN) {
+		/* needs the filter banks of the block mixer */
+		if (!dsp_scan_start())
+			return;
+
+		Analog.AGC_on = false;
+		Analog.shunt_sensor_gain = shunt_sensor_gain_preset[Analog.overall_gain];
+		Analog.clamp_sensor_gain = clamp_sensor_gain_preset[Analog.overall_gain];
+		shunt_sensor_set_gain(Analog.shunt_sensor_gain);
+		clamp_sensor_set_gain(Analog.clamp_sensor_gain);
+
+		/* the acquisition interrupt moves the input from here on */
+		__disable_irq();
+		Analog.mes_mode = MEASUREMENT_MODE_SCAN;
+		scan_select(Analog.selected_sensor);
+		__enable_irq();
+	} else {
+		Analog.mes_mode = mode;
+		dsp_scan_stop();
+		switch_sensing_chanel(Analog.selected_sensor);
+	}
+}
+
+/* the reading in progress is dropped, the next one is taken with the new profile */
+void measurement_set_profile(Dsp_profile_t profile)
+{
+	if (profile >= DSP_PROFILE_COUNT)
+		return;
+
+	/* the interrupt mixes into the queue, and filters on the sample mixer */
+	__disable_irq();
+	dsp_set_profile(profile);
+	dsp_restart_readings();
+	__enable_irq();
+}
+
 bool store_coeffs_to_flash_struct(void)
 {
 	uint32_t start_addr = COEFFS_FLASH_START_ADDR;
@@ -419,6 +730,8 @@ void recall_coeffs_from_flash_struct(void)
 		Cal_data.v_sens_gain = Reserve_cal_data.v_sens_gain;
 		Cal_data.v_sens_phi = Reserve_cal_data.v_sens_phi;
 	}
+
+	dsp_calibration_changed();
 }
 
 #ifdef __cplusplus
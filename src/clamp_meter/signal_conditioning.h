@@ -15,10 +15,33 @@
 #include "DSP_functions.h"
 #include "menu_calibration.h"
 
+/*
+ * AGC on the peak of each block: outside TOO_LOW..TOO_HIGH the gain moves in
+ * one step to the one that brings the peak to AGC_TARGET_LEVEL, see
+ * agc_target_gain(). The band around the target is the hysteresis. The
+ * blocks a move lands in are not judged: AGC_HOLD_BLOCKS of them, and any
+ * until the ADC gain has been applied.
+ */
 #define AMPLITUDE_TOO_HIGH_LIMIT	3000000UL
 #define AMPLITUDE_TOO_LOW_LIMIT		100000UL
-#define AMPLITUDE_HIGH_COUNTER_LIMIT	50
-#define AMPLITUDE_LOW_COUNTER_LIMIT		500
+#define AGC_TARGET_LEVEL			1500000UL
+#define AGC_HOLD_BLOCKS				2
+
+/*
+ * Excitation control: where the gain ladder has no step left (the voltage
+ * sensor has none), the excitation amplitude moves in its place, between
+ * readings, to bring the peak to EXCITATION_TARGET_LEVEL: down from
+ * AMPLITUDE_TOO_HIGH_LIMIT at the lowest step, up from below
+ * EXCITATION_RAISE_LEVEL at the highest one. It stays within
+ * EXCITATION_AMPLITUDE_MIN and the operator's generator_amplitude. The
+ * amplitude is in DAC digits, not in the operator's steps of
+ * DACC_VOLTS_TO_DIGITS_CONV_COEFF of them: a digit is 0.5 % of the minimum.
+ * It is rounded down, which puts the peak between EXCITATION_RAISE_LEVEL and
+ * EXCITATION_TARGET_LEVEL, inside the band, so the loop doesn't hunt.
+ */
+#define EXCITATION_TARGET_LEVEL		2500000UL
+#define EXCITATION_RAISE_LEVEL		(EXCITATION_TARGET_LEVEL / 2)
+#define EXCITATION_AMPLITUDE_MIN	(5 * DACC_VOLTS_TO_DIGITS_CONV_COEFF)
 
 #define SHUNT_SENSOR_MAX_GAIN	4
 #define CLAMP_SENSOR_MAX_GAIN	4
@@ -35,6 +58,17 @@ COEFFS_FLASH_PAGES_OCCUPIED)
 
 #define CALIBRATION_EXTERNAL_VOLTAGE_STARTVAL	37.15f
 
+/*
+ * MEASUREMENT_MODE_SCAN: the ADC input is moved VOLTAGE -> SHUNT -> CLAMP by
+ * the acquisition interrupt every SCAN_DWELL_BLOCKS blocks, and each sensor
+ * is filtered in its own bank (see dsp_scan_start()). The first
+ * SCAN_SETTLE_BLOCKS blocks after a switch are dropped. The ADC gain is GAIN_1
+ * for the voltage sensor and follows overall_gain for the other two; the
+ * AGC is off.
+ */
+#define SCAN_DWELL_BLOCKS	8
+#define SCAN_SETTLE_BLOCKS	1
+
 
 #define CALIBRATION_DATA_PASSWORD	0xA5
 
@@ -50,7 +84,7 @@ typedef enum {
 
 typedef enum {
 	MEASUREMENT_MODE_MANUAL = 0,
-	MEASUREMENT_MODE_1
+	MEASUREMENT_MODE_SCAN
 } measurement_mode_type_t;
 
 extern bool flash_test_runing;
@@ -62,13 +96,17 @@ typedef struct {
 	bool generator_is_active	: 1;
 	bool ampl_is_too_low		: 1;
 	bool ampl_is_too_high		: 1;
+	bool excitation_control_on	: 1;
 
+	/* the operator's setting, the limit of excitation_control() */
 	uint16_t generator_amplitude;
+	/* in the DAC table, in digits */
+	uint16_t excitation_amplitude;
 
 	sensor_type_t selected_sensor;
 
-	uint16_t ampl_too_low_counter;
-	uint16_t ampl_too_high_counter;
+	/* largest absolute sample of the last block */
+	uint32_t ampl_peak;
 
 	gain_type_t adc_gain;
 	uint8_t shunt_sensor_gain;
@@ -79,6 +117,10 @@ typedef struct {
 	refsel_type_t neg_ch;
 
 	measurement_mode_type_t mes_mode;
+
+	/* scan mode: the sensor the ADC is set to and its blocks so far */
+	sensor_type_t scan_sensor;
+	uint16_t scan_blocks;
 } Analog_t;
 
 extern Analog_t Analog;
@@ -203,7 +245,16 @@ void measurement_start			(void);
 void measurement_stop			(void);
 void increase_gain				(void);
 void decrease_gain				(void);
+void set_overall_gain			(uint8_t gain);
+void excitation_control			(uint32_t blocks);
+void excitation_control_enable	(bool on);
+uint8_t agc_target_gain			(uint32_t peak);
 void switch_sensing_chanel	(sensor_type_t switch_to_sensor);
+void measurement_set_mode		(measurement_mode_type_t mode);
+void measurement_set_profile	(Dsp_profile_t profile);
+void sensor_scan_block			(sensor_type_t sensor);
+sensor_type_t sensor_of_mux		(uint8_t mux);
+gain_type_t sensor_adc_gain		(sensor_type_t sensor);
 bool store_coeffs_to_flash_struct(void);
 void recall_coeffs_from_flash_struct(void);
 
@@ -1,10 +1,29 @@
 set(SOURCES
+    circuit_fit.c
+    circuit_fit.h
     display_data_sender.c
     display_data_sender.h
     DSP_functions.c
+    DSP_calibration.c
+    DSP_calibration.h
+    DSP_cic.c
+    DSP_cic.h
+    DSP_complex.h
+    DSP_correlator.c
+    DSP_correlator.h
     DSP_functions.h
+    DSP_halfband.c
+    DSP_halfband.h
+    DSP_harmonics.c
+    DSP_harmonics.h
+    DSP_q31.c
+    DSP_q31.h
+    DSP_quadrature.c
+    DSP_quadrature.h
+    DSP_queue.h
     external_periph_ctrl.c
     external_periph_ctrl.h
+    fastmath.h
     ILI9486_config.h
     ILI9486_ctrl.c
     ILI9486_fonts.h
@@ -27,8 +46,12 @@ set(SOURCES
     menu_ili9486_kbrd_mngr.c
     menu_ili9486_kbrd_mngr.h
     menu_types_ili9486.h
+    profiler.c
+    profiler.h
     signal_conditioning.c
     signal_conditioning.h
+    sweep.c
+    sweep.h
     system.c
     system.h
     system_init.c
@@ -0,0 +1,167 @@
+#include <string.h>
+
+#include "asf.h"
+#include "sweep.h"
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+Sweep_t Sweep;
+
+/* low to high, PRE 1: 222 Hz ... 3.55 kHz with the 22 point table */
+static const osr_type_t sweep_osr[SWEEP_POINTS] = { OSR_1024, OSR_512, OSR_256, OSR_128, OSR_64 };
+
+static MCP3462_rate_t sweep_rates[SWEEP_POINTS];
+static MCP3462_rate_t nominal_rate;
+
+/* the readings a point is taken from */
+#define SWEEP_SENSORS ((1u << SHUNT_SENSOR) | (1u << CLAMP_SENSOR) | (1u << VOLTAGE_SENSOR))
+
+/* what the sweep came from and goes back to */
+static measurement_mode_type_t saved_mode;
+static Dsp_profile_t           saved_profile;
+
+static float32_t
+rate_frequency(const MCP3462_rate_t *rate)
+{
+    return (float32_t)MCP3462_MCLK_HZ / (4.0f * (float32_t)rate->ratio * SINTABLE_LEN);
+}
+
+static void
+sweep_select(const MCP3462_rate_t *rate, Sweep_state_t state)
+{
+    Sweep.blocks = 0;
+    Sweep.state  = state;
+    MCP3462_set_rate(rate);
+}
+
+static void
+sweep_take_point(Sweep_point_t *point)
+{
+    point->Z_ovrl      = clamp_measurements_result.Z_ovrl;
+    point->Z_ovrl_phi  = clamp_measurements_result.Z_ovrl_phi;
+    point->Z_clamp     = clamp_measurements_result.Z_clamp;
+    point->Z_clamp_phi = clamp_measurements_result.Z_clamp_phi;
+    point->data_lost   = clamp_measurements_result.data_lost;
+    point->final       = Sweep.settled && clamp_measurements_result.final_sensors == SWEEP_SENSORS;
+}
+
+/* false if a rate can't be streamed or the sensors can't be scanned */
+bool
+sweep_start(void)
+{
+    uint8_t step;
+
+    if (Sweep.state != SWEEP_IDLE && Sweep.state != SWEEP_DONE)
+        return false;
+
+    if (!MCP3462_rate_prepare(OSR_256, PRE_0, &nominal_rate))
+        return false;
+
+    for (step = 0; step < SWEEP_POINTS; step++)
+        if (!MCP3462_rate_prepare(sweep_osr[step], PRE_0, &sweep_rates[step]))
+            return false;
+
+    saved_mode    = Analog.mes_mode;
+    saved_profile = clamp_measurements_result.profile;
+
+    measurement_set_mode(MEASUREMENT_MODE_SCAN);
+
+    if (Analog.mes_mode != MEASUREMENT_MODE_SCAN)
+        return false;
+
+    measurement_set_profile(DSP_PROFILE_FAST);
+
+    memset(Sweep.spectrum, 0, sizeof(Sweep.spectrum));
+
+    for (step = 0; step < SWEEP_POINTS; step++) {
+        Sweep.spectrum[step].freq_hz    = rate_frequency(&sweep_rates[step]);
+        Sweep.spectrum[step].calibrated = sweep_rates[step].ratio == nominal_rate.ratio;
+    }
+
+    Sweep.step = 0;
+    sweep_select(&sweep_rates[0], SWEEP_RATE);
+
+    return true;
+}
+
+/* the points taken so far are kept */
+void
+sweep_stop(void)
+{
+    if (sweep_is_running())
+        sweep_select(&nominal_rate, SWEEP_RESTORE);
+}
+
+/* still stepping: not yet on the way back to the nominal rate */
+bool
+sweep_is_running(void)
+{
+    return Sweep.state == SWEEP_RATE || Sweep.state == SWEEP_SETTLING;
+}
+
+/* main loop, after the filtered blocks: the number of them that were not dropped */
+void
+sweep_poll(uint32_t blocks)
+{
+    switch (Sweep.state) {
+    case SWEEP_RATE:
+        if (MCP3462_get_rate() != sweep_rates[Sweep.step].ratio)
+            return;
+
+        /* everything filtered so far was at the previous frequency */
+        __disable_irq();
+        dsp_restart_readings();
+        __enable_irq();
+
+        Sweep.blocks  = 0;
+        Sweep.settled = false;
+        Sweep.state   = SWEEP_SETTLING;
+        break;
+
+    case SWEEP_SETTLING:
+        Sweep.blocks += blocks;
+
+        if (dsp_blocks_since_restart() < SWEEP_SETTLE_BLOCKS)
+            /* restarted, by the step or by a move during it */
+            Sweep.settled = false;
+        else if (!Sweep.settled) {
+            /* the readings so far may be from the transient, or from the previous rate */
+            Sweep.settled                           = true;
+            clamp_measurements_result.final_sensors = 0;
+        }
+
+        if (!(Sweep.settled && clamp_measurements_result.final_sensors == SWEEP_SENSORS) &&
+            Sweep.blocks < SWEEP_STEP_MAX_BLOCKS)
+            return;
+
+        sweep_take_point(&Sweep.spectrum[Sweep.step]);
+
+        if (++Sweep.step < SWEEP_POINTS)
+            sweep_select(&sweep_rates[Sweep.step], SWEEP_RATE);
+        else
+            sweep_select(&nominal_rate, SWEEP_RESTORE);
+        break;
+
+    case SWEEP_RESTORE:
+        if (MCP3462_get_rate() != nominal_rate.ratio)
+            return;
+
+        Sweep.state = SWEEP_DONE;
+
+        /* both restart the readings, at the nominal rate now */
+        measurement_set_profile(saved_profile);
+        measurement_set_mode(saved_mode);
+        break;
+
+    default:
+        break;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
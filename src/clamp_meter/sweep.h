@@ -0,0 +1,83 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+#include "asf.h"
+#include "arm_math.h"
+#include "MCP3462.h"
+
+/*
+ * Impedance spectrum: the excitation is stepped through SWEEP_POINTS
+ * frequencies and Z_ovrl / Z_clamp are taken at each of them. The DAC steps
+ * on data ready, so a step is a new ADC rate (MCP3462_set_rate()): the sine
+ * table stays SINTABLE_LEN points per period and every filter of the
+ * cascade, designed relative to the ADC rate, stays matched. A step only
+ * writes CONFIG1 and restarts the filters; the rates are prepared once by
+ * sweep_start().
+ *
+ * The three sensors are read by MEASUREMENT_MODE_SCAN with DSP_PROFILE_FAST.
+ * A point is taken once the filters have had SWEEP_SETTLE_BLOCKS since the
+ * readings were last restarted (by the step itself, or by a range or
+ * excitation move during it) and each sensor has had a final reading after
+ * that. A point still waiting SWEEP_STEP_MAX_BLOCKS after its rate was
+ * applied is taken as it is and not marked final. The calibration is the one of the nominal frequency (OSR_256):
+ * at the other points the gain and phase of the sensor front ends go into
+ * the impedances uncorrected, and those points are not marked calibrated.
+ *
+ * KEY_LEFT on the measurement page starts a sweep and stops one under way.
+ */
+#define SWEEP_POINTS          5
+/* of all three sensors: about 320 each, against 250 for FAST to settle */
+#define SWEEP_SETTLE_BLOCKS   960
+#define SWEEP_STEP_MAX_BLOCKS (4 * SWEEP_SETTLE_BLOCKS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SWEEP_IDLE = 0,
+    /* waiting for the rate of the step to be applied at a resync */
+    SWEEP_RATE,
+    SWEEP_SETTLING,
+    /* back at the nominal rate, waiting for it to be applied */
+    SWEEP_RESTORE,
+    SWEEP_DONE
+} Sweep_state_t;
+
+typedef struct {
+    float32_t freq_hz;
+
+    float32_t Z_ovrl;
+    float32_t Z_ovrl_phi;
+    float32_t Z_clamp;
+    float32_t Z_clamp_phi;
+
+    /* a block was lost inside the window of the readings */
+    bool data_lost;
+    /* taken from final readings of all three sensors, after the settling time */
+    bool final;
+    /* taken at the frequency the sensors are calibrated at */
+    bool calibrated;
+} Sweep_point_t;
+
+typedef struct {
+    Sweep_state_t state;
+    uint8_t       step;
+    uint32_t      blocks;
+    /* the readings have had SWEEP_SETTLE_BLOCKS since the last restart */
+    bool          settled;
+
+    Sweep_point_t spectrum[SWEEP_POINTS];
+} Sweep_t;
+
+extern Sweep_t Sweep;
+
+bool sweep_start(void);
+void sweep_stop(void);
+bool sweep_is_running(void);
+void sweep_poll(uint32_t blocks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SWEEP_H_ */
@@ -6,6 +6,8 @@
 #include "keyboard.h"
 #include "DSP_functions.h"
 #include "external_periph_ctrl.h"
+#include "profiler.h"
+#include "fastmath.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -134,8 +136,8 @@ buzzer_set_freq(float32_t current)
     else
         clamp_I_i = clamp_measurements_result.I_clamp_I;
 
-    rc_val_f    = 50 + k * (-log2f(current) - offst);
-    rc_lf_val_f = 10000 + 90e3 * (-log2f(clamp_I_i) - 9.95f);
+    rc_val_f    = 50 + k * (-fast_log2f(current) - offst);
+    rc_lf_val_f = 10000 + 90e3 * (-fast_log2f(clamp_I_i) - 9.95f);
 
     if (rc_val_f > BUZZER_FREQ_RC_MAX)
         rc_val_f = BUZZER_FREQ_RC_MAX;
@@ -264,6 +266,7 @@ system_init(void)
     io_init();
     external_periph_ctrl_init();
     system_tick_init();
+    profiler_init();
     keyboard_encoder_init();
     dacc_init();
     spi_init();
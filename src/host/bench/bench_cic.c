@@ -0,0 +1,251 @@
+//
+// The two front ends of the lock-in chain side by side: mixer + biquad1 +
+// firdec1 against the integer mixer + CIC + compensation FIR. Prints the
+// magnitude response around the excitation frequency (offset in cycles per
+// ADC sample, dB relative to DC) and the cost per ADC sample, for whole
+// blocks and for one sample per call as in the ADC interrupt. Cycles are TSC
+// cycles on x86, nanoseconds elsewhere.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "DSP_functions.h"
+#include "DSP_cic.h"
+
+#define BENCH_BLOCKS   20000
+#define BENCH_FULLSCALE 8388607.0
+/* outputs at the decimated rate before the response is measured */
+#define BENCH_SETTLE   400
+#define BENCH_MEASURE  400
+
+#define OUT_LEN (BIQUAD1_BUFFSIZE / FIR_DEC_FACTOR)
+
+typedef struct {
+    arm_biquad_cascade_df2T_instance_f32 biquad_sin;
+    arm_biquad_cascade_df2T_instance_f32 biquad_cos;
+    arm_fir_decimate_instance_f32        firdec_sin;
+    arm_fir_decimate_instance_f32        firdec_cos;
+    float32_t biquad_state_sin[BIQUAD1_NSTAGES * 2];
+    float32_t biquad_state_cos[BIQUAD1_NSTAGES * 2];
+    float32_t firdec_state_sin[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    float32_t firdec_state_cos[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    float32_t mixer_sin_ref[MIXER_REF_LEN];
+    float32_t mixer_cos_ref[MIXER_REF_LEN];
+} biquad_front_t;
+
+typedef struct {
+    Cic_t                cic;
+    arm_fir_instance_f32 comp_sin;
+    arm_fir_instance_f32 comp_cos;
+    float32_t            comp_state_sin[OUT_LEN + CIC_COMP_NCOEFFS - 1];
+    float32_t            comp_state_cos[OUT_LEN + CIC_COMP_NCOEFFS - 1];
+} cic_front_t;
+
+static biquad_front_t biquad_front;
+static cic_front_t    cic_front;
+
+static uint64_t
+bench_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void
+biquad_front_init(biquad_front_t *f)
+{
+    uint32_t idx;
+
+    arm_biquad_cascade_df2T_init_f32(&f->biquad_sin, BIQUAD1_NSTAGES, biquad1_coeffs, f->biquad_state_sin);
+    arm_biquad_cascade_df2T_init_f32(&f->biquad_cos, BIQUAD1_NSTAGES, biquad1_coeffs, f->biquad_state_cos);
+    arm_fir_decimate_init_f32(&f->firdec_sin, FIR1_DEC_NCOEFFS, FIR_DEC_FACTOR, fir1_3kHz_coeffs,
+                              f->firdec_state_sin, FIR1_DEC_BLOCKSIZE);
+    arm_fir_decimate_init_f32(&f->firdec_cos, FIR1_DEC_NCOEFFS, FIR_DEC_FACTOR, fir1_3kHz_coeffs,
+                              f->firdec_state_cos, FIR1_DEC_BLOCKSIZE);
+
+    for (idx = 0; idx < MIXER_REF_LEN; idx++) {
+        f->mixer_sin_ref[idx] = sin_table[idx % SINTABLE_LEN];
+        f->mixer_cos_ref[idx] = cos_table[idx % SINTABLE_LEN];
+    }
+}
+
+/* one block, as do_filter() does it with DSP_BLOCK_MIXER */
+static void
+biquad_front_block(biquad_front_t *f, const int32_t *raw, uint32_t phase, float32_t *sin_out, float32_t *cos_out)
+{
+    float32_t raw_f[BIQUAD1_BUFFSIZE];
+    float32_t sin_buff[BIQUAD1_BUFFSIZE];
+    float32_t cos_buff[BIQUAD1_BUFFSIZE];
+    uint32_t  idx;
+
+    for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++)
+        raw_f[idx] = (float32_t)raw[idx];
+
+    arm_mult_f32(raw_f, &f->mixer_sin_ref[phase], sin_buff, BIQUAD1_BUFFSIZE);
+    arm_mult_f32(raw_f, &f->mixer_cos_ref[phase], cos_buff, BIQUAD1_BUFFSIZE);
+    arm_biquad_cascade_df2T_f32(&f->biquad_sin, sin_buff, sin_buff, BIQUAD1_BUFFSIZE);
+    arm_biquad_cascade_df2T_f32(&f->biquad_cos, cos_buff, cos_buff, BIQUAD1_BUFFSIZE);
+    arm_fir_decimate_f32(&f->firdec_sin, sin_buff, sin_out, FIR1_DEC_BLOCKSIZE);
+    arm_fir_decimate_f32(&f->firdec_cos, cos_buff, cos_out, FIR1_DEC_BLOCKSIZE);
+}
+
+static void
+cic_front_init(cic_front_t *f)
+{
+    dsp_cic_reset(&f->cic);
+    arm_fir_init_f32(&f->comp_sin, CIC_COMP_NCOEFFS, cic_comp_coeffs, f->comp_state_sin, OUT_LEN);
+    arm_fir_init_f32(&f->comp_cos, CIC_COMP_NCOEFFS, cic_comp_coeffs, f->comp_state_cos, OUT_LEN);
+}
+
+static void
+cic_front_block(cic_front_t *f, const int32_t *raw, uint32_t phase, float32_t *sin_out, float32_t *cos_out)
+{
+    float32_t sin_buff[OUT_LEN];
+    float32_t cos_buff[OUT_LEN];
+
+    dsp_cic_process(&f->cic, raw, phase, BIQUAD1_BUFFSIZE, sin_buff, cos_buff);
+    arm_fir_f32(&f->comp_sin, sin_buff, sin_out, OUT_LEN);
+    arm_fir_f32(&f->comp_cos, cos_buff, cos_out, OUT_LEN);
+}
+
+static void
+make_block(int32_t *raw, uint32_t start, double offset)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++)
+        raw[idx] = (int32_t)lround(0.4 * BENCH_FULLSCALE *
+                                   sin(2.0 * M_PI * (1.0 / SINTABLE_LEN + offset) * (start + idx) + 0.3));
+}
+
+/* rms magnitude of the demodulated vector in dB relative to the input half amplitude */
+static void
+response(double offset, double *biquad_db, double *cic_db)
+{
+    int32_t   raw[BIQUAD1_BUFFSIZE];
+    float32_t sin_out[OUT_LEN];
+    float32_t cos_out[OUT_LEN];
+    double    biquad_sq = 0;
+    double    cic_sq    = 0;
+    double    half      = 0.2 * BENCH_FULLSCALE;
+    uint32_t  block;
+    uint32_t  idx;
+
+    biquad_front_init(&biquad_front);
+    cic_front_init(&cic_front);
+
+    for (block = 0; block < (BENCH_SETTLE + BENCH_MEASURE) / OUT_LEN; block++) {
+        uint32_t start = block * BIQUAD1_BUFFSIZE;
+
+        make_block(raw, start, offset);
+
+        biquad_front_block(&biquad_front, raw, start % SINTABLE_LEN, sin_out, cos_out);
+        if (block >= BENCH_SETTLE / OUT_LEN)
+            for (idx = 0; idx < OUT_LEN; idx++)
+                biquad_sq += (double)sin_out[idx] * sin_out[idx] + (double)cos_out[idx] * cos_out[idx];
+
+        cic_front_block(&cic_front, raw, start % SINTABLE_LEN, sin_out, cos_out);
+        if (block >= BENCH_SETTLE / OUT_LEN)
+            for (idx = 0; idx < OUT_LEN; idx++)
+                cic_sq += (double)sin_out[idx] * sin_out[idx] + (double)cos_out[idx] * cos_out[idx];
+    }
+
+    *biquad_db = 10.0 * log10(biquad_sq / BENCH_MEASURE / (half * half) + 1e-30);
+    *cic_db    = 10.0 * log10(cic_sq / BENCH_MEASURE / (half * half) + 1e-30);
+}
+
+int
+main(void)
+{
+    static int32_t raw[SINTABLE_LEN * BIQUAD1_BUFFSIZE];
+    double         offsets[] = { 0, 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.03, 0.05, 0.1 };
+    float32_t      sin_out[OUT_LEN];
+    float32_t      cos_out[OUT_LEN];
+    uint64_t       biquad_cycles = 0;
+    uint64_t       cic_cycles    = 0;
+    uint64_t       t0;
+    uint32_t       block;
+    uint32_t       idx;
+
+    dsp_cic_init();
+
+    printf("offset     biquad1+firdec1     cic+comp   [dB]\n");
+
+    for (idx = 0; idx < sizeof(offsets) / sizeof(offsets[0]); idx++) {
+        double biquad_db;
+        double cic_db;
+
+        response(offsets[idx], &biquad_db, &cic_db);
+        printf("%7.4f %16.2f %12.2f\n", offsets[idx], biquad_db, cic_db);
+    }
+
+    /* SINTABLE_LEN blocks hold a whole number of periods, so they can be replayed */
+    for (block = 0; block < SINTABLE_LEN; block++)
+        make_block(&raw[block * BIQUAD1_BUFFSIZE], block * BIQUAD1_BUFFSIZE, 0);
+
+    biquad_front_init(&biquad_front);
+    cic_front_init(&cic_front);
+
+    for (block = 0; block < BENCH_BLOCKS; block++) {
+        const int32_t *samples = &raw[(block % SINTABLE_LEN) * BIQUAD1_BUFFSIZE];
+        uint32_t       phase   = (block * BIQUAD1_BUFFSIZE) % SINTABLE_LEN;
+
+        t0 = bench_now();
+        biquad_front_block(&biquad_front, samples, phase, sin_out, cos_out);
+        biquad_cycles += bench_now() - t0;
+
+        t0 = bench_now();
+        cic_front_block(&cic_front, samples, phase, sin_out, cos_out);
+        cic_cycles += bench_now() - t0;
+    }
+
+    printf("block:      biquad1+firdec1 %8.2f, cic+comp %8.2f per sample\n",
+           (double)biquad_cycles / (BENCH_BLOCKS * BIQUAD1_BUFFSIZE),
+           (double)cic_cycles / (BENCH_BLOCKS * BIQUAD1_BUFFSIZE));
+
+    /* one sample per call, the interrupt side of DSP_SAMPLE_MIXER */
+    biquad_front_init(&biquad_front);
+    cic_front_init(&cic_front);
+    biquad_cycles = 0;
+    cic_cycles    = 0;
+
+    for (block = 0; block < BENCH_BLOCKS; block++) {
+        const int32_t *samples = &raw[(block % SINTABLE_LEN) * BIQUAD1_BUFFSIZE];
+        uint32_t       phase   = (block * BIQUAD1_BUFFSIZE) % SINTABLE_LEN;
+        float32_t      sin_buff[BIQUAD1_BUFFSIZE];
+        float32_t      cos_buff[BIQUAD1_BUFFSIZE];
+
+        t0 = bench_now();
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++) {
+            float32_t sin_prod = sin_table[(phase + idx) % SINTABLE_LEN] * samples[idx];
+            float32_t cos_prod = cos_table[(phase + idx) % SINTABLE_LEN] * samples[idx];
+
+            arm_biquad_cascade_df2T_f32(&biquad_front.biquad_sin, &sin_prod, &sin_buff[idx], 1);
+            arm_biquad_cascade_df2T_f32(&biquad_front.biquad_cos, &cos_prod, &cos_buff[idx], 1);
+        }
+        biquad_cycles += bench_now() - t0;
+
+        t0 = bench_now();
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++)
+            dsp_cic_process(&cic_front.cic, &samples[idx], (phase + idx) % SINTABLE_LEN, 1,
+                            &sin_buff[idx / FIR_DEC_FACTOR], &cos_buff[idx / FIR_DEC_FACTOR]);
+        cic_cycles += bench_now() - t0;
+    }
+
+    printf("per sample: biquad1         %8.2f, cic      %8.2f per sample\n",
+           (double)biquad_cycles / (BENCH_BLOCKS * BIQUAD1_BUFFSIZE),
+           (double)cic_cycles / (BENCH_BLOCKS * BIQUAD1_BUFFSIZE));
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+//
+// Calls per second of the fastmath.h approximations next to the libm calls
+// they replace, on inputs spread over the range the firmware feeds them.
+// Host numbers; on the Cortex-M4 the gap is wider, libm there is soft
+// double for acos/asin and log2.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "fastmath.h"
+
+#define BENCH_LEN    4096
+#define BENCH_ROUNDS 2000
+
+/* volatile, so that the calls are neither hoisted out of the rounds nor vectorized */
+static volatile float32_t bench_x[BENCH_LEN];
+static volatile float32_t bench_y[BENCH_LEN];
+static volatile float32_t bench_sink;
+
+static double
+bench_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define BENCH(name, expr)                                                                           \
+    do {                                                                                            \
+        double    t0  = bench_seconds();                                                            \
+        float32_t acc = 0;                                                                          \
+        uint32_t  round;                                                                            \
+        uint32_t  idx;                                                                              \
+                                                                                                    \
+        for (round = 0; round < BENCH_ROUNDS; round++)                                              \
+            for (idx = 0; idx < BENCH_LEN; idx++) {                                                 \
+                float32_t x = bench_x[idx];                                                         \
+                float32_t y = bench_y[idx];                                                         \
+                (void)y;                                                                            \
+                acc += (expr);                                                                      \
+            }                                                                                       \
+                                                                                                    \
+        bench_sink = acc;                                                                           \
+        printf("%-22s %8.1f Mcalls/s\n", name,                                                      \
+               (double)BENCH_ROUNDS * BENCH_LEN / (bench_seconds() - t0) * 1e-6);                   \
+    } while (0)
+
+static float32_t
+sincos_sum(float32_t x)
+{
+    float32_t sine;
+    float32_t cosine;
+
+    fast_sincosf(x, &sine, &cosine);
+
+    return sine + cosine;
+}
+
+int
+main(void)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < BENCH_LEN; idx++) {
+        float32_t theta = 2.0f * PI * idx / BENCH_LEN;
+
+        bench_x[idx] = 3.0f * cosf(theta) + 1e-3f;
+        bench_y[idx] = 3.0f * sinf(theta);
+    }
+
+    BENCH("atan2f", atan2f(y, x));
+    BENCH("fast_atan2f", fast_atan2f(y, x));
+    BENCH("hypotf", hypotf(x, y));
+    BENCH("fast_hypotf", fast_hypotf(x, y));
+    BENCH("sinf + cosf", sinf(x) + cosf(x));
+    BENCH("fast_sincosf", sincos_sum(x));
+    BENCH("log2f", log2f(x * x + 1e-6f));
+    BENCH("fast_log2f", fast_log2f(x * x + 1e-6f));
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+//
+// Cost of the lock-in front end per ADC sample, split into the part that runs
+// in the acquisition interrupt (adc_block_handler) and the part that runs in
+// the main loop (dsp_integrating_filter -> do_filter). Reported in TSC cycles
+// on x86, nanoseconds elsewhere.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#define BENCH_BLOCKS    20000
+#define BENCH_WARMUP    100
+
+static int32_t bench_block[SINTABLE_LEN * MCP3462_STREAM_BLOCKLEN];
+
+static uint64_t
+bench_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+int
+main(void)
+{
+    uint64_t isr_cycles    = 0;
+    uint64_t filter_cycles = 0;
+    uint64_t t0;
+    uint32_t block;
+    uint32_t idx;
+
+    /* SINTABLE_LEN blocks hold a whole number of periods, so they can be replayed */
+    for (idx = 0; idx < sizeof(bench_block) / sizeof(bench_block[0]); idx++)
+        bench_block[idx] = (int32_t)(0.1 * MCP3462_MODEL_FULLSCALE * sin(2.0 * M_PI * idx / SINTABLE_LEN + 0.5));
+
+    hal_host_reset();
+    dsp_init();
+    reset_filters();
+
+    for (block = 0; block < BENCH_WARMUP + BENCH_BLOCKS; block++) {
+        const int32_t *samples = &bench_block[(block % SINTABLE_LEN) * MCP3462_STREAM_BLOCKLEN];
+
+        t0 = bench_now();
+        adc_block_handler(samples, MCP3462_STREAM_BLOCKLEN);
+        if (block >= BENCH_WARMUP)
+            isr_cycles += bench_now() - t0;
+
+        t0 = bench_now();
+        dsp_integrating_filter();
+        if (block >= BENCH_WARMUP)
+            filter_cycles += bench_now() - t0;
+    }
+
+#if defined(DSP_SAMPLE_MIXER) && defined(DSP_CIC)
+    printf("mixer: per sample, CIC (DSP_SAMPLE_MIXER, DSP_CIC)\n");
+#elif defined(DSP_SAMPLE_MIXER)
+    printf("mixer: per sample (DSP_SAMPLE_MIXER)\n");
+#elif defined(DSP_Q31)
+    printf("mixer: block, q31 chain (DSP_Q31)\n");
+#elif defined(DSP_CORRELATOR)
+    printf("mixer: whole-period correlator (DSP_CORRELATOR)\n");
+#elif defined(DSP_CIC)
+    printf("mixer: block, CIC (DSP_CIC)\n");
+#elif defined(DSP_HALFBAND)
+    printf("mixer: block, halfband chain (DSP_HALFBAND)\n");
+#elif defined(DSP_QUADRATURE)
+    printf("mixer: block, 4 samples per period (DSP_QUADRATURE)\n");
+#else
+    printf("mixer: block\n");
+#endif
+    printf("isr    %8.2f per sample\n", (double)isr_cycles / (BENCH_BLOCKS * MCP3462_STREAM_BLOCKLEN));
+    printf("filter %8.2f per sample\n", (double)filter_cycles / (BENCH_BLOCKS * MCP3462_STREAM_BLOCKLEN));
+    printf("total  %8.2f per sample\n",
+           (double)(isr_cycles + filter_cycles) / (BENCH_BLOCKS * MCP3462_STREAM_BLOCKLEN));
+    printf("V_ovrl %g, degree %g\n", clamp_measurements_result.V_ovrl, clamp_measurements_result.degree);
+
+    return 0;
+}
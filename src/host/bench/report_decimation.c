@@ -0,0 +1,305 @@
+//
+// The two decimation chains between the mixer and the integrator side by
+// side: biquad1 -> firdec1 -> biquad2 -> firdec2 -> biquad3 (default) against
+// halfband -> halfband -> poly -> poly -> biquad3 (DSP_HALFBAND). Prints for
+// one channel
+//  - the magnitude response at the frequencies the mixer puts the excitation
+//    and its harmonics on (m / SINTABLE_LEN cycles per ADC sample), with and
+//    without biquad3,
+//  - the worst rejection of what folds onto the band of biquad3 (within
+//    REPORT_BAND of a multiple of the output rate),
+//  - group delay, settling time of a step to within REPORT_SETTLE_TOL of its
+//    final value, and the multiplies per output.
+// The responses come from the coefficients, the settling from running the
+// kernels the firmware uses.
+//
+
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "DSP_functions.h"
+#include "DSP_halfband.h"
+
+#define CHAIN_DECIMATION (BIQUAD1_BUFFSIZE)
+/* protected band around DC, in cycles per output: ~6x the -3 dB point of biquad3 */
+#define REPORT_BAND       0.01
+#define REPORT_SETTLE_TOL 1e-3
+#define REPORT_OUTPUTS    6000
+
+typedef enum { STAGE_FIR, STAGE_BIQUAD } stage_kind_t;
+
+typedef struct {
+    const char     *name;
+    stage_kind_t    kind;
+    const float32_t *coeffs;
+    uint32_t        len;    /* taps, or sections */
+    uint32_t        factor; /* decimation after the stage */
+    uint32_t        macs;   /* multiplies per input (biquad) or per output (FIR) */
+} stage_t;
+
+static const stage_t old_chain[] = {
+    { "biquad1", STAGE_BIQUAD, biquad1_coeffs, BIQUAD1_NSTAGES, 1, 5 * BIQUAD1_NSTAGES },
+    { "firdec1", STAGE_FIR, fir1_3kHz_coeffs, FIR1_DEC_NCOEFFS, FIR_DEC_FACTOR, FIR1_DEC_NCOEFFS },
+    { "biquad2", STAGE_BIQUAD, biquad2_coeffs, BIQUAD2_NSTAGES, 1, 5 * BIQUAD2_NSTAGES },
+    { "firdec2", STAGE_FIR, fir2_300Hz_coeffs, FIR2_DEC_NCOEFFS, FIR_DEC_FACTOR, FIR2_DEC_NCOEFFS },
+    { "biquad3", STAGE_BIQUAD, biquad3_coeffs, BIQUAD3_NSTAGES, 1, 5 * BIQUAD3_NSTAGES },
+};
+
+static const stage_t new_chain[] = {
+    /* zero taps skipped and symmetry folded, see dsp_halfband_decimate() */
+    { "halfband1", STAGE_FIR, halfband_coeffs, HALFBAND_NCOEFFS, HALFBAND_FACTOR, 3 },
+    { "halfband2", STAGE_FIR, halfband_coeffs, HALFBAND_NCOEFFS, HALFBAND_FACTOR, 3 },
+    { "poly1", STAGE_FIR, poly_dec_coeffs, POLY_DEC_NCOEFFS, POLY_DEC_FACTOR, POLY_DEC_NCOEFFS },
+    { "poly2", STAGE_FIR, poly_dec_coeffs, POLY_DEC_NCOEFFS, POLY_DEC_FACTOR, POLY_DEC_NCOEFFS },
+    { "biquad3", STAGE_BIQUAD, biquad3_coeffs, BIQUAD3_NSTAGES, 1, 5 * BIQUAD3_NSTAGES },
+};
+
+#define OLD_STAGES (sizeof(old_chain) / sizeof(old_chain[0]))
+#define NEW_STAGES (sizeof(new_chain) / sizeof(new_chain[0]))
+
+/* f in cycles per sample at the input of the stage */
+static double complex
+stage_response(const stage_t *stage, double f)
+{
+    double complex z1 = cexp(-2.0 * M_PI * J * f);
+    double complex h  = 1;
+    uint32_t       k;
+
+    if (stage->kind == STAGE_FIR) {
+        h = 0;
+        for (k = 0; k < stage->len; k++)
+            h += stage->coeffs[k] * cpow(z1, k);
+        return h;
+    }
+
+    /* CMSIS layout: b0 b1 b2 a1 a2, with the feedback signs flipped */
+    for (k = 0; k < stage->len; k++) {
+        const float32_t *c = &stage->coeffs[5 * k];
+
+        h *= (c[0] + c[1] * z1 + c[2] * z1 * z1) / (1.0 - c[3] * z1 - c[4] * z1 * z1);
+    }
+
+    return h;
+}
+
+/* f in cycles per ADC sample; stages up to (not including) last */
+static double complex
+chain_response(const stage_t *chain, uint32_t stages, double f)
+{
+    double complex h    = 1;
+    uint32_t       rate = 1;
+    uint32_t       idx;
+
+    for (idx = 0; idx < stages; idx++) {
+        h *= stage_response(&chain[idx], f * rate);
+        rate *= chain[idx].factor;
+    }
+
+    return h;
+}
+
+static double
+to_db(double complex h)
+{
+    return 20.0 * log10(cabs(h) + 1e-300);
+}
+
+/* in ADC samples, at DC */
+static double
+group_delay(const stage_t *chain, uint32_t stages)
+{
+    double df = 1e-7;
+
+    return -carg(chain_response(chain, stages, df)) / (2.0 * M_PI * df);
+}
+
+static double
+worst_alias(const stage_t *chain, uint32_t stages)
+{
+    double   worst = -1e9;
+    double   band  = REPORT_BAND / CHAIN_DECIMATION;
+    uint32_t k;
+    int      step;
+
+    for (k = 1; k <= CHAIN_DECIMATION / 2; k++) {
+        for (step = -10; step <= 10; step++) {
+            double f  = (double)k / CHAIN_DECIMATION + step * band / 10;
+            double db = to_db(chain_response(chain, stages, f));
+
+            if (f <= 0.5 && db > worst)
+                worst = db;
+        }
+    }
+
+    return worst;
+}
+
+static uint32_t
+macs_per_output(const stage_t *chain, uint32_t stages)
+{
+    uint32_t macs = 0;
+    uint32_t rate = CHAIN_DECIMATION;
+    uint32_t idx;
+
+    for (idx = 0; idx < stages; idx++) {
+        /* rate: stage inputs per chain output */
+        if (chain[idx].kind == STAGE_BIQUAD)
+            macs += chain[idx].macs * rate;
+        rate /= chain[idx].factor;
+        if (chain[idx].kind == STAGE_FIR)
+            macs += chain[idx].macs * rate;
+    }
+
+    return macs;
+}
+
+static float32_t step_out[REPORT_OUTPUTS];
+
+/* outputs until the step response stays within REPORT_SETTLE_TOL of the last one */
+static uint32_t
+settling(void)
+{
+    float32_t final = step_out[REPORT_OUTPUTS - 1];
+    uint32_t  n     = REPORT_OUTPUTS;
+
+    while (n > 0 && fabsf(step_out[n - 1] - final) <= REPORT_SETTLE_TOL * fabsf(final))
+        n--;
+
+    return n;
+}
+
+/* unit step through the chain, with the firmware kernels */
+static uint32_t
+settle_old(bool with_biquad3)
+{
+    static float32_t b1_state[BIQUAD1_NSTAGES * 2];
+    static float32_t b2_state[BIQUAD2_NSTAGES * 2];
+    static float32_t b3_state[BIQUAD3_NSTAGES * 2];
+    static float32_t f1_state[FIR1_DEC_BLOCKSIZE + FIR1_DEC_NCOEFFS - 1];
+    static float32_t f2_state[FIR2_DEC_BLOCKSIZE + FIR2_DEC_NCOEFFS - 1];
+
+    arm_biquad_cascade_df2T_instance_f32 b1, b2, b3;
+    arm_fir_decimate_instance_f32        f1, f2;
+    float32_t                            buff[BIQUAD1_BUFFSIZE];
+    float32_t                            fir1_out[FIR2_DEC_BLOCKSIZE];
+    float32_t                            out;
+    uint32_t                             n;
+    uint32_t                             idx;
+
+    memset(b1_state, 0, sizeof(b1_state));
+    memset(b2_state, 0, sizeof(b2_state));
+    memset(b3_state, 0, sizeof(b3_state));
+    arm_biquad_cascade_df2T_init_f32(&b1, BIQUAD1_NSTAGES, biquad1_coeffs, b1_state);
+    arm_biquad_cascade_df2T_init_f32(&b2, BIQUAD2_NSTAGES, biquad2_coeffs, b2_state);
+    arm_biquad_cascade_df2T_init_f32(&b3, BIQUAD3_NSTAGES, biquad3_coeffs, b3_state);
+    arm_fir_decimate_init_f32(&f1, FIR1_DEC_NCOEFFS, FIR_DEC_FACTOR, fir1_3kHz_coeffs, f1_state, FIR1_DEC_BLOCKSIZE);
+    arm_fir_decimate_init_f32(&f2, FIR2_DEC_NCOEFFS, FIR_DEC_FACTOR, fir2_300Hz_coeffs, f2_state, FIR2_DEC_BLOCKSIZE);
+
+    for (n = 0; n < REPORT_OUTPUTS; n++) {
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++)
+            buff[idx] = 1.0f;
+
+        arm_biquad_cascade_df2T_f32(&b1, buff, buff, BIQUAD1_BUFFSIZE);
+        arm_fir_decimate_f32(&f1, buff, fir1_out, FIR1_DEC_BLOCKSIZE);
+        arm_biquad_cascade_df2T_f32(&b2, fir1_out, fir1_out, BIQUAD2_BUFFSIZE);
+        arm_fir_decimate_f32(&f2, fir1_out, &out, FIR2_DEC_BLOCKSIZE);
+        if (with_biquad3)
+            arm_biquad_cascade_df2T_f32(&b3, &out, &out, BIQUAD3_BUFFSIZE);
+
+        step_out[n] = out;
+    }
+
+    return settling();
+}
+
+static uint32_t
+settle_new(bool with_biquad3)
+{
+    static float32_t p1_state[POLY1_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+    static float32_t p2_state[POLY2_DEC_BLOCKSIZE + POLY_DEC_NCOEFFS - 1];
+    static float32_t b3_state[BIQUAD3_NSTAGES * 2];
+
+    arm_biquad_cascade_df2T_instance_f32 b3;
+    arm_fir_decimate_instance_f32        p1, p2;
+    Halfband_t                           hb1, hb2;
+    float32_t                            buff[HALFBAND1_BLOCKSIZE];
+    float32_t                            hb1_out[HALFBAND2_BLOCKSIZE];
+    float32_t                            hb2_out[POLY1_DEC_BLOCKSIZE];
+    float32_t                            p1_out[POLY2_DEC_BLOCKSIZE];
+    float32_t                            out;
+    uint32_t                             n;
+    uint32_t                             idx;
+
+    memset(b3_state, 0, sizeof(b3_state));
+    dsp_halfband_reset(&hb1);
+    dsp_halfband_reset(&hb2);
+    arm_fir_decimate_init_f32(&p1, POLY_DEC_NCOEFFS, POLY_DEC_FACTOR, poly_dec_coeffs, p1_state, POLY1_DEC_BLOCKSIZE);
+    arm_fir_decimate_init_f32(&p2, POLY_DEC_NCOEFFS, POLY_DEC_FACTOR, poly_dec_coeffs, p2_state, POLY2_DEC_BLOCKSIZE);
+    arm_biquad_cascade_df2T_init_f32(&b3, BIQUAD3_NSTAGES, biquad3_coeffs, b3_state);
+
+    for (n = 0; n < REPORT_OUTPUTS; n++) {
+        for (idx = 0; idx < HALFBAND1_BLOCKSIZE; idx++)
+            buff[idx] = 1.0f;
+
+        dsp_halfband_decimate(&hb1, buff, hb1_out, HALFBAND1_BLOCKSIZE);
+        dsp_halfband_decimate(&hb2, hb1_out, hb2_out, HALFBAND2_BLOCKSIZE);
+        arm_fir_decimate_f32(&p1, hb2_out, p1_out, POLY1_DEC_BLOCKSIZE);
+        arm_fir_decimate_f32(&p2, p1_out, &out, POLY2_DEC_BLOCKSIZE);
+        if (with_biquad3)
+            arm_biquad_cascade_df2T_f32(&b3, &out, &out, BIQUAD3_BUFFSIZE);
+
+        step_out[n] = out;
+    }
+
+    return settling();
+}
+
+int
+main(void)
+{
+    uint32_t m;
+
+    printf("magnitude at m / %d cycles per ADC sample [dB]\n", SINTABLE_LEN);
+    printf(" m   default  halfband   | with biquad3: default  halfband\n");
+
+    for (m = 0; m <= SINTABLE_LEN / 2; m++) {
+        double f = (double)m / SINTABLE_LEN;
+
+        printf("%2u %9.1f %9.1f   | %20.1f %9.1f\n",
+               m,
+               to_db(chain_response(old_chain, OLD_STAGES - 1, f)),
+               to_db(chain_response(new_chain, NEW_STAGES - 1, f)),
+               to_db(chain_response(old_chain, OLD_STAGES, f)),
+               to_db(chain_response(new_chain, NEW_STAGES, f)));
+    }
+
+    printf("\n                              default  halfband\n");
+    printf("worst alias onto +-%.2f fs_out  %8.1f  %8.1f dB (without biquad3)\n",
+           REPORT_BAND,
+           worst_alias(old_chain, OLD_STAGES - 1),
+           worst_alias(new_chain, NEW_STAGES - 1));
+    printf("droop at %.2f fs_out            %8.4f  %8.4f dB (without biquad3)\n",
+           REPORT_BAND,
+           to_db(chain_response(old_chain, OLD_STAGES - 1, REPORT_BAND / CHAIN_DECIMATION)),
+           to_db(chain_response(new_chain, NEW_STAGES - 1, REPORT_BAND / CHAIN_DECIMATION)));
+    printf("group delay                   %8.1f  %8.1f ADC samples (without biquad3)\n",
+           group_delay(old_chain, OLD_STAGES - 1),
+           group_delay(new_chain, NEW_STAGES - 1));
+    printf("group delay                   %8.1f  %8.1f ADC samples\n",
+           group_delay(old_chain, OLD_STAGES),
+           group_delay(new_chain, NEW_STAGES));
+    printf("settling to %g               %8u  %8u outputs (without biquad3)\n",
+           REPORT_SETTLE_TOL, settle_old(false), settle_new(false));
+    printf("settling to %g               %8u  %8u outputs\n",
+           REPORT_SETTLE_TOL, settle_old(true), settle_new(true));
+    printf("multiplies per output         %8u  %8u per channel\n",
+           macs_per_output(old_chain, OLD_STAGES),
+           macs_per_output(new_chain, NEW_STAGES));
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+//
+// Reference C implementations of the CMSIS-DSP kernels declared in the host
+// arm_math.h. They follow the CMSIS algorithms sample for sample (state
+// layout, coefficient order and sign convention), so filter state written by
+// the firmware means the same thing here as on the target.
+//
+
+#include "arm_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void
+arm_biquad_cascade_df2T_init_f32(arm_biquad_cascade_df2T_instance_f32 *S,
+                                 uint8_t                               numStages,
+                                 float32_t                            *pCoeffs,
+                                 float32_t                            *pState)
+{
+    S->numStages = numStages;
+    S->pCoeffs   = pCoeffs;
+    S->pState    = pState;
+
+    memset(pState, 0, 2u * numStages * sizeof(float32_t));
+}
+
+void
+arm_biquad_cascade_df2T_f32(const arm_biquad_cascade_df2T_instance_f32 *S,
+                            float32_t                                  *pSrc,
+                            float32_t                                  *pDst,
+                            uint32_t                                    blockSize)
+{
+    float32_t *pIn     = pSrc;
+    float32_t *pState  = S->pState;
+    float32_t *pCoeffs = S->pCoeffs;
+    uint32_t   stage   = S->numStages;
+
+    do {
+        float32_t b0 = pCoeffs[0];
+        float32_t b1 = pCoeffs[1];
+        float32_t b2 = pCoeffs[2];
+        float32_t a1 = pCoeffs[3];
+        float32_t a2 = pCoeffs[4];
+        float32_t d1 = pState[0];
+        float32_t d2 = pState[1];
+        uint32_t  n;
+
+        for (n = 0; n < blockSize; n++) {
+            float32_t x = pIn[n];
+            float32_t y = b0 * x + d1;
+
+            d1      = b1 * x + a1 * y + d2;
+            d2      = b2 * x + a2 * y;
+            pDst[n] = y;
+        }
+
+        pState[0] = d1;
+        pState[1] = d2;
+        pState += 2;
+        pCoeffs += 5;
+
+        /* the next stage works in place on this stage's output */
+        pIn = pDst;
+    } while (--stage);
+}
+
+void
+arm_fir_init_f32(arm_fir_instance_f32 *S,
+                 uint16_t              numTaps,
+                 float32_t            *pCoeffs,
+                 float32_t            *pState,
+                 uint32_t              blockSize)
+{
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->pState  = pState;
+
+    memset(pState, 0, (numTaps + (blockSize - 1u)) * sizeof(float32_t));
+}
+
+void
+arm_fir_f32(const arm_fir_instance_f32 *S, float32_t *pSrc, float32_t *pDst, uint32_t blockSize)
+{
+    float32_t *pState  = S->pState;
+    float32_t *pCoeffs = S->pCoeffs;
+    float32_t *pStateCurnt;
+    uint32_t   numTaps = S->numTaps;
+    uint32_t   i;
+    uint32_t   k;
+
+    /* new samples are appended after the (numTaps - 1) history samples */
+    pStateCurnt = S->pState + (numTaps - 1u);
+
+    for (i = 0; i < blockSize; i++) {
+        float32_t sum = 0.0f;
+
+        *pStateCurnt++ = *pSrc++;
+
+        /* CMSIS keeps the taps time reversed, so both run oldest first */
+        for (k = 0; k < numTaps; k++)
+            sum += pState[k] * pCoeffs[k];
+
+        pState++;
+        *pDst++ = sum;
+    }
+
+    /* keep the last (numTaps - 1) samples for the next call */
+    pStateCurnt = S->pState;
+
+    for (i = 0; i < numTaps - 1u; i++)
+        *pStateCurnt++ = *pState++;
+}
+
+arm_status
+arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32 *S,
+                          uint16_t                       numTaps,
+                          uint8_t                        M,
+                          float32_t                     *pCoeffs,
+                          float32_t                     *pState,
+                          uint32_t                       blockSize)
+{
+    if ((blockSize % M) != 0u)
+        return ARM_MATH_LENGTH_ERROR;
+
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->M       = M;
+    S->pState  = pState;
+
+    memset(pState, 0, (numTaps + (blockSize - 1u)) * sizeof(float32_t));
+
+    return ARM_MATH_SUCCESS;
+}
+
+void
+arm_fir_decimate_f32(const arm_fir_decimate_instance_f32 *S,
+                     float32_t                           *pSrc,
+                     float32_t                           *pDst,
+                     uint32_t                             blockSize)
+{
+    float32_t *pState     = S->pState;
+    float32_t *pCoeffs    = S->pCoeffs;
+    float32_t *pStateCurnt;
+    uint32_t   numTaps    = S->numTaps;
+    uint32_t   outBlock   = blockSize / S->M;
+    uint32_t   i;
+    uint32_t   k;
+
+    /* new samples are appended after the (numTaps - 1) history samples */
+    pStateCurnt = S->pState + (numTaps - 1u);
+
+    for (i = 0; i < outBlock; i++) {
+        float32_t sum = 0.0f;
+
+        for (k = 0; k < S->M; k++)
+            *pStateCurnt++ = *pSrc++;
+
+        /* CMSIS keeps the taps time reversed, so both run oldest first */
+        for (k = 0; k < numTaps; k++)
+            sum += pState[k] * pCoeffs[k];
+
+        pState += S->M;
+        *pDst++ = sum;
+    }
+
+    /* keep the last (numTaps - 1) samples for the next call */
+    pStateCurnt = S->pState;
+
+    for (i = 0; i < numTaps - 1u; i++)
+        *pStateCurnt++ = *pState++;
+}
+
+static inline q31_t
+clip_q63_to_q31(q63_t x)
+{
+    return ((q31_t)(x >> 32) != ((q31_t)x >> 31)) ? ((0x7FFFFFFF ^ ((q31_t)(x >> 63)))) : (q31_t)x;
+}
+
+/* (1.63 * 1.31) >> 32, split like the CMSIS macro so the rounding matches */
+static inline q63_t
+mult32x64(q63_t x, q31_t y)
+{
+    return ((q63_t)(((q63_t)(x & 0x00000000FFFFFFFF) * y) >> 32)) + ((q63_t)(x >> 32) * y);
+}
+
+void
+arm_biquad_cas_df1_32x64_init_q31(arm_biquad_cas_df1_32x64_ins_q31 *S,
+                                  uint8_t                           numStages,
+                                  q31_t                            *pCoeffs,
+                                  q63_t                            *pState,
+                                  uint8_t                           postShift)
+{
+    S->numStages = numStages;
+    S->pCoeffs   = pCoeffs;
+    S->pState    = pState;
+    S->postShift = postShift;
+
+    memset(pState, 0, 4u * numStages * sizeof(q63_t));
+}
+
+void
+arm_biquad_cas_df1_32x64_q31(const arm_biquad_cas_df1_32x64_ins_q31 *S,
+                             q31_t                                  *pSrc,
+                             q31_t                                  *pDst,
+                             uint32_t                                blockSize)
+{
+    q31_t   *pIn     = pSrc;
+    q63_t   *pState  = S->pState;
+    q31_t   *pCoeffs = S->pCoeffs;
+    uint32_t uShift  = (uint32_t)S->postShift + 1u;
+    uint32_t lShift  = 32u - uShift;
+    uint32_t stage   = S->numStages;
+
+    do {
+        q31_t    b0  = pCoeffs[0];
+        q31_t    b1  = pCoeffs[1];
+        q31_t    b2  = pCoeffs[2];
+        q31_t    a1  = pCoeffs[3];
+        q31_t    a2  = pCoeffs[4];
+        q31_t    Xn1 = (q31_t)pState[0];
+        q31_t    Xn2 = (q31_t)pState[1];
+        q63_t    Yn1 = pState[2];
+        q63_t    Yn2 = pState[3];
+        uint32_t n;
+
+        for (n = 0; n < blockSize; n++) {
+            q31_t Xn  = pIn[n];
+            q63_t acc = (q63_t)Xn * b0;
+
+            acc += (q63_t)Xn1 * b1;
+            acc += (q63_t)Xn2 * b2;
+            acc += mult32x64(Yn1, a1);
+            acc += mult32x64(Yn2, a2);
+
+            Yn2 = Yn1;
+            Xn2 = Xn1;
+            Xn1 = Xn;
+
+            /* the state keeps y in 1.63, the output is its upper word */
+            Yn1     = (q63_t)((uint64_t)acc << uShift);
+            pDst[n] = (q31_t)(acc >> lShift);
+        }
+
+        pState[0] = Xn1;
+        pState[1] = Xn2;
+        pState[2] = Yn1;
+        pState[3] = Yn2;
+        pState += 4;
+        pCoeffs += 5;
+
+        pIn = pDst;
+    } while (--stage);
+}
+
+arm_status
+arm_fir_decimate_init_q31(arm_fir_decimate_instance_q31 *S,
+                          uint16_t                       numTaps,
+                          uint8_t                        M,
+                          q31_t                         *pCoeffs,
+                          q31_t                         *pState,
+                          uint32_t                       blockSize)
+{
+    if ((blockSize % M) != 0u)
+        return ARM_MATH_LENGTH_ERROR;
+
+    S->numTaps = numTaps;
+    S->pCoeffs = pCoeffs;
+    S->M       = M;
+    S->pState  = pState;
+
+    memset(pState, 0, (numTaps + (blockSize - 1u)) * sizeof(q31_t));
+
+    return ARM_MATH_SUCCESS;
+}
+
+void
+arm_fir_decimate_q31(const arm_fir_decimate_instance_q31 *S,
+                     q31_t                               *pSrc,
+                     q31_t                               *pDst,
+                     uint32_t                             blockSize)
+{
+    q31_t   *pState   = S->pState;
+    q31_t   *pCoeffs  = S->pCoeffs;
+    q31_t   *pStateCurnt;
+    uint32_t numTaps  = S->numTaps;
+    uint32_t outBlock = blockSize / S->M;
+    uint32_t i;
+    uint32_t k;
+
+    pStateCurnt = S->pState + (numTaps - 1u);
+
+    for (i = 0; i < outBlock; i++) {
+        q63_t sum = 0;
+
+        for (k = 0; k < S->M; k++)
+            *pStateCurnt++ = *pSrc++;
+
+        for (k = 0; k < numTaps; k++)
+            sum += (q63_t)pState[k] * pCoeffs[k];
+
+        pState += S->M;
+        *pDst++ = (q31_t)(sum >> 31);
+    }
+
+    pStateCurnt = S->pState;
+
+    for (i = 0; i < numTaps - 1u; i++)
+        *pStateCurnt++ = *pState++;
+}
+
+void
+arm_mult_q31(q31_t *pSrcA, q31_t *pSrcB, q31_t *pDst, uint32_t blockSize)
+{
+    while (blockSize--) {
+        q63_t out = ((q63_t)*pSrcA++ * *pSrcB++) >> 32;
+
+        /* __SSAT(out, 31) << 1 */
+        if (out > 0x3FFFFFFF)
+            out = 0x3FFFFFFF;
+        else if (out < -0x40000000)
+            out = -0x40000000;
+
+        *pDst++ = (q31_t)(out << 1);
+    }
+}
+
+void
+arm_float_to_q31(float32_t *pSrc, q31_t *pDst, uint32_t blockSize)
+{
+    while (blockSize--)
+        *pDst++ = clip_q63_to_q31((q63_t)(*pSrc++ * 2147483648.0f));
+}
+
+void
+arm_dot_prod_f32(float32_t *pSrcA, float32_t *pSrcB, uint32_t blockSize, float32_t *result)
+{
+    float32_t sum = 0.0f;
+
+    while (blockSize--)
+        sum += *pSrcA++ * *pSrcB++;
+
+    *result = sum;
+}
+
+void
+arm_mult_f32(float32_t *pSrcA, float32_t *pSrcB, float32_t *pDst, uint32_t blockSize)
+{
+    while (blockSize--)
+        *pDst++ = *pSrcA++ * *pSrcB++;
+}
+
+void
+arm_sin_cos_f32(float32_t theta, float32_t *pSinVal, float32_t *pCosVal)
+{
+    /* CMSIS takes the angle in degrees */
+    double rad = (double)theta * (3.14159265358979323846 / 180.0);
+
+    *pSinVal = (float32_t)sin(rad);
+    *pCosVal = (float32_t)cos(rad);
+}
+
+/* first occurrence, as CMSIS */
+void
+arm_max_q31(q31_t *pSrc, uint32_t blockSize, q31_t *pResult, uint32_t *pIndex)
+{
+    uint32_t i;
+
+    *pResult = pSrc[0];
+    *pIndex  = 0;
+
+    for (i = 1; i < blockSize; i++) {
+        if (pSrc[i] > *pResult) {
+            *pResult = pSrc[i];
+            *pIndex  = i;
+        }
+    }
+}
+
+void
+arm_min_q31(q31_t *pSrc, uint32_t blockSize, q31_t *pResult, uint32_t *pIndex)
+{
+    uint32_t i;
+
+    *pResult = pSrc[0];
+    *pIndex  = 0;
+
+    for (i = 1; i < blockSize; i++) {
+        if (pSrc[i] < *pResult) {
+            *pResult = pSrc[i];
+            *pIndex  = i;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
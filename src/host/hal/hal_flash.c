@@ -0,0 +1,120 @@
+//
+// Internal flash mock. The firmware reads calibration data by dereferencing
+// IFLASH addresses directly, so the array is mapped at the real IFLASH_ADDR;
+// the host executable is linked above it (see src/host/CMakeLists.txt).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#define FLASH_ERASED_BYTE 0xFFu
+
+static uint8_t *flash_base;
+
+static void __attribute__((constructor))
+flash_map(void)
+{
+    void *p = mmap((void *)(uintptr_t)IFLASH_ADDR, IFLASH_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (p != (void *)(uintptr_t)IFLASH_ADDR) {
+        fprintf(stderr, "hal_flash: cannot map IFLASH at 0x%08x\n", IFLASH_ADDR);
+        abort();
+    }
+
+    flash_base = (uint8_t *)p;
+    memset(flash_base, FLASH_ERASED_BYTE, IFLASH_SIZE);
+}
+
+static bool
+flash_range_is_valid(uint32_t ul_address, uint32_t ul_size)
+{
+    return (ul_address >= IFLASH_ADDR) && (ul_size <= IFLASH_SIZE) &&
+           (ul_address - IFLASH_ADDR <= IFLASH_SIZE - ul_size);
+}
+
+uint32_t
+flash_unlock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end)
+{
+    if (ul_end < ul_start || !flash_range_is_valid(ul_start, ul_end - ul_start + 1u))
+        return FLASH_RC_INVALID;
+
+    if (pul_actual_start != NULL)
+        *pul_actual_start = ul_start;
+    if (pul_actual_end != NULL)
+        *pul_actual_end = ul_end;
+
+    return FLASH_RC_OK;
+}
+
+uint32_t
+flash_lock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end)
+{
+    return flash_unlock(ul_start, ul_end, pul_actual_start, pul_actual_end);
+}
+
+uint32_t
+flash_erase_page(uint32_t ul_address, uint8_t uc_page_num)
+{
+    /* IFLASH_ERASE_PAGES_4/8/16/32 encoding, aligned down like the EEFC does */
+    uint32_t size  = (4u << uc_page_num) * IFLASH_PAGE_SIZE;
+    uint32_t start = ul_address & ~(size - 1u);
+
+    if (!flash_range_is_valid(start, size))
+        return FLASH_RC_INVALID;
+
+    memset(flash_base + (start - IFLASH_ADDR), FLASH_ERASED_BYTE, size);
+
+    return FLASH_RC_OK;
+}
+
+uint32_t
+flash_write(uint32_t ul_address, const void *p_buffer, uint32_t ul_size, uint32_t ul_erase_flag)
+{
+    uint8_t       *dst = flash_base + (ul_address - IFLASH_ADDR);
+    const uint8_t *src = (const uint8_t *)p_buffer;
+    uint32_t       i;
+
+    if (!flash_range_is_valid(ul_address, ul_size))
+        return FLASH_RC_INVALID;
+
+    /* without an erase, programming can only clear bits */
+    for (i = 0; i < ul_size; i++)
+        dst[i] = ul_erase_flag ? src[i] : (uint8_t)(dst[i] & src[i]);
+
+    return FLASH_RC_OK;
+}
+
+uint8_t *
+hal_host_flash_base(void)
+{
+    return flash_base;
+}
+
+void
+hal_host_flash_erase_all(void)
+{
+    memset(flash_base, FLASH_ERASED_BYTE, IFLASH_SIZE);
+}
+
+void
+hal_flash_reset(void)
+{
+    /* flash content survives a reset on the target as well */
+}
+
+#ifdef __cplusplus
+}
+#endif
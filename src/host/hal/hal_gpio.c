@@ -0,0 +1,263 @@
+//
+// PIO controller mock. Output calls land in the port image, inputs are driven
+// from the tests and edge handlers are invoked synchronously, exactly like the
+// PIO ISR on the target would do for the same pin mask.
+//
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HAL_PIO_HANDLERS_MAX 8
+
+typedef struct {
+    Pio     *port;
+    uint32_t id;
+    uint32_t mask;
+    uint32_t attr;
+    void (*handler)(uint32_t, uint32_t);
+} hal_pio_handler_t;
+
+Pio hal_host_pioa;
+Pio hal_host_piob;
+Pio hal_host_piod;
+
+static hal_pio_handler_t pio_handlers[HAL_PIO_HANDLERS_MAX];
+static uint32_t          pio_handlers_num;
+
+static IRQn_Type
+pio_irqn(Pio *p_pio)
+{
+    if (p_pio == PIOB)
+        return PIOB_IRQn;
+    if (p_pio == PIOD)
+        return PIOD_IRQn;
+
+    return PIOA_IRQn;
+}
+
+void
+pio_pull_up(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_pull_up_enable)
+{
+    if (ul_pull_up_enable)
+        p_pio->pull_up |= ul_mask;
+    else
+        p_pio->pull_up &= ~ul_mask;
+}
+
+void
+pio_pull_down(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_pull_down_enable)
+{
+    if (ul_pull_down_enable)
+        p_pio->pull_down |= ul_mask;
+    else
+        p_pio->pull_down &= ~ul_mask;
+}
+
+void
+pio_set_peripheral(Pio *p_pio, const pio_type_t ul_type, const uint32_t ul_mask)
+{
+    if (ul_type == PIO_NOT_A_PIN)
+        p_pio->periph_mask &= ~ul_mask;
+    else
+        p_pio->periph_mask |= ul_mask;
+}
+
+void
+pio_set_output(Pio           *p_pio,
+               const uint32_t ul_mask,
+               const uint32_t ul_default_level,
+               const uint32_t ul_multidrive_enable,
+               const uint32_t ul_pull_up_enable)
+{
+    UNUSED(ul_multidrive_enable);
+
+    pio_pull_up(p_pio, ul_mask, ul_pull_up_enable);
+    p_pio->output_enable |= ul_mask;
+    p_pio->periph_mask &= ~ul_mask;
+
+    if (ul_default_level)
+        p_pio->output |= ul_mask;
+    else
+        p_pio->output &= ~ul_mask;
+}
+
+void
+pio_set_input(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_attribute)
+{
+    pio_pull_up(p_pio, ul_mask, ul_attribute & PIO_PULLUP);
+    p_pio->output_enable &= ~ul_mask;
+    p_pio->periph_mask &= ~ul_mask;
+
+    if (ul_attribute & PIO_PULLUP)
+        p_pio->input |= ul_mask;
+}
+
+void
+pio_set(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->output |= ul_mask;
+    p_pio->set_clear_writes++;
+}
+
+void
+pio_clear(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->output &= ~ul_mask;
+    p_pio->set_clear_writes++;
+}
+
+void
+pio_sync_output_write(Pio *p_pio, const uint32_t ul_mask)
+{
+    /* ODSR writes only reach the bits enabled in OWSR */
+    p_pio->output = (p_pio->output & ~p_pio->output_write_enable) | (ul_mask & p_pio->output_write_enable);
+    p_pio->sync_writes++;
+}
+
+void
+pio_enable_output_write(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->output_write_enable |= ul_mask;
+}
+
+void
+pio_disable_output_write(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->output_write_enable &= ~ul_mask;
+}
+
+void
+pio_enable_interrupt(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->irq_mask |= ul_mask;
+}
+
+void
+pio_disable_interrupt(Pio *p_pio, const uint32_t ul_mask)
+{
+    p_pio->irq_mask &= ~ul_mask;
+}
+
+void
+pio_set_debounce_filter(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_cut_off)
+{
+    UNUSED(ul_cut_off);
+    p_pio->debounce |= ul_mask;
+}
+
+uint32_t
+pio_get_pin_value(uint32_t ul_pin)
+{
+    /* ASF pin numbering: PIOA 0..31, PIOB 32..63, PIOC 64..95, PIOD 96..127 */
+    Pio     *port;
+    uint32_t mask = 1u << (ul_pin & 0x1Fu);
+
+    switch (ul_pin >> 5) {
+    case 0: port = PIOA; break;
+    case 1: port = PIOB; break;
+    case 3: port = PIOD; break;
+    default: return 0;
+    }
+
+    if (port->output_enable & mask)
+        return (port->output & mask) ? 1 : 0;
+
+    return (port->input & mask) ? 1 : 0;
+}
+
+uint32_t
+pio_handler_set(Pio *p_pio, uint32_t ul_id, uint32_t ul_mask, uint32_t ul_attr, void (*p_handler)(uint32_t, uint32_t))
+{
+    uint32_t i;
+
+    for (i = 0; i < pio_handlers_num; i++) {
+        if (pio_handlers[i].port == p_pio && pio_handlers[i].mask == ul_mask)
+            break;
+    }
+
+    if (i == HAL_PIO_HANDLERS_MAX)
+        return 1;
+
+    pio_handlers[i].port    = p_pio;
+    pio_handlers[i].id      = ul_id;
+    pio_handlers[i].mask    = ul_mask;
+    pio_handlers[i].attr    = ul_attr;
+    pio_handlers[i].handler = p_handler;
+
+    if (i == pio_handlers_num)
+        pio_handlers_num++;
+
+    return 0;
+}
+
+void
+pio_handler_set_priority(Pio *p_pio, IRQn_Type ul_irqn, uint32_t ul_priority)
+{
+    UNUSED(p_pio);
+
+    NVIC_DisableIRQ(ul_irqn);
+    NVIC_ClearPendingIRQ(ul_irqn);
+    NVIC_SetPriority(ul_irqn, ul_priority);
+    NVIC_EnableIRQ(ul_irqn);
+}
+
+static void
+pio_dispatch(Pio *p_pio, uint32_t mask, bool only_matching_edge, bool level)
+{
+    uint32_t i;
+
+    if (!hal_host_irq_is_enabled(pio_irqn(p_pio)))
+        return;
+
+    mask &= p_pio->irq_mask;
+
+    for (i = 0; i < pio_handlers_num; i++) {
+        hal_pio_handler_t *h = &pio_handlers[i];
+
+        if (h->port != p_pio || !(h->mask & mask) || h->handler == NULL)
+            continue;
+
+        /* additional interrupt modes select a single edge, otherwise both fire */
+        if (only_matching_edge && (h->attr & PIO_IT_AIME) && (((h->attr & PIO_IT_RE_OR_HL) != 0) != level))
+            continue;
+
+        h->handler(h->id, h->mask & mask);
+    }
+}
+
+void
+hal_host_pio_set_input(Pio *p_pio, uint32_t mask, bool level)
+{
+    uint32_t previous = p_pio->input;
+
+    if (level)
+        p_pio->input |= mask;
+    else
+        p_pio->input &= ~mask;
+
+    pio_dispatch(p_pio, (previous ^ p_pio->input) & mask, true, level);
+}
+
+void
+hal_host_pio_fire(Pio *p_pio, uint32_t mask)
+{
+    pio_dispatch(p_pio, mask, false, false);
+}
+
+void
+hal_gpio_reset(void)
+{
+    memset(&hal_host_pioa, 0, sizeof(hal_host_pioa));
+    memset(&hal_host_piob, 0, sizeof(hal_host_piob));
+    memset(&hal_host_piod, 0, sizeof(hal_host_piod));
+    memset(pio_handlers, 0, sizeof(pio_handlers));
+    pio_handlers_num = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,35 @@
+//
+// Glue between the individual peripheral mocks; not visible to the firmware
+// or to the tests.
+//
+
+#ifndef CLAMPMETER_HAL_HOST_PRIVATE_H
+#define CLAMPMETER_HAL_HOST_PRIVATE_H
+
+#include "hal_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* firmware interrupt handlers, weak so that partial links still resolve */
+void TC0_Handler(void) __attribute__((weak));
+void TWI0_Handler(void) __attribute__((weak));
+void DACC_Handler(void) __attribute__((weak));
+void SPI_Handler(void) __attribute__((weak));
+
+void hal_gpio_reset(void);
+void hal_spi_reset(void);
+void hal_timer_reset(void);
+void hal_twi_reset(void);
+void hal_twi_poll(void);
+void hal_twi_pdc_started(void);
+void hal_spi_pdc_rx_written(void);
+void hal_flash_reset(void);
+void hal_system_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CLAMPMETER_HAL_HOST_PRIVATE_H
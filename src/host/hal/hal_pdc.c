@@ -0,0 +1,74 @@
+//
+// Peripheral DMA controller mock. The register image is kept per peripheral;
+// enabling a channel notifies the owning peripheral mock, which performs the
+// transfer and raises its completion interrupt on the next hal_host_poll().
+//
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void
+pdc_tx_init(Pdc *p_pdc, pdc_packet_t *p_packet, pdc_packet_t *p_next_packet)
+{
+    if (p_packet != NULL) {
+        p_pdc->PERIPH_TPR = p_packet->ul_addr;
+        p_pdc->PERIPH_TCR = p_packet->ul_size;
+    }
+
+    if (p_next_packet != NULL) {
+        p_pdc->PERIPH_TNPR = p_next_packet->ul_addr;
+        p_pdc->PERIPH_TNCR = p_next_packet->ul_size;
+    }
+}
+
+void
+pdc_rx_init(Pdc *p_pdc, pdc_packet_t *p_packet, pdc_packet_t *p_next_packet)
+{
+    if (p_packet != NULL) {
+        p_pdc->PERIPH_RPR = p_packet->ul_addr;
+        p_pdc->PERIPH_RCR = p_packet->ul_size;
+    }
+
+    if (p_next_packet != NULL) {
+        p_pdc->PERIPH_RNPR = p_next_packet->ul_addr;
+        p_pdc->PERIPH_RNCR = p_next_packet->ul_size;
+    }
+
+    if (p_pdc == &hal_host_spi.pdc)
+        hal_spi_pdc_rx_written();
+}
+
+void
+pdc_enable_transfer(Pdc *p_pdc, uint32_t ul_controls)
+{
+    if (ul_controls & PERIPH_PTCR_RXTEN)
+        p_pdc->PERIPH_PTSR |= PERIPH_PTSR_RXTEN;
+    if (ul_controls & PERIPH_PTCR_TXTEN)
+        p_pdc->PERIPH_PTSR |= PERIPH_PTSR_TXTEN;
+
+    if ((ul_controls & PERIPH_PTCR_TXTEN) && p_pdc == &hal_host_twi0.pdc)
+        hal_twi_pdc_started();
+}
+
+void
+pdc_disable_transfer(Pdc *p_pdc, uint32_t ul_controls)
+{
+    if (ul_controls & PERIPH_PTCR_RXTDIS)
+        p_pdc->PERIPH_PTSR &= ~PERIPH_PTSR_RXTEN;
+    if (ul_controls & PERIPH_PTCR_TXTDIS)
+        p_pdc->PERIPH_PTSR &= ~PERIPH_PTSR_TXTEN;
+}
+
+uint32_t
+pdc_read_status(Pdc *p_pdc)
+{
+    return p_pdc->PERIPH_PTSR;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,281 @@
+//
+// SPI master mock. Every word written is clocked MSB first through the device
+// model attached with hal_host_spi_attach(); the chip select follows the
+// CSAAT/CSNAAT behaviour configured by the firmware, so the model sees the
+// same frame boundaries as the real slave. PDC transfers are clocked on
+// demand by hal_host_spi_pdc_run().
+//
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+Spi hal_host_spi;
+
+static hal_spi_device_t spi_device;
+
+static void
+spi_frame_end(Spi *p_spi)
+{
+    if (!p_spi->frame_active)
+        return;
+
+    p_spi->frame_active = false;
+
+    if (spi_device.frame_end != NULL)
+        spi_device.frame_end(spi_device.ctx);
+}
+
+static uint8_t
+spi_clock_byte(uint8_t mosi)
+{
+    if (spi_device.transfer == NULL)
+        return 0xFF;
+
+    return spi_device.transfer(spi_device.ctx, mosi);
+}
+
+spi_status_t
+spi_write(Spi *p_spi, uint16_t us_data, uint8_t uc_pcs, uint8_t uc_last)
+{
+    uint32_t csr = p_spi->SPI_CSR[uc_pcs & 0x3u];
+
+    p_spi->frame_active = true;
+    p_spi->transfers++;
+
+    if ((csr & SPI_CSR_BITS_Msk) == SPI_CSR_BITS_16_BIT) {
+        uint16_t hi = spi_clock_byte((uint8_t)(us_data >> 8));
+        uint16_t lo = spi_clock_byte((uint8_t)us_data);
+
+        p_spi->rx_data = (uint16_t)((hi << 8) | lo);
+    }
+    else {
+        p_spi->rx_data = spi_clock_byte((uint8_t)us_data);
+    }
+
+    if (uc_last || ((csr & SPI_CS_RISE_FORCED) && !(csr & SPI_CS_KEEP_LOW)))
+        spi_frame_end(p_spi);
+
+    return SPI_OK;
+}
+
+spi_status_t
+spi_read(Spi *p_spi, uint16_t *us_data, uint8_t *p_pcs)
+{
+    *us_data = p_spi->rx_data;
+
+    if (p_pcs != NULL)
+        *p_pcs = 0;
+
+    return SPI_OK;
+}
+
+uint32_t
+spi_is_tx_ready(Spi *p_spi)
+{
+    UNUSED(p_spi);
+    return 1;
+}
+
+void
+spi_set_lastxfer(Spi *p_spi)
+{
+    spi_frame_end(p_spi);
+}
+
+void
+spi_enable(Spi *p_spi)
+{
+    p_spi->enabled = true;
+}
+
+void
+spi_set_master_mode(Spi *p_spi)
+{
+    p_spi->SPI_MR |= 0x1u;
+}
+
+void
+spi_disable_mode_fault_detect(Spi *p_spi)
+{
+    p_spi->SPI_MR |= (0x1u << 4);
+}
+
+void
+spi_configure_cs_behavior(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_cs_behavior)
+{
+    p_spi->SPI_CSR[ul_pcs_ch] &= ~(uint32_t)(SPI_CS_KEEP_LOW | SPI_CS_RISE_FORCED);
+    p_spi->SPI_CSR[ul_pcs_ch] |= ul_cs_behavior;
+}
+
+void
+spi_set_bits_per_transfer(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_bits)
+{
+    p_spi->SPI_CSR[ul_pcs_ch] &= ~SPI_CSR_BITS_Msk;
+    p_spi->SPI_CSR[ul_pcs_ch] |= ul_bits;
+}
+
+int16_t
+spi_set_baudrate_div(Spi *p_spi, uint32_t ul_pcs_ch, uint8_t uc_baudrate_divider)
+{
+    if (!uc_baudrate_divider)
+        return -1;
+
+    p_spi->SPI_CSR[ul_pcs_ch] &= ~(0xFFu << 8);
+    p_spi->SPI_CSR[ul_pcs_ch] |= (uint32_t)uc_baudrate_divider << 8;
+
+    return 0;
+}
+
+void
+spi_set_clock_polarity(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_polarity)
+{
+    if (ul_polarity)
+        p_spi->SPI_CSR[ul_pcs_ch] |= 0x1u;
+    else
+        p_spi->SPI_CSR[ul_pcs_ch] &= ~0x1u;
+}
+
+void
+spi_set_clock_phase(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_phase)
+{
+    if (ul_phase)
+        p_spi->SPI_CSR[ul_pcs_ch] |= 0x2u;
+    else
+        p_spi->SPI_CSR[ul_pcs_ch] &= ~0x2u;
+}
+
+void
+spi_set_peripheral_chip_select_value(Spi *p_spi, uint32_t ul_value)
+{
+    p_spi->SPI_MR &= ~(0xFu << 16);
+    p_spi->SPI_MR |= (ul_value & 0xFu) << 16;
+}
+
+void
+spi_set_transfer_delay(Spi *p_spi, uint32_t ul_pcs_ch, uint8_t uc_dlybs, uint8_t uc_dlybct)
+{
+    p_spi->SPI_CSR[ul_pcs_ch] &= ~(0xFFFFu << 16);
+    p_spi->SPI_CSR[ul_pcs_ch] |= ((uint32_t)uc_dlybs << 16) | ((uint32_t)uc_dlybct << 24);
+}
+
+uint32_t
+spi_read_status(Spi *p_spi)
+{
+    return p_spi->SPI_SR;
+}
+
+void
+spi_enable_interrupt(Spi *p_spi, uint32_t ul_sources)
+{
+    p_spi->SPI_IMR |= ul_sources;
+}
+
+void
+spi_disable_interrupt(Spi *p_spi, uint32_t ul_sources)
+{
+    p_spi->SPI_IMR &= ~ul_sources;
+}
+
+uint32_t
+spi_read_interrupt_mask(Spi *p_spi)
+{
+    return p_spi->SPI_IMR;
+}
+
+Pdc *
+spi_get_pdc_base(Spi *p_spi)
+{
+    return &p_spi->pdc;
+}
+
+void
+hal_spi_pdc_rx_written(void)
+{
+    /* writing RCR/RNCR clears the end-of-buffer flags, as on the target */
+    if (hal_host_spi.pdc.PERIPH_RCR)
+        hal_host_spi.SPI_SR &= ~(SPI_SR_ENDRX | SPI_SR_RXBUFF);
+    else if (hal_host_spi.pdc.PERIPH_RNCR)
+        hal_host_spi.SPI_SR &= ~SPI_SR_RXBUFF;
+}
+
+static void
+spi_pdc_raise(uint32_t flags)
+{
+    hal_host_spi.SPI_SR |= flags;
+
+    /* delivered once per event, so a handler that leaves the flag set does not loop */
+    if ((hal_host_spi.SPI_IMR & flags) && hal_host_irq_is_enabled(SPI_IRQn) && SPI_Handler)
+        SPI_Handler();
+}
+
+uint32_t
+hal_host_spi_pdc_run(uint32_t max_bytes)
+{
+    Pdc     *pdc = &hal_host_spi.pdc;
+    uint32_t n   = 0;
+
+    while (n < max_bytes) {
+        uint8_t mosi = 0;
+        uint8_t miso;
+
+        if (!(pdc->PERIPH_PTSR & PERIPH_PTSR_RXTEN) || !(pdc->PERIPH_PTSR & PERIPH_PTSR_TXTEN))
+            break;
+        if (pdc->PERIPH_RCR == 0 || pdc->PERIPH_TCR == 0)
+            break;
+
+        mosi = *(const uint8_t *)(uintptr_t)pdc->PERIPH_TPR;
+        pdc->PERIPH_TPR++;
+
+        if (--pdc->PERIPH_TCR == 0) {
+            pdc->PERIPH_TPR  = pdc->PERIPH_TNPR;
+            pdc->PERIPH_TCR  = pdc->PERIPH_TNCR;
+            pdc->PERIPH_TNCR = 0;
+        }
+
+        hal_host_spi.frame_active = true;
+        hal_host_spi.transfers++;
+        miso = spi_clock_byte(mosi);
+        n++;
+
+        *(uint8_t *)(uintptr_t)pdc->PERIPH_RPR = miso;
+        pdc->PERIPH_RPR++;
+
+        if (--pdc->PERIPH_RCR == 0) {
+            if (pdc->PERIPH_RNCR) {
+                pdc->PERIPH_RPR  = pdc->PERIPH_RNPR;
+                pdc->PERIPH_RCR  = pdc->PERIPH_RNCR;
+                pdc->PERIPH_RNCR = 0;
+                spi_pdc_raise(SPI_SR_ENDRX);
+            }
+            else {
+                spi_pdc_raise(SPI_SR_ENDRX | SPI_SR_RXBUFF);
+            }
+        }
+    }
+
+    return n;
+}
+
+void
+hal_host_spi_attach(const hal_spi_device_t *device)
+{
+    if (device != NULL)
+        spi_device = *device;
+    else
+        memset(&spi_device, 0, sizeof(spi_device));
+}
+
+void
+hal_spi_reset(void)
+{
+    memset(&hal_host_spi, 0, sizeof(hal_host_spi));
+    memset(&spi_device, 0, sizeof(spi_device));
+}
+
+#ifdef __cplusplus
+}
+#endif
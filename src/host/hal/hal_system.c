@@ -0,0 +1,332 @@
+//
+// Core and system controller mocks: NVIC, PMC, EFC, WDT, DACC, the bus
+// matrix, and the newlib extensions the firmware relies on. Also hosts the
+// global reset and poll entry points of the host HAL.
+//
+
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HAL_PMC_PCK_NUM 3
+
+Dacc   hal_host_dacc;
+Matrix hal_host_matrix;
+Efc    hal_host_efc;
+Wdt    hal_host_wdt;
+
+static bool     nvic_enabled[PERIPH_COUNT_IRQn];
+static uint32_t nvic_priority[PERIPH_COUNT_IRQn];
+static uint64_t pmc_periph_clk;
+static bool     pmc_pck_enabled[HAL_PMC_PCK_NUM];
+
+/*
+ * NVIC
+ */
+void
+NVIC_EnableIRQ(IRQn_Type irqn)
+{
+    nvic_enabled[irqn] = true;
+}
+
+void
+NVIC_DisableIRQ(IRQn_Type irqn)
+{
+    nvic_enabled[irqn] = false;
+}
+
+void
+NVIC_ClearPendingIRQ(IRQn_Type irqn)
+{
+    UNUSED(irqn);
+}
+
+void
+NVIC_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+    nvic_priority[irqn] = priority;
+}
+
+uint32_t
+NVIC_GetPriority(IRQn_Type irqn)
+{
+    return nvic_priority[irqn];
+}
+
+bool
+hal_host_irq_is_enabled(IRQn_Type irqn)
+{
+    return nvic_enabled[irqn];
+}
+
+/*
+ * PMC: oscillators and PLL lock immediately
+ */
+void
+pmc_enable_periph_clk(uint32_t ul_id)
+{
+    pmc_periph_clk |= 1ull << ul_id;
+}
+
+uint32_t
+pmc_is_periph_clk_enabled(uint32_t ul_id)
+{
+    return (pmc_periph_clk >> ul_id) & 1u;
+}
+
+void
+pmc_enable_pck(uint32_t ul_id)
+{
+    pmc_pck_enabled[ul_id] = true;
+}
+
+void
+pmc_disable_pck(uint32_t ul_id)
+{
+    pmc_pck_enabled[ul_id] = false;
+}
+
+uint32_t
+pmc_is_pck_enabled(uint32_t ul_id)
+{
+    return pmc_pck_enabled[ul_id];
+}
+
+uint32_t
+pmc_switch_pck_to_mainck(uint32_t ul_id, uint32_t ul_pres)
+{
+    UNUSED(ul_id);
+    UNUSED(ul_pres);
+    return 0;
+}
+
+void
+pmc_osc_enable_main_xtal(uint32_t ul_xtal_startup_time)
+{
+    UNUSED(ul_xtal_startup_time);
+}
+
+uint32_t
+pmc_osc_is_ready_main_xtal(void)
+{
+    return 1;
+}
+
+void
+pmc_switch_mainck_to_xtal(uint32_t ul_bypass, uint32_t ul_xtal_startup_time)
+{
+    UNUSED(ul_bypass);
+    UNUSED(ul_xtal_startup_time);
+}
+
+uint32_t
+pmc_osc_is_ready_mainck(void)
+{
+    return 1;
+}
+
+void
+pmc_enable_pllack(uint32_t mula, uint32_t pllacount, uint32_t diva)
+{
+    UNUSED(mula);
+    UNUSED(pllacount);
+    UNUSED(diva);
+}
+
+uint32_t
+pmc_is_locked_pllack(void)
+{
+    return 1;
+}
+
+uint32_t
+pmc_switch_mck_to_pllack(uint32_t ul_pres)
+{
+    UNUSED(ul_pres);
+    return 0;
+}
+
+uint32_t
+sysclk_get_cpu_hz(void)
+{
+    return HAL_HOST_CPU_HZ;
+}
+
+uint32_t
+sysclk_get_peripheral_hz(void)
+{
+    return HAL_HOST_CPU_HZ;
+}
+
+/*
+ * EFC, WDT
+ */
+void
+efc_set_wait_state(Efc *p_efc, uint32_t ul_fws)
+{
+    p_efc->EEFC_FMR = (p_efc->EEFC_FMR & ~(0xFu << 8)) | ((ul_fws & 0xFu) << 8);
+}
+
+void
+efc_enable_cloe(Efc *p_efc)
+{
+    p_efc->EEFC_FMR |= (0x1u << 26);
+}
+
+void
+wdt_disable(Wdt *p_wdt)
+{
+    p_wdt->WDT_MR |= (0x1u << 15);
+}
+
+/*
+ * DACC: configuration is recorded, conversions are not simulated
+ */
+void
+dacc_reset(Dacc *p_dacc)
+{
+    Pdc pdc = p_dacc->pdc;
+
+    memset(p_dacc, 0, sizeof(*p_dacc));
+    p_dacc->pdc = pdc;
+}
+
+void
+dacc_set_transfer_mode(Dacc *p_dacc, uint32_t ul_mode)
+{
+    if (ul_mode)
+        p_dacc->DACC_MR |= (0x1u << 4);
+    else
+        p_dacc->DACC_MR &= ~(0x1u << 4);
+}
+
+uint32_t
+dacc_set_trigger(Dacc *p_dacc, uint32_t ul_trigger)
+{
+    p_dacc->trigger = ul_trigger;
+    p_dacc->DACC_MR |= 0x1u;
+
+    return 0;
+}
+
+void
+dacc_disable_trigger(Dacc *p_dacc)
+{
+    p_dacc->DACC_MR &= ~0x1u;
+}
+
+uint32_t
+dacc_set_timing(Dacc *p_dacc, uint32_t ul_maxs, uint32_t ul_startup)
+{
+    UNUSED(p_dacc);
+    UNUSED(ul_maxs);
+    UNUSED(ul_startup);
+
+    return 0;
+}
+
+uint32_t
+dacc_set_channel_selection(Dacc *p_dacc, uint32_t ul_channel)
+{
+    p_dacc->DACC_MR = (p_dacc->DACC_MR & ~(0x3u << 16)) | ((ul_channel & 0x3u) << 16);
+
+    return 0;
+}
+
+void
+dacc_set_analog_control(Dacc *p_dacc, uint32_t ul_analog_control)
+{
+    p_dacc->DACC_ACR = ul_analog_control;
+}
+
+void
+dacc_enable_channel(Dacc *p_dacc, uint32_t ul_channel)
+{
+    p_dacc->DACC_CHSR |= 1u << ul_channel;
+}
+
+void
+dacc_enable_interrupt(Dacc *p_dacc, uint32_t ul_interrupt_mask)
+{
+    p_dacc->DACC_IMR |= ul_interrupt_mask;
+}
+
+void
+dacc_disable_interrupt(Dacc *p_dacc, uint32_t ul_interrupt_mask)
+{
+    p_dacc->DACC_IMR &= ~ul_interrupt_mask;
+}
+
+Pdc *
+dacc_get_pdc_base(Dacc *p_dacc)
+{
+    return &p_dacc->pdc;
+}
+
+/*
+ * newlib
+ */
+char *
+gcvtf(float value, int ndigit, char *buf)
+{
+    return gcvt((double)value, ndigit, buf);
+}
+
+/*
+ * host HAL entry points
+ */
+void
+hal_host_poll(void)
+{
+    hal_twi_poll();
+}
+
+void
+hal_host_dacc_packet_end(void)
+{
+    Pdc *pdc = &hal_host_dacc.pdc;
+
+    if (!(pdc->PERIPH_PTSR & PERIPH_PTSR_TXTEN))
+        return;
+
+    pdc->PERIPH_TPR  = pdc->PERIPH_TNPR;
+    pdc->PERIPH_TCR  = pdc->PERIPH_TNCR;
+    pdc->PERIPH_TNCR = 0;
+
+    if (hal_host_irq_is_enabled(DACC_IRQn) && (hal_host_dacc.DACC_IMR & DACC_IMR_ENDTX) && DACC_Handler)
+        DACC_Handler();
+}
+
+void
+hal_system_reset(void)
+{
+    memset(&hal_host_dacc, 0, sizeof(hal_host_dacc));
+    memset(&hal_host_matrix, 0, sizeof(hal_host_matrix));
+    memset(&hal_host_efc, 0, sizeof(hal_host_efc));
+    memset(&hal_host_wdt, 0, sizeof(hal_host_wdt));
+    memset(nvic_enabled, 0, sizeof(nvic_enabled));
+    memset(nvic_priority, 0, sizeof(nvic_priority));
+    memset(pmc_pck_enabled, 0, sizeof(pmc_pck_enabled));
+    pmc_periph_clk = 0;
+}
+
+void
+hal_host_reset(void)
+{
+    hal_system_reset();
+    hal_gpio_reset();
+    hal_spi_reset();
+    hal_timer_reset();
+    hal_twi_reset();
+    hal_flash_reset();
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,175 @@
+//
+// Timer counter, SysTick and busy-wait delays on a virtual time base. Nothing
+// here sleeps: delay_ms() and hal_host_advance_us() move the clock forward and
+// deliver the TC0 channel 0 compare interrupts that fall into the interval.
+// The DWT cycle counter is the exception and follows the host clock.
+//
+
+#include <time.h>
+
+#include "hal_host.h"
+#include "hal_host_private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TC_CMR_TCCLKS_Msk 0x7u
+#define TC_IER_CPCS       (0x1u << 4)
+
+Tc             hal_host_tc0;
+SysTick_Type   hal_host_systick;
+CoreDebug_Type hal_host_coredebug;
+
+static DWT_Type dwt;
+
+static uint64_t time_us;
+static uint64_t tc0_next_tick_us;
+
+static uint32_t
+tc_period_us(const TcChannel *ch)
+{
+    static const uint32_t dividers[4] = { 2, 8, 32, 128 };
+    uint32_t              clk         = ch->TC_CMR & TC_CMR_TCCLKS_Msk;
+    uint64_t              period;
+
+    if (clk > 3 || ch->TC_RC == 0)
+        return 0;
+
+    period = (uint64_t)ch->TC_RC * dividers[clk] * 1000000u / HAL_HOST_CPU_HZ;
+
+    return period ? (uint32_t)period : 1u;
+}
+
+void
+tc_init(Tc *p_tc, uint32_t ul_Channel, uint32_t ul_Mode)
+{
+    p_tc->TC_CHANNEL[ul_Channel].TC_CMR  = ul_Mode;
+    p_tc->TC_CHANNEL[ul_Channel].TC_IMR  = 0;
+    p_tc->TC_CHANNEL[ul_Channel].running = false;
+}
+
+void
+tc_set_block_mode(Tc *p_tc, uint32_t ul_blockmode)
+{
+    p_tc->TC_BMR = ul_blockmode;
+}
+
+void
+tc_start(Tc *p_tc, uint32_t ul_channel)
+{
+    p_tc->TC_CHANNEL[ul_channel].running = true;
+
+    if (p_tc == TC0 && ul_channel == 0)
+        tc0_next_tick_us = time_us + tc_period_us(&p_tc->TC_CHANNEL[0]);
+}
+
+void
+tc_stop(Tc *p_tc, uint32_t ul_channel)
+{
+    p_tc->TC_CHANNEL[ul_channel].running = false;
+}
+
+void
+tc_write_rc(Tc *p_tc, uint32_t ul_channel, uint32_t ul_value)
+{
+    p_tc->TC_CHANNEL[ul_channel].TC_RC = ul_value;
+}
+
+void
+tc_enable_interrupt(Tc *p_tc, uint32_t ul_channel, uint32_t ul_sources)
+{
+    p_tc->TC_CHANNEL[ul_channel].TC_IMR |= ul_sources;
+}
+
+uint32_t
+tc_get_status(Tc *p_tc, uint32_t ul_channel)
+{
+    UNUSED(p_tc);
+    UNUSED(ul_channel);
+
+    return 0;
+}
+
+uint32_t
+hal_host_tc_rc(Tc *p_tc, uint32_t ul_channel)
+{
+    return p_tc->TC_CHANNEL[ul_channel].running ? p_tc->TC_CHANNEL[ul_channel].TC_RC : 0;
+}
+
+void
+hal_host_advance_us(uint32_t us)
+{
+    uint64_t  end = time_us + us;
+    TcChannel *ch = &hal_host_tc0.TC_CHANNEL[0];
+
+    for (;;) {
+        uint32_t period = tc_period_us(ch);
+        bool     ticks  = ch->running && period && (ch->TC_IMR & TC_IER_CPCS);
+
+        if (!ticks || tc0_next_tick_us > end)
+            break;
+
+        time_us = tc0_next_tick_us;
+        tc0_next_tick_us += period;
+
+        if (hal_host_irq_is_enabled(TC0_IRQn) && TC0_Handler)
+            TC0_Handler();
+    }
+
+    time_us = end;
+
+    if (hal_host_systick.CTRL & 0x1u) {
+        uint64_t cycles = time_us * (HAL_HOST_CPU_HZ / 1000000u);
+        uint32_t reload = hal_host_systick.LOAD + 1u;
+
+        hal_host_systick.VAL = hal_host_systick.LOAD - (uint32_t)(cycles % reload);
+    }
+}
+
+uint64_t
+hal_host_time_us(void)
+{
+    return time_us;
+}
+
+void
+delay_ms(uint32_t ms)
+{
+    hal_host_advance_us(ms * 1000u);
+}
+
+void
+delay_us(uint32_t us)
+{
+    hal_host_advance_us(us);
+}
+
+DWT_Type *
+hal_host_dwt(void)
+{
+    struct timespec ts;
+
+    if ((hal_host_coredebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        dwt.CYCCNT = (uint32_t)(((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec) *
+                                (HAL_HOST_CPU_HZ / 1000000u) / 1000u);
+    }
+
+    return &dwt;
+}
+
+void
+hal_timer_reset(void)
+{
+    memset(&hal_host_tc0, 0, sizeof(hal_host_tc0));
+    memset((void *)&hal_host_systick, 0, sizeof(hal_host_systick));
+    memset((void *)&hal_host_coredebug, 0, sizeof(hal_host_coredebug));
+    memset((void *)&dwt, 0, sizeof(dwt));
+    time_us          = 0;
+    tc0_next_tick_us = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
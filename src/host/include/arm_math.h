@@ -0,0 +1,156 @@
+//
+// Host build of the CMSIS-DSP subset used by clamp_meter. The target links the
+// prebuilt libarm_cortexM4lf_math_softfp.a, whose header cannot be compiled
+// without a Cortex core; the declarations and instance layouts below mirror
+// CMSIS-DSP V1.5.3 and are backed by plain C reference kernels in
+// src/host/dsp/arm_math_host.c.
+//
+
+#ifndef CLAMPMETER_HOST_ARM_MATH_H
+#define CLAMPMETER_HOST_ARM_MATH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PI 3.14159265358979f
+
+typedef int8_t  q7_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+typedef float   float32_t;
+typedef double  float64_t;
+
+typedef enum {
+    ARM_MATH_SUCCESS        = 0,
+    ARM_MATH_ARGUMENT_ERROR = -1,
+    ARM_MATH_LENGTH_ERROR   = -2,
+    ARM_MATH_SIZE_MISMATCH  = -3,
+    ARM_MATH_NANINF         = -4,
+    ARM_MATH_SINGULAR       = -5,
+    ARM_MATH_TEST_FAILURE   = -6
+} arm_status;
+
+typedef struct {
+    uint8_t    numStages;
+    float32_t *pState;
+    float32_t *pCoeffs;
+} arm_biquad_cascade_df2T_instance_f32;
+
+typedef struct {
+    uint16_t   numTaps;
+    float32_t *pState;
+    float32_t *pCoeffs;
+} arm_fir_instance_f32;
+
+typedef struct {
+    uint8_t    M;
+    uint16_t   numTaps;
+    float32_t *pCoeffs;
+    float32_t *pState;
+} arm_fir_decimate_instance_f32;
+
+typedef struct {
+    uint8_t  numStages;
+    q63_t   *pState;
+    q31_t   *pCoeffs;
+    uint8_t  postShift;
+} arm_biquad_cas_df1_32x64_ins_q31;
+
+typedef struct {
+    uint8_t  M;
+    uint16_t numTaps;
+    q31_t   *pCoeffs;
+    q31_t   *pState;
+} arm_fir_decimate_instance_q31;
+
+void arm_biquad_cascade_df2T_init_f32(arm_biquad_cascade_df2T_instance_f32 *S,
+                                      uint8_t                               numStages,
+                                      float32_t                            *pCoeffs,
+                                      float32_t                            *pState);
+
+void arm_biquad_cascade_df2T_f32(const arm_biquad_cascade_df2T_instance_f32 *S,
+                                 float32_t                                  *pSrc,
+                                 float32_t                                  *pDst,
+                                 uint32_t                                    blockSize);
+
+void arm_fir_init_f32(arm_fir_instance_f32 *S,
+                      uint16_t              numTaps,
+                      float32_t            *pCoeffs,
+                      float32_t            *pState,
+                      uint32_t              blockSize);
+
+void arm_fir_f32(const arm_fir_instance_f32 *S, float32_t *pSrc, float32_t *pDst, uint32_t blockSize);
+
+arm_status arm_fir_decimate_init_f32(arm_fir_decimate_instance_f32 *S,
+                                     uint16_t                       numTaps,
+                                     uint8_t                        M,
+                                     float32_t                     *pCoeffs,
+                                     float32_t                     *pState,
+                                     uint32_t                       blockSize);
+
+void arm_fir_decimate_f32(const arm_fir_decimate_instance_f32 *S,
+                          float32_t                           *pSrc,
+                          float32_t                           *pDst,
+                          uint32_t                             blockSize);
+
+void arm_biquad_cas_df1_32x64_init_q31(arm_biquad_cas_df1_32x64_ins_q31 *S,
+                                       uint8_t                           numStages,
+                                       q31_t                            *pCoeffs,
+                                       q63_t                            *pState,
+                                       uint8_t                           postShift);
+
+void arm_biquad_cas_df1_32x64_q31(const arm_biquad_cas_df1_32x64_ins_q31 *S,
+                                  q31_t                                  *pSrc,
+                                  q31_t                                  *pDst,
+                                  uint32_t                                blockSize);
+
+arm_status arm_fir_decimate_init_q31(arm_fir_decimate_instance_q31 *S,
+                                     uint16_t                       numTaps,
+                                     uint8_t                        M,
+                                     q31_t                         *pCoeffs,
+                                     q31_t                         *pState,
+                                     uint32_t                       blockSize);
+
+void arm_fir_decimate_q31(const arm_fir_decimate_instance_q31 *S,
+                          q31_t                               *pSrc,
+                          q31_t                               *pDst,
+                          uint32_t                             blockSize);
+
+void arm_mult_q31(q31_t *pSrcA, q31_t *pSrcB, q31_t *pDst, uint32_t blockSize);
+
+void arm_float_to_q31(float32_t *pSrc, q31_t *pDst, uint32_t blockSize);
+
+void arm_dot_prod_f32(float32_t *pSrcA, float32_t *pSrcB, uint32_t blockSize, float32_t *result);
+
+void arm_mult_f32(float32_t *pSrcA, float32_t *pSrcB, float32_t *pDst, uint32_t blockSize);
+
+void arm_sin_cos_f32(float32_t theta, float32_t *pSinVal, float32_t *pCosVal);
+
+void arm_max_q31(q31_t *pSrc, uint32_t blockSize, q31_t *pResult, uint32_t *pIndex);
+
+void arm_min_q31(q31_t *pSrc, uint32_t blockSize, q31_t *pResult, uint32_t *pIndex);
+
+static inline arm_status
+arm_sqrt_f32(float32_t in, float32_t *pOut)
+{
+    if (in >= 0.0f) {
+        *pOut = sqrtf(in);
+        return ARM_MATH_SUCCESS;
+    }
+
+    *pOut = 0.0f;
+    return ARM_MATH_ARGUMENT_ERROR;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CLAMPMETER_HOST_ARM_MATH_H
@@ -0,0 +1,465 @@
+//
+// Host replacement for the ASF umbrella header. The clamp_meter modules talk to
+// the hardware only through the ASF driver calls and a handful of registers;
+// this header re-declares exactly that surface and binds it to the mocked
+// peripherals in src/host/hal, so the same sources compile on a workstation.
+//
+
+#ifndef CLAMPMETER_HOST_ASF_H
+#define CLAMPMETER_HOST_ASF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNUSED(v) (void)(v)
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+/*
+ * Interrupt numbers and peripheral identifiers (SAM4E8C numbering)
+ */
+typedef enum IRQn {
+    WDT_IRQn  = 4,
+    PMC_IRQn  = 5,
+    EFC_IRQn  = 6,
+    PIOA_IRQn = 9,
+    PIOB_IRQn = 10,
+    PIOD_IRQn = 12,
+    TWI0_IRQn = 17,
+    TWI1_IRQn = 18,
+    SPI_IRQn  = 19,
+    TC0_IRQn  = 21,
+    TC1_IRQn  = 22,
+    TC2_IRQn  = 23,
+    DACC_IRQn = 32,
+
+    PERIPH_COUNT_IRQn = 46
+} IRQn_Type;
+
+#define ID_PIOA 9
+#define ID_PIOB 10
+#define ID_PIOD 12
+#define ID_TWI0 17
+#define ID_TWI1 18
+#define ID_SPI  19
+#define ID_TC0  21
+#define ID_TC1  22
+#define ID_TC2  23
+#define ID_DACC 32
+
+#define CHIP_FREQ_MAINCK_RC_4MHZ 4000000UL
+#define CHIP_FREQ_CPU_MAX        120000000UL
+
+#define IFLASH_ADDR      0x00400000u
+#define IFLASH_SIZE      0x80000u
+#define IFLASH_PAGE_SIZE 512u
+
+/*
+ * Peripheral register blocks
+ *
+ * Only the registers the firmware touches directly carry their datasheet names;
+ * the rest of the state is what the mock needs to answer driver calls.
+ */
+typedef struct {
+    uint32_t PERIPH_RPR;
+    uint32_t PERIPH_RCR;
+    uint32_t PERIPH_TPR;
+    uint32_t PERIPH_TCR;
+    uint32_t PERIPH_RNPR;
+    uint32_t PERIPH_RNCR;
+    uint32_t PERIPH_TNPR;
+    uint32_t PERIPH_TNCR;
+    uint32_t PERIPH_PTSR;
+} Pdc;
+
+#define PERIPH_PTCR_RXTEN  (0x1u << 0)
+#define PERIPH_PTCR_RXTDIS (0x1u << 1)
+#define PERIPH_PTCR_TXTEN  (0x1u << 8)
+#define PERIPH_PTCR_TXTDIS (0x1u << 9)
+#define PERIPH_PTSR_RXTEN  (0x1u << 0)
+#define PERIPH_PTSR_TXTEN  (0x1u << 8)
+
+typedef struct pdc_packet {
+    uint32_t ul_addr;
+    uint32_t ul_size;
+} pdc_packet_t;
+
+typedef struct {
+    uint32_t output;                /* ODSR */
+    uint32_t input;                 /* PDSR, driven by the host tests */
+    uint32_t output_enable;         /* OSR */
+    uint32_t output_write_enable;   /* OWSR */
+    uint32_t pull_up;
+    uint32_t pull_down;
+    uint32_t periph_mask;           /* pins handed over to a peripheral */
+    uint32_t irq_mask;              /* IMR */
+    uint32_t debounce;
+    uint32_t sync_writes;           /* number of pio_sync_output_write() calls */
+    uint32_t set_clear_writes;      /* number of pio_set()/pio_clear() calls */
+} Pio;
+
+typedef struct {
+    Pdc      pdc;
+    uint32_t SPI_MR;
+    uint32_t SPI_SR;
+    uint32_t SPI_IMR;
+    uint32_t SPI_CSR[4];
+    uint16_t rx_data;
+    bool     enabled;
+    bool     frame_active;
+    uint32_t transfers;
+} Spi;
+
+typedef struct {
+    uint32_t TC_CMR;
+    uint32_t TC_RC;
+    uint32_t TC_IMR;
+    bool     running;
+} TcChannel;
+
+typedef struct {
+    TcChannel TC_CHANNEL[3];
+    uint32_t  TC_BMR;
+} Tc;
+
+typedef struct {
+    Pdc      pdc;
+    uint32_t TWI_CR;
+    uint32_t TWI_MMR;
+    uint32_t TWI_SR;
+    uint32_t TWI_IMR;
+    uint32_t speed_hz;
+} Twi;
+
+typedef struct {
+    Pdc      pdc;
+    uint32_t DACC_MR;
+    uint32_t DACC_CHSR;
+    uint32_t DACC_IMR;
+    uint32_t DACC_ACR;
+    uint32_t trigger;
+} Dacc;
+
+typedef struct {
+    uint32_t CCFG_SYSIO;
+} Matrix;
+
+typedef struct {
+    uint32_t EEFC_FMR;
+} Efc;
+
+typedef struct {
+    uint32_t WDT_MR;
+} Wdt;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+
+extern Pio          hal_host_pioa;
+extern Pio          hal_host_piob;
+extern Pio          hal_host_piod;
+extern Spi          hal_host_spi;
+extern Tc           hal_host_tc0;
+extern Twi          hal_host_twi0;
+extern Dacc         hal_host_dacc;
+extern Matrix       hal_host_matrix;
+extern Efc          hal_host_efc;
+extern Wdt          hal_host_wdt;
+extern SysTick_Type hal_host_systick;
+
+/*
+ * DWT cycle counter. Reading DWT refreshes CYCCNT from the host's monotonic
+ * clock, in ticks of HAL_HOST_CPU_HZ, while TRCENA and CYCCNTENA are set; it
+ * measures real execution time, not the virtual time base of hal_timer.c.
+ */
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk     (0x1u << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (0x1u << 24)
+
+extern CoreDebug_Type hal_host_coredebug;
+
+DWT_Type *hal_host_dwt(void);
+
+#define PIOA      (&hal_host_pioa)
+#define PIOB      (&hal_host_piob)
+#define PIOD      (&hal_host_piod)
+#define SPI       (&hal_host_spi)
+#define TC0       (&hal_host_tc0)
+#define TWI0      (&hal_host_twi0)
+#define DACC      (&hal_host_dacc)
+#define MATRIX    (&hal_host_matrix)
+#define EFC       (&hal_host_efc)
+#define WDT       (&hal_host_wdt)
+#define SysTick   (&hal_host_systick)
+#define DWT       (hal_host_dwt())
+#define CoreDebug (&hal_host_coredebug)
+
+#define CCFG_SYSIO_SYSIO10 (0x1u << 10)
+#define CCFG_SYSIO_SYSIO11 (0x1u << 11)
+
+#define DACC_MR_CLKDIV (0x1u << 22)
+#define DACC_IMR_ENDTX (0x1u << 2)
+
+#define TWI_CR_STOP         (0x1u << 1)
+#define TWI_SR_TXCOMP       (0x1u << 0)
+#define TWI_SR_ENDTX        (0x1u << 13)
+#define TWI_MMR_DADR_Pos    16
+#define TWI_MMR_DADR_Msk    (0x7fu << TWI_MMR_DADR_Pos)
+#define TWI_MMR_DADR(value) ((TWI_MMR_DADR_Msk & ((value) << TWI_MMR_DADR_Pos)))
+
+#define PMC_MCKR_PRES_Pos 4
+
+/*
+ * NVIC
+ */
+void     NVIC_EnableIRQ(IRQn_Type irqn);
+void     NVIC_DisableIRQ(IRQn_Type irqn);
+void     NVIC_ClearPendingIRQ(IRQn_Type irqn);
+void     NVIC_SetPriority(IRQn_Type irqn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irqn);
+
+static inline void
+__disable_irq(void)
+{ }
+
+static inline void
+__enable_irq(void)
+{ }
+
+static inline void
+__DMB(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ * PIO
+ */
+typedef enum _pio_type {
+    PIO_NOT_A_PIN   = 0,
+    PIO_PERIPH_A    = (0x1u << 28),
+    PIO_PERIPH_B    = (0x2u << 28),
+    PIO_PERIPH_C    = (0x3u << 28),
+    PIO_PERIPH_D    = (0x4u << 28),
+    PIO_INPUT       = (0x5u << 28),
+    PIO_OUTPUT_0    = (0x6u << 28),
+    PIO_OUTPUT_1    = (0x7u << 28)
+} pio_type_t;
+
+#define PIO_DEFAULT      (0u << 0)
+#define PIO_PULLUP       (1u << 0)
+#define PIO_DEGLITCH     (1u << 1)
+#define PIO_OPENDRAIN    (1u << 2)
+#define PIO_DEBOUNCE     (1u << 3)
+#define PIO_IT_AIME      (1u << 4)
+#define PIO_IT_RE_OR_HL  (1u << 5)
+#define PIO_IT_EDGE      (1u << 6)
+#define PIO_IT_FALL_EDGE (0 | PIO_IT_EDGE | PIO_IT_AIME)
+#define PIO_IT_RISE_EDGE (PIO_IT_RE_OR_HL | PIO_IT_EDGE | PIO_IT_AIME)
+
+void     pio_pull_up(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_pull_up_enable);
+void     pio_pull_down(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_pull_down_enable);
+void     pio_set_peripheral(Pio *p_pio, const pio_type_t ul_type, const uint32_t ul_mask);
+void     pio_set_output(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_default_level,
+                        const uint32_t ul_multidrive_enable, const uint32_t ul_pull_up_enable);
+void     pio_set_input(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_attribute);
+void     pio_set(Pio *p_pio, const uint32_t ul_mask);
+void     pio_clear(Pio *p_pio, const uint32_t ul_mask);
+void     pio_sync_output_write(Pio *p_pio, const uint32_t ul_mask);
+void     pio_enable_output_write(Pio *p_pio, const uint32_t ul_mask);
+void     pio_disable_output_write(Pio *p_pio, const uint32_t ul_mask);
+void     pio_enable_interrupt(Pio *p_pio, const uint32_t ul_mask);
+void     pio_disable_interrupt(Pio *p_pio, const uint32_t ul_mask);
+void     pio_set_debounce_filter(Pio *p_pio, const uint32_t ul_mask, const uint32_t ul_cut_off);
+uint32_t pio_get_pin_value(uint32_t ul_pin);
+uint32_t pio_handler_set(Pio *p_pio, uint32_t ul_id, uint32_t ul_mask, uint32_t ul_attr,
+                         void (*p_handler)(uint32_t, uint32_t));
+void     pio_handler_set_priority(Pio *p_pio, IRQn_Type ul_irqn, uint32_t ul_priority);
+
+/*
+ * SPI
+ */
+typedef enum {
+    SPI_OK = 0,
+    SPI_ERROR,
+    SPI_ERROR_TIMEOUT
+} spi_status_t;
+
+typedef enum spi_cs_behavior {
+    SPI_CS_KEEP_LOW    = (0x1u << 3),
+    SPI_CS_RISE_NO_TX  = 0,
+    SPI_CS_RISE_FORCED = (0x1u << 2)
+} spi_cs_behavior_t;
+
+#define SPI_TIMEOUT          15000
+#define SPI_SR_RDRF          (0x1u << 0)
+#define SPI_SR_TDRE          (0x1u << 1)
+#define SPI_SR_ENDRX         (0x1u << 4)
+#define SPI_SR_ENDTX         (0x1u << 5)
+#define SPI_SR_RXBUFF        (0x1u << 6)
+#define SPI_SR_TXBUFE        (0x1u << 7)
+#define SPI_SR_TXEMPTY       (0x1u << 9)
+#define SPI_IER_ENDRX        SPI_SR_ENDRX
+#define SPI_IER_RXBUFF       SPI_SR_RXBUFF
+#define SPI_IDR_ENDRX        SPI_SR_ENDRX
+#define SPI_IDR_RXBUFF       SPI_SR_RXBUFF
+#define SPI_CSR_BITS_8_BIT   (0x0u << 4)
+#define SPI_CSR_BITS_16_BIT  (0x8u << 4)
+#define SPI_CSR_BITS_Msk     (0xfu << 4)
+
+spi_status_t spi_write(Spi *p_spi, uint16_t us_data, uint8_t uc_pcs, uint8_t uc_last);
+spi_status_t spi_read(Spi *p_spi, uint16_t *us_data, uint8_t *p_pcs);
+uint32_t     spi_is_tx_ready(Spi *p_spi);
+void         spi_set_lastxfer(Spi *p_spi);
+void         spi_enable(Spi *p_spi);
+void         spi_set_master_mode(Spi *p_spi);
+void         spi_disable_mode_fault_detect(Spi *p_spi);
+void         spi_configure_cs_behavior(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_cs_behavior);
+void         spi_set_bits_per_transfer(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_bits);
+int16_t      spi_set_baudrate_div(Spi *p_spi, uint32_t ul_pcs_ch, uint8_t uc_baudrate_divider);
+void         spi_set_clock_polarity(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_polarity);
+void         spi_set_clock_phase(Spi *p_spi, uint32_t ul_pcs_ch, uint32_t ul_phase);
+void         spi_set_peripheral_chip_select_value(Spi *p_spi, uint32_t ul_value);
+void         spi_set_transfer_delay(Spi *p_spi, uint32_t ul_pcs_ch, uint8_t uc_dlybs, uint8_t uc_dlybct);
+uint32_t     spi_read_status(Spi *p_spi);
+void         spi_enable_interrupt(Spi *p_spi, uint32_t ul_sources);
+void         spi_disable_interrupt(Spi *p_spi, uint32_t ul_sources);
+uint32_t     spi_read_interrupt_mask(Spi *p_spi);
+Pdc         *spi_get_pdc_base(Spi *p_spi);
+
+/*
+ * PDC
+ */
+void     pdc_tx_init(Pdc *p_pdc, pdc_packet_t *p_packet, pdc_packet_t *p_next_packet);
+void     pdc_rx_init(Pdc *p_pdc, pdc_packet_t *p_packet, pdc_packet_t *p_next_packet);
+void     pdc_enable_transfer(Pdc *p_pdc, uint32_t ul_controls);
+void     pdc_disable_transfer(Pdc *p_pdc, uint32_t ul_controls);
+uint32_t pdc_read_status(Pdc *p_pdc);
+
+/*
+ * TC
+ */
+void     tc_init(Tc *p_tc, uint32_t ul_Channel, uint32_t ul_Mode);
+void     tc_set_block_mode(Tc *p_tc, uint32_t ul_blockmode);
+void     tc_start(Tc *p_tc, uint32_t ul_channel);
+void     tc_stop(Tc *p_tc, uint32_t ul_channel);
+void     tc_write_rc(Tc *p_tc, uint32_t ul_channel, uint32_t ul_value);
+void     tc_enable_interrupt(Tc *p_tc, uint32_t ul_channel, uint32_t ul_sources);
+uint32_t tc_get_status(Tc *p_tc, uint32_t ul_channel);
+
+/*
+ * TWI
+ */
+typedef struct options {
+    uint32_t master_clk;
+    uint32_t speed;
+    uint8_t  chip;
+    bool     smbus;
+} twi_options_t;
+
+typedef struct twi_packet {
+    uint8_t  addr[3];
+    uint32_t addr_length;
+    void    *buffer;
+    uint32_t length;
+    uint8_t  chip;
+} twi_packet_t;
+
+#define TWI_SUCCESS 0
+
+uint32_t twi_master_init(Twi *p_twi, const twi_options_t *p_opt);
+uint32_t twi_set_speed(Twi *p_twi, uint32_t ul_speed, uint32_t ul_mck);
+uint32_t twi_master_read(Twi *p_twi, twi_packet_t *p_packet);
+uint32_t twi_master_write(Twi *p_twi, twi_packet_t *p_packet);
+void     twi_enable_interrupt(Twi *p_twi, uint32_t ul_sources);
+void     twi_disable_interrupt(Twi *p_twi, uint32_t ul_sources);
+uint32_t twi_get_interrupt_mask(Twi *p_twi);
+Pdc     *twi_get_pdc_base(Twi *p_twi);
+
+/*
+ * DACC
+ */
+void     dacc_reset(Dacc *p_dacc);
+void     dacc_set_transfer_mode(Dacc *p_dacc, uint32_t ul_mode);
+uint32_t dacc_set_trigger(Dacc *p_dacc, uint32_t ul_trigger);
+void     dacc_disable_trigger(Dacc *p_dacc);
+uint32_t dacc_set_timing(Dacc *p_dacc, uint32_t ul_maxs, uint32_t ul_startup);
+uint32_t dacc_set_channel_selection(Dacc *p_dacc, uint32_t ul_channel);
+void     dacc_set_analog_control(Dacc *p_dacc, uint32_t ul_analog_control);
+void     dacc_enable_channel(Dacc *p_dacc, uint32_t ul_channel);
+void     dacc_enable_interrupt(Dacc *p_dacc, uint32_t ul_interrupt_mask);
+void     dacc_disable_interrupt(Dacc *p_dacc, uint32_t ul_interrupt_mask);
+Pdc     *dacc_get_pdc_base(Dacc *p_dacc);
+
+/*
+ * PMC, EFC, WDT, sysclk, delay
+ */
+void     pmc_enable_periph_clk(uint32_t ul_id);
+uint32_t pmc_is_periph_clk_enabled(uint32_t ul_id);
+void     pmc_enable_pck(uint32_t ul_id);
+void     pmc_disable_pck(uint32_t ul_id);
+uint32_t pmc_is_pck_enabled(uint32_t ul_id);
+uint32_t pmc_switch_pck_to_mainck(uint32_t ul_id, uint32_t ul_pres);
+void     pmc_osc_enable_main_xtal(uint32_t ul_xtal_startup_time);
+uint32_t pmc_osc_is_ready_main_xtal(void);
+void     pmc_switch_mainck_to_xtal(uint32_t ul_bypass, uint32_t ul_xtal_startup_time);
+uint32_t pmc_osc_is_ready_mainck(void);
+void     pmc_enable_pllack(uint32_t mula, uint32_t pllacount, uint32_t diva);
+uint32_t pmc_is_locked_pllack(void);
+uint32_t pmc_switch_mck_to_pllack(uint32_t ul_pres);
+
+void efc_set_wait_state(Efc *p_efc, uint32_t ul_fws);
+void efc_enable_cloe(Efc *p_efc);
+void wdt_disable(Wdt *p_wdt);
+
+uint32_t sysclk_get_cpu_hz(void);
+uint32_t sysclk_get_peripheral_hz(void);
+
+void delay_ms(uint32_t ms);
+void delay_us(uint32_t us);
+
+/*
+ * Flash service
+ */
+#define FLASH_RC_OK      0
+#define FLASH_RC_INVALID 0x10
+#define FLASH_RC_ERROR   0x10
+
+uint32_t flash_unlock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end);
+uint32_t flash_lock(uint32_t ul_start, uint32_t ul_end, uint32_t *pul_actual_start, uint32_t *pul_actual_end);
+uint32_t flash_erase_page(uint32_t ul_address, uint8_t uc_page_num);
+uint32_t flash_write(uint32_t ul_address, const void *p_buffer, uint32_t ul_size, uint32_t ul_erase_flag);
+
+/*
+ * newlib extensions the firmware relies on
+ */
+char *gcvtf(float value, int ndigit, char *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CLAMPMETER_HOST_ASF_H
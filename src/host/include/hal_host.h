@@ -0,0 +1,67 @@
+//
+// Test-side controls of the mocked peripherals: attaching device models to
+// the SPI bus, raising pin interrupts, advancing the virtual clock and
+// delivering the deferred PDC/TWI completion interrupts.
+//
+
+#ifndef CLAMPMETER_HAL_HOST_H
+#define CLAMPMETER_HAL_HOST_H
+
+#include "asf.h"
+
+#define HAL_HOST_CPU_HZ 120000000UL
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SPI slave hooked to the bus. transfer() is called for every byte clocked
+ * while the chip select is low; frame_end() when it rises again.
+ */
+typedef struct {
+    uint8_t (*transfer)(void *ctx, uint8_t mosi);
+    void (*frame_end)(void *ctx);
+    void *ctx;
+} hal_spi_device_t;
+
+void hal_host_spi_attach(const hal_spi_device_t *device);
+
+/*
+ * clocks up to max_bytes of the armed SPI PDC transfer through the attached
+ * device; ENDRX/RXBUFF interrupts are delivered as they occur. Returns the
+ * number of bytes transferred, 0 once the PDC has nothing left to do.
+ */
+uint32_t hal_host_spi_pdc_run(uint32_t max_bytes);
+
+/* drives an input pin and fires the registered edge handler */
+void hal_host_pio_set_input(Pio *p_pio, uint32_t mask, bool level);
+void hal_host_pio_fire(Pio *p_pio, uint32_t mask);
+
+/*
+ * the DAC's PDC has played its packet: the next one becomes current and
+ * ENDTX is delivered, as the DAC trigger would after DACC_PACKETLEN samples
+ */
+void hal_host_dacc_packet_end(void);
+
+/* advances the virtual time base; TC0 ch0 ticks are delivered every 10 ms */
+void     hal_host_advance_us(uint32_t us);
+uint64_t hal_host_time_us(void);
+
+/* delivers interrupts the mocks have deferred (TWI TXCOMP, DACC ENDTX, ...) */
+void hal_host_poll(void);
+
+bool     hal_host_irq_is_enabled(IRQn_Type irqn);
+uint32_t hal_host_tc_rc(Tc *p_tc, uint32_t ul_channel);
+uint8_t *hal_host_flash_base(void);
+void     hal_host_flash_erase_all(void);
+uint32_t hal_host_twi_bytes_sent(void);
+
+/* restores every mock to its power-on state */
+void hal_host_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CLAMPMETER_HAL_HOST_H
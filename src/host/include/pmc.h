@@ -0,0 +1,7 @@
+//
+// Host stand-in for the ASF pmc driver header, see asf.h.
+//
+
+#pragma once
+
+#include "asf.h"
@@ -0,0 +1,7 @@
+//
+// Host stand-in for the ASF twi driver header, see asf.h.
+//
+
+#pragma once
+
+#include "asf.h"
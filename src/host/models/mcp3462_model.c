@@ -0,0 +1,218 @@
+#include <math.h>
+#include <string.h>
+
+#include "mcp3462_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MODEL_DEVICE_ADDR  0x1u
+#define MODEL_STATUS_BYTE  ((MODEL_DEVICE_ADDR << 4) | 0x3u)   /* DR, CRCCFG, POR inactive */
+#define MODEL_CMD_READ_S   0x1u
+#define MODEL_CMD_WRITE_I  0x2u
+#define MODEL_CMD_READ_I   0x3u
+
+#define MODEL_ADCDATA_ADDR 0x0u
+#define MODEL_CONFIG1_ADDR 0x2u
+#define MODEL_CONFIG2_ADDR 0x3u
+#define MODEL_MUX_ADDR     0x6u
+
+/* register widths in bytes with 24-bit ADCDATA (DATA_FORMAT 0) */
+static const uint8_t reg_width[MCP3462_MODEL_REGS_NUM] = { 3, 1, 1, 1, 1, 1, 1, 3, 3, 3, 3, 3, 3, 1, 2, 2 };
+
+static uint32_t
+model_convert(mcp3462_model_t *model)
+{
+    float   value = 0.0f;
+    int32_t code;
+
+    if (model->source != NULL)
+        value = model->source(model->source_ctx, mcp3462_model_mux(model), model->conversions);
+
+    model->conversions++;
+
+    value *= mcp3462_model_gain(model) * (float)MCP3462_MODEL_FULLSCALE;
+
+    if (value > (float)MCP3462_MODEL_FULLSCALE) {
+        code = MCP3462_MODEL_FULLSCALE;
+        model->clipped++;
+    }
+    else if (value < -(float)MCP3462_MODEL_FULLSCALE - 1.0f) {
+        code = -MCP3462_MODEL_FULLSCALE - 1;
+        model->clipped++;
+    }
+    else {
+        code = (int32_t)lrintf(value);
+    }
+
+    return (uint32_t)code & 0xFFFFFFu;
+}
+
+static void
+model_load_register(mcp3462_model_t *model)
+{
+    if (model->reg_addr == MODEL_ADCDATA_ADDR)
+        model->regs[MODEL_ADCDATA_ADDR] = model_convert(model);
+
+    model->shift = model->regs[model->reg_addr];
+}
+
+static void
+model_store_register(mcp3462_model_t *model)
+{
+    uint8_t addr = model->reg_addr;
+
+    if (addr == MODEL_ADCDATA_ADDR)
+        return;
+
+    if (addr == MODEL_CONFIG2_ADDR && model->regs[addr] != model->shift)
+        model->gain_writes++;
+    if (addr == MODEL_MUX_ADDR && model->regs[addr] != model->shift)
+        model->mux_writes++;
+
+    model->regs[addr] = model->shift;
+}
+
+static uint8_t
+model_transfer(void *ctx, uint8_t mosi)
+{
+    mcp3462_model_t *model = (mcp3462_model_t *)ctx;
+    uint8_t          miso  = 0;
+    uint8_t          width;
+
+    switch (model->phase) {
+    case MCP3462_MODEL_IDLE:
+        if ((mosi >> 6) != MODEL_DEVICE_ADDR) {
+            model->phase = MCP3462_MODEL_IGNORE;
+            return 0xFF;
+        }
+
+        model->reg_addr    = (mosi >> 2) & 0xFu;
+        model->incremental = (mosi & 0x3u) != MODEL_CMD_READ_S;
+
+        switch (mosi & 0x3u) {
+        case MODEL_CMD_READ_S:
+        case MODEL_CMD_READ_I:
+            model->phase    = MCP3462_MODEL_READ;
+            model->byte_idx = 0;
+            break;
+        case MODEL_CMD_WRITE_I:
+            model->phase    = MCP3462_MODEL_WRITE;
+            model->byte_idx = 0;
+            model->shift    = 0;
+            break;
+        default:
+            /* fast commands carry no payload */
+            model->phase = MCP3462_MODEL_IGNORE;
+            break;
+        }
+
+        return MODEL_STATUS_BYTE;
+
+    case MCP3462_MODEL_READ:
+        /* a register is latched when its first byte is clocked out */
+        if (model->byte_idx == 0)
+            model_load_register(model);
+
+        width = reg_width[model->reg_addr];
+        miso  = (uint8_t)(model->shift >> (8u * (width - 1u - model->byte_idx)));
+
+        if (++model->byte_idx == width) {
+            /* static reads loop on the same register, incremental ones move on */
+            if (model->incremental)
+                model->reg_addr = (model->reg_addr + 1u) % MCP3462_MODEL_REGS_NUM;
+
+            model->byte_idx = 0;
+        }
+
+        return miso;
+
+    case MCP3462_MODEL_WRITE:
+        width        = reg_width[model->reg_addr];
+        model->shift = (model->shift << 8) | mosi;
+
+        if (++model->byte_idx == width) {
+            model_store_register(model);
+            model->reg_addr = (model->reg_addr + 1u) % MCP3462_MODEL_REGS_NUM;
+            model->byte_idx = 0;
+            model->shift    = 0;
+        }
+
+        return 0;
+
+    default:
+        return 0xFF;
+    }
+}
+
+static void
+model_frame_end(void *ctx)
+{
+    mcp3462_model_t *model = (mcp3462_model_t *)ctx;
+
+    model->phase    = MCP3462_MODEL_IDLE;
+    model->byte_idx = 0;
+    model->shift    = 0;
+    model->frames++;
+}
+
+void
+mcp3462_model_init(mcp3462_model_t *model, mcp3462_model_source_t source, void *ctx)
+{
+    memset(model, 0, sizeof(*model));
+
+    model->source     = source;
+    model->source_ctx = ctx;
+
+    /* power-on defaults from the datasheet register map */
+    model->regs[0x1] = 0xC0;
+    model->regs[0x2] = 0x0C;
+    model->regs[0x3] = 0x8B;
+    model->regs[0x5] = 0x73;
+    model->regs[0x6] = 0x01;
+}
+
+void
+mcp3462_model_attach(mcp3462_model_t *model)
+{
+    hal_spi_device_t device = { model_transfer, model_frame_end, model };
+
+    hal_host_spi_attach(&device);
+}
+
+float
+mcp3462_model_gain(const mcp3462_model_t *model)
+{
+    uint32_t gain = (model->regs[MODEL_CONFIG2_ADDR] >> 3) & 0x7u;
+
+    return gain ? (float)(1u << (gain - 1u)) : (1.0f / 3.0f);
+}
+
+float
+mcp3462_model_rate(const mcp3462_model_t *model)
+{
+    static const uint32_t osr_ratio[] = { 32,   64,    128,   256,   512,   1024,  2048,  4096,
+                                          8192, 16384, 20480, 24576, 40960, 49152, 81920, 98304 };
+
+    uint32_t config1 = model->regs[MODEL_CONFIG1_ADDR];
+    uint32_t ratio   = osr_ratio[(config1 >> 2) & 0xFu] << ((config1 >> 6) & 0x3u);
+
+    return MCP3462_MODEL_MCLK_HZ / (4.0f * (float)ratio);
+}
+
+uint8_t
+mcp3462_model_mux(const mcp3462_model_t *model)
+{
+    return (uint8_t)model->regs[MODEL_MUX_ADDR];
+}
+
+uint32_t
+mcp3462_model_reg(const mcp3462_model_t *model, uint8_t addr)
+{
+    return model->regs[addr % MCP3462_MODEL_REGS_NUM];
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+//
+// Behavioural model of the MCP3462 SPI interface: command byte decoding,
+// incremental register writes, static/incremental reads and the 24-bit
+// ADCDATA register. Conversion results come from a user supplied source
+// evaluated at the configured MUX, scaled by the PGA gain and clipped.
+//
+
+#ifndef CLAMPMETER_MCP3462_MODEL_H
+#define CLAMPMETER_MCP3462_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCP3462_MODEL_REGS_NUM 16
+#define MCP3462_MODEL_FULLSCALE 8388607
+#define MCP3462_MODEL_MCLK_HZ   20000000.0f
+
+/*
+ * returns the differential input seen at gain 1 as a fraction of full scale;
+ * mux is the MUX register value (VIN+ << 4 | VIN-), index counts conversions
+ */
+typedef float (*mcp3462_model_source_t)(void *ctx, uint8_t mux, uint32_t index);
+
+typedef enum {
+    MCP3462_MODEL_IDLE = 0,
+    MCP3462_MODEL_READ,
+    MCP3462_MODEL_WRITE,
+    MCP3462_MODEL_IGNORE
+} mcp3462_model_phase_t;
+
+typedef struct {
+    uint32_t               regs[MCP3462_MODEL_REGS_NUM];
+    mcp3462_model_source_t source;
+    void                  *source_ctx;
+
+    mcp3462_model_phase_t  phase;
+    bool                   incremental;
+    uint8_t                reg_addr;
+    uint8_t                byte_idx;
+    uint32_t               shift;   /* register image being shifted in or out */
+
+    uint32_t               conversions;
+    uint32_t               frames;
+    uint32_t               gain_writes;
+    uint32_t               mux_writes;
+    uint32_t               clipped;
+} mcp3462_model_t;
+
+void     mcp3462_model_init(mcp3462_model_t *model, mcp3462_model_source_t source, void *ctx);
+void     mcp3462_model_attach(mcp3462_model_t *model);
+float    mcp3462_model_gain(const mcp3462_model_t *model);
+uint8_t  mcp3462_model_mux(const mcp3462_model_t *model);
+/* conversions per second at the CONFIG1 OSR and prescaler */
+float    mcp3462_model_rate(const mcp3462_model_t *model);
+uint32_t mcp3462_model_reg(const mcp3462_model_t *model, uint8_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CLAMPMETER_MCP3462_MODEL_H
@@ -0,0 +1,37 @@
+//
+// Minimal check macros for the host tests: every failed check is reported
+// with its location and counted, and the test executable returns non-zero
+// when any check failed.
+//
+
+#ifndef CLAMPMETER_HOST_TEST_H
+#define CLAMPMETER_HOST_TEST_H
+
+#include <math.h>
+#include <stdio.h>
+
+static int host_test_failures;
+
+#define HOST_CHECK(cond)                                                                    \
+    do {                                                                                    \
+        if (!(cond)) {                                                                      \
+            host_test_failures++;                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);        \
+        }                                                                                   \
+    } while (0)
+
+#define HOST_CHECK_NEAR(value, expected, tolerance)                                         \
+    do {                                                                                    \
+        double host_v_ = (double)(value);                                                   \
+        double host_e_ = (double)(expected);                                                \
+        if (!(fabs(host_v_ - host_e_) <= (double)(tolerance))) {                            \
+            host_test_failures++;                                                           \
+            fprintf(stderr, "%s:%d: %s = %g, expected %g +- %g\n", __FILE__, __LINE__,      \
+                    #value, host_v_, host_e_, (double)(tolerance));                         \
+        }                                                                                   \
+    } while (0)
+
+#define HOST_TEST_RESULT()                                                                  \
+    (host_test_failures ? (fprintf(stderr, "%d check(s) failed\n", host_test_failures), 1) : 0)
+
+#endif   // CLAMPMETER_HOST_TEST_H
@@ -0,0 +1,207 @@
+//
+// PDC driven MCP3462 acquisition: read pacing, bit-exact equivalence with the
+// per-sample interrupt path, one interrupt per block, and register writes
+// deferred to a block boundary without losing conversions.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#define TEST_WINDOWS    3
+#define TEST_DR_MASK    (1u << MCP3462_IRQ_PIN)
+
+static float
+sine_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+    (void)mux;
+
+    return 0.2f * (float)sin(2.0 * M_PI * index / SINTABLE_LEN + 0.3);
+}
+
+static void
+test_timing(void)
+{
+    uint8_t scbr   = 0;
+    uint8_t dlybct = 0;
+
+    /* 120 MHz: 6144 MCK cycles per conversion, 2048 per byte */
+    HOST_CHECK(MCP3462_stream_timing(120000000UL, &scbr, &dlybct));
+    HOST_CHECK(scbr >= MCP3462_STREAM_MIN_SCBR);
+    HOST_CHECK(3u * (8u * scbr + 32u * dlybct) == 6144u);
+
+    HOST_CHECK(MCP3462_stream_timing(60000000UL, &scbr, &dlybct));
+    HOST_CHECK(3u * (8u * scbr + 32u * dlybct) == 3072u);
+
+    /* conversion period not a whole number of MCK cycles */
+    HOST_CHECK(!MCP3462_stream_timing(119999999UL, &scbr, &dlybct));
+}
+
+static void
+test_rate_timing(void)
+{
+    MCP3462_rate_t rate;
+    uint32_t       mck = sysclk_get_peripheral_hz();
+
+    /* a byte per third of a conversion, at every rate of the sweep */
+    HOST_CHECK(MCP3462_rate_prepare(OSR_64, PRE_0, &rate));
+    HOST_CHECK(rate.ratio == 64);
+    HOST_CHECK(rate.scbr >= MCP3462_STREAM_MIN_SCBR);
+    HOST_CHECK((uint64_t)3 * (8u * rate.scbr + 32u * rate.dlybct) * MCP3462_MCLK_HZ == (uint64_t)mck * 4 * 64);
+
+    HOST_CHECK(MCP3462_rate_prepare(OSR_256, PRE_4, &rate));
+    HOST_CHECK(rate.ratio == 1024);
+    HOST_CHECK((uint64_t)3 * (8u * rate.scbr + 32u * rate.dlybct) * MCP3462_MCLK_HZ == (uint64_t)mck * 4 * 1024);
+
+    /* too slow for DLYBCT to pace */
+    HOST_CHECK(!MCP3462_rate_prepare(OSR_98304, PRE_8, &rate));
+}
+
+static void
+start(mcp3462_model_t *adc)
+{
+    hal_host_reset();
+    mcp3462_model_init(adc, sine_source, NULL);
+    mcp3462_model_attach(adc);
+
+    dsp_init();
+    reset_filters();
+}
+
+static Dsp_t
+run_per_sample(void)
+{
+    mcp3462_model_t adc;
+    uint32_t        windows = 0;
+
+    start(&adc);
+
+    while (windows < TEST_WINDOWS) {
+        adc_interrupt_handler(ID_PIOA, TEST_DR_MASK);
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready) {
+            clamp_measurements_result.new_data_is_ready = false;
+            windows++;
+        }
+    }
+
+    return clamp_measurements_result;
+}
+
+static Dsp_t
+run_stream(void)
+{
+    mcp3462_model_t        adc;
+    MCP3462_stream_stats_t stats;
+    uint32_t               windows = 0;
+    uint32_t               bytes   = 0;
+
+    start(&adc);
+    dsp_acquisition_start();
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_ARMED);
+
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_RUNNING);
+
+    while (windows < TEST_WINDOWS && bytes < 10000000) {
+        bytes += hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES);
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready) {
+            clamp_measurements_result.new_data_is_ready = false;
+            windows++;
+        }
+    }
+
+    stats = MCP3462_stream_stats();
+
+    /* one command byte per resync, then data only */
+    HOST_CHECK(adc.frames == 0);
+    HOST_CHECK(stats.resyncs == 1);
+    HOST_CHECK(stats.samples == stats.blocks * MCP3462_STREAM_BLOCKLEN);
+    HOST_CHECK(bytes == adc.conversions * MCP3462_SAMPLE_BYTES);
+    HOST_CHECK(test_counter_adc == stats.samples);
+
+    dsp_acquisition_stop();
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_IDLE);
+    HOST_CHECK(adc.frames == 1);
+
+    return clamp_measurements_result;
+}
+
+static void
+test_equivalence(void)
+{
+    Dsp_t reference = run_per_sample();
+    Dsp_t streamed  = run_stream();
+
+    /* same samples through the same filters: results are bit identical */
+    HOST_CHECK(streamed.V_ovrl == reference.V_ovrl);
+    HOST_CHECK(streamed.V_ovrl_phi == reference.V_ovrl_phi);
+    HOST_CHECK(streamed.degree == reference.degree);
+}
+
+static void
+test_deferred_register_write(void)
+{
+    mcp3462_model_t        adc;
+    MCP3462_stream_stats_t stats;
+    uint32_t               csr_before;
+    uint32_t               guard = 0;
+
+    start(&adc);
+    csr_before = SPI->SPI_CSR[0];
+
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES * MCP3462_STREAM_BLOCKLEN / 2);
+    HOST_CHECK(SPI->SPI_CSR[0] != csr_before);
+
+    MCP3462_set_gain(GAIN_2);
+    MCP3462_set_mux(REF_CH2, REF_CH3);
+    HOST_CHECK(adc.gain_writes == 0);
+    HOST_CHECK(adc.mux_writes == 0);
+
+    /* the ring drains at the next block boundary, then waits for data ready */
+    while (MCP3462_stream_state() != MCP3462_STREAM_ARMED && guard++ < 1000)
+        hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES);
+
+    stats = MCP3462_stream_stats();
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_ARMED);
+    HOST_CHECK(stats.blocks == 2);
+    HOST_CHECK(adc.conversions == stats.samples);
+    HOST_CHECK(SPI->SPI_CSR[0] == csr_before);
+    HOST_CHECK(hal_host_spi_pdc_run(1) == 0);
+
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_RUNNING);
+    HOST_CHECK(adc.gain_writes == 1);
+    HOST_CHECK(adc.mux_writes == 1);
+    HOST_CHECK(mcp3462_model_gain(&adc) == 2.0f);
+    HOST_CHECK(mcp3462_model_mux(&adc) == ((REF_CH2 << 4) | REF_CH3));
+    HOST_CHECK(MCP3462_stream_stats().resyncs == 2);
+
+    hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES * MCP3462_STREAM_BLOCKLEN);
+    HOST_CHECK(MCP3462_stream_stats().blocks == 3);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_timing();
+    test_rate_timing();
+    test_equivalence();
+    test_deferred_register_write();
+
+    return HOST_TEST_RESULT();
+}
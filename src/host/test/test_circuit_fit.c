@@ -0,0 +1,380 @@
+//
+// Equivalent circuit fit on synthetic impedances: each model comes back with
+// its own components and a zero residual and is picked as the best one, the
+// others don't fit; loads from ohms to megohms, a single point, noisy points
+// and unusable input. Then the fits of a sweep's spectrum, and the ones the
+// result path keeps with every reading of an RC load (two points with
+// DSP_DUAL_TONE, the excitation alone otherwise).
+//
+
+#include <complex.h>
+#include <math.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "circuit_fit.h"
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+#include "sweep.h"
+
+#define TEST_POINTS    5
+#define TEST_TOLERANCE 1e-4
+
+/*
+ * the reading: the generator drives R_SHUNT in series with TEST_R_LOAD ||
+ * TEST_C_LOAD, the clamp is around the capacitor lead and gives
+ * TEST_CLAMP_OHMS volts per amp
+ */
+#define TEST_DR_MASK            (1u << MCP3462_IRQ_PIN)
+#define TEST_V_TONE             0.1
+#define TEST_R_LOAD             1000.0
+#define TEST_C_LOAD             180e-9
+#define TEST_CLAMP_OHMS         1000.0
+#define TEST_OVERALL_GAIN       1
+#define TEST_BLOCKS             300
+#define TEST_READING_TOLERANCE  0.01
+
+static const double test_freq_hz[TEST_POINTS] = { 222, 444, 888, 1776, 3551 };
+
+typedef double complex (*test_load_t)(double omega, double R, double reactive);
+
+static double complex
+series_rc(double omega, double R, double C)
+{
+    return R + 1.0 / (J * omega * C);
+}
+
+static double complex
+parallel_rc(double omega, double R, double C)
+{
+    return 1.0 / (1.0 / R + J * omega * C);
+}
+
+static double complex
+series_rl(double omega, double R, double L)
+{
+    return R + J * omega * L;
+}
+
+/* as the readings give them: |Z| and the angle of the admittance */
+static void
+make_points(test_load_t load, double R, double reactive, double noise, Circuit_point_t *points, uint32_t count)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < count; idx++) {
+        double complex Z = load(2.0 * M_PI * test_freq_hz[idx], R, reactive);
+
+        /* alternating, so it can't be taken up by a component */
+        Z *= 1.0 + ((idx & 1) ? noise : -noise) * (1.0 + J);
+
+        points[idx] = circuit_point((float32_t)test_freq_hz[idx], (float32_t)cabs(Z), (float32_t)(-carg(Z) * 180.0 / M_PI));
+    }
+}
+
+static void
+check_exact(test_load_t load, Circuit_model_t model, double R, double reactive)
+{
+    Circuit_point_t  points[TEST_POINTS];
+    Circuit_result_t result;
+    Circuit_model_t  other;
+
+    make_points(load, R, reactive, 0, points, TEST_POINTS);
+
+    HOST_CHECK(circuit_fit(points, TEST_POINTS, &result));
+    HOST_CHECK(result.has_best);
+    HOST_CHECK(result.best == model);
+    HOST_CHECK(result.model[model].valid);
+    HOST_CHECK_NEAR(result.model[model].R, R, TEST_TOLERANCE * R);
+    HOST_CHECK_NEAR(result.model[model].reactive, reactive, TEST_TOLERANCE * reactive);
+    HOST_CHECK(result.model[model].residual < TEST_TOLERANCE);
+
+    /* over a decade and more of frequency the wrong models are off by far more */
+    for (other = CIRCUIT_SERIES_RC; other < CIRCUIT_MODELS; other++)
+        if (other != model)
+            HOST_CHECK(!result.model[other].valid || result.model[other].residual > 0.05);
+}
+
+static void
+test_models(void)
+{
+    check_exact(series_rc, CIRCUIT_SERIES_RC, 1000, 180e-9);
+    check_exact(parallel_rc, CIRCUIT_PARALLEL_RC, 1000, 180e-9);
+    check_exact(series_rl, CIRCUIT_SERIES_RL, 10, 1e-3);
+
+    /* far from the scale the sums are formed at */
+    check_exact(series_rc, CIRCUIT_SERIES_RC, 2, 100e-6);
+    check_exact(parallel_rc, CIRCUIT_PARALLEL_RC, 1e6, 1e-9);
+    check_exact(series_rl, CIRCUIT_SERIES_RL, 0.5, 20e-6);
+}
+
+/* two unknowns from two values: every model that comes out physical fits one point exactly */
+static void
+test_single_point(void)
+{
+    Circuit_point_t  point;
+    Circuit_result_t result;
+    double           omega = 2.0 * M_PI * test_freq_hz[0];
+    double complex   Z     = series_rc(omega, 1000, 1e-6);
+
+    make_points(series_rc, 1000, 1e-6, 0, &point, 1);
+
+    HOST_CHECK(circuit_fit(&point, 1, &result));
+    HOST_CHECK(result.model[CIRCUIT_SERIES_RC].valid);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].valid);
+    HOST_CHECK(!result.model[CIRCUIT_SERIES_RL].valid);
+    HOST_CHECK(result.model[CIRCUIT_SERIES_RC].residual < TEST_TOLERANCE);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].residual < TEST_TOLERANCE);
+
+    /* the parallel equivalent of the same impedance */
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].R, 1.0 / creal(1.0 / Z), TEST_TOLERANCE / creal(1.0 / Z));
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].reactive,
+                    cimag(1.0 / Z) / omega,
+                    TEST_TOLERANCE * cimag(1.0 / Z) / omega);
+}
+
+/* a lossless capacitor: no series resistance, no parallel one */
+static void
+test_pure_capacitor(void)
+{
+    Circuit_point_t  points[TEST_POINTS];
+    Circuit_result_t result;
+
+    make_points(series_rc, 0, 47e-9, 0, points, TEST_POINTS);
+
+    HOST_CHECK(circuit_fit(points, TEST_POINTS, &result));
+    HOST_CHECK(result.model[CIRCUIT_SERIES_RC].valid);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].valid);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_SERIES_RC].R, 0, 1e-3);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_SERIES_RC].reactive, 47e-9, TEST_TOLERANCE * 47e-9);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].R > 1e6);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].reactive, 47e-9, TEST_TOLERANCE * 47e-9);
+}
+
+/* 1 % noise on every point: the components within a few %, the residual about the noise */
+static void
+test_noise(void)
+{
+    Circuit_point_t  points[TEST_POINTS];
+    Circuit_result_t result;
+
+    make_points(parallel_rc, 1000, 180e-9, 0.01, points, TEST_POINTS);
+
+    HOST_CHECK(circuit_fit(points, TEST_POINTS, &result));
+    HOST_CHECK(result.has_best && result.best == CIRCUIT_PARALLEL_RC);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].R, 1000, 30);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].reactive, 180e-9, 0.03 * 180e-9);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].residual > 0.005);
+    HOST_CHECK(result.model[CIRCUIT_PARALLEL_RC].residual < 0.03);
+}
+
+static void
+test_bad_input(void)
+{
+    Circuit_point_t  points[CIRCUIT_FIT_MAX_POINTS + 1] = { 0 };
+    Circuit_result_t result;
+
+    make_points(series_rc, 1000, 1e-6, 0, points, 2);
+
+    HOST_CHECK(!circuit_fit(points, 0, &result));
+    HOST_CHECK(!circuit_fit(points, CIRCUIT_FIT_MAX_POINTS + 1, &result));
+    HOST_CHECK(!result.has_best);
+
+    /* no reading yet */
+    points[1] = circuit_point(444, 0, 0);
+    HOST_CHECK(!circuit_fit(points, 2, &result));
+
+    points[1] = circuit_point(0, 1000, 0);
+    HOST_CHECK(!circuit_fit(points, 2, &result));
+
+    /* the same frequency twice only gives one point's worth: still solvable */
+    points[1] = points[0];
+    HOST_CHECK(circuit_fit(points, 2, &result));
+    HOST_CHECK(result.model[CIRCUIT_SERIES_RC].valid);
+}
+
+/* a finished sweep of the parallel RC, one point of it lost */
+static void
+test_spectrum(void)
+{
+    Circuit_result_t result;
+    uint8_t          step;
+
+    Sweep.state = SWEEP_RATE;
+    HOST_CHECK(!circuit_fit_spectrum(false, &result));
+    HOST_CHECK(!result.has_best);
+
+    for (step = 0; step < SWEEP_POINTS; step++) {
+        Sweep_point_t *point = &Sweep.spectrum[step];
+        double         omega = 2.0 * M_PI * test_freq_hz[step];
+        double complex Z     = parallel_rc(omega, TEST_R_LOAD, TEST_C_LOAD);
+
+        point->freq_hz     = (float32_t)test_freq_hz[step];
+        point->data_lost   = false;
+        point->Z_ovrl      = (float32_t)cabs(Z);
+        point->Z_ovrl_phi  = (float32_t)(-carg(Z) * 180.0 / M_PI);
+        point->Z_clamp     = (float32_t)(1.0 / (omega * TEST_C_LOAD));
+        point->Z_clamp_phi = 90;
+    }
+
+    /* its window had a gap: left out */
+    Sweep.spectrum[2].data_lost = true;
+    Sweep.spectrum[2].Z_ovrl    = 1;
+    Sweep.state                 = SWEEP_DONE;
+
+    /* the load is told apart from a series RC by its spectrum */
+    HOST_CHECK(circuit_fit_spectrum(false, &result));
+    HOST_CHECK(result.has_best && result.best == CIRCUIT_PARALLEL_RC);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].R, TEST_R_LOAD, TEST_TOLERANCE * TEST_R_LOAD);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_PARALLEL_RC].reactive, TEST_C_LOAD, TEST_TOLERANCE * TEST_C_LOAD);
+
+    /* the clamp branch is the capacitor alone */
+    HOST_CHECK(circuit_fit_spectrum(true, &result));
+    HOST_CHECK_NEAR(result.model[CIRCUIT_SERIES_RC].R, 0, 1e-3);
+    HOST_CHECK_NEAR(result.model[CIRCUIT_SERIES_RC].reactive, TEST_C_LOAD, TEST_TOLERANCE * TEST_C_LOAD);
+
+    Sweep.state = SWEEP_IDLE;
+}
+
+static double
+tone_frequency(uint32_t bin)
+{
+    return MCP3462_MODEL_MCLK_HZ / (4.0 * MCP3462_OSR_RATIO * MCP3462_PRE_RATIO * SINTABLE_LEN) * bin;
+}
+
+/* one tone of the sensor behind mux; the lock-in reads Re(p) cos + Im(p) sin as the phasor p */
+static double
+tone_sample(uint8_t mux, uint32_t index, uint32_t bin)
+{
+    double         omega     = 2.0 * M_PI * tone_frequency(bin);
+    double         phase     = 2.0 * M_PI * bin * index / SINTABLE_LEN;
+    double complex Y_load    = 1.0 / parallel_rc(omega, TEST_R_LOAD, TEST_C_LOAD);
+    double complex V_applied = TEST_V_TONE / (1.0 + R_SHUNT * Y_load);
+    double complex p;
+
+    switch (mux >> 4) {
+    case REF_CH4: p = TEST_V_TONE; break;
+    case REF_CH2: p = TEST_V_TONE - V_applied; break;
+    case REF_CH0: p = TEST_CLAMP_OHMS * J * omega * TEST_C_LOAD * V_applied; break;
+    default: return 0;
+    }
+
+    return creal(p) * cos(phase) + cimag(p) * sin(phase);
+}
+
+static float
+load_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+
+#ifdef DSP_DUAL_TONE
+    return (float)(tone_sample(mux, index, 1) + tone_sample(mux, index, DUAL_TONE_BIN));
+#else
+    return (float)tone_sample(mux, index, 1);
+#endif
+}
+
+/* a lock-in output of FS / 2 per unit of input reads as 1 V (1 A) */
+static void
+setup_calibration(void)
+{
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+    Cal_data.shunt_gain[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]] = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.shunt_phi[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]]  = 0;
+    Cal_data.clamp_gain[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] =
+        (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * TEST_CLAMP_OHMS);
+    Cal_data.clamp_phi[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] = 0;
+    dsp_calibration_changed();
+}
+
+static void
+run_blocks(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+/* every reading of the shunt and of the clamp refits their branch */
+static void
+test_reading(void)
+{
+    mcp3462_model_t         adc;
+    const Circuit_result_t *fit;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, load_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    Analog.overall_gain = TEST_OVERALL_GAIN;
+    measurement_set_profile(DSP_PROFILE_FAST);
+    measurement_set_mode(MEASUREMENT_MODE_SCAN);
+    HOST_CHECK(!clamp_measurements_result.fit_ovrl.has_best);
+    HOST_CHECK(!clamp_measurements_result.fit_clamp.has_best);
+
+    run_blocks(&adc, TEST_BLOCKS);
+
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(clamp_measurements_result.result_is_final);
+
+    /* one point fits either RC exactly: each is the equivalent of the load at the excitation */
+    fit = &clamp_measurements_result.fit_ovrl;
+    HOST_CHECK(fit->has_best);
+    HOST_CHECK(fit->model[CIRCUIT_PARALLEL_RC].valid);
+    HOST_CHECK_NEAR(fit->model[CIRCUIT_PARALLEL_RC].R, TEST_R_LOAD, TEST_READING_TOLERANCE * TEST_R_LOAD);
+    HOST_CHECK_NEAR(fit->model[CIRCUIT_PARALLEL_RC].reactive, TEST_C_LOAD, TEST_READING_TOLERANCE * TEST_C_LOAD);
+#ifdef DSP_DUAL_TONE
+    /* the second tone tells them apart */
+    HOST_CHECK(fit->best == CIRCUIT_PARALLEL_RC);
+    HOST_CHECK(fit->model[CIRCUIT_PARALLEL_RC].residual < TEST_READING_TOLERANCE);
+    HOST_CHECK(!fit->model[CIRCUIT_SERIES_RC].valid || fit->model[CIRCUIT_SERIES_RC].residual > 0.05);
+#endif
+
+    fit = &clamp_measurements_result.fit_clamp;
+    HOST_CHECK(fit->has_best);
+    HOST_CHECK(fit->model[CIRCUIT_SERIES_RC].valid);
+    HOST_CHECK_NEAR(fit->model[CIRCUIT_SERIES_RC].R, 0, TEST_READING_TOLERANCE / (2.0 * M_PI * tone_frequency(1) * TEST_C_LOAD));
+    HOST_CHECK_NEAR(fit->model[CIRCUIT_SERIES_RC].reactive, TEST_C_LOAD, TEST_READING_TOLERANCE * TEST_C_LOAD);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_models();
+    test_single_point();
+    test_pure_capacitor();
+    test_noise();
+    test_bad_input();
+    test_spectrum();
+    test_reading();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,45 @@
+//
+// Smoke test of the ILI9486 driver and the measurement page: initialisation,
+// a full clear and a refresh must run against the mocked parallel bus and
+// actually toggle the display control lines.
+//
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "ILI9486_public.h"
+#include "ILI9486_config.h"
+#include "menu_ili9486.h"
+
+static uint32_t
+bus_writes(void)
+{
+    return PIOA->sync_writes + PIOA->set_clear_writes + PIOB->sync_writes + PIOB->set_clear_writes +
+           PIOD->sync_writes + PIOD->set_clear_writes;
+}
+
+int
+main(void)
+{
+    uint32_t after_clear;
+    uint32_t after_init;
+
+    hal_host_reset();
+
+    TFT_Init();
+    TFT_Clear(COLOR_BLACK);
+    after_clear = bus_writes();
+    HOST_CHECK(after_clear > 320u * 480u);
+
+    display_init();
+    after_init = bus_writes();
+    HOST_CHECK(after_init > after_clear);
+
+    display_refresh();
+    HOST_CHECK(bus_writes() > after_init);
+
+    /* chip select is released after every transaction */
+    HOST_CHECK((TFT_CS_PIO->output & TFT_CS_PIN) != 0);
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,165 @@
+//
+// Predictive AGC: from the peak of one block and the gain ladder the shunt
+// goes straight to the overall_gain that puts the peak at AGC_TARGET_LEVEL,
+// once from far too low and once from clipping, and then stays there.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+/* a peak of 30000 counts at GAIN_1V3 */
+#define TEST_LOW_LEVEL      (3 * 30000.0 / MCP3462_MODEL_FULLSCALE)
+#define TEST_HIGH_LEVEL     (20 * TEST_LOW_LEVEL)
+#define TEST_RANGE_BLOCKS   8
+#define TEST_STABLE_BLOCKS  200
+
+/* the shunt amplifier of the model, per front-end setting */
+static const double fe_gain[] = { 1, 2, 5, 10, 20 };
+
+static double level;
+
+static float
+shunt_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+
+    if (mux >> 4 != REF_CH2)
+        return 0;
+
+    return (float)(level * fe_gain[Analog.shunt_sensor_gain] * sin(2.0 * M_PI * index / SINTABLE_LEN));
+}
+
+static void
+setup_calibration(void)
+{
+    uint8_t gain;
+
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+
+    for (gain = 0; gain < sizeof(fe_gain) / sizeof(fe_gain[0]); gain++) {
+        Cal_data.shunt_gain[gain] = (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * fe_gain[gain]);
+        Cal_data.shunt_phi[gain]  = 0;
+    }
+
+    dsp_calibration_changed();
+}
+
+/* the highest step whose peak is at most AGC_TARGET_LEVEL, for the true input */
+static uint8_t
+expected_gain(void)
+{
+    uint8_t target = 0;
+    uint8_t gain;
+    double  peak;
+
+    for (gain = 0; gain <= SHUNT_SENSOR_MAX_OVERALL_GAIN; gain++) {
+        peak = level * MCP3462_MODEL_FULLSCALE * fe_gain[shunt_sensor_gain_preset[gain]] *
+               adc_gain_coeffs[shunt_sensor_adc_gain_preset[gain]];
+
+        if (peak <= AGC_TARGET_LEVEL)
+            target = gain;
+    }
+
+    return target;
+}
+
+/* streams blocks, realigning on data ready; returns the number of overall_gain moves */
+static uint32_t
+run(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end   = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+    uint8_t  gain  = Analog.overall_gain;
+    uint32_t moves = 0;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+
+        if (Analog.overall_gain != gain) {
+            gain = Analog.overall_gain;
+            moves++;
+        }
+    }
+
+    return moves;
+}
+
+static void
+test_agc(void)
+{
+    mcp3462_model_t adc;
+    uint32_t        clipped;
+    uint8_t         gain;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, shunt_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    switch_sensing_chanel(SHUNT_SENSOR);
+    Analog.overall_gain = 1;
+    decrease_gain();
+    HOST_CHECK(Analog.overall_gain == 0);
+    HOST_CHECK(Analog.AGC_on);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    /* far too low: one move up, instead of one step per settle time */
+    level = TEST_LOW_LEVEL;
+    HOST_CHECK(run(&adc, TEST_RANGE_BLOCKS) == 1);
+    HOST_CHECK(Analog.overall_gain == expected_gain());
+    HOST_CHECK(Analog.overall_gain > 1);
+
+    /* and no hunting inside the band */
+    HOST_CHECK(run(&adc, TEST_STABLE_BLOCKS) == 0);
+    HOST_CHECK(Analog.ampl_peak > AMPLITUDE_TOO_LOW_LIMIT);
+    HOST_CHECK(Analog.ampl_peak < AMPLITUDE_TOO_HIGH_LIMIT);
+    HOST_CHECK(mcp3462_model_gain(&adc) == adc_gain_coeffs[Analog.adc_gain]);
+
+    /* clipping: the peak is only a lower bound, still one move down here, into the band */
+    clipped = adc.clipped;
+    gain    = Analog.overall_gain;
+    level   = TEST_HIGH_LEVEL;
+    HOST_CHECK(run(&adc, TEST_RANGE_BLOCKS) == 1);
+    HOST_CHECK(adc.clipped > clipped);
+    HOST_CHECK(Analog.overall_gain < gain);
+
+    clipped = adc.clipped;
+    HOST_CHECK(run(&adc, TEST_STABLE_BLOCKS) == 0);
+    HOST_CHECK(adc.clipped == clipped);
+    HOST_CHECK(Analog.ampl_peak > AMPLITUDE_TOO_LOW_LIMIT);
+    HOST_CHECK(Analog.ampl_peak < AMPLITUDE_TOO_HIGH_LIMIT);
+
+    /* manual gain: the peak is still measured, nothing moves */
+    Analog.AGC_on = false;
+    level         = TEST_LOW_LEVEL;
+    HOST_CHECK(run(&adc, TEST_RANGE_BLOCKS) == 0);
+    HOST_CHECK(Analog.ampl_is_too_low);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_agc();
+
+    return HOST_TEST_RESULT();
+}
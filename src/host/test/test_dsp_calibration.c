@@ -0,0 +1,107 @@
+//
+// Calibration cache: the factors are 1 / gain * e^(-j phi) of the selected
+// gains, they are built once per gain state and not per result, and a change
+// of any gain or of Cal_data gives new factors.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+void manage_sensed_data(float32_t sin_vect, float32_t cos_vect);
+
+static void
+check_factor(const Dsp_cal_factor_t *factor, double gain, double phi)
+{
+    HOST_CHECK_NEAR(factor->gain_inv, 1.0 / gain, 1e-6 / gain);
+    HOST_CHECK_NEAR(factor->correction.I, cos(-phi * M_PI / 180.0) / gain, 1e-5 / gain);
+    HOST_CHECK_NEAR(factor->correction.Q, sin(-phi * M_PI / 180.0) / gain, 1e-5 / gain);
+}
+
+static void
+setup(void)
+{
+    hal_host_reset();
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Analog.adc_gain                = GAIN_2;
+    Analog.shunt_sensor_gain       = 1;
+    Analog.clamp_sensor_gain       = 2;
+    Cal_data.v_sens_gain           = 150000.0f;
+    Cal_data.v_sens_phi            = 12.5f;
+    Cal_data.shunt_gain[0]         = 9000.0f;
+    Cal_data.shunt_phi[0]          = -3.0f;
+    Cal_data.shunt_gain[1]         = 90000.0f;
+    Cal_data.shunt_phi[1]          = -7.0f;
+    Cal_data.clamp_gain[2]         = 4.0e7f;
+    Cal_data.clamp_phi[2]          = 200.0f;
+    dsp_calibration_changed();
+}
+
+static void
+test_factors(void)
+{
+    double adc_gain;
+
+    setup();
+    adc_gain = adc_gain_coeffs[Analog.adc_gain];
+
+    check_factor(dsp_calibration(VOLTAGE_SENSOR), 150000.0 * adc_gain, 12.5);
+    check_factor(dsp_calibration(SHUNT_SENSOR), 90000.0 * adc_gain, -7.0);
+    check_factor(dsp_calibration(CLAMP_SENSOR), 4.0e7 * adc_gain, 200.0);
+
+    /* the clamp position gain is part of the clamp factor */
+    Clamp_calibrator.is_calibrated = true;
+    Clamp_calibrator.position_gain = 1.25f;
+    check_factor(dsp_calibration(CLAMP_SENSOR), 4.0e7 * adc_gain / 1.25, 200.0);
+}
+
+static void
+test_rebuilds(void)
+{
+    uint32_t rebuilds;
+    uint32_t idx;
+
+    setup();
+    dsp_calibration(VOLTAGE_SENSOR);
+    rebuilds = dsp_calibration_rebuilds();
+
+    /* results of every sensor in turn, all with the same gains */
+    for (idx = 0; idx < 30; idx++) {
+        Analog.selected_sensor = (sensor_type_t)(idx % 3);
+        manage_sensed_data(0.01f, 0.02f);
+    }
+    HOST_CHECK(dsp_calibration_rebuilds() == rebuilds);
+
+    /* a gain switch by the AGC */
+    Analog.adc_gain = GAIN_4;
+    check_factor(dsp_calibration(VOLTAGE_SENSOR), 150000.0 * adc_gain_coeffs[GAIN_4], 12.5);
+    HOST_CHECK(dsp_calibration_rebuilds() == rebuilds + 1);
+
+    Analog.shunt_sensor_gain = 0;
+    check_factor(dsp_calibration(SHUNT_SENSOR), 9000.0 * adc_gain_coeffs[GAIN_4], -3.0);
+    HOST_CHECK(dsp_calibration_rebuilds() == rebuilds + 2);
+    dsp_calibration(CLAMP_SENSOR);
+    HOST_CHECK(dsp_calibration_rebuilds() == rebuilds + 2);
+
+    /* new calibration data is only seen after it is announced */
+    Cal_data.v_sens_gain = 160000.0f;
+    dsp_calibration_changed();
+    check_factor(dsp_calibration(VOLTAGE_SENSOR), 160000.0 * adc_gain_coeffs[GAIN_4], 12.5);
+    HOST_CHECK(dsp_calibration_rebuilds() == rebuilds + 3);
+}
+
+int
+main(void)
+{
+    test_factors();
+    test_rebuilds();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,157 @@
+//
+// CIC front end: the demodulated amplitude of a sine at the excitation
+// frequency, the sinc^N response around it, the same outputs however the
+// input is cut, no overflow at full scale, and a flat passband once the
+// compensation FIR is applied.
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_cic.h"
+
+#define TEST_FULLSCALE 8388607.0
+#define TEST_SAMPLES   (40 * BIQUAD1_BUFFSIZE)
+#define TEST_OUTPUTS   (TEST_SAMPLES / FIR_DEC_FACTOR)
+/* CIC_ORDER outputs to fill the combs */
+#define TEST_SETTLE    (CIC_ORDER + 1)
+
+static int32_t   raw[TEST_SAMPLES];
+static float32_t sin_out[TEST_OUTPUTS];
+static float32_t cos_out[TEST_OUTPUTS];
+
+/* sine at the excitation frequency plus offset (in cycles per ADC sample) */
+static void
+fill(double amplitude, double offset)
+{
+    uint32_t n;
+
+    for (n = 0; n < TEST_SAMPLES; n++)
+        raw[n] = (int32_t)lround(amplitude * TEST_FULLSCALE *
+                                 sin(2.0 * M_PI * (1.0 / SINTABLE_LEN + offset) * n + 0.5));
+}
+
+static uint32_t
+run(uint32_t chunk)
+{
+    Cic_t    cic;
+    uint32_t done    = 0;
+    uint32_t outputs = 0;
+    uint32_t len;
+
+    dsp_cic_reset(&cic);
+
+    while (done < TEST_SAMPLES) {
+        len = (TEST_SAMPLES - done < chunk) ? (TEST_SAMPLES - done) : chunk;
+        outputs += dsp_cic_process(&cic, &raw[done], done % SINTABLE_LEN, len, &sin_out[outputs], &cos_out[outputs]);
+        done += len;
+    }
+
+    return outputs;
+}
+
+static double
+cic_response(double f)
+{
+    if (f == 0)
+        return 1;
+
+    return pow(sin(M_PI * f * FIR_DEC_FACTOR) / (FIR_DEC_FACTOR * sin(M_PI * f)), CIC_ORDER);
+}
+
+static double
+comp_response(double f)
+{
+    double   re = 0;
+    double   im = 0;
+    uint32_t k;
+
+    /* f in cycles per ADC sample, the FIR runs at the decimated rate */
+    for (k = 0; k < CIC_COMP_NCOEFFS; k++) {
+        re += cic_comp_coeffs[k] * cos(2.0 * M_PI * f * FIR_DEC_FACTOR * k);
+        im -= cic_comp_coeffs[k] * sin(2.0 * M_PI * f * FIR_DEC_FACTOR * k);
+    }
+
+    return sqrt(re * re + im * im);
+}
+
+/* magnitude of the demodulated vector after the CIC has settled */
+static void
+test_response(double amplitude, double offset)
+{
+    double   half = amplitude * TEST_FULLSCALE / 2.0;
+    double   expected = half * fabs(cic_response(offset));
+    uint32_t idx;
+
+    fill(amplitude, offset);
+    HOST_CHECK(run(BIQUAD1_BUFFSIZE) == TEST_OUTPUTS);
+
+    for (idx = TEST_SETTLE; idx < TEST_OUTPUTS; idx++) {
+        double mag = sqrt((double)sin_out[idx] * sin_out[idx] + (double)cos_out[idx] * cos_out[idx]);
+
+        /* what is left of the 2f product and the reference rounding */
+        HOST_CHECK_NEAR(mag, expected, half * 2e-4);
+    }
+}
+
+static void
+test_split(void)
+{
+    float32_t ref_sin[TEST_OUTPUTS];
+    float32_t ref_cos[TEST_OUTPUTS];
+    uint32_t  chunks[] = { 1, 7, SINTABLE_LEN, 37 };
+    uint32_t  idx;
+
+    fill(0.3, 0.001);
+    run(BIQUAD1_BUFFSIZE);
+    memcpy(ref_sin, sin_out, sizeof(ref_sin));
+    memcpy(ref_cos, cos_out, sizeof(ref_cos));
+
+    for (idx = 0; idx < sizeof(chunks) / sizeof(chunks[0]); idx++) {
+        HOST_CHECK(run(chunks[idx]) == TEST_OUTPUTS);
+        HOST_CHECK(memcmp(ref_sin, sin_out, sizeof(ref_sin)) == 0);
+        HOST_CHECK(memcmp(ref_cos, cos_out, sizeof(ref_cos)) == 0);
+    }
+}
+
+int
+main(void)
+{
+    double   offsets[] = { 0, 0.001, 0.005, 0.01, 0.02 };
+    uint32_t idx;
+    double   sum = 0;
+
+    dsp_cic_init();
+
+    /* exact phase: the vector of a sine at 0.5 rad */
+    fill(0.2, 0);
+    run(BIQUAD1_BUFFSIZE);
+    HOST_CHECK_NEAR(sin_out[TEST_OUTPUTS - 1], 0.1 * TEST_FULLSCALE * cos(0.5), 0.1 * TEST_FULLSCALE * 2e-4);
+    HOST_CHECK_NEAR(cos_out[TEST_OUTPUTS - 1], 0.1 * TEST_FULLSCALE * sin(0.5), 0.1 * TEST_FULLSCALE * 2e-4);
+
+    for (idx = 0; idx < sizeof(offsets) / sizeof(offsets[0]); idx++)
+        test_response(0.2, offsets[idx]);
+
+    /* the integrators wrap around, the outputs must not */
+    test_response(1.0, 0);
+    test_response(1.0, 0.005);
+
+    test_split();
+
+    /* compensation: unity at DC, flat to 0.01 dB up to a quarter of the decimated rate */
+    for (idx = 0; idx < CIC_COMP_NCOEFFS; idx++)
+        sum += cic_comp_coeffs[idx];
+
+    HOST_CHECK_NEAR(sum, 1.0, 1e-6);
+
+    for (idx = 0; idx <= 25; idx++) {
+        double f = idx * 0.001;
+
+        HOST_CHECK_NEAR(20.0 * log10(fabs(cic_response(f)) * comp_response(f)), 0.0, 0.01);
+    }
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,194 @@
+//
+// Whole-period correlator: exact I/Q for a sine with DC and harmonics added,
+// independent of how the samples are cut into blocks, a valid first result
+// from the firmware path after CORRELATOR_MIN_PERIODS, and windows that close
+// early once the uncertainty target is reached.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_correlator.h"
+#include "signal_conditioning.h"
+
+#define TEST_AMPLITUDE 0.2
+#define TEST_PHASE_DEG 30.0
+#define TEST_FULLSCALE 8388607.0
+
+static double   noise;
+static uint32_t noise_seed = 12345;
+
+/* Box-Muller over a fixed LCG, so the test is repeatable */
+static double
+gauss(void)
+{
+    double u1;
+    double u2;
+
+    noise_seed = noise_seed * 1664525u + 1013904223u;
+    u1         = (noise_seed + 1.0) / 4294967297.0;
+    noise_seed = noise_seed * 1664525u + 1013904223u;
+    u2         = (noise_seed + 1.0) / 4294967297.0;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static float32_t
+test_sample(uint32_t n, bool dirty)
+{
+    double w = 2.0 * M_PI * n / SINTABLE_LEN;
+    double x = TEST_AMPLITUDE * sin(w + TEST_PHASE_DEG * M_PI / 180.0) + noise * gauss();
+
+    /* DC offset, 2nd and 5th harmonic: all orthogonal over a whole period */
+    if (dirty)
+        x += 0.05 + 0.1 * sin(2.0 * w + 0.3) + 0.05 * cos(5.0 * w);
+
+    return (float32_t)lround(x * TEST_FULLSCALE);
+}
+
+static void
+test_block_split(uint32_t block_len, bool dirty)
+{
+    Correlator_t corr;
+    float32_t    raw[BIQUAD1_BUFFSIZE];
+    float32_t    sin_vect = 0;
+    float32_t    cos_vect = 0;
+    uint32_t     windows  = 0;
+    uint32_t     n        = 0;
+    uint32_t     periods  = 7;
+    double       half     = TEST_AMPLITUDE * TEST_FULLSCALE / 2.0;
+
+    dsp_correlator_reset(&corr, periods);
+
+    while (windows < 3) {
+        uint32_t phase = n % SINTABLE_LEN;
+        uint32_t idx;
+
+        for (idx = 0; idx < block_len; idx++)
+            raw[idx] = test_sample(n + idx, dirty);
+
+        n += block_len;
+
+        if (dsp_correlator_process(&corr, raw, phase, block_len, &sin_vect, &cos_vect)) {
+            windows++;
+
+            /* the window closes in the block holding its last sample */
+            HOST_CHECK(n - windows * periods * SINTABLE_LEN < block_len);
+            HOST_CHECK_NEAR(sin_vect, half * cos(TEST_PHASE_DEG * M_PI / 180.0), half * 1e-5);
+            HOST_CHECK_NEAR(cos_vect, half * sin(TEST_PHASE_DEG * M_PI / 180.0), half * 1e-5);
+        }
+    }
+}
+
+/* feeds the firmware until a final reading; returns the samples it took */
+static uint32_t
+run_until_final(uint32_t max_samples)
+{
+    int32_t  block[BIQUAD1_BUFFSIZE];
+    uint32_t samples     = 0;
+    uint32_t provisional = 0;
+
+    reset_filters();
+    clamp_measurements_result.new_data_is_ready = false;
+    clamp_measurements_result.result_is_final   = false;
+
+    while (!clamp_measurements_result.result_is_final && samples < max_samples) {
+        uint16_t idx;
+
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++)
+            block[idx] = (int32_t)test_sample(samples + idx, false);
+
+        samples += BIQUAD1_BUFFSIZE;
+
+        adc_block_handler(block, BIQUAD1_BUFFSIZE);
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready && !clamp_measurements_result.result_is_final) {
+            clamp_measurements_result.new_data_is_ready = false;
+            provisional++;
+        }
+    }
+
+    /* provisional readings from CORRELATOR_MIN_PERIODS on, one per block */
+    HOST_CHECK(provisional <= (samples - CORRELATOR_MIN_PERIODS * SINTABLE_LEN) / BIQUAD1_BUFFSIZE + 1);
+
+    return samples;
+}
+
+static void
+test_first_result(void)
+{
+    uint32_t samples;
+    uint32_t window = dsp_correlator_periods(INTEGRATOR_LENGTH) * SINTABLE_LEN;
+    double   half   = TEST_AMPLITUDE * TEST_FULLSCALE / 2.0;
+
+    hal_host_reset();
+    dsp_init();
+
+    /* no settling and no noise: the very first reading is already the answer */
+    samples = run_until_final(10 * window);
+    HOST_CHECK(clamp_measurements_result.new_data_is_ready);
+    HOST_CHECK(samples - CORRELATOR_MIN_PERIODS * SINTABLE_LEN < BIQUAD1_BUFFSIZE);
+    HOST_CHECK(clamp_measurements_result.mag_uncertainty < 1e-5f);
+    HOST_CHECK_NEAR(clamp_measurements_result.degree, 90.0f - TEST_PHASE_DEG, 1e-3f);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl * Cal_data.v_sens_gain * adc_gain_coeffs[Analog.adc_gain],
+                    half,
+                    half * 1e-5);
+
+    /* without a target every window runs to its full length */
+    dsp_set_uncertainty_target(0);
+    samples = run_until_final(10 * window);
+    HOST_CHECK(samples - window < BIQUAD1_BUFFSIZE);
+    dsp_set_uncertainty_target(UNCERTAINTY_TARGET_DEFAULT);
+}
+
+/* a noisy input: the window closes once the target is met, with a matching error */
+static void
+test_early_final(float32_t target)
+{
+    uint32_t window = dsp_correlator_periods(INTEGRATOR_LENGTH) * SINTABLE_LEN;
+    double   half   = TEST_AMPLITUDE * TEST_FULLSCALE / 2.0;
+    uint32_t samples;
+    float32_t sigma;
+
+    noise = 0.02;
+    dsp_set_uncertainty_target(target);
+    samples = run_until_final(10 * window);
+
+    HOST_CHECK(clamp_measurements_result.result_is_final);
+    HOST_CHECK(samples < window);
+    HOST_CHECK(clamp_measurements_result.mag_uncertainty <= target);
+    HOST_CHECK(clamp_measurements_result.phi_uncertainty <= target * 180.0f / PI);
+
+    sigma = clamp_measurements_result.mag_uncertainty;
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl * Cal_data.v_sens_gain * adc_gain_coeffs[Analog.adc_gain],
+                    half,
+                    half * 4 * sigma);
+    HOST_CHECK_NEAR(clamp_measurements_result.degree,
+                    90.0f - TEST_PHASE_DEG,
+                    4 * clamp_measurements_result.phi_uncertainty);
+
+    noise = 0;
+    dsp_set_uncertainty_target(UNCERTAINTY_TARGET_DEFAULT);
+}
+
+int
+main(void)
+{
+    HOST_CHECK(dsp_correlator_periods(INTEGRATOR_LENGTH) == 1364);
+    HOST_CHECK(dsp_correlator_periods(1) == CORRELATOR_MIN_PERIODS);
+
+    test_block_split(BIQUAD1_BUFFSIZE, false);
+    test_block_split(BIQUAD1_BUFFSIZE, true);
+    test_block_split(SINTABLE_LEN, true);
+    test_block_split(37, true);
+    test_block_split(1, true);
+    test_first_result();
+    test_early_final(2e-3f);
+    test_early_final(1e-3f);
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,229 @@
+//
+// Dual tone excitation: the DAC table holds both tones, and one scan of an
+// RC load gives its impedance at the excitation and at DUAL_TONE_BIN times
+// it side by side. Each tone has to read the load at its own frequency, as
+// if the other one wasn't there, and the odd harmonics of a distorted
+// generator mustn't reach the second one.
+//
+
+#include <complex.h>
+#include <math.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+/*
+ * the generator drives R_SHUNT in series with R_LOAD || C_LOAD with
+ * TEST_V_TONE per tone, the clamp is around the capacitor lead and gives
+ * TEST_CLAMP_OHMS volts per amp
+ */
+#define TEST_DR_MASK       (1u << MCP3462_IRQ_PIN)
+#define TEST_V_TONE        0.1
+#define TEST_R_LOAD        1000.0
+#define TEST_C_LOAD        180e-9
+#define TEST_CLAMP_OHMS    1000.0
+#define TEST_OVERALL_GAIN  1
+#define TEST_BLOCKS        300
+#define TEST_TOLERANCE     1e-3
+#define TEST_PHI_TOLERANCE 0.1
+/* of each odd harmonic of the excitation, up to TEST_ODD_HARMONICS */
+#define TEST_DISTORTION    0.02
+#define TEST_ODD_HARMONICS 9
+
+static double
+deg(double complex z)
+{
+    return carg(z) * 180.0 / M_PI;
+}
+
+/* difference of two angles in degrees, folded into -180 ... 180 */
+static double
+angle_diff(double a, double b)
+{
+    return remainder(a - b, 360.0);
+}
+
+static double
+tone_frequency(uint32_t bin)
+{
+    return MCP3462_MODEL_MCLK_HZ / (4.0 * MCP3462_OSR_RATIO * MCP3462_PRE_RATIO * SINTABLE_LEN) * bin;
+}
+
+static double complex
+load_admittance(double freq_hz)
+{
+    return 1.0 / TEST_R_LOAD + J * 2.0 * M_PI * freq_hz * TEST_C_LOAD;
+}
+
+/* one tone of the sensor behind mux; the lock-in reads Re(p) cos + Im(p) sin as the phasor p */
+static double
+tone_sample(uint8_t mux, uint32_t index, uint32_t bin)
+{
+    double         freq_hz   = tone_frequency(bin);
+    double         phase     = 2.0 * M_PI * bin * index / SINTABLE_LEN;
+    double complex V_applied = TEST_V_TONE / (1.0 + R_SHUNT * load_admittance(freq_hz));
+    double complex p;
+
+    switch (mux >> 4) {
+    case REF_CH4: p = TEST_V_TONE; break;
+    case REF_CH2: p = TEST_V_TONE - V_applied; break;
+    case REF_CH0: p = TEST_CLAMP_OHMS * J * 2.0 * M_PI * freq_hz * TEST_C_LOAD * V_applied; break;
+    default: return 0;
+    }
+
+    return creal(p) * cos(phase) + cimag(p) * sin(phase);
+}
+
+/* odd harmonics of the excitation, as the generator distorts it, on the voltage sensor */
+static double
+distortion_sample(uint8_t mux, uint32_t index)
+{
+    double   sample = 0;
+    uint32_t order;
+
+    if (mux >> 4 != REF_CH4)
+        return 0;
+
+    for (order = 3; order <= TEST_ODD_HARMONICS; order += 2)
+        sample += TEST_DISTORTION * TEST_V_TONE * cos(2.0 * M_PI * order * index / SINTABLE_LEN);
+
+    return sample;
+}
+
+static float
+load_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    return (float)(tone_sample(mux, index, 1) + tone_sample(mux, index, DUAL_TONE_BIN) +
+                   distortion_sample(mux, index));
+}
+
+/* a lock-in output of FS / 2 per unit of input reads as 1 V (1 A) */
+static void
+setup_calibration(void)
+{
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+    Cal_data.shunt_gain[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]] = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.shunt_phi[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]]  = 0;
+    Cal_data.clamp_gain[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] =
+        (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * TEST_CLAMP_OHMS);
+    Cal_data.clamp_phi[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] = 0;
+    dsp_calibration_changed();
+}
+
+static void
+run_blocks(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+/* both tones at half the amplitude, so the sum stays inside the single tone swing */
+static void
+test_dac_table(void)
+{
+    float32_t amplitude = DACC_MAX_AMPLITUDE * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+    uint32_t  point;
+    double    expected;
+
+    dsp_init();
+
+    for (point = 0; point < SINTABLE_LEN; point++) {
+        expected = DACC_OFFSET_HALFSCALE + amplitude * 0.5 *
+                                               (sin(2.0 * M_PI * point / SINTABLE_LEN) +
+                                                sin(2.0 * M_PI * DUAL_TONE_BIN * point / SINTABLE_LEN));
+
+        HOST_CHECK_NEAR(g_sintable[point], expected, 1.0);
+        HOST_CHECK(fabs(g_sintable[point] - (double)DACC_OFFSET_HALFSCALE) <= amplitude);
+    }
+}
+
+static void
+test_both_tones(void)
+{
+    mcp3462_model_t adc;
+    double complex  Y_load;
+    double          freq_hz;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, load_source, &adc);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    Analog.overall_gain = TEST_OVERALL_GAIN;
+    measurement_set_profile(DSP_PROFILE_FAST);
+    measurement_set_mode(MEASUREMENT_MODE_SCAN);
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_SCAN);
+
+    run_blocks(&adc, TEST_BLOCKS);
+
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+    HOST_CHECK(clamp_measurements_result.result_is_final);
+    HOST_CHECK(clamp_measurements_result.tone2.result_is_final);
+    HOST_CHECK(clamp_measurements_result.tone2.new_data_is_ready);
+
+    /* the excitation, with the second tone cancelled */
+    freq_hz = tone_frequency(1);
+    Y_load  = load_admittance(freq_hz);
+
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_TONE, TEST_TOLERANCE * TEST_V_TONE);
+    HOST_CHECK_NEAR(clamp_measurements_result.Z_ovrl, 1.0 / cabs(Y_load), TEST_TOLERANCE / cabs(Y_load));
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.Z_ovrl_phi, deg(Y_load)), 0, TEST_PHI_TOLERANCE);
+    HOST_CHECK_NEAR(clamp_measurements_result.Z_clamp * 2.0 * M_PI * freq_hz * TEST_C_LOAD, 1.0, TEST_TOLERANCE);
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.Z_clamp_phi, 90.0), 0, TEST_PHI_TOLERANCE);
+
+    /* the second tone, with the excitation cancelled */
+    freq_hz = tone_frequency(DUAL_TONE_BIN);
+    Y_load  = load_admittance(freq_hz);
+
+    HOST_CHECK_NEAR(clamp_measurements_result.tone2.V_ovrl, TEST_V_TONE, TEST_TOLERANCE * TEST_V_TONE);
+    HOST_CHECK_NEAR(clamp_measurements_result.tone2.Z_ovrl, 1.0 / cabs(Y_load), TEST_TOLERANCE / cabs(Y_load));
+    HOST_CHECK_NEAR(clamp_measurements_result.tone2.R_ovrl, 1.0 / creal(Y_load), TEST_TOLERANCE / creal(Y_load));
+    HOST_CHECK_NEAR(clamp_measurements_result.tone2.X_ovrl, 1.0 / cimag(Y_load), TEST_TOLERANCE / cimag(Y_load));
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.tone2.Z_ovrl_phi, deg(Y_load)), 0, TEST_PHI_TOLERANCE);
+    HOST_CHECK_NEAR(clamp_measurements_result.tone2.Z_clamp * 2.0 * M_PI * freq_hz * TEST_C_LOAD, 1.0, TEST_TOLERANCE);
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.tone2.Z_clamp_phi, 90.0), 0, TEST_PHI_TOLERANCE);
+
+    /* the point of two tones: the load is resistive at one and capacitive at the other */
+    HOST_CHECK(clamp_measurements_result.Z_ovrl_phi < 60.0);
+    HOST_CHECK(clamp_measurements_result.tone2.Z_ovrl_phi > 75.0);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_dac_table();
+    test_both_tones();
+
+    return HOST_TEST_RESULT();
+}
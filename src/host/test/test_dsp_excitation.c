@@ -0,0 +1,315 @@
+//
+// Excitation control: the shunt signal is driven by the DAC table itself.
+// Clipping at the lowest gain step, the amplitude comes down once to put the
+// peak at EXCITATION_TARGET_LEVEL; too little at the highest one, it goes up
+// to the operator's ceiling and no further. The reading left on display is
+// scaled with it, and with the range held by hand nothing moves. The loop is
+// switched from the measurement page, moves in DAC digits, and a new table
+// goes to the PDC next pointer without touching the one being played. A
+// switch-off right after a move waits for the DAC to start on the move.
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "keyboard.h"
+#include "menu_calibration.h"
+#include "menu_ili9486_kbrd_mngr.h"
+#include "menu_types_ili9486.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK      (1u << MCP3462_IRQ_PIN)
+/* peaks at the full DAC amplitude */
+#define TEST_HIGH_PEAK    4000000.0
+#define TEST_LOW_PEAK     2000000.0
+#define TEST_CEILING      30
+#define TEST_BLOCKS       300
+#define TEST_V_OVRL       0.5f
+/* near the minimum, where a step of the operator's amplitude is 20 %; the peak at the ceiling */
+#define TEST_LOW_CEILING  7
+#define TEST_MIN_PEAK     3200000.0
+#define TEST_FULL_DIGITS  (DACC_MAX_AMPLITUDE * DACC_VOLTS_TO_DIGITS_CONV_COEFF)
+/* the peak of SINTABLE_LEN samples misses the crest by up to 1 - cos(pi / SINTABLE_LEN) */
+#define TEST_PEAK_TOL     0.015
+
+/* the shunt amplifier of the model, per front-end setting */
+static const double fe_gain[] = { 1, 2, 5, 10, 20 };
+
+/* of the shunt signal at the ADC input, for the full DAC amplitude */
+static double level;
+
+/* the table the PDC goes on with; the image lives below 4 GiB */
+static const uint16_t *
+queued_table(void)
+{
+    return (const uint16_t *)(uintptr_t)g_dacc_pdc_base->PERIPH_TNPR;
+}
+
+/* what the DAC puts out now, 1 at DACC_MAX_AMPLITUDE */
+static double
+dac_output(uint32_t index)
+{
+    const uint16_t *playing = (const uint16_t *)(uintptr_t)g_dacc_pdc_base->PERIPH_TPR;
+
+    return ((double)playing[index % DACC_PACKETLEN] - DACC_OFFSET_HALFSCALE) / TEST_FULL_DIGITS;
+}
+
+static float
+shunt_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+
+    if (mux >> 4 != REF_CH2)
+        return 0;
+
+    return (float)(level * fe_gain[Analog.shunt_sensor_gain] * dac_output(index));
+}
+
+static void
+setup_calibration(void)
+{
+    uint8_t gain;
+
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+
+    for (gain = 0; gain < sizeof(fe_gain) / sizeof(fe_gain[0]); gain++) {
+        Cal_data.shunt_gain[gain] = (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * fe_gain[gain]);
+        Cal_data.shunt_phi[gain]  = 0;
+    }
+
+    dsp_calibration_changed();
+}
+
+/* the input level that peaks at peak on step gain with the full amplitude */
+static double
+level_for_peak(double peak, uint8_t gain)
+{
+    return peak / (MCP3462_MODEL_FULLSCALE * fe_gain[shunt_sensor_gain_preset[gain]] *
+                   adc_gain_coeffs[shunt_sensor_adc_gain_preset[gain]]);
+}
+
+static void
+press_key(uint16_t key)
+{
+    MMMenu.current_menu = MENU_MEASURE;
+    Keyboard.keys       = key;
+    kbrd_manager();
+}
+
+static void
+start(mcp3462_model_t *adc)
+{
+    hal_host_reset();
+    mcp3462_model_init(adc, shunt_source, NULL);
+    mcp3462_model_attach(adc);
+
+    dsp_init();
+    /* nothing for the loop to act on before the first reading of this test */
+    clamp_measurements_result.result_is_final = false;
+    /* the DAC and its PDC, as measurement_start() starts them */
+    pdc_tx_init(g_dacc_pdc_base, &g_dacc_packet, &g_dacc_next_packet);
+    pdc_enable_transfer(g_dacc_pdc_base, PERIPH_PTCR_TXTEN);
+    dacc_enable_interrupt(DACC, DACC_INTERRUPT_MASK);
+    setup_calibration();
+    switch_sensing_chanel(SHUNT_SENSOR);
+    measurement_set_profile(DSP_PROFILE_FAST);
+    HOST_CHECK(Analog.excitation_amplitude == Analog.generator_amplitude * DACC_VOLTS_TO_DIGITS_CONV_COEFF);
+
+    /* off until the operator turns it on */
+    HOST_CHECK(!Analog.excitation_control_on);
+    press_key(KEY_BACK);
+    HOST_CHECK(Analog.excitation_control_on);
+}
+
+/*
+ * streams blocks, realigning on data ready; the DAC ends a period every
+ * DACC_PACKETLEN conversions. Returns the number of amplitude moves.
+ */
+static uint32_t
+run(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end       = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+    uint16_t amplitude = Analog.excitation_amplitude;
+    uint32_t moves     = 0;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        if (adc->conversions % DACC_PACKETLEN == 0)
+            hal_host_dacc_packet_end();
+
+        dsp_integrating_filter();
+
+        if (Analog.excitation_amplitude != amplitude) {
+            amplitude = Analog.excitation_amplitude;
+            moves++;
+        }
+    }
+
+    return moves;
+}
+
+static void
+test_reduce(void)
+{
+    mcp3462_model_t adc;
+    const uint16_t *played;
+    uint16_t        full[DACC_PACKETLEN];
+
+    start(&adc);
+    set_overall_gain(0);
+    level = level_for_peak(TEST_HIGH_PEAK, 0);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    /* a voltage reading taken before */
+    clamp_measurements_result.V_ovrl = TEST_V_OVRL;
+
+    played = queued_table();
+    memcpy(full, played, sizeof(full));
+
+    /* the gain ladder can't go lower: one move, after the first reading */
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 1);
+    HOST_CHECK(Analog.overall_gain == 0);
+    HOST_CHECK_NEAR(Analog.excitation_amplitude,
+                    TEST_FULL_DIGITS * (double)EXCITATION_TARGET_LEVEL / TEST_HIGH_PEAK,
+                    TEST_PEAK_TOL * TEST_FULL_DIGITS * EXCITATION_TARGET_LEVEL / TEST_HIGH_PEAK);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl,
+                    TEST_V_OVRL * Analog.excitation_amplitude / TEST_FULL_DIGITS,
+                    1e-6);
+
+    /* the new table went in beside the one the period in progress ends on */
+    HOST_CHECK(queued_table() == g_sintable);
+    HOST_CHECK(queued_table() != played);
+    HOST_CHECK(memcmp(full, played, sizeof(full)) == 0);
+
+    /* in the band, at the same gain, and it stays there */
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 0);
+    HOST_CHECK(Analog.overall_gain == 0);
+    HOST_CHECK(Analog.ampl_peak < AMPLITUDE_TOO_HIGH_LIMIT);
+    HOST_CHECK(Analog.ampl_peak > EXCITATION_RAISE_LEVEL);
+    HOST_CHECK(clamp_measurements_result.result_is_final);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt,
+                    level * Analog.excitation_amplitude / TEST_FULL_DIGITS,
+                    1e-3 * level);
+
+    /* a table queued in this period: the next one has to wait for the DAC to start on it */
+    HOST_CHECK(dsp_set_sine_table_digits(Analog.excitation_amplitude));
+    played = queued_table();
+    HOST_CHECK(!dsp_set_sine_table_digits(TEST_FULL_DIGITS));
+    HOST_CHECK(queued_table() == played);
+
+    /* switched off then, the operator's amplitude is back from the next period */
+    Analog.generator_is_active = true;
+    press_key(KEY_BACK);
+    HOST_CHECK(!Analog.excitation_control_on);
+    HOST_CHECK(Analog.excitation_amplitude < TEST_FULL_DIGITS);
+    HOST_CHECK(queued_table() == played);
+
+    run(&adc, 1);
+    HOST_CHECK(Analog.excitation_amplitude == TEST_FULL_DIGITS);
+    HOST_CHECK(memcmp(full, queued_table(), sizeof(full)) == 0);
+    Analog.generator_is_active = false;
+
+    dsp_acquisition_stop();
+}
+
+/* near the minimum, where the operator's steps are 20 % apart, the peak still comes out on target */
+static void
+test_fine_step(void)
+{
+    mcp3462_model_t adc;
+    double          wanted;
+
+    start(&adc);
+
+    Analog.generator_amplitude  = TEST_LOW_CEILING;
+    Analog.excitation_amplitude = TEST_LOW_CEILING * DACC_VOLTS_TO_DIGITS_CONV_COEFF;
+    dsp_calculate_sine_table(TEST_LOW_CEILING);
+
+    set_overall_gain(0);
+    level = level_for_peak(TEST_MIN_PEAK * DACC_MAX_AMPLITUDE / TEST_LOW_CEILING, 0);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    wanted = TEST_LOW_CEILING * DACC_VOLTS_TO_DIGITS_CONV_COEFF * (double)EXCITATION_TARGET_LEVEL / TEST_MIN_PEAK;
+
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 1);
+    HOST_CHECK(Analog.excitation_amplitude > EXCITATION_AMPLITUDE_MIN);
+    HOST_CHECK_NEAR(Analog.excitation_amplitude, wanted, TEST_PEAK_TOL * wanted);
+
+    /* rounded down into the band: it stays */
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 0);
+    HOST_CHECK_NEAR(Analog.ampl_peak, EXCITATION_TARGET_LEVEL, TEST_PEAK_TOL * EXCITATION_TARGET_LEVEL);
+    HOST_CHECK(Analog.ampl_peak <= EXCITATION_TARGET_LEVEL);
+
+    dsp_acquisition_stop();
+}
+
+static void
+test_raise(void)
+{
+    mcp3462_model_t adc;
+    uint8_t         top = SHUNT_SENSOR_MAX_OVERALL_GAIN;
+
+    start(&adc);
+
+    /* the operator's ceiling, from the least the loop goes to */
+    Analog.generator_amplitude  = TEST_CEILING;
+    Analog.excitation_amplitude = EXCITATION_AMPLITUDE_MIN;
+    dsp_set_sine_table_digits(Analog.excitation_amplitude);
+
+    set_overall_gain(top);
+    level = level_for_peak(TEST_LOW_PEAK * DACC_MAX_AMPLITUDE / TEST_CEILING, top);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 1);
+    HOST_CHECK(Analog.excitation_amplitude == TEST_CEILING * DACC_VOLTS_TO_DIGITS_CONV_COEFF);
+    HOST_CHECK(Analog.overall_gain == top);
+
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 0);
+    HOST_CHECK(Analog.ampl_peak > EXCITATION_RAISE_LEVEL);
+    HOST_CHECK(Analog.ampl_peak < AMPLITUDE_TOO_HIGH_LIMIT);
+    HOST_CHECK(adc.clipped == 0);
+
+    /* the range held by hand, or the loop off: nothing moves */
+    Analog.AGC_on = false;
+    level /= 10;
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 0);
+
+    Analog.AGC_on = true;
+    press_key(KEY_BACK);
+    HOST_CHECK(!Analog.excitation_control_on);
+    set_overall_gain(0);
+    level = level_for_peak(TEST_HIGH_PEAK * DACC_MAX_AMPLITUDE / TEST_CEILING, 0);
+    HOST_CHECK(run(&adc, TEST_BLOCKS) == 0);
+    HOST_CHECK(Analog.ampl_peak > AMPLITUDE_TOO_HIGH_LIMIT);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_reduce();
+    test_fine_step();
+    test_raise();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,196 @@
+//
+// Gain steps under a steady input: the shunt goes through a front-end gain
+// switch in the middle of a block, then an ADC gain switch at a resync. The
+// filter history is rescaled to the new gains and the block with the switch
+// in it is dropped, so the calibrated reading must not move while the step
+// would otherwise ring through the cascade and the integrator window. Nor
+// may its displayed phase, which takes the phase calibration of the gains
+// the blocks were filtered with.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+#define TEST_V_SHUNT        0.004
+#define TEST_SHUNT_PHI      0.5
+#define TEST_FIRST_GAIN     3
+#define TEST_LAST_GAIN      6
+#define TEST_INTEGRATOR_LEN 40
+#define TEST_SETTLE_BLOCKS  6000
+#define TEST_WATCH_BLOCKS   2000
+#define TEST_TOLERANCE      0.005
+/* the float chains settle a few 0.1 % apart at different input levels */
+#define TEST_STEP_TOLERANCE 0.01
+/* degrees; the front-end steps are 0.5 degrees and more apart */
+#define TEST_PHI_TOLERANCE  0.3
+
+/* the shunt amplifier of the model: gain and phase shift (degrees) per front-end setting */
+static const double fe_gain[] = { 1, 2, 5, 10, 20 };
+static const double fe_phi[]  = { 0, -0.5, -1, -2, -4 };
+
+static float
+shunt_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    double phase = 2.0 * M_PI * index / SINTABLE_LEN;
+    uint8_t gain = Analog.shunt_sensor_gain;
+
+    (void)ctx;
+
+    if (mux >> 4 != REF_CH2)
+        return 0;
+
+    /* a delay of the input turns the lock-in vector the positive way */
+    return (float)(TEST_V_SHUNT * fe_gain[gain] * sin(phase + TEST_SHUNT_PHI - fe_phi[gain] * M_PI / 180));
+}
+
+/* a lock-in output of FS / 2 per unit at the shunt reads as 1 V */
+static void
+setup_calibration(void)
+{
+    uint8_t gain;
+
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+
+    for (gain = 0; gain < sizeof(fe_gain) / sizeof(fe_gain[0]); gain++) {
+        Cal_data.shunt_gain[gain] = (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * fe_gain[gain]);
+        Cal_data.shunt_phi[gain]  = (float32_t)fe_phi[gain];
+    }
+
+    dsp_calibration_changed();
+}
+
+/* streams conversions, realigning on data ready after every deferred register write */
+static void
+stream(mcp3462_model_t *adc, uint32_t conversions, bool filter)
+{
+    uint32_t end = adc->conversions + conversions;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        if (filter)
+            dsp_integrating_filter();
+    }
+}
+
+static void
+run(mcp3462_model_t *adc, uint32_t conversions)
+{
+    stream(adc, conversions, true);
+}
+
+static double
+vector_error(double I, double Q, double ref_I, double ref_Q)
+{
+    return hypot(I - ref_I, Q - ref_Q) / hypot(ref_I, ref_Q);
+}
+
+/* difference of two angles in degrees, folded into -180 ... 180 */
+static double
+angle_diff(double a, double b)
+{
+    return remainder(a - b, 360.0);
+}
+
+static void
+test_gain_switch(void)
+{
+    mcp3462_model_t adc;
+    double          ref_I;
+    double          ref_Q;
+    double          ref_phi;
+    double          worst;
+    double          worst_phi;
+    double          error;
+    uint32_t        block;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, shunt_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    dsp_set_integrator_len(TEST_INTEGRATOR_LEN);
+    switch_sensing_chanel(SHUNT_SENSOR);
+    Analog.AGC_on       = false;
+    Analog.overall_gain = TEST_FIRST_GAIN - 1;
+    increase_gain();
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    run(&adc, TEST_SETTLE_BLOCKS * MCP3462_STREAM_BLOCKLEN);
+
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt, TEST_V_SHUNT, TEST_TOLERANCE * TEST_V_SHUNT);
+    ref_I   = clamp_measurements_result.V_shunt_I;
+    ref_Q   = clamp_measurements_result.V_shunt_Q;
+    ref_phi = clamp_measurements_result.V_shunt_phi;
+
+    while (Analog.overall_gain < TEST_LAST_GAIN) {
+        /* the front-end switches at once, a third into a block */
+        run(&adc, MCP3462_STREAM_BLOCKLEN / 3);
+        increase_gain();
+
+        worst     = 0;
+        worst_phi = 0;
+
+        for (block = 0; block < TEST_WATCH_BLOCKS; block++) {
+            run(&adc, MCP3462_STREAM_BLOCKLEN);
+
+            error = vector_error(clamp_measurements_result.V_shunt_I,
+                                 clamp_measurements_result.V_shunt_Q,
+                                 ref_I,
+                                 ref_Q);
+            if (error > worst)
+                worst = error;
+
+            error = fabs(angle_diff(clamp_measurements_result.V_shunt_phi, ref_phi));
+            if (error > worst_phi)
+                worst_phi = error;
+        }
+
+        /* left alone, the step would be 50 % of the reading on the way through */
+        HOST_CHECK(worst < TEST_STEP_TOLERANCE);
+        HOST_CHECK(worst_phi < TEST_PHI_TOLERANCE);
+        HOST_CHECK(adc.clipped == 0);
+    }
+
+    /* both kinds of step have been through */
+    HOST_CHECK(Analog.shunt_sensor_gain == shunt_sensor_gain_preset[TEST_LAST_GAIN]);
+    HOST_CHECK(mcp3462_model_gain(&adc) == adc_gain_coeffs[shunt_sensor_adc_gain_preset[TEST_LAST_GAIN]]);
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+
+    /* blocks still queued from before a step: their phase is of the old front-end setting */
+    run(&adc, TEST_WATCH_BLOCKS * MCP3462_STREAM_BLOCKLEN);
+    stream(&adc, 3 * MCP3462_STREAM_BLOCKLEN, false);
+    while (Analog.shunt_sensor_gain == shunt_sensor_gain_preset[TEST_LAST_GAIN])
+        decrease_gain();
+    dsp_integrating_filter();
+
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.V_shunt_phi, ref_phi), 0, TEST_PHI_TOLERANCE);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_gain_switch();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,166 @@
+//
+// Halfband decimation chain (DSP_HALFBAND): the folded halfband kernel gives
+// the outputs of a plain FIR decimator however the input is cut, all stages
+// have unity gain at DC, and what folds onto the band of biquad3 is rejected
+// at least as well as by biquad1 ... firdec2.
+//
+
+#include <complex.h>
+#include <math.h>
+#include <string.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_halfband.h"
+
+#define TEST_BLOCKS 8
+#define TEST_LEN    (TEST_BLOCKS * HALFBAND1_BLOCKSIZE)
+/* protected band around DC, in cycles per output */
+#define TEST_BAND   0.01
+
+static float32_t input[TEST_LEN];
+static float32_t reference[TEST_LEN / HALFBAND_FACTOR];
+static float32_t output[TEST_LEN / HALFBAND_FACTOR];
+
+static void
+test_kernel(void)
+{
+    static float32_t              state[HALFBAND1_BLOCKSIZE + HALFBAND_NCOEFFS - 1];
+    arm_fir_decimate_instance_f32 fir;
+    Halfband_t                    hb;
+    uint32_t                      chunks[] = { HALFBAND1_BLOCKSIZE, 2, 22, 36 };
+    uint32_t                      seed     = 1;
+    uint32_t                      idx;
+    uint32_t                      chunk;
+
+    for (idx = 0; idx < TEST_LEN; idx++) {
+        seed       = seed * 1664525u + 1013904223u;
+        input[idx] = (float32_t)((int32_t)seed >> 8);
+    }
+
+    arm_fir_decimate_init_f32(&fir, HALFBAND_NCOEFFS, HALFBAND_FACTOR, halfband_coeffs, state, HALFBAND1_BLOCKSIZE);
+    for (idx = 0; idx < TEST_BLOCKS; idx++)
+        arm_fir_decimate_f32(&fir,
+                             &input[idx * HALFBAND1_BLOCKSIZE],
+                             &reference[idx * HALFBAND1_BLOCKSIZE / HALFBAND_FACTOR],
+                             HALFBAND1_BLOCKSIZE);
+
+    for (chunk = 0; chunk < sizeof(chunks) / sizeof(chunks[0]); chunk++) {
+        uint32_t done = 0;
+
+        dsp_halfband_reset(&hb);
+        memset(output, 0, sizeof(output));
+
+        while (done < TEST_LEN) {
+            uint32_t len = (TEST_LEN - done < chunks[chunk]) ? (TEST_LEN - done) : chunks[chunk];
+
+            dsp_halfband_decimate(&hb, &input[done], &output[done / HALFBAND_FACTOR], len);
+            done += len;
+        }
+
+        for (idx = 0; idx < TEST_LEN / HALFBAND_FACTOR; idx++)
+            HOST_CHECK_NEAR(output[idx], reference[idx], fabsf(reference[idx]) * 1e-6f + 1.0f);
+    }
+}
+
+static double complex
+fir_response(const float32_t *coeffs, uint32_t len, double f)
+{
+    double complex h = 0;
+    uint32_t       k;
+
+    for (k = 0; k < len; k++)
+        h += coeffs[k] * cexp(-2.0 * M_PI * J * f * k);
+
+    return h;
+}
+
+static double complex
+biquad_response(const float32_t *coeffs, uint32_t stages, double f)
+{
+    double complex z1 = cexp(-2.0 * M_PI * J * f);
+    double complex h  = 1;
+    uint32_t       k;
+
+    for (k = 0; k < stages; k++) {
+        const float32_t *c = &coeffs[5 * k];
+
+        h *= (c[0] + c[1] * z1 + c[2] * z1 * z1) / (1.0 - c[3] * z1 - c[4] * z1 * z1);
+    }
+
+    return h;
+}
+
+/* f in cycles per ADC sample, up to the input of biquad3 */
+static double
+halfband_chain(double f)
+{
+    return cabs(fir_response(halfband_coeffs, HALFBAND_NCOEFFS, f) *
+                fir_response(halfband_coeffs, HALFBAND_NCOEFFS, 2 * f) *
+                fir_response(poly_dec_coeffs, POLY_DEC_NCOEFFS, 4 * f) *
+                fir_response(poly_dec_coeffs, POLY_DEC_NCOEFFS, 20 * f));
+}
+
+static double
+default_chain(double f)
+{
+    return cabs(biquad_response(biquad1_coeffs, BIQUAD1_NSTAGES, f) *
+                fir_response(fir1_3kHz_coeffs, FIR1_DEC_NCOEFFS, f) *
+                biquad_response(biquad2_coeffs, BIQUAD2_NSTAGES, 10 * f) *
+                fir_response(fir2_300Hz_coeffs, FIR2_DEC_NCOEFFS, 10 * f));
+}
+
+static void
+test_alias(void)
+{
+    double   halfband_worst = 0;
+    double   default_worst  = 0;
+    uint32_t k;
+    int      step;
+
+    for (k = 1; k <= BIQUAD1_BUFFSIZE / 2; k++) {
+        for (step = -10; step <= 10; step++) {
+            double f = (k + step * TEST_BAND / 10) / BIQUAD1_BUFFSIZE;
+
+            if (f > 0.5)
+                continue;
+            if (halfband_chain(f) > halfband_worst)
+                halfband_worst = halfband_chain(f);
+            if (default_chain(f) > default_worst)
+                default_worst = default_chain(f);
+        }
+    }
+
+    HOST_CHECK(halfband_worst <= default_worst);
+    HOST_CHECK(20.0 * log10(halfband_worst) < -110.0);
+
+    /* flat where biquad3 passes */
+    HOST_CHECK_NEAR(20.0 * log10(halfband_chain(TEST_BAND / BIQUAD1_BUFFSIZE)), 0.0, 0.01);
+}
+
+int
+main(void)
+{
+    double   sum = 0;
+    uint32_t idx;
+
+    test_kernel();
+
+    for (idx = 0; idx < HALFBAND_NCOEFFS; idx++)
+        sum += halfband_coeffs[idx];
+    HOST_CHECK_NEAR(sum, 1.0, 1e-7);
+
+    sum = 0;
+    for (idx = 0; idx < POLY_DEC_NCOEFFS; idx++)
+        sum += poly_dec_coeffs[idx];
+    HOST_CHECK_NEAR(sum, 1.0, 1e-6);
+
+    test_alias();
+
+    return HOST_TEST_RESULT();
+}
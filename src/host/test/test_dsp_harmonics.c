@@ -0,0 +1,169 @@
+//
+// Distortion monitor: THD of a sine with 2nd and 3rd harmonic and DC added,
+// independent of how the samples are cut into blocks and of a break in
+// them, and end to end through the ADC model: a distorted sensor signal is
+// flagged next to the chain's reading, a clean one is not, whatever the
+// sensors not on display were left at.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_harmonics.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK   (1u << MCP3462_IRQ_PIN)
+#define TEST_AMPLITUDE 0.4
+#define TEST_H2        0.05
+#define TEST_H3        0.02
+#define TEST_FULLSCALE 8388607.0
+#define TEST_BLOCKS    700
+
+/* of the fundamental, in the model source */
+static double test_h2;
+static double test_h3;
+
+static double
+test_signal(uint32_t n)
+{
+    double w = 2.0 * M_PI * n / SINTABLE_LEN;
+
+    return TEST_AMPLITUDE * (sin(w + 0.4) + test_h2 * sin(2.0 * w - 1.1) + test_h3 * cos(3.0 * w + 0.7)) + 0.03;
+}
+
+static double
+expected_thd(void)
+{
+    return sqrt(test_h2 * test_h2 + test_h3 * test_h3);
+}
+
+static void
+test_block_split(uint32_t block_len)
+{
+    Harmonics_t harm;
+    float32_t   raw[BIQUAD1_BUFFSIZE];
+    float32_t   thd     = -1;
+    uint32_t    windows = 0;
+    uint32_t    n       = 0;
+    uint32_t    idx;
+    bool        broken  = false;
+
+    test_h2 = TEST_H2;
+    test_h3 = TEST_H3;
+
+    dsp_harmonics_init();
+    dsp_harmonics_reset(&harm, 7);
+
+    while (windows < 4) {
+        for (idx = 0; idx < block_len; idx++)
+            raw[idx] = (float32_t)lround(test_signal(n + idx) * TEST_FULLSCALE);
+
+        if (dsp_harmonics_process(&harm, raw, n % SINTABLE_LEN, block_len, &thd)) {
+            windows++;
+            HOST_CHECK_NEAR(thd, expected_thd(), 1e-4);
+        }
+
+        n += block_len;
+
+        /* samples lost after the second window: the period they cut short must not count */
+        if (windows == 2 && !broken) {
+            dsp_harmonics_break(&harm);
+            n += 13;
+            broken = true;
+        }
+    }
+
+    HOST_CHECK(windows == 4);
+}
+
+static float
+sensor_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+
+    if ((mux >> 4) != REF_CH4)
+        return 0;
+
+    return (float)test_signal(index);
+}
+
+static void
+run_blocks(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+static void
+test_reading(void)
+{
+    mcp3462_model_t adc;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, sensor_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    test_h2 = TEST_H2;
+    test_h3 = TEST_H3;
+
+    dsp_init();
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    HOST_CHECK(clamp_measurements_result.thd_limit == THD_LIMIT_DEFAULT);
+    HOST_CHECK(!clamp_measurements_result.distorted);
+
+    run_blocks(&adc, TEST_BLOCKS);
+
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl_thd, expected_thd(), 1e-3);
+    HOST_CHECK(clamp_measurements_result.V_shunt_thd == 0);
+    HOST_CHECK(clamp_measurements_result.I_clamp_thd == 0);
+    HOST_CHECK(clamp_measurements_result.distorted);
+
+    /* the next windows are clean */
+    test_h2 = 0;
+    test_h3 = 0;
+
+    run_blocks(&adc, TEST_BLOCKS);
+
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl_thd, 0, 1e-3);
+    HOST_CHECK(!clamp_measurements_result.distorted);
+
+    /* a distorted sensor that isn't on display, left from a scan, doesn't flag this one */
+    clamp_measurements_result.V_shunt_thd = 2 * THD_LIMIT_DEFAULT;
+    clamp_measurements_result.I_clamp_thd = 2 * THD_LIMIT_DEFAULT;
+
+    run_blocks(&adc, TEST_BLOCKS);
+
+    HOST_CHECK(!clamp_measurements_result.distorted);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_block_split(BIQUAD1_BUFFSIZE);
+    test_block_split(SINTABLE_LEN);
+    test_block_split(17);
+
+    test_reading();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,169 @@
+//
+// Result math in rectangular form: the DSP_complex.h operations against
+// double precision, and the three sensor readings of a known load giving
+// back its admittance as R_ovrl / X_ovrl and R_clamp / X_clamp, with the
+// phases shown on the display unchanged.
+//
+
+#include <complex.h>
+#include <math.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_complex.h"
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+void manage_sensed_data(float32_t sin_vect, float32_t cos_vect);
+
+/* parallel RC load, generator output and the part of the current in the clamp */
+#define TEST_R_LOAD   5000.0
+#define TEST_X_LOAD   8000.0
+#define TEST_V_OVRL   2.0
+#define TEST_V_PHI    30.0
+#define TEST_R_CLAMP  12000.0
+#define TEST_X_CLAMP  -20000.0
+
+static double
+deg(double complex z)
+{
+    return carg(z) * 180.0 / M_PI;
+}
+
+/* difference of two angles in degrees, folded into -180 ... 180 */
+static double
+angle_diff(double a, double b)
+{
+    return remainder(a - b, 360.0);
+}
+
+static void
+test_ops(void)
+{
+    Complex_t      a  = complex_make(3.0f, -4.0f);
+    Complex_t      b  = complex_make(-1.5f, 2.5f);
+    double complex ad = 3.0 - 4.0 * J;
+    double complex bd = -1.5 + 2.5 * J;
+    Complex_t      r;
+
+    r = complex_mul(a, b);
+    HOST_CHECK_NEAR(r.I, creal(ad * bd), 1e-5);
+    HOST_CHECK_NEAR(r.Q, cimag(ad * bd), 1e-5);
+
+    r = complex_mul_conj(a, b);
+    HOST_CHECK_NEAR(r.I, creal(ad * conj(bd)), 1e-5);
+    HOST_CHECK_NEAR(r.Q, cimag(ad * conj(bd)), 1e-5);
+
+    r = complex_div(a, b);
+    HOST_CHECK_NEAR(r.I, creal(ad / bd), 1e-5);
+    HOST_CHECK_NEAR(r.Q, cimag(ad / bd), 1e-5);
+
+    r = complex_sub(complex_add(a, b), complex_conj(b));
+    HOST_CHECK_NEAR(r.I, creal(ad + bd - conj(bd)), 1e-5);
+    HOST_CHECK_NEAR(r.Q, cimag(ad + bd - conj(bd)), 1e-5);
+
+    HOST_CHECK_NEAR(complex_abs(a), 5.0, 1e-5);
+    HOST_CHECK_NEAR(complex_norm(b), 8.5, 1e-5);
+
+    r = complex_polar(2.0f, 120.0f);
+    HOST_CHECK_NEAR(r.I, -1.0, 1e-4);
+    HOST_CHECK_NEAR(r.Q, sqrt(3.0), 1e-4);
+
+    r = complex_unit(a, 5.0f);
+    HOST_CHECK_NEAR(r.I, 0.6, 1e-6);
+    HOST_CHECK_NEAR(r.Q, -0.8, 1e-6);
+
+    r = complex_unit(complex_make(0, 0), 0);
+    HOST_CHECK(r.I == 1 && r.Q == 0);
+}
+
+/* what the lock-in hands to manage_sensed_data() for a voltage v at the sensor */
+static void
+sense(sensor_type_t sensor, double complex v, double gain, double phi)
+{
+    double complex raw = v * gain * cexp(J * phi * M_PI / 180.0);
+
+    Analog.selected_sensor = sensor;
+    manage_sensed_data((float32_t)cimag(raw), (float32_t)creal(raw));
+}
+
+static void
+test_load(void)
+{
+    double complex Y_load    = 1.0 / TEST_R_LOAD + J / TEST_X_LOAD;
+    double complex Y_clamp   = 1.0 / TEST_R_CLAMP + J / TEST_X_CLAMP;
+    double complex V_ovrl    = TEST_V_OVRL * cexp(J * TEST_V_PHI * M_PI / 180.0);
+    double complex V_applied = V_ovrl / (1.0 + R_SHUNT * Y_load);
+    double complex V_shunt   = V_ovrl - V_applied;
+    double complex I_clamp;
+    double         adc_gain;
+
+    hal_host_reset();
+    memset(&clamp_measurements_result, 0, sizeof(clamp_measurements_result));
+    Calibrator.is_calibrating        = false;
+    Clamp_calibrator.is_calibrated   = false;
+    Analog.adc_gain                  = GAIN_2;
+    Analog.shunt_sensor_gain         = 1;
+    Analog.clamp_sensor_gain         = 2;
+    Cal_data.v_sens_gain             = 150000.0f;
+    Cal_data.v_sens_phi              = 12.5f;
+    Cal_data.shunt_gain[1]           = 90000.0f;
+    Cal_data.shunt_phi[1]            = -7.0f;
+    Cal_data.clamp_gain[2]           = 4.0e7f;
+    Cal_data.clamp_phi[2]            = 200.0f;
+    dsp_calibration_changed();
+    adc_gain                         = adc_gain_coeffs[Analog.adc_gain];
+
+    /* a clamp reading before anything else must not give NaN */
+    sense(CLAMP_SENSOR, 1e-3, Cal_data.clamp_gain[2] * adc_gain, Cal_data.clamp_phi[2]);
+    HOST_CHECK(isfinite(clamp_measurements_result.I_clamp_I) && isfinite(clamp_measurements_result.I_clamp_Q));
+
+    sense(VOLTAGE_SENSOR, V_ovrl, Cal_data.v_sens_gain * adc_gain, Cal_data.v_sens_phi);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, 1e-5);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl_I, creal(V_ovrl), 1e-4);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl_Q, cimag(V_ovrl), 1e-4);
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.V_ovrl_phi, TEST_V_PHI), 0, 0.01);
+
+    sense(SHUNT_SENSOR, V_shunt, Cal_data.shunt_gain[1] * adc_gain, Cal_data.shunt_phi[1]);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt, cabs(V_shunt), 1e-5 * cabs(V_shunt));
+    HOST_CHECK_NEAR(clamp_measurements_result.V_applied, cabs(V_applied), 1e-5 * cabs(V_applied));
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.V_applied_phi, deg(V_applied)), 0, 0.01);
+    HOST_CHECK_NEAR(clamp_measurements_result.R_ovrl, TEST_R_LOAD, 1e-3 * TEST_R_LOAD);
+    HOST_CHECK_NEAR(clamp_measurements_result.X_ovrl, TEST_X_LOAD, 1e-3 * TEST_X_LOAD);
+    HOST_CHECK_NEAR(clamp_measurements_result.Z_ovrl, 1.0 / cabs(Y_load), 1e-3 / cabs(Y_load));
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.Z_ovrl_phi, deg(Y_load)), 0, 0.01);
+
+    /* I_clamp is referred to the phases of V_ovrl and V_applied */
+    I_clamp = Y_clamp * cabs(V_applied) * cexp(J * (carg(V_ovrl) + carg(V_applied)));
+
+    sense(CLAMP_SENSOR, I_clamp, Cal_data.clamp_gain[2] * adc_gain, Cal_data.clamp_phi[2]);
+    HOST_CHECK_NEAR(clamp_measurements_result.I_clamp, cabs(I_clamp), 1e-5 * cabs(I_clamp));
+    HOST_CHECK_NEAR(clamp_measurements_result.R_clamp, TEST_R_CLAMP, 1e-3 * TEST_R_CLAMP);
+    HOST_CHECK_NEAR(clamp_measurements_result.X_clamp, TEST_X_CLAMP, 1e-3 * -TEST_X_CLAMP);
+    HOST_CHECK_NEAR(clamp_measurements_result.Z_clamp, 1.0 / cabs(Y_clamp), 1e-3 / cabs(Y_clamp));
+    HOST_CHECK_NEAR(angle_diff(clamp_measurements_result.Z_clamp_phi, deg(Y_clamp)), 0, 0.01);
+    HOST_CHECK(clamp_measurements_result.Z_clamp_phi >= 0 && clamp_measurements_result.Z_clamp_phi < 360);
+
+    /* the clamp position gain scales the current */
+    Clamp_calibrator.is_calibrated = true;
+    Clamp_calibrator.position_gain = 1.25f;
+
+    sense(CLAMP_SENSOR, I_clamp, Cal_data.clamp_gain[2] * adc_gain, Cal_data.clamp_phi[2]);
+    HOST_CHECK_NEAR(clamp_measurements_result.I_clamp, 1.25 * cabs(I_clamp), 1e-5 * cabs(I_clamp));
+    HOST_CHECK_NEAR(clamp_measurements_result.R_clamp, TEST_R_CLAMP / 1.25, 1e-3 * TEST_R_CLAMP);
+}
+
+int
+main(void)
+{
+    test_ops();
+    test_load();
+
+    return HOST_TEST_RESULT();
+}
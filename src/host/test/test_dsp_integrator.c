@@ -0,0 +1,215 @@
+//
+// Sliding-window integrator: provisional results while the window fills, a
+// result at every decimated step once it is full, integrator_len changes that
+// take effect on the next step without restarting the window, and an
+// uncertainty estimate that matches the scatter of the readings.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#define TEST_AMPLITUDE  0.2
+#define TEST_PHASE_DEG  30.0
+/* biquad3 has settled after this many cascade outputs */
+#define TEST_SETTLE     2400
+
+static uint32_t n;
+static double   noise;
+static uint32_t noise_seed = 12345;
+
+/* Box-Muller over a fixed LCG, so the test is repeatable */
+static double
+gauss(void)
+{
+    double u1;
+    double u2;
+
+    noise_seed = noise_seed * 1664525u + 1013904223u;
+    u1         = (noise_seed + 1.0) / 4294967297.0;
+    noise_seed = noise_seed * 1664525u + 1013904223u;
+    u2         = (noise_seed + 1.0) / 4294967297.0;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/* measurement_start() restarts the DAC together with the filters */
+static void
+restart(void)
+{
+    reset_filters();
+    n = 0;
+}
+
+/* one ADC block through the firmware; true if it produced a result */
+static bool
+step(void)
+{
+    int32_t  block[BIQUAD1_BUFFSIZE];
+    uint16_t idx;
+
+    for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++, n++)
+        block[idx] = (int32_t)lround(8388607.0 *
+                                     (TEST_AMPLITUDE * sin(2.0 * M_PI * n / SINTABLE_LEN + TEST_PHASE_DEG * M_PI / 180.0) +
+                                      noise * gauss()));
+
+    adc_block_handler(block, BIQUAD1_BUFFSIZE);
+    dsp_integrating_filter();
+
+    if (!clamp_measurements_result.new_data_is_ready)
+        return false;
+
+    clamp_measurements_result.new_data_is_ready = false;
+    return true;
+}
+
+/* short windows leave more of the cascade's output ripple in the result */
+static void
+check_result(float32_t tolerance)
+{
+    float32_t expected = TEST_AMPLITUDE * 8388607.0 / 2.0;
+
+    HOST_CHECK_NEAR(clamp_measurements_result.degree, 90.0f - TEST_PHASE_DEG, 100.0f * tolerance);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl * Cal_data.v_sens_gain * adc_gain_coeffs[Analog.adc_gain],
+                    expected,
+                    expected * tolerance);
+}
+
+static void
+test_first_window(uint32_t len)
+{
+    uint32_t steps;
+
+    restart();
+    dsp_set_integrator_len(len);
+
+    /* nothing for the first few outputs, provisional ones while the window fills */
+    for (steps = 1; steps < len; steps++) {
+        if (steps < INTEGRATOR_MIN_LENGTH) {
+            HOST_CHECK(!step());
+        }
+        else {
+            /* the cascade is still ramping up: far from the target */
+            HOST_CHECK(step());
+            HOST_CHECK(!clamp_measurements_result.result_is_final);
+            HOST_CHECK(clamp_measurements_result.mag_uncertainty > clamp_measurements_result.uncertainty_target);
+        }
+    }
+
+    /* final at integrator_len at the latest, then a result every step */
+    for (steps = 0; steps < 10; steps++) {
+        HOST_CHECK(step());
+        HOST_CHECK(clamp_measurements_result.result_is_final);
+    }
+}
+
+/*
+ * Readings one window apart are independent; their scatter must agree with
+ * the uncertainty the integrator reports for each of them.
+ */
+static void
+test_uncertainty(void)
+{
+    double   sum      = 0;
+    double   sum_sq   = 0;
+    double   reported = 0;
+    double   phi_sum  = 0;
+    double   phi_sq   = 0;
+    double   phi_rep  = 0;
+    uint32_t readings = 40;
+    uint32_t idx;
+    uint32_t steps;
+    double   mean;
+    double   spread;
+
+    restart();
+    noise = 0.05;
+    dsp_set_integrator_len(INTEGRATOR_LENGTH);
+
+    for (steps = 0; steps < TEST_SETTLE; steps++)
+        step();
+
+    for (idx = 0; idx < readings; idx++) {
+        for (steps = 0; steps < 2 * INTEGRATOR_LENGTH; steps++)
+            step();
+
+        HOST_CHECK(step());
+        HOST_CHECK(clamp_measurements_result.result_is_final);
+
+        sum += clamp_measurements_result.V_ovrl;
+        sum_sq += (double)clamp_measurements_result.V_ovrl * clamp_measurements_result.V_ovrl;
+        reported += clamp_measurements_result.mag_uncertainty;
+        phi_sum += clamp_measurements_result.degree;
+        phi_sq += (double)clamp_measurements_result.degree * clamp_measurements_result.degree;
+        phi_rep += clamp_measurements_result.phi_uncertainty;
+    }
+
+    mean   = sum / readings;
+    spread = sqrt((sum_sq - sum * sum / readings) / (readings - 1)) / mean;
+    HOST_CHECK(spread > 0.5 * reported / readings && spread < 2.0 * reported / readings);
+
+    spread = sqrt((phi_sq - phi_sum * phi_sum / readings) / (readings - 1));
+    HOST_CHECK(spread > 0.5 * phi_rep / readings && spread < 2.0 * phi_rep / readings);
+
+    noise = 0;
+}
+
+int
+main(void)
+{
+    uint32_t steps;
+
+    hal_host_reset();
+    dsp_init();
+
+    HOST_CHECK(clamp_measurements_result.integrator_len == INTEGRATOR_LENGTH);
+
+    test_first_window(INTEGRATOR_LENGTH);
+    test_first_window(1);
+    test_first_window(37);
+
+    /* settle with the default window, then every step is a valid reading */
+    restart();
+    dsp_set_integrator_len(INTEGRATOR_LENGTH);
+
+    for (steps = 0; steps < TEST_SETTLE; steps++)
+        step();
+
+    HOST_CHECK(step());
+    check_result(0.005f);
+
+    /* shorter and longer windows: the history is kept, no restart */
+    dsp_set_integrator_len(50);
+    HOST_CHECK(step());
+    check_result(0.02f);
+
+    dsp_set_integrator_len(INTEGRATOR_MAX_LENGTH);
+    HOST_CHECK(step());
+    check_result(0.005f);
+
+    dsp_set_integrator_len(1);
+    HOST_CHECK(step());
+    check_result(0.02f);
+
+    /* out of range lengths are clamped */
+    dsp_set_integrator_len(10 * INTEGRATOR_MAX_LENGTH);
+    HOST_CHECK(clamp_measurements_result.integrator_len == INTEGRATOR_MAX_LENGTH);
+    dsp_set_integrator_len(0);
+    HOST_CHECK(clamp_measurements_result.integrator_len == 1);
+
+    /* the float running sums are rebuilt once per window: no drift */
+    dsp_set_integrator_len(INTEGRATOR_LENGTH);
+
+    for (steps = 0; steps < 20 * INTEGRATOR_LENGTH; steps++)
+        HOST_CHECK(step());
+
+    check_result(0.005f);
+
+    test_uncertainty();
+
+    return HOST_TEST_RESULT();
+}
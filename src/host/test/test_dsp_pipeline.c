@@ -0,0 +1,76 @@
+//
+// End-to-end check of the lock-in chain: a sine at the excitation frequency
+// (SINTABLE_LEN samples per period) is streamed from the MCP3462 model by the
+// SPI PDC, and the voltage sensor result must come out with the programmed
+// magnitude and phase.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#define TEST_AMPLITUDE  0.2f
+#define TEST_PHASE_DEG  30.0f
+/* biquad3 needs a few integrator windows to settle */
+#define TEST_SAMPLES    ((TEST_RESULTS + 1) * INTEGRATOR_LENGTH * BIQUAD1_BUFFSIZE)
+#define TEST_RESULTS    8
+
+static float
+sine_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+    (void)mux;
+
+    return TEST_AMPLITUDE * (float)sin(2.0 * M_PI * index / SINTABLE_LEN + TEST_PHASE_DEG * M_PI / 180.0);
+}
+
+int
+main(void)
+{
+    mcp3462_model_t adc;
+    uint32_t        results = 0;
+    uint32_t        samples = 0;
+    float32_t       expected_abs = TEST_AMPLITUDE * MCP3462_MODEL_FULLSCALE / 2.0f;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, sine_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, (1 << ADC_INTERRUPT_PIN));
+
+    while (samples < TEST_SAMPLES) {
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        samples++;
+
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready) {
+            clamp_measurements_result.new_data_is_ready = false;
+            results++;
+        }
+    }
+
+    HOST_CHECK(results >= TEST_RESULTS);
+    HOST_CHECK(adc.conversions == samples);
+    HOST_CHECK(MCP3462_stream_state() == MCP3462_STREAM_RUNNING);
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(Analog.adc_gain == GAIN_1);
+
+    /* the mixer references are sin/cos, so the reported angle is 90 - phase */
+    HOST_CHECK_NEAR(clamp_measurements_result.degree, 90.0f - TEST_PHASE_DEG, 0.1f);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl * Cal_data.v_sens_gain * adc_gain_coeffs[Analog.adc_gain],
+                    expected_abs,
+                    expected_abs * 0.005f);
+
+    return HOST_TEST_RESULT();
+}
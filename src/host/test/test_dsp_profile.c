@@ -0,0 +1,145 @@
+//
+// Measurement speed profiles: each one sets its integrator window and
+// uncertainty target, and FAST, with the wide output stage, settles on a
+// step of the input in a fraction of the blocks NORMAL needs while reading
+// the same value.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+#define TEST_V_OVRL         0.2
+#define TEST_HORIZON_BLOCKS 4000
+#define TEST_TOLERANCE      0.01
+
+static float
+voltage_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    (void)ctx;
+
+    if (mux >> 4 != REF_CH4)
+        return 0;
+
+    return (float)(TEST_V_OVRL * sin(2.0 * M_PI * index / SINTABLE_LEN));
+}
+
+/* streams blocks, realigning on data ready after every deferred register write */
+static void
+run(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+/* blocks from a restart until the reading stays within TEST_TOLERANCE */
+static uint32_t
+settle_blocks(mcp3462_model_t *adc, Dsp_profile_t profile)
+{
+    uint32_t settled = 0;
+    uint32_t block;
+
+    measurement_set_profile(profile);
+    HOST_CHECK(clamp_measurements_result.profile == profile);
+    clamp_measurements_result.V_ovrl = 0;
+
+    for (block = 1; block <= TEST_HORIZON_BLOCKS; block++) {
+        run(adc, 1);
+
+        if (fabs(clamp_measurements_result.V_ovrl - TEST_V_OVRL) >= TEST_TOLERANCE * TEST_V_OVRL)
+            settled = block;
+    }
+
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, TEST_TOLERANCE * TEST_V_OVRL);
+
+    return settled;
+}
+
+static void
+test_profile_settings(void)
+{
+    dsp_init();
+    HOST_CHECK(clamp_measurements_result.profile == DSP_PROFILE_NORMAL);
+    HOST_CHECK(clamp_measurements_result.integrator_len == INTEGRATOR_LENGTH);
+    HOST_CHECK(clamp_measurements_result.uncertainty_target == UNCERTAINTY_TARGET_DEFAULT);
+
+    measurement_set_profile(DSP_PROFILE_FAST);
+    HOST_CHECK(clamp_measurements_result.integrator_len < INTEGRATOR_LENGTH);
+    HOST_CHECK(clamp_measurements_result.uncertainty_target > UNCERTAINTY_TARGET_DEFAULT);
+
+    measurement_set_profile(DSP_PROFILE_PRECISE);
+    HOST_CHECK(clamp_measurements_result.integrator_len == INTEGRATOR_MAX_LENGTH);
+    HOST_CHECK(clamp_measurements_result.uncertainty_target < UNCERTAINTY_TARGET_DEFAULT);
+
+    /* out of range leaves everything as it is */
+    measurement_set_profile(DSP_PROFILE_COUNT);
+    HOST_CHECK(clamp_measurements_result.profile == DSP_PROFILE_PRECISE);
+    HOST_CHECK(clamp_measurements_result.integrator_len == INTEGRATOR_MAX_LENGTH);
+}
+
+static void
+test_profile_speed(void)
+{
+    mcp3462_model_t adc;
+#ifndef DSP_CORRELATOR
+    uint32_t        fast;
+    uint32_t        normal;
+#endif
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, voltage_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+    dsp_calibration_changed();
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+#ifdef DSP_CORRELATOR
+    /* the correlator has no output stage: its readings are whole periods from the start */
+    settle_blocks(&adc, DSP_PROFILE_NORMAL);
+    settle_blocks(&adc, DSP_PROFILE_FAST);
+#else
+    normal = settle_blocks(&adc, DSP_PROFILE_NORMAL);
+    fast   = settle_blocks(&adc, DSP_PROFILE_FAST);
+
+    HOST_CHECK(fast * 4 < normal);
+#endif
+
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_profile_settings();
+    test_profile_speed();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,226 @@
+//
+// Accuracy of the q31 lock-in chain. The float32 chain (the firmware's
+// do_filter()) and the q31 one (dsp_q31_filter_block()) are fed identical ADC
+// blocks, and both integrated I/Q vectors are compared with the same filter
+// structure evaluated in double precision.
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_q31.h"
+
+#define TEST_WINDOWS    10
+/* biquad3 needs a few integrator windows to settle */
+#define TEST_SETTLED    5
+
+typedef struct {
+    double amplitude;    // fraction of the positive full scale
+    double mag_tol;      // relative, q31 against double
+    double phase_tol;    // degrees, q31 against double
+} q31_case_t;
+
+typedef struct {
+    double mag;
+    double phase;
+} chain_error_t;
+
+/* double precision df2T cascade, in place */
+typedef struct {
+    const float32_t *coeffs;
+    uint8_t          stages;
+    double           state[BIQUAD3_NSTAGES][2];
+} ref_biquad_t;
+
+typedef struct {
+    const float32_t *coeffs;
+    double           history[FIR1_DEC_NCOEFFS];
+} ref_firdec_t;
+
+typedef struct {
+    ref_biquad_t biquad1, biquad2, biquad3;
+    ref_firdec_t fir1, fir2;
+} ref_chain_t;
+
+static void
+ref_biquad(ref_biquad_t *bq, double *data, uint32_t len)
+{
+    uint8_t  stage;
+    uint32_t n;
+
+    for (stage = 0; stage < bq->stages; stage++) {
+        const float32_t *c = &bq->coeffs[stage * 5];
+        double          *d = bq->state[stage];
+
+        for (n = 0; n < len; n++) {
+            double x = data[n];
+            double y = c[0] * x + d[0];
+
+            d[0]    = c[1] * x + c[3] * y + d[1];
+            d[1]    = c[2] * x + c[4] * y;
+            data[n] = y;
+        }
+    }
+}
+
+static uint32_t
+ref_firdec(ref_firdec_t *fir, const double *in, uint32_t len, double *out)
+{
+    uint32_t produced = 0;
+    uint32_t n;
+    uint32_t k;
+
+    for (n = 0; n < len; n++) {
+        double sum = 0;
+
+        memmove(&fir->history[1], &fir->history[0], (FIR1_DEC_NCOEFFS - 1) * sizeof(double));
+        fir->history[0] = in[n];
+
+        if ((n % FIR_DEC_FACTOR) != FIR_DEC_FACTOR - 1)
+            continue;
+
+        for (k = 0; k < FIR1_DEC_NCOEFFS; k++)
+            sum += fir->history[k] * fir->coeffs[k];
+
+        out[produced++] = sum;
+    }
+
+    return produced;
+}
+
+static double
+ref_chain(ref_chain_t *chain, double *mixed)
+{
+    double fir1_out[FIR1_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+    double fir2_out[FIR2_DEC_BLOCKSIZE / FIR_DEC_FACTOR];
+
+    ref_biquad(&chain->biquad1, mixed, FIR1_DEC_BLOCKSIZE);
+    ref_firdec(&chain->fir1, mixed, FIR1_DEC_BLOCKSIZE, fir1_out);
+    ref_biquad(&chain->biquad2, fir1_out, FIR2_DEC_BLOCKSIZE);
+    ref_firdec(&chain->fir2, fir1_out, FIR2_DEC_BLOCKSIZE, fir2_out);
+    ref_biquad(&chain->biquad3, fir2_out, 1);
+
+    return fir2_out[0];
+}
+
+static void
+ref_chain_init(ref_chain_t *chain)
+{
+    memset(chain, 0, sizeof(*chain));
+
+    chain->biquad1.coeffs = biquad1_coeffs;
+    chain->biquad1.stages = BIQUAD1_NSTAGES;
+    chain->biquad2.coeffs = biquad2_coeffs;
+    chain->biquad2.stages = BIQUAD2_NSTAGES;
+    chain->biquad3.coeffs = biquad3_coeffs;
+    chain->biquad3.stages = BIQUAD3_NSTAGES;
+    chain->fir1.coeffs    = fir1_3kHz_coeffs;
+    chain->fir2.coeffs    = fir2_300Hz_coeffs;
+}
+
+static void
+track_error(chain_error_t *worst, double s, double c, double ref_s, double ref_c)
+{
+    double mag   = fabs(hypot(s, c) / hypot(ref_s, ref_c) - 1.0);
+    double phase = fabs(atan2(s, c) - atan2(ref_s, ref_c)) * 180.0 / M_PI;
+
+    if (mag > worst->mag)
+        worst->mag = mag;
+    if (phase > worst->phase)
+        worst->phase = phase;
+}
+
+static void
+run_case(const q31_case_t *tc)
+{
+    ref_chain_t   ref_sin, ref_cos;
+    chain_error_t f32_err = { 0, 0 };
+    chain_error_t q31_err = { 0, 0 };
+    uint32_t      n       = 0;
+    uint32_t      window;
+
+    hal_host_reset();
+    dsp_init();
+    reset_filters();
+    dsp_q31_init(fir1_3kHz_coeffs, fir2_300Hz_coeffs, biquad1_coeffs, biquad2_coeffs, biquad3_coeffs);
+    ref_chain_init(&ref_sin);
+    ref_chain_init(&ref_cos);
+
+    for (window = 0; window < TEST_WINDOWS; window++) {
+        double   f32_sin = 0, f32_cos = 0;
+        double   ref_s = 0, ref_c = 0;
+        q63_t    q31_sin = 0, q31_cos = 0;
+        uint32_t out;
+
+        for (out = 0; out < INTEGRATOR_LENGTH; out++) {
+            int32_t   block[BIQUAD1_BUFFSIZE];
+            q31_t     block_q31[BIQUAD1_BUFFSIZE];
+            double    mixed_sin[BIQUAD1_BUFFSIZE];
+            double    mixed_cos[BIQUAD1_BUFFSIZE];
+            uint32_t  phase = n % SINTABLE_LEN;
+            float32_t s, c;
+            q31_t     s_q31, c_q31;
+            uint16_t  idx;
+
+            for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++, n++) {
+                block[idx]     = (int32_t)lround(tc->amplitude * 8388607.0 *
+                                                 sin(2.0 * M_PI * n / SINTABLE_LEN + 0.7));
+                block_q31[idx] = dsp_q31_from_adc(block[idx]);
+                mixed_sin[idx] = block[idx] * (double)sin_table[n % SINTABLE_LEN];
+                mixed_cos[idx] = block[idx] * (double)cos_table[n % SINTABLE_LEN];
+            }
+
+            adc_block_handler(block, BIQUAD1_BUFFSIZE);
+            do_filter(&s, &c);
+            dsp_q31_filter_block(block_q31, phase, &s_q31, &c_q31);
+
+            f32_sin += s;
+            f32_cos += c;
+            q31_sin += s_q31;
+            q31_cos += c_q31;
+            ref_s += ref_chain(&ref_sin, mixed_sin);
+            ref_c += ref_chain(&ref_cos, mixed_cos);
+        }
+
+        if (window < TEST_SETTLED)
+            continue;
+
+        track_error(&f32_err, f32_sin, f32_cos, ref_s, ref_c);
+        track_error(&q31_err,
+                    dsp_q31_to_adc(q31_sin / INTEGRATOR_LENGTH),
+                    dsp_q31_to_adc(q31_cos / INTEGRATOR_LENGTH),
+                    ref_s / INTEGRATOR_LENGTH,
+                    ref_c / INTEGRATOR_LENGTH);
+    }
+
+    printf("amplitude %-7g  f32: |mag| %.2e |phase| %.2e deg   q31: |mag| %.2e |phase| %.2e deg\n",
+           tc->amplitude,
+           f32_err.mag,
+           f32_err.phase,
+           q31_err.mag,
+           q31_err.phase);
+
+    HOST_CHECK(q31_err.mag < tc->mag_tol);
+    HOST_CHECK(q31_err.phase < tc->phase_tol);
+}
+
+int
+main(void)
+{
+    static const q31_case_t cases[] = {
+        { 0.9, 5e-4, 5e-3 },
+        { 0.2, 5e-4, 5e-3 },
+        { 1e-3, 5e-4, 5e-2 },
+        { 5e-5, 5e-3, 5e-1 },
+    };
+    uint32_t idx;
+
+    for (idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++)
+        run_case(&cases[idx]);
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,112 @@
+//
+// Quadrature mixer (DSP_QUADRATURE): the routed I/Q sums equal mixing with
+// the four point tables followed by (1 2 3 4 3 2 1) / 16 and decimation by 4,
+// a sine at the excitation frequency gives its vector whatever the phase of
+// the blocks, and an ADC offset gives nothing.
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "DSP_quadrature.h"
+
+#define TEST_BLOCKS  6
+#define TEST_LEN     (TEST_BLOCKS * BIQUAD1_BUFFSIZE)
+#define TEST_OUTPUTS (TEST_LEN / QUADRATURE_LEN)
+/* outputs whose taps reach into the zeroed history */
+#define TEST_SETTLE  2
+
+static float32_t raw[TEST_LEN];
+static float32_t sin_out[TEST_OUTPUTS];
+static float32_t cos_out[TEST_OUTPUTS];
+
+static void
+run(uint32_t phase)
+{
+    Quadrature_t quad;
+    uint32_t     block;
+
+    dsp_quadrature_reset(&quad);
+
+    for (block = 0; block < TEST_BLOCKS; block++)
+        HOST_CHECK(dsp_quadrature_mix(&quad,
+                                      &raw[block * BIQUAD1_BUFFSIZE],
+                                      phase,
+                                      BIQUAD1_BUFFSIZE,
+                                      &sin_out[block * POLY1_DEC_BLOCKSIZE],
+                                      &cos_out[block * POLY1_DEC_BLOCKSIZE]) == POLY1_DEC_BLOCKSIZE);
+}
+
+/* raw[n] at table index (phase + n); the mixer starts from QUADRATURE_HISTORY zeros */
+static void
+test_reference(uint32_t phase)
+{
+    static const double weights[] = { 1, 2, 3, 4, 3, 2, 1 };
+    uint32_t            seed      = 7;
+    uint32_t            centre    = 3;
+    uint32_t            n;
+    uint32_t            idx;
+
+    for (n = 0; n < TEST_LEN; n++) {
+        seed   = seed * 1664525u + 1013904223u;
+        raw[n] = (float32_t)((int32_t)seed >> 8);
+    }
+
+    run(phase);
+
+    /* first sample at table index 0 that has three before it, counting the zeros */
+    while ((phase + centre + 2 * SINTABLE_LEN - QUADRATURE_HISTORY) % SINTABLE_LEN != 0)
+        centre++;
+
+    for (idx = 0; idx < TEST_OUTPUTS; idx++, centre += QUADRATURE_LEN) {
+        double sin_ref = 0;
+        double cos_ref = 0;
+        int    k;
+
+        for (k = -3; k <= 3; k++) {
+            uint32_t pos   = centre + k;
+            uint32_t table = (phase + pos + 2 * SINTABLE_LEN - QUADRATURE_HISTORY) % SINTABLE_LEN;
+            double   x     = pos < QUADRATURE_HISTORY ? 0 : raw[pos - QUADRATURE_HISTORY];
+
+            sin_ref += weights[k + 3] / 16 * x * sin_table[table];
+            cos_ref += weights[k + 3] / 16 * x * cos_table[table];
+        }
+
+        HOST_CHECK_NEAR(sin_out[idx], sin_ref, fabs(sin_ref) * 1e-6 + 1.0);
+        HOST_CHECK_NEAR(cos_out[idx], cos_ref, fabs(cos_ref) * 1e-6 + 1.0);
+    }
+}
+
+static void
+test_vector(uint32_t phase, double amplitude, double phi)
+{
+    uint32_t n;
+    uint32_t idx;
+
+    for (n = 0; n < TEST_LEN; n++)
+        raw[n] = (float32_t)(amplitude * sin(2.0 * M_PI * (phase + n) / SINTABLE_LEN + phi) + 1000.0);
+
+    run(phase);
+
+    for (idx = TEST_SETTLE; idx < TEST_OUTPUTS; idx++) {
+        HOST_CHECK_NEAR(sin_out[idx], amplitude / 2 * cos(phi), amplitude * 1e-6);
+        HOST_CHECK_NEAR(cos_out[idx], amplitude / 2 * sin(phi), amplitude * 1e-6);
+    }
+}
+
+int
+main(void)
+{
+    uint32_t phase;
+
+    for (phase = 0; phase < QUADRATURE_LEN; phase++) {
+        test_reference(phase);
+        test_vector(phase, 1e5, 0.5);
+        test_vector(phase, 3e6, -2.0);
+    }
+
+    return HOST_TEST_RESULT();
+}
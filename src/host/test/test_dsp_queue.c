@@ -0,0 +1,169 @@
+//
+// Block queue between the ADC interrupt and do_filter(): blocks come out in
+// order across the wrap, a full queue drops the new block instead of the
+// waiting ones and marks the gap behind them, and a main loop that stalls
+// for longer than the queue holds gets the drops counted and its readings
+// flagged until the window is clear.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "signal_conditioning.h"
+
+#define TEST_AMPLITUDE 0.2
+#define TEST_STALL     20
+
+static uint32_t n;
+
+static void
+test_ring(void)
+{
+    Dsp_queue_t queue;
+    uint32_t    payload[DSP_QUEUE_LEN];
+    uint32_t    written = 0;
+    uint32_t    read    = 0;
+    uint32_t    slot;
+    uint32_t    round;
+    uint32_t    idx;
+
+    dsp_queue_reset(&queue);
+    HOST_CHECK(!dsp_queue_read_slot(&queue, &slot));
+
+    /* one slot is always the interrupt's */
+    for (idx = 0; idx < DSP_QUEUE_LEN - 1; idx++) {
+        payload[dsp_queue_write_slot(&queue)] = written++;
+        HOST_CHECK(dsp_queue_publish(&queue));
+    }
+
+    slot = dsp_queue_write_slot(&queue);
+    payload[slot] = 1000;
+    HOST_CHECK(!dsp_queue_publish(&queue));
+    HOST_CHECK(dsp_queue_write_slot(&queue) == slot);
+    HOST_CHECK(dsp_queue_stats(&queue).dropped == 1);
+    HOST_CHECK(dsp_queue_stats(&queue).blocks == DSP_QUEUE_LEN);
+    HOST_CHECK(dsp_queue_stats(&queue).high_water == DSP_QUEUE_LEN - 1);
+
+    /* the blocks that waited at the drop come before the gap, the next one after it */
+    for (idx = 0; idx < DSP_QUEUE_LEN - 1; idx++) {
+        HOST_CHECK(dsp_queue_read_slot(&queue, &slot));
+        HOST_CHECK(payload[slot] == read++);
+        HOST_CHECK(!dsp_queue_gap(&queue));
+        dsp_queue_release(&queue);
+    }
+
+    payload[dsp_queue_write_slot(&queue)] = written++;
+    HOST_CHECK(dsp_queue_publish(&queue));
+    HOST_CHECK(dsp_queue_read_slot(&queue, &slot));
+    HOST_CHECK(payload[slot] == read++);
+    HOST_CHECK(dsp_queue_gap(&queue));
+    HOST_CHECK(!dsp_queue_gap(&queue));
+    dsp_queue_release(&queue);
+
+    /* uneven producer and consumer over many wraps */
+    for (round = 0; round < 100; round++) {
+        for (idx = 0; idx < round % 3 + 1 && dsp_queue_read_slot(&queue, &slot); idx++) {
+            HOST_CHECK(payload[slot] == read++);
+            dsp_queue_release(&queue);
+        }
+
+        for (idx = 0; idx < round % 2 + 1; idx++) {
+            payload[dsp_queue_write_slot(&queue)] = written;
+            if (dsp_queue_publish(&queue))
+                written++;
+        }
+    }
+
+    while (dsp_queue_read_slot(&queue, &slot)) {
+        HOST_CHECK(payload[slot] == read++);
+        dsp_queue_release(&queue);
+    }
+
+    HOST_CHECK(read == written);
+}
+
+static void
+feed(uint32_t blocks)
+{
+    int32_t  block[BIQUAD1_BUFFSIZE];
+    uint32_t idx;
+
+    while (blocks--) {
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++, n++)
+            block[idx] = (int32_t)lround(8388607.0 * TEST_AMPLITUDE * sin(2.0 * M_PI * n / SINTABLE_LEN + 0.5));
+
+        adc_block_handler(block, BIQUAD1_BUFFSIZE);
+    }
+}
+
+/* feeds block by block until a reading comes out; false if none within limit blocks */
+static bool
+next_reading(uint32_t limit)
+{
+    while (limit--) {
+        feed(1);
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready) {
+            clamp_measurements_result.new_data_is_ready = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void
+test_stall(void)
+{
+    Dsp_queue_stats_t stats;
+    uint32_t          readings = 0;
+    uint32_t          idx;
+
+    hal_host_reset();
+    dsp_init();
+    reset_filters();
+    n = 0;
+
+    for (idx = 0; idx < INTEGRATOR_LENGTH; idx++)
+        if (next_reading(1))
+            HOST_CHECK(!clamp_measurements_result.data_lost);
+
+    stats = dsp_block_queue_stats();
+    HOST_CHECK(stats.dropped == 0);
+    HOST_CHECK(stats.high_water == 1);
+    HOST_CHECK(stats.max_lag == 1);
+
+    /* the UI holds the main loop for TEST_STALL blocks */
+    feed(TEST_STALL);
+    stats = dsp_block_queue_stats();
+    HOST_CHECK(stats.dropped == TEST_STALL - (DSP_QUEUE_LEN - 1));
+    HOST_CHECK(stats.high_water == DSP_QUEUE_LEN - 1);
+
+    /* one call drains everything that waited */
+    dsp_integrating_filter();
+    stats = dsp_block_queue_stats();
+    HOST_CHECK(stats.max_lag == TEST_STALL);
+    HOST_CHECK(stats.blocks == INTEGRATOR_LENGTH + TEST_STALL);
+    HOST_CHECK(clamp_measurements_result.data_lost);
+
+    /* flagged until the window has moved past the gap */
+    while (next_reading(1) && clamp_measurements_result.data_lost)
+        readings++;
+
+    HOST_CHECK(!clamp_measurements_result.data_lost);
+    HOST_CHECK(readings + DSP_QUEUE_LEN - 1 >= INTEGRATOR_LENGTH);
+    HOST_CHECK(readings <= INTEGRATOR_LENGTH + DSP_QUEUE_LEN);
+}
+
+int
+main(void)
+{
+    test_ring();
+    test_stall();
+
+    return HOST_TEST_RESULT();
+}
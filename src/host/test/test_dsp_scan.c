@@ -0,0 +1,168 @@
+//
+// MEASUREMENT_MODE_SCAN: the stream moves the MUX VOLTAGE -> SHUNT -> CLAMP
+// at block boundaries while the three sensors see different signals, each
+// sensor is filtered in its own bank and all three results come out as if
+// it had been measured alone. The first conversions after every MUX change
+// are garbage in the model, so they only pass if the settling blocks are
+// dropped.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+#define TEST_V_OVRL         0.2
+#define TEST_V_SHUNT        0.05
+#define TEST_SHUNT_PHI      0.5
+#define TEST_I_CLAMP        0.02
+#define TEST_CLAMP_PHI      -1.0
+/* conversions after a MUX change that are not the new input yet */
+#define TEST_GARBAGE        (MCP3462_STREAM_BLOCKLEN / 2)
+#define TEST_GARBAGE_LEVEL  0.4f
+#define TEST_OVERALL_GAIN   6
+#define TEST_INTEGRATOR_LEN 40
+#define TEST_BLOCKS         8000
+
+typedef struct {
+    uint8_t  mux;
+    uint32_t changed_at;
+} scan_source_t;
+
+static float
+scan_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    scan_source_t *src   = ctx;
+    double         phase = 2.0 * M_PI * index / SINTABLE_LEN;
+
+    if (mux != src->mux) {
+        src->mux        = mux;
+        src->changed_at = index;
+    }
+
+    /* at the excitation frequency, so that no demodulator rejects it */
+    if (index - src->changed_at < TEST_GARBAGE)
+        return TEST_GARBAGE_LEVEL * (float)cos(phase);
+
+    switch (mux >> 4) {
+    case REF_CH4: return (float)(TEST_V_OVRL * sin(phase));
+    case REF_CH2: return (float)(TEST_V_SHUNT * sin(phase + TEST_SHUNT_PHI));
+    case REF_CH0: return (float)(TEST_I_CLAMP * sin(phase + TEST_CLAMP_PHI));
+    default: return 0;
+    }
+}
+
+/* a lock-in output of FS / 2 per unit of input reads as 1 V (1 A) */
+static void
+setup_calibration(void)
+{
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+    Cal_data.shunt_gain[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]] = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.shunt_phi[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]]  = 0;
+    Cal_data.clamp_gain[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.clamp_phi[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]]  = 0;
+    dsp_calibration_changed();
+}
+
+/* streams blocks, realigning on data ready after every deferred register write */
+static void
+run(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+static void
+test_scan(void)
+{
+    mcp3462_model_t adc;
+    scan_source_t   src = { 0, 0 };
+    uint32_t        mux_writes;
+    double          v_applied;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, scan_source, &src);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    dsp_set_integrator_len(TEST_INTEGRATOR_LEN);
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    Analog.overall_gain = TEST_OVERALL_GAIN;
+    measurement_set_mode(MEASUREMENT_MODE_SCAN);
+
+#ifndef DSP_BLOCK_MIXER
+    /* the sample mixer filters in the interrupt and can't keep banks */
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_MANUAL);
+    dsp_acquisition_stop();
+    return;
+#endif
+
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_SCAN);
+    HOST_CHECK(!Analog.AGC_on);
+    mux_writes = adc.mux_writes;
+
+    run(&adc, TEST_BLOCKS);
+
+    HOST_CHECK(adc.conversions >= TEST_BLOCKS * MCP3462_STREAM_BLOCKLEN);
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+
+    /* one switch per dwell, plus the block in flight and the dropped one */
+    HOST_CHECK(adc.mux_writes - mux_writes >= TEST_BLOCKS / (SCAN_DWELL_BLOCKS + SCAN_SETTLE_BLOCKS + 2));
+    HOST_CHECK(adc.mux_writes - mux_writes <= TEST_BLOCKS / SCAN_DWELL_BLOCKS + 1);
+
+    /* each sensor at its own ADC gain, and calibrated with it */
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, 0.005 * TEST_V_OVRL);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt, TEST_V_SHUNT, 0.005 * TEST_V_SHUNT);
+    HOST_CHECK_NEAR(clamp_measurements_result.I_clamp, TEST_I_CLAMP, 0.005 * TEST_I_CLAMP);
+
+    /* V_applied = V_ovrl - V_shunt needs the phases of both banks to agree */
+    v_applied = sqrt(TEST_V_OVRL * TEST_V_OVRL + TEST_V_SHUNT * TEST_V_SHUNT -
+                     2 * TEST_V_OVRL * TEST_V_SHUNT * cos(TEST_SHUNT_PHI));
+    HOST_CHECK_NEAR(clamp_measurements_result.V_applied, v_applied, 0.005 * v_applied);
+
+    /* back to the selected sensor alone, with its bank */
+    measurement_set_mode(MEASUREMENT_MODE_MANUAL);
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_MANUAL);
+    HOST_CHECK(Analog.selected_sensor == VOLTAGE_SENSOR);
+
+    run(&adc, 4 * TEST_INTEGRATOR_LEN);
+
+    HOST_CHECK(mcp3462_model_mux(&adc) >> 4 == REF_CH4);
+    HOST_CHECK(mcp3462_model_gain(&adc) == 1.0f);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, 0.005 * TEST_V_OVRL);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_scan();
+
+    return HOST_TEST_RESULT();
+}
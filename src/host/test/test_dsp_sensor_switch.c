@@ -0,0 +1,156 @@
+//
+// Manual sensor switches: the shunt is ranged by the AGC, the voltage sensor
+// is read for a while and the shunt is selected again. It must come back at
+// the range it was left at and, from its own filter bank, give the right
+// reading within a few blocks instead of a whole settle time.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "menu_calibration.h"
+#include "signal_conditioning.h"
+
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+#define TEST_V_OVRL         0.2
+#define TEST_V_SHUNT        0.004
+#define TEST_INTEGRATOR_LEN 40
+#define TEST_SETTLE_BLOCKS  6000
+/* the block in flight, the one with the MUX change, the settling one and the first reading */
+#define TEST_RESUME_BLOCKS  (SCAN_SETTLE_BLOCKS + 3)
+#define TEST_TOLERANCE      0.01
+
+/* the shunt amplifier of the model, per front-end setting */
+static const double fe_gain[] = { 1, 2, 5, 10, 20 };
+
+static float
+sensor_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    double phase = 2.0 * M_PI * index / SINTABLE_LEN;
+
+    (void)ctx;
+
+    switch (mux >> 4) {
+    case REF_CH4: return (float)(TEST_V_OVRL * sin(phase));
+    case REF_CH2: return (float)(TEST_V_SHUNT * fe_gain[Analog.shunt_sensor_gain] * sin(phase));
+    default: return 0;
+    }
+}
+
+/* a lock-in output of FS / 2 per unit at the sensor reads as 1 V */
+static void
+setup_calibration(void)
+{
+    uint8_t gain;
+
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+
+    for (gain = 0; gain < sizeof(fe_gain) / sizeof(fe_gain[0]); gain++) {
+        Cal_data.shunt_gain[gain] = (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * fe_gain[gain]);
+        Cal_data.shunt_phi[gain]  = 0;
+    }
+
+    dsp_calibration_changed();
+}
+
+/* streams blocks, realigning on data ready after every deferred register write */
+static void
+run(mcp3462_model_t *adc, uint32_t blocks)
+{
+    uint32_t end = adc->conversions + blocks * MCP3462_STREAM_BLOCKLEN;
+
+    while (adc->conversions < end) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+    }
+}
+
+static void
+test_sensor_switch(void)
+{
+    mcp3462_model_t adc;
+    uint8_t         shunt_gain;
+    float           adc_gain;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, sensor_source, NULL);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    dsp_set_integrator_len(TEST_INTEGRATOR_LEN);
+    switch_sensing_chanel(SHUNT_SENSOR);
+    HOST_CHECK(Analog.AGC_on);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    /* the AGC finds the shunt range */
+    run(&adc, TEST_SETTLE_BLOCKS);
+
+    shunt_gain = Analog.overall_gain;
+    adc_gain   = mcp3462_model_gain(&adc);
+    HOST_CHECK(shunt_gain > 0);
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt, TEST_V_SHUNT, TEST_TOLERANCE * TEST_V_SHUNT);
+
+    /* the voltage sensor at GAIN_1, with the shunt amplifier off */
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    HOST_CHECK(!Analog.AGC_on);
+    HOST_CHECK(Analog.shunt_sensor_gain == 0);
+
+    run(&adc, TEST_SETTLE_BLOCKS);
+
+    HOST_CHECK(mcp3462_model_mux(&adc) >> 4 == REF_CH4);
+    HOST_CHECK(mcp3462_model_gain(&adc) == 1.0f);
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, TEST_TOLERANCE * TEST_V_OVRL);
+
+    /* back to the shunt: its range at once, and a fresh reading from its warm bank */
+    switch_sensing_chanel(SHUNT_SENSOR);
+    HOST_CHECK(Analog.overall_gain == shunt_gain);
+    HOST_CHECK(Analog.shunt_sensor_gain == shunt_sensor_gain_preset[shunt_gain]);
+
+    clamp_measurements_result.V_shunt = 0;
+    run(&adc, TEST_RESUME_BLOCKS);
+
+    HOST_CHECK(mcp3462_model_mux(&adc) >> 4 == REF_CH2);
+    HOST_CHECK(mcp3462_model_gain(&adc) == adc_gain);
+    HOST_CHECK(Analog.overall_gain == shunt_gain);
+    HOST_CHECK(adc.clipped == 0);
+#ifdef DSP_BLOCK_MIXER
+    HOST_CHECK_NEAR(clamp_measurements_result.V_shunt, TEST_V_SHUNT, TEST_TOLERANCE * TEST_V_SHUNT);
+#endif
+
+    /* and the voltage sensor again, from its own bank */
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    clamp_measurements_result.V_ovrl = 0;
+    run(&adc, TEST_RESUME_BLOCKS);
+
+#ifdef DSP_BLOCK_MIXER
+    HOST_CHECK_NEAR(clamp_measurements_result.V_ovrl, TEST_V_OVRL, TEST_TOLERANCE * TEST_V_OVRL);
+#endif
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_sensor_switch();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,248 @@
+//
+// Impedance spectrum of an RC load, end to end: the sweep steps the ADC rate
+// and with it the excitation, the model evaluates the load at the frequency
+// of its current CONFIG1, and every point of the spectrum has to match the
+// load at the frequency it is reported at; only the point at the nominal
+// rate is marked calibrated. A restart of the readings in the middle of a
+// step makes the sweep wait for final readings again. The sweep is started
+// from the measurement page key, and afterwards the nominal rate, mode and
+// profile are back.
+//
+
+#include <complex.h>
+#include <math.h>
+
+/* the firmware names its phasor components I and Q */
+#undef I
+#define J _Complex_I
+
+#include "hal_host.h"
+#include "mcp3462_model.h"
+#include "host_test.h"
+
+#include "DSP_calibration.h"
+#include "DSP_functions.h"
+#include "keyboard.h"
+#include "menu_calibration.h"
+#include "menu_ili9486_kbrd_mngr.h"
+#include "menu_types_ili9486.h"
+#include "signal_conditioning.h"
+#include "sweep.h"
+
+/*
+ * the generator drives R_SHUNT in series with R_LOAD || C_LOAD, the clamp
+ * is around the capacitor lead and gives TEST_CLAMP_OHMS volts per amp
+ */
+#define TEST_DR_MASK        (1u << MCP3462_IRQ_PIN)
+#define TEST_V_OVRL         0.2
+#define TEST_R_LOAD         1000.0
+#define TEST_C_LOAD         180e-9
+#define TEST_CLAMP_OHMS     1000.0
+#define TEST_OVERALL_GAIN   1
+#define TEST_HORIZON_BLOCKS 8000
+#define TEST_TOLERANCE      0.01
+#define TEST_PHI_TOLERANCE  1.0
+/* a range or excitation move restarts the readings here, once the step has settled */
+#define TEST_RESTART_STEP   1
+#define TEST_ALL_SENSORS    ((1u << SHUNT_SENSOR) | (1u << CLAMP_SENSOR) | (1u << VOLTAGE_SENSOR))
+
+/* OSR * PRE of the sweep points, and the nominal one */
+static const uint32_t sweep_ratio[SWEEP_POINTS] = { 1024, 512, 256, 128, 64 };
+
+static double
+deg(double complex z)
+{
+    return carg(z) * 180.0 / M_PI;
+}
+
+/* difference of two angles in degrees, folded into -180 ... 180 */
+static double
+angle_diff(double a, double b)
+{
+    return remainder(a - b, 360.0);
+}
+
+static double complex
+load_admittance(double freq_hz)
+{
+    return 1.0 / TEST_R_LOAD + J * 2.0 * M_PI * freq_hz * TEST_C_LOAD;
+}
+
+/* the lock-in reads Re(p) cos + Im(p) sin of the excitation phase as the phasor p */
+static float
+load_source(void *ctx, uint8_t mux, uint32_t index)
+{
+    const mcp3462_model_t *adc       = ctx;
+    double                 freq_hz   = mcp3462_model_rate(adc) / SINTABLE_LEN;
+    double                 phase     = 2.0 * M_PI * index / SINTABLE_LEN;
+    double complex         Y_load    = load_admittance(freq_hz);
+    double complex         V_applied = TEST_V_OVRL / (1.0 + R_SHUNT * Y_load);
+    double complex         p;
+
+    switch (mux >> 4) {
+    case REF_CH4: p = TEST_V_OVRL; break;
+    case REF_CH2: p = TEST_V_OVRL - V_applied; break;
+    case REF_CH0: p = TEST_CLAMP_OHMS * J * 2.0 * M_PI * freq_hz * TEST_C_LOAD * V_applied; break;
+    default: return 0;
+    }
+
+    return (float)(creal(p) * cos(phase) + cimag(p) * sin(phase));
+}
+
+/* a lock-in output of FS / 2 per unit of input reads as 1 V (1 A) */
+static void
+setup_calibration(void)
+{
+    Calibrator.is_calibrating      = false;
+    Clamp_calibrator.is_calibrated = false;
+    Cal_data.v_sens_gain           = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.v_sens_phi            = 0;
+    Cal_data.shunt_gain[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]] = MCP3462_MODEL_FULLSCALE / 2.0f;
+    Cal_data.shunt_phi[shunt_sensor_gain_preset[TEST_OVERALL_GAIN]]  = 0;
+    Cal_data.clamp_gain[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] =
+        (float32_t)(MCP3462_MODEL_FULLSCALE / 2.0 * TEST_CLAMP_OHMS);
+    Cal_data.clamp_phi[clamp_sensor_gain_preset[TEST_OVERALL_GAIN]] = 0;
+    dsp_calibration_changed();
+}
+
+static void
+press_key(uint16_t key)
+{
+    MMMenu.current_menu = MENU_MEASURE;
+    Keyboard.keys       = key;
+    kbrd_manager();
+}
+
+/*
+ * streams until the sweep is done, realigning on data ready after every
+ * deferred register write; with restart, the readings are restarted once in
+ * TEST_RESTART_STEP and the point of the step must come from settled, final
+ * readings taken after that
+ */
+static void
+run_sweep(mcp3462_model_t *adc, bool restart)
+{
+    uint32_t end       = adc->conversions + TEST_HORIZON_BLOCKS * MCP3462_STREAM_BLOCKLEN;
+    bool     restarted = false;
+    bool     taken     = false;
+
+    while (adc->conversions < end && Sweep.state != SWEEP_DONE) {
+        if (MCP3462_stream_state() == MCP3462_STREAM_ARMED)
+            hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+        if (hal_host_spi_pdc_run(MCP3462_SAMPLE_BYTES) != MCP3462_SAMPLE_BYTES)
+            break;
+
+        dsp_integrating_filter();
+
+        if (restart && !restarted && Sweep.state == SWEEP_SETTLING && Sweep.step == TEST_RESTART_STEP &&
+            Sweep.settled && clamp_measurements_result.final_sensors != 0) {
+            dsp_restart_readings();
+            restarted = true;
+
+            HOST_CHECK(clamp_measurements_result.final_sensors == 0);
+        }
+
+        /* the point of the step has just been taken */
+        if (restarted && !taken && Sweep.step > TEST_RESTART_STEP) {
+            HOST_CHECK(clamp_measurements_result.final_sensors == TEST_ALL_SENSORS);
+            HOST_CHECK(dsp_blocks_since_restart() >= SWEEP_SETTLE_BLOCKS);
+            taken = true;
+        }
+    }
+
+    HOST_CHECK(restarted == restart);
+    HOST_CHECK(taken == restart);
+}
+
+static void
+test_sweep(void)
+{
+    mcp3462_model_t adc;
+    double complex  Y_load;
+    double          freq_hz;
+    uint8_t         step;
+
+    hal_host_reset();
+    mcp3462_model_init(&adc, load_source, &adc);
+    mcp3462_model_attach(&adc);
+
+    dsp_init();
+    setup_calibration();
+    switch_sensing_chanel(VOLTAGE_SENSOR);
+    reset_filters();
+    dsp_acquisition_start();
+    hal_host_pio_fire(PIOA, TEST_DR_MASK);
+
+    Analog.overall_gain        = TEST_OVERALL_GAIN;
+    Analog.generator_is_active = true;
+
+#ifndef DSP_BLOCK_MIXER
+    /* the sample mixer can't scan the sensors */
+    HOST_CHECK(!sweep_start());
+    HOST_CHECK(Sweep.state == SWEEP_IDLE);
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_MANUAL);
+    dsp_acquisition_stop();
+    return;
+#endif
+
+    press_key(KEY_LEFT);
+    HOST_CHECK(sweep_is_running());
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_SCAN);
+    HOST_CHECK(clamp_measurements_result.profile == DSP_PROFILE_FAST);
+    HOST_CHECK(!sweep_start());
+
+    run_sweep(&adc, true);
+
+    HOST_CHECK(Sweep.state == SWEEP_DONE);
+    HOST_CHECK(adc.clipped == 0);
+    HOST_CHECK(dsp_block_queue_stats().dropped == 0);
+
+    for (step = 0; step < SWEEP_POINTS; step++) {
+        const Sweep_point_t *point = &Sweep.spectrum[step];
+
+        freq_hz = MCP3462_MODEL_MCLK_HZ / (4.0 * sweep_ratio[step] * SINTABLE_LEN);
+        Y_load  = load_admittance(freq_hz);
+
+        HOST_CHECK_NEAR(point->freq_hz, freq_hz, 1e-4 * freq_hz);
+        HOST_CHECK(!point->data_lost);
+        HOST_CHECK(point->final);
+        HOST_CHECK(point->calibrated == (sweep_ratio[step] == MCP3462_OSR_RATIO * MCP3462_PRE_RATIO));
+
+        HOST_CHECK_NEAR(point->Z_ovrl, 1.0 / cabs(Y_load), TEST_TOLERANCE / cabs(Y_load));
+        HOST_CHECK_NEAR(angle_diff(point->Z_ovrl_phi, deg(Y_load)), 0, TEST_PHI_TOLERANCE);
+
+        /* the clamp only sees the capacitor */
+        HOST_CHECK_NEAR(point->Z_clamp * 2.0 * M_PI * freq_hz * TEST_C_LOAD, 1.0, TEST_TOLERANCE);
+        HOST_CHECK_NEAR(angle_diff(point->Z_clamp_phi, 90.0), 0, TEST_PHI_TOLERANCE);
+    }
+
+    /* the load has a corner inside the sweep */
+    HOST_CHECK(Sweep.spectrum[0].Z_ovrl > 2.0 * Sweep.spectrum[SWEEP_POINTS - 1].Z_ovrl);
+
+    HOST_CHECK(MCP3462_get_rate() == MCP3462_OSR_RATIO * MCP3462_PRE_RATIO);
+    HOST_CHECK(mcp3462_model_rate(&adc) == MCP3462_MODEL_MCLK_HZ / (4.0f * MCP3462_OSR_RATIO));
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_MANUAL);
+    HOST_CHECK(clamp_measurements_result.profile == DSP_PROFILE_NORMAL);
+
+    /* a second press stops a sweep under way, and the nominal rate comes back */
+    press_key(KEY_LEFT);
+    HOST_CHECK(sweep_is_running());
+    press_key(KEY_LEFT);
+    HOST_CHECK(!sweep_is_running());
+
+    run_sweep(&adc, false);
+    HOST_CHECK(Sweep.state == SWEEP_DONE);
+    HOST_CHECK(MCP3462_get_rate() == MCP3462_OSR_RATIO * MCP3462_PRE_RATIO);
+    HOST_CHECK(Analog.mes_mode == MEASUREMENT_MODE_MANUAL);
+
+    dsp_acquisition_stop();
+}
+
+int
+main(void)
+{
+    test_sweep();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,148 @@
+//
+// fastmath.h against double precision libm over the whole input range of
+// each function; the limits are the error bounds documented in the header.
+//
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "host_test.h"
+
+#include "fastmath.h"
+
+#define SWEEP_STEPS 2000000
+
+static void
+report(const char *name, double worst, double at)
+{
+    printf("%-14s max error %.3g at %.9g\n", name, worst, at);
+}
+
+static void
+test_atan2(void)
+{
+    double   worst = 0;
+    double   at    = 0;
+    uint32_t idx;
+
+    /* every direction, at magnitudes across the float range */
+    for (idx = 0; idx < SWEEP_STEPS; idx++) {
+        double theta = -M_PI + 2.0 * M_PI * idx / SWEEP_STEPS;
+        double mag   = ldexp(1.0, (int)(idx % 200) - 100);
+        float  y     = (float)(mag * sin(theta));
+        float  x     = (float)(mag * cos(theta));
+        double err   = fabs(fast_atan2f(y, x) - atan2((double)y, (double)x));
+
+        /* -pi and pi are the same direction */
+        if (err > M_PI)
+            err = fabs(err - 2.0 * M_PI);
+
+        if (err > worst) {
+            worst = err;
+            at    = theta;
+        }
+    }
+
+    report("fast_atan2f", worst, at);
+    HOST_CHECK(worst <= 4e-7);
+
+    HOST_CHECK(fast_atan2f(0, 0) == 0);
+    HOST_CHECK_NEAR(fast_atan2f(0, -1), M_PI, 4e-7);
+    HOST_CHECK_NEAR(fast_atan2f(-1, 0), -M_PI / 2, 4e-7);
+    HOST_CHECK_NEAR(fast_atan2f(1e-30f, 1e30f), 0, 4e-7);
+}
+
+static void
+test_sincos(double range)
+{
+    double   worst = 0;
+    double   at    = 0;
+    uint32_t idx;
+
+    /* error relative to the documented bound 2.5e-7 + 9e-8 |x| */
+    for (idx = 0; idx <= SWEEP_STEPS; idx++) {
+        float  x = (float)(-range + 2.0 * range * idx / SWEEP_STEPS);
+        float  sine;
+        float  cosine;
+        double err;
+
+        fast_sincosf(x, &sine, &cosine);
+
+        err = fmax(fabs(sine - sin((double)x)), fabs(cosine - cos((double)x)));
+        err = fmax(err, fabs(fast_sinf(x) - sin((double)x)));
+        err = fmax(err, fabs(fast_cosf(x) - cos((double)x)));
+        err /= 2.5e-7 + 9e-8 * fabs(x);
+
+        if (err > worst) {
+            worst = err;
+            at    = x;
+        }
+    }
+
+    printf("fast_sincosf   max error %.3g of the bound at %.9g\n", worst, at);
+    HOST_CHECK(worst <= 1.0);
+}
+
+static void
+test_hypot(void)
+{
+    double   worst = 0;
+    double   at    = 0;
+    uint32_t idx;
+
+    for (idx = 0; idx < SWEEP_STEPS; idx++) {
+        double theta = 2.0 * M_PI * idx / SWEEP_STEPS;
+        double mag   = ldexp(1.0 + (idx % 997) / 997.0, (int)(idx % 110) - 50);
+        float  x     = (float)(mag * cos(theta));
+        float  y     = (float)(mag * sin(theta));
+        double ref   = hypot((double)x, (double)y);
+        double err   = fabs(fast_hypotf(x, y) - ref) / ref;
+
+        if (err > worst) {
+            worst = err;
+            at    = ref;
+        }
+    }
+
+    report("fast_hypotf", worst, at);
+    HOST_CHECK(worst <= 2.4e-7);
+}
+
+static void
+test_log2(void)
+{
+    double          worst = 0;
+    double          at    = 0;
+    fastmath_bits_t bits;
+
+    /* every 7th positive normal float */
+    for (bits.u = 0x00800000; bits.u < 0x7f800000; bits.u += 7) {
+        double ref = log2((double)bits.f);
+        /* less the rounding of the result to float */
+        double err = fabs(fast_log2f(bits.f) - ref) - fabs(ref) * FLT_EPSILON / 2;
+
+        if (err > worst) {
+            worst = err;
+            at    = bits.f;
+        }
+    }
+
+    report("fast_log2f", worst, at);
+    HOST_CHECK(worst <= 3e-7);
+
+    HOST_CHECK(fast_log2f(1.0f) == 0);
+    HOST_CHECK(fast_log2f(0.0f) == -127);
+}
+
+int
+main(void)
+{
+    test_atan2();
+    test_sincos(4.0 * M_PI);
+    test_sincos(1e5);
+    test_hypot();
+    test_log2();
+
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+//
+// Cycle profiler: min/max/mean bookkeeping, the ISR load derived from the ADC
+// sample period, and the instrumented regions of the lock-in chain counting
+// their calls. Built once with PROFILER_ENABLE and once without, where the
+// hot paths must not record anything.
+//
+
+#include <math.h>
+
+#include "hal_host.h"
+#include "host_test.h"
+
+#include "DSP_functions.h"
+#include "profiler.h"
+#include "signal_conditioning.h"
+
+#define TEST_BLOCKS 200
+
+static void
+test_bookkeeping(void)
+{
+    Profile_t results;
+
+    profiler_reset();
+
+    profiler_record(PROFILE_DISPLAY_REFRESH, 300);
+    profiler_record(PROFILE_DISPLAY_REFRESH, 100);
+    profiler_record(PROFILE_DISPLAY_REFRESH, 200);
+
+    results = profiler_results();
+    HOST_CHECK(results.region[PROFILE_DISPLAY_REFRESH].calls == 3);
+    HOST_CHECK(results.region[PROFILE_DISPLAY_REFRESH].min == 100);
+    HOST_CHECK(results.region[PROFILE_DISPLAY_REFRESH].max == 300);
+    HOST_CHECK(results.region[PROFILE_DISPLAY_REFRESH].mean == 200);
+    HOST_CHECK(results.region[PROFILE_DISPLAY_REFRESH].total == 600);
+    HOST_CHECK(results.region[PROFILE_DO_FILTER].calls == 0);
+    HOST_CHECK(results.isr_load == 0);
+
+    /* 120 MHz core, 20 MHz MCLK / (4 * OSR 256) */
+    HOST_CHECK(results.clock_hz == HAL_HOST_CPU_HZ);
+    HOST_CHECK(results.sample_cycles == 6144);
+
+    /* half a sample period for one sample, then a tenth for a block */
+    profiler_record_isr(PROFILE_ADC_ISR, 3072, 1);
+    profiler_record_isr(PROFILE_ADC_ISR, 61440, 100);
+
+    results = profiler_results();
+    HOST_CHECK(results.isr_samples == 101);
+    HOST_CHECK_NEAR(results.isr_load, 100.0 * (3072 + 61440) / (101 * 6144.0), 1e-3);
+    HOST_CHECK_NEAR(results.isr_load_peak, 50.0, 1e-3);
+
+    profiler_reset();
+    results = profiler_results();
+    HOST_CHECK(results.region[PROFILE_ADC_ISR].calls == 0);
+    HOST_CHECK(results.isr_samples == 0);
+    HOST_CHECK(results.isr_load_peak == 0);
+}
+
+static void
+test_regions(void)
+{
+    int32_t   block[BIQUAD1_BUFFSIZE];
+    uint32_t  readings = 0;
+    uint32_t  n        = 0;
+    uint32_t  blocks;
+    uint32_t  idx;
+    Profile_t results;
+
+    hal_host_reset();
+    dsp_init();
+    reset_filters();
+    profiler_init();
+
+    for (blocks = 0; blocks < TEST_BLOCKS; blocks++) {
+        for (idx = 0; idx < BIQUAD1_BUFFSIZE; idx++, n++)
+            block[idx] = (int32_t)lround(8388607.0 * 0.2 * sin(2.0 * M_PI * n / SINTABLE_LEN + 0.5));
+
+        adc_block_handler(block, BIQUAD1_BUFFSIZE);
+        dsp_integrating_filter();
+
+        if (clamp_measurements_result.new_data_is_ready) {
+            clamp_measurements_result.new_data_is_ready = false;
+            readings++;
+        }
+    }
+
+    HOST_CHECK(readings > 0);
+
+    results = profiler_results();
+
+#ifdef PROFILER_ENABLE
+    HOST_CHECK(results.region[PROFILE_ADC_ISR].calls == TEST_BLOCKS);
+    HOST_CHECK(results.isr_samples == TEST_BLOCKS * BIQUAD1_BUFFSIZE);
+    HOST_CHECK(results.region[PROFILE_DO_FILTER].calls == TEST_BLOCKS);
+    HOST_CHECK(results.region[PROFILE_MANAGE_SENSED_DATA].calls == readings);
+
+    for (idx = PROFILE_ADC_ISR; idx <= PROFILE_MANAGE_SENSED_DATA; idx++) {
+        HOST_CHECK(results.region[idx].min <= results.region[idx].mean);
+        HOST_CHECK(results.region[idx].mean <= results.region[idx].max);
+        HOST_CHECK(results.region[idx].max > 0);
+    }
+
+    HOST_CHECK(results.isr_load > 0);
+    HOST_CHECK(results.isr_load_peak >= results.isr_load);
+#else
+    for (idx = 0; idx < PROFILE_REGIONS; idx++)
+        HOST_CHECK(results.region[idx].calls == 0);
+
+    HOST_CHECK(results.isr_samples == 0);
+#endif
+}
+
+int
+main(void)
+{
+    test_bookkeeping();
+    test_regions();
+
+    return HOST_TEST_RESULT();
+}